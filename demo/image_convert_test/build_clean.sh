@@ -0,0 +1,3 @@
+
+rm -rf ../../../build/image_convert_test/*
+
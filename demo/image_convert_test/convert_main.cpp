@@ -0,0 +1,153 @@
+
+//-------------------------------------------------------------------------------------------
+// Row converter parity test
+//
+// Headless. Converts the same pixels between every pair of formats at every SIMD level
+// this cpu supports, and checks that each level gives the same bytes as the scalar one.
+//
+//   parity   - every pair, every level, run lengths 0 to 70, off vector alignment,
+//              and no bytes written past the run
+//   inplace  - src and dst in one buffer, where dest pixels are no larger than source,
+//              at the same start and with dst before src, as rows converted in place
+//   bounds   - runs that end at the end of an allocation
+//
+// Float sources hold values in and out of 0..1 and halfway rounding cases. Exits with
+// the number of failed checks. Run under a sanitizer to catch overreads.
+//
+
+#include "imagex.h"
+#include "imagex_convert.h"
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <vector>
+
+#define MAX_RUN		70
+#define GUARD		32					// bytes checked past the run
+#define GUARD_BYTE	0xA5
+
+ImageOp::Format g_fmts[] = { ImageOp::BW8, ImageOp::BW16, ImageOp::BW32, ImageOp::RGB8, ImageOp::RGBA8,
+							 ImageOp::RGB16, ImageOp::RGBA32F, ImageOp::BGR8, ImageOp::F32 };
+const char* g_names[] = { "BW8", "BW16", "BW32", "RGB8", "RGBA8", "RGB16", "RGBA32F", "BGR8", "F32" };
+int g_nfmts = sizeof(g_fmts) / sizeof(g_fmts[0]);
+
+int g_fail = 0;
+
+void check ( bool ok, const char* what, int s, int d, int lev, int cnt )
+{
+	if ( !ok ) {
+		g_fail++;
+		if ( g_fail <= 20 ) printf ( "  FAIL: %s, %s -> %s, level %d, %d pixels\n", what, g_names[s], g_names[d], lev, cnt );
+	}
+}
+
+// Source pixels. Float formats get values around and outside 0..1, others random bytes.
+void make_source ( ImageOp::Format fmt, XBYTE* buf, int cnt )
+{
+	int bytes = getFormatBytes ( fmt );
+	if ( fmt == ImageOp::RGBA32F || fmt == ImageOp::F32 ) {
+		static const float vals[] = { 0.f, 1.f, 0.5f, -0.25f, 1.75f, 0.5f/255.f, 1.5f/255.f, 127.5f/255.f,
+									  0.5f/65535.f, 0.999f, 1e-7f, -1e6f, 1e6f, 0.3333f, 0.6667f, 2.f };
+		int nv = sizeof(vals) / sizeof(vals[0]);
+		float* f = (float*) buf;
+		for ( int i = 0; i < cnt * bytes / 4; i++ ) {
+			f[i] = ( rand() % 4 == 0 ) ? vals[ rand() % nv ] : ( rand() % 20001 - 5000 ) / 10000.f;
+		}
+	} else {
+		for ( int i = 0; i < cnt * bytes; i++ ) buf[i] = (XBYTE) rand ();
+	}
+}
+
+void test_parity ()
+{
+	printf ( "parity, best level %d\n", getRowConvertLevel() );
+	std::vector<XBYTE> src ( MAX_RUN * 16 + 64 ), ref ( MAX_RUN * 16 + GUARD ), out ( MAX_RUN * 16 + GUARD + 64 );
+
+	for ( int s = 0; s < g_nfmts; s++ ) {
+		for ( int d = 0; d < g_nfmts; d++ ) {
+			funcRowConvert base = getRowConvert ( g_fmts[s], g_fmts[d], IMG_SIMD_NONE );
+			check ( base != 0x0, "pair supported", s, d, 0, 0 );
+			if ( base == 0x0 ) continue;
+			int db = getFormatBytes ( g_fmts[d] );
+
+			for ( int cnt = 0; cnt <= MAX_RUN; cnt++ ) {
+				int shift = ( cnt % 4 ) * 4;					// off vector alignment, on channel alignment
+				XBYTE* sp = src.data() + shift;
+				make_source ( g_fmts[s], sp, cnt );
+				memset ( ref.data(), GUARD_BYTE, ref.size() );
+				base ( sp, ref.data(), cnt );
+				bool kept = true;
+				for ( int i = 0; i < GUARD; i++ ) kept &= ( ref[ cnt*db + i ] == GUARD_BYTE );
+				check ( kept, "scalar stays in run", s, d, 0, cnt );
+
+				for ( int lev = 1; lev <= getRowConvertLevel(); lev++ ) {
+					funcRowConvert fn = getRowConvert ( g_fmts[s], g_fmts[d], lev );
+					XBYTE* dp = out.data() + ( 12 - shift );
+					memset ( out.data(), GUARD_BYTE, out.size() );
+					fn ( sp, dp, cnt );
+					check ( memcmp ( dp, ref.data(), cnt*db + GUARD ) == 0, "same as scalar", s, d, lev, cnt );
+				}
+			}
+		}
+	}
+}
+
+void test_inplace ()
+{
+	printf ( "inplace\n" );
+	std::vector<XBYTE> src ( MAX_RUN * 16 ), ref ( MAX_RUN * 16 ), buf ( MAX_RUN * 32 );
+
+	for ( int s = 0; s < g_nfmts; s++ ) {
+		for ( int d = 0; d < g_nfmts; d++ ) {
+			int sb = getFormatBytes ( g_fmts[s] ), db = getFormatBytes ( g_fmts[d] );
+			if ( db > sb ) continue;
+			int cnt = MAX_RUN - s - d;
+			make_source ( g_fmts[s], src.data(), cnt );
+			getRowConvert ( g_fmts[s], g_fmts[d], IMG_SIMD_NONE ) ( src.data(), ref.data(), cnt );
+
+			for ( int lev = 0; lev <= getRowConvertLevel(); lev++ ) {
+				memcpy ( buf.data(), src.data(), cnt * sb );
+				getRowConvert ( g_fmts[s], g_fmts[d], lev ) ( buf.data(), buf.data(), cnt );
+				check ( memcmp ( buf.data(), ref.data(), cnt * db ) == 0, "in place same as separate", s, d, lev, cnt );
+
+				// second row of an image converted in place, dest row starts before the source row
+				memcpy ( buf.data() + cnt * sb, src.data(), cnt * sb );
+				getRowConvert ( g_fmts[s], g_fmts[d], lev ) ( buf.data() + cnt * sb, buf.data() + cnt * db, cnt );
+				check ( memcmp ( buf.data() + cnt * db, ref.data(), cnt * db ) == 0, "dest before source same as separate", s, d, lev, cnt );
+			}
+		}
+	}
+}
+
+void test_bounds ()
+{
+	printf ( "bounds\n" );
+	// one pixel at the very end of an allocation, so a sanitizer sees any overread
+	for ( int s = 0; s < g_nfmts; s++ ) {
+		for ( int d = 0; d < g_nfmts; d++ ) {
+			int sb = getFormatBytes ( g_fmts[s] ), db = getFormatBytes ( g_fmts[d] );
+			for ( int cnt = 1; cnt <= 17; cnt += 8 ) {
+				for ( int lev = 0; lev <= getRowConvertLevel(); lev++ ) {
+					XBYTE* sp = (XBYTE*) malloc ( cnt * sb );
+					XBYTE* dp = (XBYTE*) malloc ( cnt * db );
+					make_source ( g_fmts[s], sp, cnt );
+					getRowConvert ( g_fmts[s], g_fmts[d], lev ) ( sp, dp, cnt );
+					free ( sp );
+					free ( dp );
+				}
+			}
+		}
+	}
+}
+
+int main ( int argc, char* argv[] )
+{
+	srand ( 21 );
+	test_parity ();
+	test_inplace ();
+	test_bounds ();
+
+	if ( g_fail == 0 ) printf ( "PASS\n" );
+	else printf ( "FAILED %d checks\n", g_fail );
+	return g_fail;
+}
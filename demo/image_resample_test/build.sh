@@ -0,0 +1,5 @@
+
+cmake CMakeLists.txt -B../../../build/image_resample_test
+make -C../../../build/image_resample_test
+
+
@@ -0,0 +1,288 @@
+
+//-------------------------------------------------------------------------------------------
+// Resample test
+//
+// Headless. Scales random images with every filter and format, and checks them against
+// a double precision reference built here from the same filter definitions.
+//
+//   reference - every filter, format and sRGB mode, within rounding of the reference
+//   parity    - every SIMD level and thread count gives the same bytes as scalar on one thread
+//   bounds    - source rows allocated exactly, and no bytes written past each dest row
+//   mips      - mip levels are dropped by every write to the image, and a blit from one
+//               of its own levels reads it before it is dropped
+//
+// Sizes include integer upscales, where trimmed filter windows start out of order
+// (4x14 to 4x70 bicubic), downscales and one pixel wide images. Exits with the number
+// of failed checks. Run under a sanitizer to catch overreads.
+//
+
+#include "imagex.h"
+#include "imagex_resample.h"
+#include "imagex_convert.h"
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <math.h>
+#include <vector>
+#include <algorithm>
+
+#define GUARD		8					// bytes past each dest row
+#define GUARD_BYTE	0xA5
+
+struct Fmt {
+	ImageOp::Format		fmt;
+	const char*			name;
+	int					chan;
+	int					bytes;			// per channel
+	bool				isfloat;
+};
+Fmt g_fmts[] = {
+	{ ImageOp::BW8,		"BW8",		1, 1, false },
+	{ ImageOp::BW16,	"BW16",		1, 2, false },
+	{ ImageOp::BW32,	"BW32",		1, 4, false },
+	{ ImageOp::RGB8,	"RGB8",		3, 1, false },
+	{ ImageOp::RGBA8,	"RGBA8",	4, 1, false },
+	{ ImageOp::RGB16,	"RGB16",	3, 2, false },
+	{ ImageOp::RGBA32F,	"RGBA32F",	4, 4, true },
+	{ ImageOp::BGR8,	"BGR8",		3, 1, false },
+	{ ImageOp::F32,		"F32",		1, 4, true },
+};
+int g_nfmts = sizeof(g_fmts) / sizeof(g_fmts[0]);
+
+const char* g_filters[] = { "Nearest", "Box", "Bilinear", "Bicubic", "Lanczos", "Kaiser" };
+
+struct Size { int sw, sh, dw, dh; };
+Size g_sizes[] = {
+	{ 4, 14, 4, 70 },					// x5 bicubic, out of order windows
+	{ 1, 1, 3, 3 },
+	{ 5, 3, 10, 6 },
+	{ 7, 5, 21, 15 },
+	{ 3, 2, 12, 8 },
+	{ 9, 9, 45, 45 },
+	{ 1, 13, 1, 39 },
+	{ 70, 14, 4, 4 },
+	{ 33, 17, 8, 5 },
+	{ 10, 10, 17, 13 },
+	{ 64, 3, 200, 2 },
+};
+int g_nsizes = sizeof(g_sizes) / sizeof(g_sizes[0]);
+
+int g_fail = 0;
+
+void check ( bool ok, const char* what, const Fmt& f, int filter, const Size& s, bool srgb, int lev, int threads )
+{
+	if ( !ok ) {
+		g_fail++;
+		if ( g_fail <= 20 ) printf ( "  FAIL: %s, %s %s%s %dx%d -> %dx%d, level %d, threads %d\n", what, f.name, g_filters[filter],
+									 srgb ? " srgb" : "", s.sw, s.sh, s.dw, s.dh, lev, threads );
+	}
+}
+
+//---- reference
+
+double filter ( int flt, double x )
+{
+	const double pi = 3.14159265358979;
+	auto sinc = [pi] ( double v ) { return ( v == 0 ) ? 1.0 : sin ( v * pi ) / ( v * pi ); };
+	auto bessel0 = [] ( double v ) {
+		double sum = 1, term = 1, h = v * 0.5;
+		for ( int k = 1; k < 20; k++ ) { term *= h / k; sum += term * term; }
+		return sum;
+	};
+	switch ( flt ) {
+	case ImageOp::Box:		return ( x >= -0.5 && x < 0.5 ) ? 1 : 0;
+	case ImageOp::Bicubic:	x = fabs ( x ); return ( x < 1 ) ? ( 1.5 * x - 2.5 ) * x * x + 1 : ( x < 2 ) ? ( ( -0.5 * x + 2.5 ) * x - 4 ) * x + 2 : 0;
+	case ImageOp::Lanczos:	return ( fabs ( x ) < 3 ) ? sinc ( x ) * sinc ( x / 3 ) : 0;
+	case ImageOp::Kaiser:	return ( fabs ( x ) < 3 ) ? sinc ( x ) * bessel0 ( 4 * sqrt ( 1 - x * x / 9 ) ) / bessel0 ( 4 ) : 0;
+	default:				x = fabs ( x ); return ( x < 1 ) ? 1 - x : 0;
+	}
+}
+
+// Weights of every source pixel for each output, edges clamped
+std::vector<double> axisWeights ( int flt, int src, int dst )
+{
+	double radius = ( flt == ImageOp::Box ) ? 0.5 : ( flt == ImageOp::Bicubic ) ? 2 : ( flt == ImageOp::Lanczos || flt == ImageOp::Kaiser ) ? 3 : 1;
+	double scale = double(dst) / src;
+	double fs = ( scale < 1 ) ? 1 / scale : 1;
+	double r = radius * fs;
+	std::vector<double> w ( (size_t) dst * src, 0.0 );
+	for ( int i = 0; i < dst; i++ ) {
+		double* wi = &w[ (size_t) i * src ];
+		float c = float( ( i + 0.5 ) / scale - 0.5 );
+		if ( flt == ImageOp::Nearest ) {
+			wi[ std::min ( src - 1, (int) ( ( i + 0.5 ) * src / dst ) ) ] = 1;
+			continue;
+		}
+		double sum = 0;
+		for ( int j = (int) floor ( c - r ); j <= (int) ceil ( c + r ); j++ ) {
+			double v = filter ( flt, ( j - c ) / fs );
+			wi[ std::max ( 0, std::min ( src - 1, j ) ) ] += v;
+			sum += v;
+		}
+		if ( sum == 0 ) { wi[ std::max ( 0, std::min ( src - 1, (int) floor ( c + 0.5 ) ) ) ] = 1; sum = 1; }
+		for ( int j = 0; j < src; j++ ) wi[j] /= sum;
+	}
+	return w;
+}
+
+double getChan ( const Fmt& f, const XBYTE* p, int c )
+{
+	switch ( f.bytes ) {
+	case 1:		return p[c];
+	case 2:		return ( (const uint16_t*) p )[c];
+	default:	return f.isfloat ? (double) ( (const float*) p )[c] : (double) ( (const uint32_t*) p )[c];
+	}
+}
+double srgbDecode ( double v )		{ v /= 255; return 255 * ( ( v <= 0.04045 ) ? v / 12.92 : pow ( ( v + 0.055 ) / 1.055, 2.4 ) ); }
+double srgbEncode ( double v )		{ v /= 255; return 255 * ( ( v <= 0.0031308 ) ? v * 12.92 : 1.055 * pow ( v, 1 / 2.4 ) - 0.055 ); }
+
+// Dest channel values, before clamping, rounding and sRGB encoding
+std::vector<double> reference ( const Fmt& f, int flt, const Size& s, const XBYTE* src, bool srgb )
+{
+	std::vector<double> wx = axisWeights ( flt, s.sw, s.dw ), wy = axisWeights ( flt, s.sh, s.dh );
+	int C = f.chan, bpp = f.chan * f.bytes;
+	std::vector<double> in ( (size_t) s.sw * s.sh * C ), mid ( (size_t) s.dw * s.sh * C, 0.0 ), out ( (size_t) s.dw * s.dh * C, 0.0 );
+	for ( int i = 0; i < s.sw * s.sh; i++ )
+		for ( int c = 0; c < C; c++ ) {
+			double v = getChan ( f, src + (size_t) i * bpp, c );
+			in[ (size_t) i * C + c ] = ( srgb && !( C == 4 && c == 3 ) ) ? srgbDecode ( v ) : v;
+		}
+	for ( int y = 0; y < s.sh; y++ )
+		for ( int x = 0; x < s.dw; x++ )
+			for ( int j = 0; j < s.sw; j++ )
+				for ( int c = 0; c < C; c++ ) mid[ ( (size_t) y * s.dw + x ) * C + c ] += wx[ (size_t) x * s.sw + j ] * in[ ( (size_t) y * s.sw + j ) * C + c ];
+	for ( int y = 0; y < s.dh; y++ )
+		for ( int j = 0; j < s.sh; j++ )
+			for ( int i = 0; i < s.dw * C; i++ ) out[ (size_t) y * s.dw * C + i ] += wy[ (size_t) y * s.sh + j ] * mid[ (size_t) j * s.dw * C + i ];
+	return out;
+}
+
+bool nearRef ( const Fmt& f, double ref, double got, bool srgb, bool alpha )
+{
+	if ( f.isfloat ) return fabs ( got - ref ) <= 1e-4 + 1e-5 * fabs ( ref );
+	double hi = ( f.bytes == 1 ) ? 255 : ( f.bytes == 2 ) ? 65535 : 4294967040.0;
+	ref = std::max ( 0.0, std::min ( hi, ref ) );
+	if ( srgb && !alpha ) ref = srgbEncode ( ref );
+	return fabs ( got - ref ) <= 1 + 1e-6 * hi;				// float sums of full range BW32 lose low bits
+}
+
+//---- tests
+
+void make_source ( const Fmt& f, XBYTE* buf, int n )
+{
+	for ( int i = 0; i < n * f.chan; i++ ) {
+		switch ( f.bytes ) {
+		case 1:		buf[i] = (XBYTE) rand ();	break;
+		case 2:		( (uint16_t*) buf )[i] = (uint16_t) rand ();	break;
+		default:
+			if ( f.isfloat ) ( (float*) buf )[i] = ( rand() % 14001 - 2000 ) / 10000.f;
+			else ( (uint32_t*) buf )[i] = ( (uint32_t) rand() << 16 ) ^ (uint32_t) rand ();
+		}
+	}
+}
+
+bool run ( const Fmt& f, int flt, const Size& s, const XBYTE* src, bool srgb, int lev, int threads, std::vector<XBYTE>& dst )
+{
+	int bpp = f.chan * f.bytes;
+	int dpitch = s.dw * bpp + GUARD;
+	dst.assign ( (size_t) dpitch * s.dh, GUARD_BYTE );
+	bool ok = resampleImage ( src, s.sw, s.sh, s.sw * bpp, dst.data(), s.dw, s.dh, dpitch, f.fmt, (ImageOp::Sampler) flt, threads, srgb, lev );
+	for ( int y = 0; y < s.dh; y++ )
+		for ( int i = 0; i < GUARD; i++ ) ok &= ( dst[ (size_t) y * dpitch + s.dw * bpp + i ] == GUARD_BYTE );
+	return ok;
+}
+
+void test_case ( const Fmt& f, int flt, const Size& s, bool srgb )
+{
+	static const int threads[] = { 1, 3, 0 };
+	int bpp = f.chan * f.bytes;
+	XBYTE* src = (XBYTE*) malloc ( (size_t) s.sw * s.sh * bpp );			// exact, so overreads are caught
+	make_source ( f, src, s.sw * s.sh );
+
+	std::vector<XBYTE> base, out;
+	check ( run ( f, flt, s, src, srgb, IMG_SIMD_NONE, 1, base ), "resample, dest rows kept", f, flt, s, srgb, 0, 1 );
+
+	std::vector<double> ref = reference ( f, flt, s, src, srgb );
+	int dpitch = s.dw * bpp + GUARD;
+	bool near = true;
+	for ( int y = 0; y < s.dh; y++ )
+		for ( int i = 0; i < s.dw * f.chan; i++ ) {
+			double got = getChan ( f, &base[ (size_t) y * dpitch ], i );
+			near &= nearRef ( f, ref[ (size_t) y * s.dw * f.chan + i ], got, srgb, f.chan == 4 && i % 4 == 3 );
+		}
+	check ( near, "matches reference", f, flt, s, srgb, 0, 1 );
+
+	for ( int lev = 0; lev <= getRowConvertLevel(); lev++ ) {
+		for ( int t = 0; t < 3; t++ ) {
+			if ( lev == 0 && threads[t] == 1 ) continue;
+			check ( run ( f, flt, s, src, srgb, lev, threads[t], out ), "resample, dest rows kept", f, flt, s, srgb, lev, threads[t] );
+			check ( out == base, "same as scalar", f, flt, s, srgb, lev, threads[t] );
+		}
+	}
+	free ( src );
+}
+
+void check_mips ( bool ok, const char* what )
+{
+	if ( !ok ) {
+		g_fail++;
+		printf ( "  FAIL: %s\n", what );
+	}
+}
+
+void test_mips ()
+{
+	printf ( "mips\n" );
+	ImageX img ( 16, 16, ImageOp::RGBA8 ), src ( 4, 4, ImageOp::RGBA8 );
+	src.Fill ( 0, 1, 0, 1 );
+	img.Fill ( 1, 0, 0, 1 );
+
+	img.BuildMips ();
+	check_mips ( img.GetNumMips() == 5, "built" );
+	img.FillRect ( 2, 2, 4, 4, Vec4F ( 0, 0, 1, 1 ) );
+	check_mips ( img.GetNumMips() == 1, "fill rect drops levels" );
+
+	img.BuildMips ();
+	img.FillRegion ( Vec4F ( 0, 0, 1, 1 ) );
+	check_mips ( img.GetNumMips() == 1, "fill region drops levels" );
+
+	img.BuildMips ();
+	img.Blit ( &src, 0, 0, 4, 4, 8, 8 );
+	check_mips ( img.GetNumMips() == 1, "blit drops levels" );
+
+	img.BuildMips ();
+	img.Composite ( &src, 0, 0, 4, 4, 0, 8 );
+	check_mips ( img.GetNumMips() == 1, "composite drops levels" );
+
+	// 4x4 level of a uniform image, blitted onto its top left corner
+	img.Fill ( 0, 0, 1, 1 );
+	img.BuildMips ();
+	img.Blit ( img.GetMip ( 2 ), 0, 0, 4, 4, 0, 0 );
+	Vec4F c = img.GetPixel ( 1, 1 );
+	check_mips ( img.GetNumMips() == 1 && c.x == 0 && c.z == 1, "blit from own level" );
+	img.BuildMips ();
+	Vec4F m = img.GetMip ( 4 )->GetPixel ( 0, 0 );
+	check_mips ( m.z == 1 && m.x == 0, "rebuilt levels see the writes" );
+}
+
+int main ( int argc, char* argv[] )
+{
+	srand ( 22 );
+	printf ( "best level %d\n", getRowConvertLevel() );
+	for ( int flt = ImageOp::Nearest; flt <= ImageOp::Kaiser; flt++ ) {
+		printf ( "%s\n", g_filters[flt] );
+		for ( int i = 0; i < g_nfmts; i++ ) {
+			const Fmt& f = g_fmts[i];
+			bool has_srgb = ( f.bytes == 1 && flt != ImageOp::Nearest );
+			for ( int s = 0; s < g_nsizes; s++ ) {
+				test_case ( f, flt, g_sizes[s], false );
+				if ( has_srgb ) test_case ( f, flt, g_sizes[s], true );
+			}
+		}
+	}
+	test_mips ();
+
+	if ( g_fail == 0 ) printf ( "PASS\n" );
+	else printf ( "FAILED %d checks\n", g_fail );
+	return g_fail;
+}
@@ -0,0 +1,194 @@
+
+//-------------------------------------------------------------------------------------------
+// Tiled image file test
+//
+// Headless. Writes a tiled image, reopens it, and checks that Open refuses files whose
+// tiles cannot all be mapped, rather than faulting on first touch.
+//
+//   roundtrip - create, write regions and pixels, reopen read-only and for writing
+//   truncate  - files cut short, including to 70000 bytes, fail to open
+//   header    - unaligned stride or offset, offset over the tile states, overflowing
+//               sizes and a bad magic fail to open
+//
+// Writes tiled_test.img in the working directory and removes it on exit. Exits with the
+// number of failed checks.
+//
+
+#include "imagex.h"
+#include "imagex_tiled.h"
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+#include <climits>
+#include <vector>
+#ifdef _WIN32
+	#include <io.h>
+#else
+	#include <unistd.h>
+#endif
+
+#define TEST_FILE		"tiled_test.img"
+#define TEST_W			600
+#define TEST_H			400
+#define TEST_TILE		256
+
+#define HDR_XRES		8					// header field offsets
+#define HDR_TILE		20
+#define HDR_STRIDE		24
+#define HDR_OFFSET		32
+#define HDR_SIZE		40
+
+int g_fail = 0;
+
+void check ( bool ok, const char* what )
+{
+	if ( !ok ) {
+		g_fail++;
+		printf ( "  FAIL: %s\n", what );
+	}
+}
+
+XBYTE pattern ( int x, int y, int c )		{ return (XBYTE) ( x * 7 + y * 13 + c * 61 ); }
+
+bool copy_file ( const char* from, const char* to )
+{
+	FILE* a = fopen ( from, "rb" );
+	FILE* b = fopen ( to, "wb" );
+	bool ok = ( a != 0x0 && b != 0x0 );
+	char buf[65536];
+	size_t n;
+	while ( ok && ( n = fread ( buf, 1, sizeof(buf), a ) ) > 0 ) ok = ( fwrite ( buf, 1, n, b ) == n );
+	if ( a ) fclose ( a );
+	if ( b ) fclose ( b );
+	return ok;
+}
+
+bool truncate_file ( const char* path, int64_t size )
+{
+	FILE* fp = fopen ( path, "r+b" );
+	if ( fp == 0x0 ) return false;
+	#ifdef _WIN32
+		bool ok = ( _chsize_s ( _fileno ( fp ), size ) == 0 );
+	#else
+		bool ok = ( ftruncate ( fileno ( fp ), (off_t) size ) == 0 );
+	#endif
+	fclose ( fp );
+	return ok;
+}
+
+bool patch_file ( const char* path, long off, const void* v, size_t len )
+{
+	FILE* fp = fopen ( path, "r+b" );
+	if ( fp == 0x0 ) return false;
+	bool ok = ( fseek ( fp, off, SEEK_SET ) == 0 && fwrite ( v, 1, len, fp ) == len );
+	fclose ( fp );
+	return ok;
+}
+
+// Copy of the test file with one header field changed, which must fail to open
+void check_patched ( long off, const void* v, size_t len, const char* what )
+{
+	const char* bad = TEST_FILE ".bad";
+	check ( copy_file ( TEST_FILE, bad ) && patch_file ( bad, off, v, len ), "patch copy" );
+	ImageTiled img;
+	check ( !img.Open ( bad, false ) && !img.IsOpen(), what );
+	remove ( bad );
+}
+
+bool check_pattern ( ImageTiled& img, int x0, int y0, int w, int h )
+{
+	ImageX reg;
+	if ( !img.GetRegion ( x0, y0, w, h, &reg ) ) return false;
+	for ( int y = 0; y < h; y++ ) {
+		XBYTE* p = reg.GetData() + (size_t) y * reg.GetBytesPerRow();
+		for ( int x = 0; x < w; x++, p += 4 )
+			for ( int c = 0; c < 4; c++ )
+				if ( p[c] != pattern ( x0 + x, y0 + y, c ) ) return false;
+	}
+	return true;
+}
+
+void test_roundtrip ()
+{
+	printf ( "roundtrip\n" );
+	ImageTiled img;
+	check ( img.Create ( TEST_FILE, TEST_W, TEST_H, ImageOp::RGBA8, TEST_TILE ), "create" );
+	check ( img.GetTilesX() == 3 && img.GetTilesY() == 2, "tile counts" );
+
+	// left 300 columns written, the rest never touched
+	ImageX src ( 300, TEST_H, ImageOp::RGBA8 );
+	for ( int y = 0; y < TEST_H; y++ ) {
+		XBYTE* p = src.GetData() + (size_t) y * src.GetBytesPerRow();
+		for ( int x = 0; x < 300; x++, p += 4 )
+			for ( int c = 0; c < 4; c++ ) p[c] = pattern ( x, y, c );
+	}
+	check ( img.SetRegion ( 0, 0, &src ), "set region" );
+	img.SetPixel ( 599, 399, Vec4F ( 1, 0, 1, 1 ) );
+	img.Close ();
+
+	check ( img.Open ( TEST_FILE, false ), "reopen read-only" );
+	check ( img.GetWidth() == TEST_W && img.GetHeight() == TEST_H && img.GetFormat() == ImageOp::RGBA8, "reopened size and format" );
+	check ( check_pattern ( img, 0, 0, 300, TEST_H ), "written region kept" );
+	check ( img.GetPixel ( 599, 399 ).x == 1 && img.GetPixel ( 599, 399 ).y == 0, "written pixel kept" );
+	check ( img.GetPixel ( 400, 10 ).x == 0 && img.GetPixel ( 400, 10 ).w == 0, "unwritten tile reads zero" );
+	img.Close ();
+
+	check ( img.Open ( TEST_FILE, true ), "reopen for writing" );
+	img.SetPixel ( 10, 10, Vec4F ( 0, 0, 0, 0 ) );
+	img.Close ();
+	check ( img.Open ( TEST_FILE, false ), "reopen after write" );
+	check ( img.GetPixel ( 10, 10 ).w == 0 && check_pattern ( img, 11, 0, 289, TEST_H ), "change kept, rest intact" );
+	img.Close ();
+}
+
+void test_truncate ()
+{
+	printf ( "truncate\n" );
+	const char* cut = TEST_FILE ".cut";
+	int64_t full = 65536 + 6 * (int64_t) TEST_TILE * TEST_TILE * 4;		// data offset + 6 tiles
+	int64_t sizes[] = { 70000, full - 1, full - TEST_TILE * TEST_TILE * 4, 65536, HDR_SIZE + 6, 10, 0 };
+	for ( int64_t sz : sizes ) {
+		check ( copy_file ( TEST_FILE, cut ) && truncate_file ( cut, sz ), "truncate copy" );
+		ImageTiled img;
+		char what[64];
+		snprintf ( what, sizeof(what), "open truncated to %lld", (long long) sz );
+		check ( !img.Open ( cut, false ) && !img.IsOpen(), what );
+	}
+	check ( copy_file ( TEST_FILE, cut ), "copy" );
+	ImageTiled img;
+	check ( img.Open ( cut, false ) && check_pattern ( img, 11, 0, 289, TEST_H ), "untruncated copy opens" );
+	img.Close ();
+	remove ( cut );
+}
+
+void test_header ()
+{
+	printf ( "header\n" );
+	int64_t v;
+	v = 262144 + 4096;		check_patched ( HDR_STRIDE, &v, 8, "unaligned stride" );
+	v = 65536 + 4096;		check_patched ( HDR_OFFSET, &v, 8, "unaligned offset" );
+	v = 0;					check_patched ( HDR_OFFSET, &v, 8, "offset over the header" );
+	v = 65536;				check_patched ( HDR_STRIDE, &v, 8, "stride smaller than a tile" );
+	v = -262144;			check_patched ( HDR_STRIDE, &v, 8, "negative stride" );
+	v = (int64_t) 1 << 62;	check_patched ( HDR_STRIDE, &v, 8, "stride past the file" );
+	v = -65536;				check_patched ( HDR_OFFSET, &v, 8, "negative offset" );
+	int32_t r[2] = { INT_MAX, INT_MAX };
+	check_patched ( HDR_XRES, r, 8, "tile count past the file" );
+	int32_t t = 1;
+	check_patched ( HDR_TILE, &t, 4, "tile states past the offset" );
+	t = INT_MAX;
+	check_patched ( HDR_TILE, &t, 4, "tile size overflow" );
+	check_patched ( 0, "IMGTILE0", 8, "bad magic" );
+}
+
+int main ( int argc, char* argv[] )
+{
+	test_roundtrip ();
+	test_truncate ();
+	test_header ();
+	remove ( TEST_FILE );
+
+	if ( g_fail == 0 ) printf ( "PASS\n" );
+	else printf ( "FAILED %d checks\n", g_fail );
+	return g_fail;
+}
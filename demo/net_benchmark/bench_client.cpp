@@ -0,0 +1,102 @@
+
+
+#include "bench_client.h"
+
+#define BULK_WINDOW		(256*1024)		// bytes queued on socket before bulk send waits
+#define BULK_BATCH		64				// events per tick, so the receiver gets a turn
+
+int Client::NetEventCallback ( Event& e, void* this_pointer ) {
+	Client* self = static_cast<Client*>( this_pointer );
+	return self->Process ( e );
+}
+
+void Client::Start ( std::string srv_addr, int srv_port, int process_ms, int select_ms )
+{
+	m_mode = BENCH_BULK;
+	m_payload = -1;					// idle until SetMode
+	m_waiting = false;
+
+	netSetSecurityLevel ( NET_SECURITY_PLAIN_TCP );
+	netSetReconnectLimit ( 10 );
+	netSetReconnectInterval ( 100 );
+
+	netInitialize ( );
+	netShowVerbose ( false );
+	netShowFlow ( false );
+	netSetProcessInterval ( process_ms );
+	netSetSelectInterval ( select_ms );
+
+	netClientStart ( );
+	netSetUserCallback ( &NetEventCallback );
+	m_sock = netClientConnectToServer ( srv_addr, srv_port, false );
+}
+
+void Client::Close ( )
+{
+	netCloseConnection ( m_sock );
+}
+
+void Client::SetMode ( int mode, int payload )
+{
+	m_mode = mode;
+	m_payload = payload;
+	m_waiting = false;
+	m_buf.assign ( imax ( payload, 0 ), 'b' );
+	m_samples.clear ( );
+}
+
+int Client::Process ( Event& e )
+{
+	eventStr_t sys = e.getTarget ( );
+	if ( sys == 'net ' && e.getName ( ) == 'nerr' ) { // Check for net error events
+		return 0;
+	}
+	e.startRead ( );
+	switch ( e.getName ( ) ) {
+		case 'sOkT': return 1;		// Connection complete
+		case 'sFIN': return 1;		// Server shutdown
+		case 'bPog': {				// Ping reply, record round trip
+			xlong t = e.getInt64 ( );
+			m_samples.push_back ( (uint64_t) TimeX::GetSystemNSec ( ) - (uint64_t) t );
+			m_waiting = false;
+			return 1;
+		}
+	};
+	return 0;
+}
+
+void Client::SendBulk ( )
+{
+	int srv_sock = getServerSock ( m_sock );
+	if ( srv_sock < 0 ) return;
+
+	for ( int n = 0; n < BULK_BATCH && netGetSendQueued ( m_sock ) < BULK_WINDOW; n++ ) {
+		Event e;
+		new_event ( e, m_payload + sizeof(int), 'app ', 'bBlk', 0, getNetPool ( ) );
+		e.attachInt ( srv_sock ); // Must always tell server which socket
+		e.attachBuf ( m_buf.data ( ), m_payload );
+		if ( !netSend ( e ) ) break;
+	}
+}
+
+void Client::SendPing ( )
+{
+	int srv_sock = getServerSock ( m_sock );
+	if ( srv_sock < 0 || m_waiting ) return;
+
+	Event e;
+	new_event ( e, m_payload + sizeof(int) + sizeof(xlong), 'app ', 'bPng', 0, getNetPool ( ) );
+	e.attachInt ( srv_sock );
+	e.attachInt64 ( (xlong) TimeX::GetSystemNSec ( ) );
+	e.attachBuf ( m_buf.data ( ), m_payload );
+	m_waiting = netSend ( e );
+}
+
+int Client::Run ( )
+{
+	if ( IsReady ( ) && m_payload >= 0 ) {
+		if ( m_mode == BENCH_BULK )	SendBulk ( );
+		else						SendPing ( );
+	}
+	return netProcessQueue ( ); // Process event queue
+}
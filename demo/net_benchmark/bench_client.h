@@ -0,0 +1,39 @@
+
+#ifndef NETBENCH_CLIENT
+#define NETBENCH_CLIENT
+
+#include "network_system.h"
+#include <vector>
+
+#define BENCH_BULK			0		// send as fast as the socket allows
+#define BENCH_PINGPONG		1		// one request in flight, measure round trip
+
+class Client : public NetworkSystem {
+public:
+	Client( const char* trace_file_name = NULL ) : NetworkSystem( trace_file_name ) { }
+
+	// Networking functions
+	void Start ( std::string srv_addr, int srv_port, int process_ms, int select_ms );
+	bool IsReady ( )	{ return netIsConnectComplete ( m_sock ) && getServerSock ( m_sock ) >= 0; }
+	void Close ( );
+	int Run ( );
+	int Process ( Event& e );
+	static int NetEventCallback ( Event& e, void* this_ptr );
+
+	// Benchmark protocol
+	void SetMode ( int mode, int payload );		// payload < 0 = idle
+	void SendBulk ( );
+	void SendPing ( );
+	std::vector<uint64_t>& getSamples ( )	{ return m_samples; }	// round trips, nsec
+	void ResetSamples ( )					{ m_samples.clear(); }
+
+private:
+	int			m_sock;				// local socket to server
+	int			m_mode;
+	int			m_payload;			// app payload bytes per event
+	bool		m_waiting;			// ping in flight
+	std::vector<char>		m_buf;
+	std::vector<uint64_t>	m_samples;
+};
+
+#endif
@@ -0,0 +1,206 @@
+
+//-------------------------------------------------------------------------------------------
+// NetworkSystem benchmark
+//
+// Headless. Runs a server and N clients in one process over loopback,
+// then reports throughput and round-trip latency for each combination of
+// payload size, connection count, process interval and select interval.
+//
+//   bulk  - clients send as fast as the socket allows. server counts events and bytes.
+//   ping  - each client keeps one request in flight. server echoes the payload.
+//
+// Results are written as CSV, one row per test, to --out file (or stdout).
+// Progress goes to stderr. Latency columns are zero for bulk tests.
+//
+// Options (lists are comma separated):
+//   --payload 64,1024,65536    app payload bytes per event
+//   --conns 1,8                client connections
+//   --process 0                netSetProcessInterval, msec
+//   --select 0,1               netSetSelectInterval, msec
+//   --time 1                   measured seconds per test
+//   --warmup 0.25              seconds before measuring
+//   --port 16201               server port
+//   --delay 0                  emulated one-way delay on server recv, msec
+//   --rate 0                   emulated server recv rate, MB/sec per connection (0 = unlimited)
+//   --compress 0               compress payloads of at least this many bytes (0 = off)
+//   --out results.csv
+//
+//-------------------------------------------------------------------------------------------
+
+#include "bench_client.h"
+#include "bench_server.h"
+
+#include <algorithm>
+
+std::string get_arg_val ( int argc, char** argv, const char* arg, std::string default_val )
+{
+	for ( int i = 1; i < argc - 1; i++ ) {
+		if ( strcmp ( argv[i], arg ) == 0 ) return argv[i+1];
+	}
+	return default_val;
+}
+
+std::vector<int> get_arg_list ( int argc, char** argv, const char* arg, std::string default_val )
+{
+	std::vector<int> list;
+	std::string val = get_arg_val ( argc, argv, arg, default_val );
+	size_t pos = 0;
+	while ( pos <= val.length() ) {
+		size_t end = val.find ( ',', pos );
+		if ( end == std::string::npos ) end = val.length();
+		if ( end > pos ) list.push_back ( atoi ( val.substr ( pos, end - pos ).c_str() ) );
+		pos = end + 1;
+	}
+	return list;
+}
+
+struct BenchConfig {
+	int		payload, conns, process_ms, select_ms, compress;
+	float	time_sec, warmup_sec;
+};
+
+// Run server and all clients, one tick each
+void run_all ( Server& srv, std::vector<Client*>& clients )
+{
+	for ( Client* cli : clients ) cli->Run ( );
+	srv.Run ( );
+}
+
+void run_for ( Server& srv, std::vector<Client*>& clients, float sec )
+{
+	uint64_t end = TimeX::GetSystemNSec ( ) + (uint64_t) ( sec * SEC_SCALAR );
+	while ( TimeX::GetSystemNSec ( ) < end ) run_all ( srv, clients );
+}
+
+uint64_t percentile ( std::vector<uint64_t>& v, double q )
+{
+	if ( v.empty() ) return 0;
+	size_t i = std::min ( v.size() - 1, (size_t) ( q * v.size() ) );
+	return v[ i ];
+}
+
+void write_row ( FILE* fp, const char* test, BenchConfig& c, double sec, uint64_t events, uint64_t bytes, std::vector<uint64_t>& rtt )
+{
+	std::sort ( rtt.begin(), rtt.end() );
+	fprintf ( fp, "%s,%d,%d,%d,%d,%.3f,%llu,%.1f,%.3f,%.1f,%.1f,%.1f\n", test, c.payload, c.conns, c.process_ms, c.select_ms, sec,
+		(unsigned long long) events, events / sec, bytes / sec / (1024.0*1024.0),
+		percentile ( rtt, 0.50 ) / 1000.0, percentile ( rtt, 0.99 ) / 1000.0, percentile ( rtt, 0.999 ) / 1000.0 );
+	fflush ( fp );
+}
+
+// Connect clients, run bulk and ping tests, disconnect
+bool run_config ( Server& srv, BenchConfig& c, int port, FILE* fp )
+{
+	std::vector<Client*> clients;
+
+	srv.netSetProcessInterval ( c.process_ms );
+	srv.netSetSelectInterval ( c.select_ms );
+
+	for ( int n = 0; n < c.conns; n++ ) {
+		Client* cli = new Client;
+		cli->Start ( "127.0.0.1", port, c.process_ms, c.select_ms );
+		cli->netSetCompression ( c.compress );
+		clients.push_back ( cli );
+	}
+	// wait for connections
+	uint64_t timeout = TimeX::GetSystemNSec ( ) + 5 * SEC_SCALAR;
+	int ready = 0;
+	while ( ready < c.conns && TimeX::GetSystemNSec ( ) < timeout ) {
+		run_all ( srv, clients );
+		ready = 0;
+		for ( Client* cli : clients ) ready += cli->IsReady ( ) ? 1 : 0;
+	}
+	bool ok = ( ready == c.conns );
+	if ( !ok ) {
+		fprintf ( stderr, "  only %d of %d clients connected.\n", ready, c.conns );
+	}
+
+	if ( ok ) {
+		// bulk throughput, measured at server
+		std::vector<uint64_t> none;
+		for ( Client* cli : clients ) cli->SetMode ( BENCH_BULK, c.payload );
+		run_for ( srv, clients, c.warmup_sec );
+		srv.ResetCounts ( );
+		uint64_t t0 = TimeX::GetSystemNSec ( );
+		run_for ( srv, clients, c.time_sec );
+		double sec = double ( TimeX::GetSystemNSec ( ) - t0 ) / SEC_SCALAR;
+		write_row ( fp, "bulk", c, sec, srv.getNumEvents(), srv.getNumBytes(), none );
+
+		// drain queued bulk data, then ping-pong latency
+		for ( Client* cli : clients ) cli->SetMode ( BENCH_BULK, -1 );
+		run_for ( srv, clients, c.warmup_sec );
+		for ( Client* cli : clients ) cli->SetMode ( BENCH_PINGPONG, c.payload );
+		run_for ( srv, clients, c.warmup_sec );
+		for ( Client* cli : clients ) cli->ResetSamples ( );
+		t0 = TimeX::GetSystemNSec ( );
+		run_for ( srv, clients, c.time_sec );
+		sec = double ( TimeX::GetSystemNSec ( ) - t0 ) / SEC_SCALAR;
+
+		std::vector<uint64_t> rtt;
+		for ( Client* cli : clients ) rtt.insert ( rtt.end(), cli->getSamples().begin(), cli->getSamples().end() );
+		uint64_t events = rtt.size();
+		write_row ( fp, "ping", c, sec, events, events * 2 * ( c.payload + Event::staticSerializedHeaderSize() ), rtt );
+	}
+
+	// disconnect
+	for ( Client* cli : clients ) {
+		cli->SetMode ( BENCH_BULK, -1 );
+		cli->Close ( );
+	}
+	run_for ( srv, clients, 0.1f );
+	for ( Client* cli : clients ) delete cli;
+
+	return ok;
+}
+
+int main ( int argc, char* argv [] )
+{
+	std::vector<int> payloads = get_arg_list ( argc, argv, "--payload", "64,1024,65536" );
+	std::vector<int> conns = get_arg_list ( argc, argv, "--conns", "1,8" );
+	std::vector<int> process = get_arg_list ( argc, argv, "--process", "0" );
+	std::vector<int> select = get_arg_list ( argc, argv, "--select", "0,1" );
+	float time_sec = atof ( get_arg_val ( argc, argv, "--time", "1" ).c_str() );
+	float warmup_sec = atof ( get_arg_val ( argc, argv, "--warmup", "0.25" ).c_str() );
+	int port = atoi ( get_arg_val ( argc, argv, "--port", "16201" ).c_str() );
+	float delay_ms = atof ( get_arg_val ( argc, argv, "--delay", "0" ).c_str() );
+	float rate_mb = atof ( get_arg_val ( argc, argv, "--rate", "0" ).c_str() );
+	int compress = atoi ( get_arg_val ( argc, argv, "--compress", "0" ).c_str() );
+	std::string out = get_arg_val ( argc, argv, "--out", "" );
+
+	FILE* fp = stdout;
+	if ( !out.empty() ) {
+		fp = fopen ( out.c_str(), "wt" );
+		if ( fp == 0x0 ) {
+			fprintf ( stderr, "Unable to open %s\n", out.c_str() );
+			return 1;
+		}
+	}
+	fprintf ( fp, "test,payload,conns,process_ms,select_ms,sec,events,events_per_sec,mb_per_sec,p50_us,p99_us,p999_us\n" );
+
+	Server srv;
+	srv.Start ( port, 0, 0 );
+	srv.netSetCompression ( compress );
+	if ( delay_ms > 0 || rate_mb > 0 ) {
+		NetEmuConfig emu;
+		emu.latency_ms = delay_ms;
+		emu.recv_bps = rate_mb * 1024.0 * 1024.0;
+		srv.netSetEmulation ( emu );
+	}
+
+	int failed = 0;
+	for ( int p : process ) {
+		for ( int s : select ) {
+			for ( int n : conns ) {
+				for ( int len : payloads ) {
+					BenchConfig c = { len, n, p, s, compress, time_sec, warmup_sec };
+					fprintf ( stderr, "payload %d, conns %d, process %d ms, select %d ms\n", len, n, p, s );
+					if ( !run_config ( srv, c, port, fp ) ) failed++;
+				}
+			}
+		}
+	}
+	srv.Close ( );
+	if ( fp != stdout ) fclose ( fp );
+
+	return ( failed > 0 ) ? 1 : 0;
+}
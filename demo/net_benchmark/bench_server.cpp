@@ -0,0 +1,74 @@
+
+
+#include "bench_server.h"
+
+int Server::NetEventCallback ( Event& e, void* this_pointer ) {
+	Server* self = static_cast<Server*>( this_pointer );
+	return self->Process ( e );
+}
+
+void Server::Start ( int srv_port, int process_ms, int select_ms )
+{
+	m_numEvents = 0;
+	m_numBytes = 0;
+	m_numClients = 0;
+
+	netSetSecurityLevel ( NET_SECURITY_PLAIN_TCP );
+	netSetReconnectLimit ( 10 );
+
+	netInitialize ( ); // Start networking
+	netShowVerbose ( false );
+	netShowFlow ( false );
+	netSetProcessInterval ( process_ms );
+	netSetSelectInterval ( select_ms );
+
+	netServerStart ( srv_port ); // Start server listening
+	netSetUserCallback ( &NetEventCallback );
+}
+
+void Server::Close ( )
+{
+	netCloseAll ( );
+}
+
+int Server::Run ( )
+{
+	return netProcessQueue ( ); // Process event queue
+}
+
+int Server::Process ( Event& e )
+{
+	int sock;
+	eventStr_t sys = e.getTarget ( );
+	if ( sys == 'net ' && e.getName ( ) == 'nerr' ) { // Check for net error events
+		return 0;
+	}
+	e.startRead ( );
+	switch ( e.getName ( ) ) { // Process Network events
+		case 'sOkT': // Connection to client complete
+			m_numClients++;
+			return 1;
+		case 'cFIN': // Client closed connection
+			m_numClients--;
+			return 1;
+	};
+	switch ( e.getName ( ) ) { // Process Benchmark events
+		case 'bBlk': { // Bulk data, count only
+			m_numEvents++;
+			m_numBytes += e.getSerializedLength ( );
+			return 1;
+		}
+		case 'bPng': { // Ping, echo time and payload back
+			sock = e.getInt ( );
+			xlong t = e.getInt64 ( );
+			int len = e.getDataLength ( ) - e.getPosInt ( );
+			Event r;
+			new_event ( r, len + sizeof(xlong), 'app ', 'bPog', 0, getNetPool ( ) );
+			r.attachInt64 ( t );
+			r.attachBuf ( e.getPos ( ), len );
+			netSend ( r, sock );
+			return 1;
+		}
+	};
+	return 0;
+}
@@ -0,0 +1,30 @@
+
+#ifndef NETBENCH_SERVER
+#define NETBENCH_SERVER
+
+#include "network_system.h"
+
+class Server : public NetworkSystem {
+public:
+	Server( const char* trace_file_name = NULL ) : NetworkSystem( trace_file_name ) { }
+
+	// Networking functions
+	void Start ( int srv_port, int process_ms, int select_ms );
+	void Close ( );
+	int Run ( );
+	int Process ( Event& e );
+	static int NetEventCallback ( Event& e, void* this_ptr );
+
+	// Benchmark counters
+	void ResetCounts ( )		{ m_numEvents = 0; m_numBytes = 0; }
+	uint64_t getNumEvents ( )	{ return m_numEvents; }
+	uint64_t getNumBytes ( )	{ return m_numBytes; }
+	int getNumClients ( )		{ return m_numClients; }
+
+private:
+	uint64_t	m_numEvents;		// bulk events received
+	uint64_t	m_numBytes;			// bulk bytes received, serialized
+	int			m_numClients;
+};
+
+#endif
@@ -0,0 +1,5 @@
+
+
+cmake CMakeLists.txt -B../../../build/net_benchmark
+make -C../../../build/net_benchmark
+
@@ -0,0 +1,2 @@
+
+rm -rf ../../../build/net_benchmark/*
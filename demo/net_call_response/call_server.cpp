@@ -29,6 +29,10 @@ void Server::Start ( )
 	int srv_port = 16101;
 	netServerStart ( srv_port ); // Start server listening
 	netSetUserCallback ( &NetEventCallback ); 
+	netAddHandler ( 'net ', 'nerr', &OnError );
+	netAddHandler ( 'app ', 'sOkT', &OnConnect );
+	netAddHandler ( 'app ', 'cFIN', &OnDisconnect );
+	netAddHandler ( 'app ', 'cRqs', &OnRequest );
 	
 	dbgprintf ( "Server IP: %s\n", getIPStr ( getHostIP() ).c_str() );	
 	dbgprintf ( "Listening on %d..\n", srv_port );
@@ -84,40 +88,52 @@ void Server::SendWordsToClient ( std::string msg, int sock )
 	netSend ( e, sock ); // Send to specific client
 }
 
-int Server::Process ( Event& e )
+// Handlers, one per message (see netAddHandler)
+// Events without a handler go to Process.
+int Server::OnError ( Event& e, void* this_ptr )
 {
-	int sock;
-	std::string line;
-	eventStr_t sys = e.getTarget ( );
-	if ( sys == 'net ' && e.getName ( ) == 'nerr' ) { // Check for net error events
-		// Enable netShowVerbose ( true ) for detailed messages; handle specific net error codes here..			
-		int code = e.getInt ( );		
-		if ( code == NET_DISCONNECTED ) {
-			dbgprintf ( "  Connection to client closed unexpectedly.\n" );
-		}		
-		return 0;
+	// Enable netShowVerbose ( true ) for detailed messages; handle specific net error codes here..
+	int code = e.getInt ( );
+	if ( code == NET_DISCONNECTED ) {
+		dbgprintf ( "  Connection to client closed unexpectedly.\n" );
 	}
+	return 0;
+}
+
+int Server::OnConnect ( Event& e, void* this_ptr )
+{
+	// Connection to client complete. (telling myself)
+	e.startRead ( );
+	int sock = e.getInt ( ); // Server sock
+	dbgprintf ( "  Connected to client: #%d\n", sock );
+	return 1;
+}
+
+int Server::OnDisconnect ( Event& e, void* this_ptr )
+{
+	// Client closed connection
 	e.startRead ( );
-	switch ( e.getName ( ) ) { // Process Network events
-		case 'sOkT': // Connection to client complete. (telling myself)
-			sock = e.getInt ( ); // Server sock		
-			dbgprintf ( "  Connected to client: #%d\n", sock );
-			return 1;
-		case 'cFIN': // Client closed connection
-			sock = e.getInt();
-			dbgprintf ( "  Disconnected client: #%d\n", sock );
-			return 1;	
-	};
-	switch ( e.getName ( ) ) { // Process Application events
-		case 'cRqs': // Client requested words for num
-			int sock = e.getInt ( ); // Which client 
-			int seq = e.getInt ( ); 		
-			int num = e.getInt ( );	
-			std::string words = ConvertToWords ( num ); // Convert the num to words 
-			SendWordsToClient ( words, sock ); // Send words back to client
-			dbgprintf ( "  Sent words to #%d: SEQ-%d: %d, %s\n", sock, seq, num, words.c_str ( ) );
-			return 1;
-	};
+	int sock = e.getInt ( );
+	dbgprintf ( "  Disconnected client: #%d\n", sock );
+	return 1;
+}
+
+int Server::OnRequest ( Event& e, void* this_ptr )
+{
+	// Client requested words for num
+	Server* self = static_cast<Server*>( this_ptr );
+	e.startRead ( );
+	int sock = e.getInt ( ); // Which client
+	int seq = e.getInt ( );
+	int num = e.getInt ( );
+	std::string words = self->ConvertToWords ( num ); // Convert the num to words
+	self->SendWordsToClient ( words, sock ); // Send words back to client
+	dbgprintf ( "  Sent words to #%d: SEQ-%d: %d, %s\n", sock, seq, num, words.c_str ( ) );
+	return 1;
+}
+
+int Server::Process ( Event& e )
+{
 	dbgprintf ( "   Unhandled message: %s\n", e.getNameStr ( ).c_str ( ) );
 	return 0;
 }
@@ -14,6 +14,10 @@ public:
 	void Close ( );
 	int Process (Event& e);
 	static int NetEventCallback ( Event& e, void* this_ptr );	
+	static int OnError ( Event& e, void* this_ptr );
+	static int OnConnect ( Event& e, void* this_ptr );
+	static int OnDisconnect ( Event& e, void* this_ptr );
+	static int OnRequest ( Event& e, void* this_ptr );
 
 	// Demo app protocol
 	void InitWords ();
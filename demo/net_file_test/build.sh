@@ -0,0 +1,5 @@
+
+cmake CMakeLists.txt -B../../../build/net_file_test
+make -C../../../build/net_file_test
+
+
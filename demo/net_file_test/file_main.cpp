@@ -0,0 +1,187 @@
+
+//-------------------------------------------------------------------------------------------
+// File transfer test
+//
+// Headless. Runs a server and a client in one process on loopback, and sends files
+// both ways with NetFileTransfer.
+//
+//   transfer - client to server and back, with a small chunk so files span many events
+//   refuse   - offers fail until accept is on, and for names that leave the receive directory
+//   workers  - the same with one server worker, where the server side of the connection
+//              is owned by the worker thread and netFileRun runs on the main thread
+//
+// Writes under file_test/ in the working directory and removes it on exit. Exits with the
+// number of failed checks.
+//
+
+#include "network_system.h"
+#include "network_file.h"
+#include <stdio.h>
+#include <functional>
+#ifdef _WIN32
+	#include <direct.h>
+	#define test_mkdir(d)		_mkdir(d)
+	#define test_rmdir(d)		_rmdir(d)
+#else
+	#include <sys/stat.h>
+	#include <unistd.h>
+	#define test_mkdir(d)		mkdir(d, 0755)
+	#define test_rmdir(d)		rmdir(d)
+#endif
+
+#define TEST_PORT		16118
+#define TEST_DIR		"file_test"
+#define TEST_SIZE		100000
+
+int g_fail = 0;
+
+void check ( bool ok, const char* what )
+{
+	if ( !ok ) {
+		g_fail++;
+		printf ( "  FAIL: %s\n", what );
+	}
+}
+
+class Node : public NetworkSystem {
+public:
+	NetFileTransfer*	mFiles = 0x0;
+	int		mSock = -1;
+
+	static int Callback ( Event& e, void* this_ptr )
+	{
+		Node* self = (Node*) this_ptr;
+		return self->mFiles->netFileEvent ( e );
+	}
+	void Start ( int port, int workers )
+	{
+		netSetSecurityLevel ( NET_SECURITY_PLAIN_TCP );
+		netSetReconnectInterval ( 100 );
+		netInitialize ();
+		netShowVerbose ( false );
+		netShowFlow ( false );
+		netSetUserCallback ( &Callback );
+		mFiles = new NetFileTransfer ( this );
+		mFiles->netFileSetChunk ( 4096 );
+		if ( workers < 0 ) {
+			netClientStart ();
+			mSock = netClientConnectToServer ( "127.0.0.1", port, false );
+		} else {
+			netServerStart ( port );
+			if ( workers > 0 ) netServerStartWorkers ( workers );
+		}
+	}
+	void Stop ()
+	{
+		delete mFiles;
+		mFiles = 0x0;
+		if ( netGetNumWorkers() > 0 ) netServerStopWorkers ();
+	}
+	bool Ready ()		{ return netIsConnectComplete ( mSock ) && getServerSock ( mSock ) >= 0; }
+};
+
+bool pump ( Node& srv, Node& cli, double sec, std::function<bool()> done )
+{
+	uint64_t end = TimeX::GetSystemNSec() + (uint64_t) ( sec * SEC_SCALAR );
+	while ( TimeX::GetSystemNSec() < end ) {
+		srv.netProcessQueue ();
+		cli.netProcessQueue ();
+		srv.mFiles->netFileRun ();
+		cli.mFiles->netFileRun ();
+		if ( done () ) return true;
+	}
+	return false;
+}
+
+std::string read_file ( std::string path )
+{
+	std::string s;
+	FILE* fp = fopen ( path.c_str(), "rb" );
+	if ( fp == 0x0 ) return "<none>";
+	char buf[ 4096 ];
+	size_t n;
+	while ( ( n = fread ( buf, 1, sizeof(buf), fp ) ) > 0 ) s.append ( buf, n );
+	fclose ( fp );
+	return s;
+}
+
+void write_file ( std::string path, const std::string& s )
+{
+	FILE* fp = fopen ( path.c_str(), "wb" );
+	if ( fp == 0x0 ) return;
+	fwrite ( s.data(), 1, s.size(), fp );
+	fclose ( fp );
+}
+
+// Send a file and wait for the sender to finish, returns the final state
+int send_file ( Node& srv, Node& cli, Node& from, int sock, std::string path, std::string name )
+{
+	int id = from.mFiles->netFileSend ( path, sock, name );
+	if ( id < 0 ) return -1;
+	NetFileInfo info;
+	pump ( srv, cli, 10, [&] { return from.mFiles->getFileInfo ( id, sock, info ) && info.state > NET_FILE_ACTIVE; } );
+	pump ( srv, cli, 0.1, [] { return false; } );			// let the receiver finish
+	return from.mFiles->getFileInfo ( id, sock, info ) ? info.state : -1;
+}
+
+void run_tests ( int workers )
+{
+	Node srv, cli;
+	srv.Start ( TEST_PORT + workers, workers );			// port per run, the last may linger
+	cli.Start ( TEST_PORT + workers, -1 );
+	check ( pump ( srv, cli, 5, [&] { return cli.Ready(); } ), "client connects" );
+	int ssock = cli.getServerSock ( cli.mSock );			// client socket on the server
+	if ( workers > 0 ) check ( ssock >= NET_SHARD_SOCKS, "socket owned by a worker" );
+
+	std::string src;
+	for ( int n = 0; n < TEST_SIZE; n++ ) src += (char) ( n * 7 + n / 251 );
+	write_file ( TEST_DIR "/src.bin", src );
+
+	printf ( "transfer\n" );
+	srv.mFiles->netFileSetRecvDir ( TEST_DIR "/srv" );
+	cli.mFiles->netFileSetRecvDir ( TEST_DIR "/cli" );
+	check ( send_file ( srv, cli, cli, cli.mSock, TEST_DIR "/src.bin", "off.bin" ) == NET_FILE_FAILED, "offer refused by default" );
+	srv.mFiles->netFileSetAccept ( true );
+	cli.mFiles->netFileSetAccept ( true );
+	check ( send_file ( srv, cli, cli, cli.mSock, TEST_DIR "/src.bin", "up.bin" ) == NET_FILE_DONE, "client to server done" );
+	check ( read_file ( TEST_DIR "/srv/up.bin" ) == src, "client to server same bytes" );
+	check ( send_file ( srv, cli, srv, ssock, TEST_DIR "/src.bin", "down.bin" ) == NET_FILE_DONE, "server to client done" );
+	check ( read_file ( TEST_DIR "/cli/down.bin" ) == src, "server to client same bytes" );
+
+	printf ( "refuse\n" );
+	const char* names[] = { "../up.bin", "..", "sub/up.bin", "sub\\up.bin", "a..b", "." };
+	for ( const char* name : names ) {
+		char what[ 64 ];
+		snprintf ( what, sizeof(what), "name %s refused", name );
+		check ( send_file ( srv, cli, cli, cli.mSock, TEST_DIR "/src.bin", name ) == NET_FILE_FAILED, what );
+	}
+	check ( read_file ( TEST_DIR "/up.bin" ) == "<none>", "nothing written outside the receive directory" );
+	srv.mFiles->netFileSetAccept ( false );
+	check ( send_file ( srv, cli, cli, cli.mSock, TEST_DIR "/src.bin", "off.bin" ) == NET_FILE_FAILED, "offer refused while accept is off" );
+	check ( read_file ( TEST_DIR "/srv/off.bin" ) == "<none>", "refused file not written" );
+
+	cli.Stop ();
+	srv.Stop ();
+	remove ( TEST_DIR "/srv/up.bin" );
+	remove ( TEST_DIR "/cli/down.bin" );
+	remove ( TEST_DIR "/src.bin" );
+}
+
+int main ( int argc, char* argv[] )
+{
+	test_mkdir ( TEST_DIR );
+	test_mkdir ( TEST_DIR "/srv" );
+	test_mkdir ( TEST_DIR "/cli" );
+
+	run_tests ( 0 );
+	printf ( "workers\n" );
+	run_tests ( 1 );
+
+	test_rmdir ( TEST_DIR "/srv" );
+	test_rmdir ( TEST_DIR "/cli" );
+	test_rmdir ( TEST_DIR );
+
+	if ( g_fail == 0 ) printf ( "PASS\n" );
+	else printf ( "FAILED %d checks\n", g_fail );
+	return g_fail;
+}
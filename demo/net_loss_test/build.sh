@@ -0,0 +1,5 @@
+
+cmake CMakeLists.txt -B../../../build/net_loss_test
+make -C../../../build/net_loss_test
+
+
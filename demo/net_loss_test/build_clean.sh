@@ -0,0 +1,3 @@
+
+rm -rf ../../../build/net_loss_test/*
+
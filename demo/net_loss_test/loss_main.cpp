@@ -0,0 +1,220 @@
+
+//-------------------------------------------------------------------------------------------
+// UDP loss test
+//
+// Headless. Runs a server and a client in one process on loopback, with reliable UDP
+// channels, and drops or delays datagrams with netSetLossModel and netSetEmulation.
+//
+//   order    - 30% loss both ways, every message on the ordered channel arrives once,
+//              in order, and some were resent
+//   delay    - latency, jitter and reordering with 10% loss. Ordered stays in order,
+//              unordered arrives once each, sequenced only moves forward.
+//   timeout  - with every datagram dropped, a reliable message is given up after
+//              NET_REL_MAX_SENDS sends. Once loss clears, new messages go through.
+//
+// Exits with the number of failed checks.
+//
+
+#include "network_system.h"
+#include <stdio.h>
+#include <vector>
+#include <functional>
+
+#define TEST_PORT		16123				// UDP on the next port
+#define TEST_MSGS		100
+
+#define CH_ORDERED		1
+#define CH_UNORDERED	2
+#define CH_SEQUENCED	3
+
+int g_fail = 0;
+
+void check ( bool ok, const char* what )
+{
+	if ( !ok ) {
+		g_fail++;
+		printf ( "  FAIL: %s\n", what );
+	}
+}
+
+class Node : public NetworkSystem {
+public:
+	int		mSock = -1;
+	int		mSrcSock = -1;									// socket of last event
+	std::vector<int>	mGot[ NET_REL_CHANNELS ];		// message numbers received, per channel
+
+	static int Callback ( Event& e, void* this_ptr )
+	{
+		Node* self = (Node*) this_ptr;
+		if ( e.getTarget() != 'app ' ) return 0;
+		self->mSrcSock = e.getSrcSock ();
+		if ( e.getName() != 'tMsg' ) return 1;
+		e.startRead ();
+		e.getInt ();												// session id
+		int ch = e.getInt ();
+		int k = e.getInt ();
+		if ( ch >= 0 && ch < NET_REL_CHANNELS ) self->mGot[ ch ].push_back ( k );
+		return 1;
+	}
+	void Start ( bool server )
+	{
+		netSetSecurityLevel ( NET_SECURITY_PLAIN_TCP );
+		netSetReconnectInterval ( 2000 );
+		netInitialize ();
+		netShowVerbose ( false );
+		netShowFlow ( false );
+		netSetUserCallback ( &Callback );
+		netSetProcessInterval ( 1 );
+		netSetRetransmit ( 10 );
+		netSetChannel ( CH_ORDERED, NET_CHAN_RELIABLE_ORDERED );
+		netSetChannel ( CH_UNORDERED, NET_CHAN_RELIABLE_UNORDERED );
+		netSetChannel ( CH_SEQUENCED, NET_CHAN_UNRELIABLE_SEQUENCED );
+		if ( server ) {
+			netServerStart ( TEST_PORT );
+		} else {
+			netClientStart ();
+			mSock = netClientConnectToServer ( "127.0.0.1", TEST_PORT, false );
+			netClientConnectUDP ( mSock );
+		}
+	}
+	bool Ready ()		{ return netIsConnectComplete ( mSock ) && getServerSock ( mSock ) >= 0 && getUDPPeerSock ( mSock ) >= 0; }
+	bool Send ( int sock, int ch, int k )
+	{
+		Event e;
+		new_event ( e, 64, 'app ', 'tMsg', 0, getNetPool() );
+		e.attachInt ( getUDPPeerSock ( sock ) );			// session id, first int of a datagram
+		e.attachInt ( ch );
+		e.attachInt ( k );
+		return netSend ( e, sock, ch );
+	}
+	bool Idle ( int sock )	{ NetRel* r = getSockRel ( sock ); return r == 0x0 || r->pending.empty(); }
+	void Clear ()				{ for ( int c = 0; c < NET_REL_CHANNELS; c++ ) mGot[ c ].clear(); }
+};
+
+bool pump ( Node& srv, Node& cli, double sec, std::function<bool()> done )
+{
+	uint64_t end = TimeX::GetSystemNSec() + (uint64_t) ( sec * SEC_SCALAR );
+	while ( TimeX::GetSystemNSec() < end ) {
+		srv.netProcessQueue ();
+		cli.netProcessQueue ();
+		if ( done () ) return true;
+	}
+	return false;
+}
+
+bool in_order ( std::vector<int>& got, int cnt )
+{
+	if ( (int) got.size() != cnt ) return false;
+	for ( int k = 0; k < cnt; k++ ) if ( got[ k ] != k ) return false;
+	return true;
+}
+
+bool each_once ( std::vector<int>& got, int cnt )
+{
+	std::vector<int> seen ( cnt, 0 );
+	for ( int k : got ) {
+		if ( k < 0 || k >= cnt || seen[ k ]++ > 0 ) return false;
+	}
+	return (int) got.size() == cnt;
+}
+
+bool forward ( std::vector<int>& got )
+{
+	for ( int n = 1; n < (int) got.size(); n++ ) if ( got[ n ] <= got[ n-1 ] ) return false;
+	return true;
+}
+
+void test_order ( Node& srv, Node& cli, int ssock )
+{
+	printf ( "order\n" );
+	srv.Clear ();
+	cli.Clear ();
+	srv.netSetLossModel ( 0.3f, 7 );
+	cli.netSetLossModel ( 0.3f, 9 );
+	uint64_t lost = srv.getUDPLost() + cli.getUDPLost();
+	for ( int k = 0; k < TEST_MSGS; k++ ) {
+		srv.Send ( ssock, CH_ORDERED, k );
+		cli.Send ( cli.mSock, CH_ORDERED, k );
+	}
+	bool done = pump ( srv, cli, 10, [&] { return srv.mGot[ CH_ORDERED ].size() >= TEST_MSGS && cli.mGot[ CH_ORDERED ].size() >= TEST_MSGS && srv.Idle ( ssock ) && cli.Idle ( cli.mSock ); } );
+	check ( done, "all delivered and acked" );
+	check ( in_order ( srv.mGot[ CH_ORDERED ], TEST_MSGS ), "client to server in order, once each" );
+	check ( in_order ( cli.mGot[ CH_ORDERED ], TEST_MSGS ), "server to client in order, once each" );
+	check ( srv.getUDPLost() + cli.getUDPLost() > lost, "datagrams dropped" );
+	check ( srv.getSockRel ( ssock )->numResent > 0 && cli.getSockRel ( cli.mSock )->numResent > 0, "messages resent" );
+	srv.netSetLossModel ( 0 );
+	cli.netSetLossModel ( 0 );
+}
+
+void test_delay ( Node& srv, Node& cli, int ssock )
+{
+	printf ( "delay\n" );
+	srv.Clear ();
+	cli.Clear ();
+	NetEmuConfig cfg;
+	cfg.latency_ms = 20;
+	cfg.jitter_ms = 15;
+	cfg.reorder = 0.25f;
+	cfg.loss = 0.1f;
+	cfg.seed = 5;
+	cli.netSetEmulation ( cfg );
+	for ( int k = 0; k < TEST_MSGS; k++ ) {
+		srv.Send ( ssock, CH_ORDERED, k );
+		srv.Send ( ssock, CH_UNORDERED, k );
+		srv.Send ( ssock, CH_SEQUENCED, k );
+		if ( k % 10 == 9 ) pump ( srv, cli, 0.005, [] { return false; } );		// spread over time, so datagrams overtake
+	}
+	bool done = pump ( srv, cli, 10, [&] { return cli.mGot[ CH_ORDERED ].size() >= TEST_MSGS && cli.mGot[ CH_UNORDERED ].size() >= TEST_MSGS && srv.Idle ( ssock ); } );
+	pump ( srv, cli, 0.2, [] { return false; } );				// late sequenced datagrams
+	check ( done, "reliable delivered and acked" );
+	check ( in_order ( cli.mGot[ CH_ORDERED ], TEST_MSGS ), "ordered in order, once each" );
+	check ( each_once ( cli.mGot[ CH_UNORDERED ], TEST_MSGS ), "unordered once each" );
+	check ( forward ( cli.mGot[ CH_SEQUENCED ] ), "sequenced only moves forward" );
+	check ( cli.mGot[ CH_SEQUENCED ].size() > 0 && cli.mGot[ CH_SEQUENCED ].size() < TEST_MSGS, "sequenced drops late and lost datagrams" );
+	NetEmu* emu = cli.getSockEmu ( -1 );
+	check ( emu != 0x0 && emu->numReordered > 0 && emu->numDropped > 0, "datagrams reordered and dropped" );
+	cli.netClearEmulation ();
+}
+
+void test_timeout ( Node& srv, Node& cli, int ssock )
+{
+	printf ( "timeout\n" );
+	srv.Clear ();
+	cli.Clear ();
+	cli.netSetLossModel ( 1.0f );
+	uint64_t resent = srv.getSockRel ( ssock )->numResent;
+	srv.Send ( ssock, CH_UNORDERED, 0 );
+	bool done = pump ( srv, cli, 10, [&] { return srv.Idle ( ssock ); } );
+	check ( done, "message given up" );
+	check ( srv.getSockRel ( ssock )->numResent - resent == NET_REL_MAX_SENDS - 1, "sent NET_REL_MAX_SENDS times" );
+	check ( cli.mGot[ CH_UNORDERED ].empty(), "nothing delivered" );
+	check ( srv.netIsConnectComplete ( ssock ) && cli.Ready(), "TCP connection kept" );
+
+	cli.netSetLossModel ( 0 );
+	srv.Send ( ssock, CH_UNORDERED, 1 );
+	done = pump ( srv, cli, 5, [&] { return cli.mGot[ CH_UNORDERED ].size() >= 1 && srv.Idle ( ssock ); } );
+	check ( done && cli.mGot[ CH_UNORDERED ][ 0 ] == 1, "new message delivered once loss clears" );
+}
+
+int main ( int argc, char* argv[] )
+{
+	Node srv, cli;
+	srv.Start ( true );
+	cli.Start ( false );
+	check ( pump ( srv, cli, 5, [&] { return cli.Ready(); } ), "client connects" );
+
+	// server learns the client socket from its first event
+	Event e;
+	new_event ( e, 64, 'app ', 'tHi ', 0, cli.getNetPool() );
+	cli.netSend ( e, cli.mSock );
+	check ( pump ( srv, cli, 5, [&] { return srv.mSrcSock >= 0 && srv.getUDPPeerSock ( srv.mSrcSock ) >= 0; } ), "server knows the client" );
+	int ssock = srv.mSrcSock;
+
+	test_order ( srv, cli, ssock );
+	test_delay ( srv, cli, ssock );
+	test_timeout ( srv, cli, ssock );
+
+	if ( g_fail == 0 ) printf ( "PASS\n" );
+	else printf ( "FAILED %d checks\n", g_fail );
+	return g_fail;
+}
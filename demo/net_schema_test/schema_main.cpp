@@ -0,0 +1,197 @@
+
+//-------------------------------------------------------------------------------------------
+// Event schema decoder test
+//
+// Headless. Writes schema structs into events and reads them back, then checks that
+// the decoder rejects every truncated payload and hostile element counts without
+// reading past the payload or allocating from the count alone.
+//
+//   roundtrip  - plain, string, vector, vector of strings, nested vectors and schemas
+//   truncate   - every payload length short of the full struct must fail to read
+//   counts     - negative, overflowing and oversized vector counts must fail to read
+//
+// Exits with the number of failed checks. Run under a sanitizer to catch overreads.
+//
+
+#include "event_system.h"
+#include "event_schema.h"
+#include <stdio.h>
+#include <string.h>
+#include <climits>
+
+struct Point {
+	int id;
+	Vec4F pos;
+};
+EVENT_SCHEMA ( Point, &Point::id, &Point::pos )
+
+struct Tag {
+	std::string key;
+	std::vector<int> vals;
+};
+EVENT_SCHEMA ( Tag, &Tag::key, &Tag::vals )
+
+struct Msg {
+	int id;
+	std::string name;
+	std::vector<float> path;
+	std::vector<std::string> words;
+	std::vector< std::vector<int> > grid;
+	std::vector<Point> points;
+	std::vector<Tag> tags;
+	xlong stamp;
+};
+EVENT_SCHEMA ( Msg, &Msg::id, &Msg::name, &Msg::path, &Msg::words, &Msg::grid, &Msg::points, &Msg::tags, &Msg::stamp )
+
+struct Words {
+	std::vector<std::string> words;
+};
+EVENT_SCHEMA ( Words, &Words::words )
+
+struct Ints {
+	std::vector<int> vals;
+};
+EVENT_SCHEMA ( Ints, &Ints::vals )
+
+struct Tags {
+	std::vector<Tag> tags;
+};
+EVENT_SCHEMA ( Tags, &Tags::tags )
+
+int g_fail = 0;
+
+void check ( bool ok, const char* what )
+{
+	if ( !ok ) {
+		g_fail++;
+		printf ( "  FAIL: %s\n", what );
+	}
+}
+
+Msg make_msg ()
+{
+	Msg m;
+	m.id = 42;
+	m.name = "schema";
+	m.path = { 1.5f, 2.5f, -3.0f };
+	m.words = { "a", "", "three" };
+	m.grid = { { 1, 2 }, {}, { 3 } };
+	m.points = { { 7, Vec4F(1,2,3,4) }, { 8, Vec4F(5,6,7,8) } };
+	m.tags = { { "x", { 1 } }, { "", {} } };
+	m.stamp = 0x123456789ALL;
+	return m;
+}
+
+bool same ( const Msg& a, const Msg& b )
+{
+	if ( a.id != b.id || a.name != b.name || a.path != b.path || a.words != b.words || a.grid != b.grid || a.stamp != b.stamp ) return false;
+	if ( a.points.size() != b.points.size() || a.tags.size() != b.tags.size() ) return false;
+	for ( size_t i = 0; i < a.points.size(); i++ ) {
+		if ( a.points[i].id != b.points[i].id || memcmp ( &a.points[i].pos, &b.points[i].pos, sizeof(Vec4F) ) != 0 ) return false;
+	}
+	for ( size_t i = 0; i < a.tags.size(); i++ ) {
+		if ( a.tags[i].key != b.tags[i].key || a.tags[i].vals != b.tags[i].vals ) return false;
+	}
+	return true;
+}
+
+// Event holding exactly the first len bytes of buf
+void make_payload ( Event& e, const char* buf, int len )
+{
+	new_event ( e, len > 0 ? len : 1, 'app ', 'tSch', 0, 0x0 );
+	if ( len > 0 ) e.attachBuf ( (char*) buf, len );
+	e.startRead ();
+}
+
+void test_roundtrip ()
+{
+	printf ( "roundtrip\n" );
+	Msg m = make_msg ();
+	Event e;
+	new_event_schema ( e, m, 'app ', 'tSch', 0x0 );
+	check ( e.getDataLength() == schema_size ( m ), "payload is schema size" );
+
+	e.startRead ();
+	Msg r;
+	check ( get_schema ( e, r ), "read back" );
+	check ( same ( m, r ), "fields match" );
+	check ( e.mPos == e.mData + e.getDataLength(), "read consumes payload" );
+}
+
+void test_truncate ()
+{
+	printf ( "truncate\n" );
+	Msg m = make_msg ();
+	Event full;
+	new_event_schema ( full, m, 'app ', 'tSch', 0x0 );
+	int len = full.getDataLength ();
+	std::vector<char> buf ( full.mData, full.mData + len );
+
+	int ok = 0;
+	for ( int n = 0; n < len; n++ ) {
+		Event e;
+		make_payload ( e, buf.data(), n );
+		e.mDataLen = n;							// payload ends here
+		Msg r;
+		char* pos = e.mPos;
+		if ( get_schema ( e, r ) ) ok++;
+		check ( e.mPos == pos, "failed read keeps position" );
+	}
+	check ( ok == 0, "no truncated payload reads" );
+}
+
+// Payload of one int count followed by pad bytes
+bool read_count ( int cnt, int pad, bool (*fn)( Event& ) )
+{
+	std::vector<char> buf ( sizeof(int) + pad, 0 );
+	memcpy ( buf.data(), &cnt, sizeof(int) );
+	Event e;
+	make_payload ( e, buf.data(), (int) buf.size() );
+	return fn ( e );
+}
+bool read_ints ( Event& e )		{ Ints v;  return get_schema ( e, v ); }
+bool read_words ( Event& e )	{ Words v; return get_schema ( e, v ); }
+bool read_tags ( Event& e )		{ Tags v;  return get_schema ( e, v ); }
+
+void test_counts ()
+{
+	printf ( "counts\n" );
+	// fixed elements. cnt * 4 overflows int for these counts
+	check ( !read_count ( -1, 64, read_ints ), "negative count" );
+	check ( !read_count ( INT_MAX, 64, read_ints ), "INT_MAX ints" );
+	check ( !read_count ( 0x40000001, 64, read_ints ), "count * 4 wraps to 4" );
+	check ( !read_count ( 0x7FFFFFF0 / 4 + 1, 64, read_ints ), "count * 4 past INT_MAX" );
+	check ( !read_count ( 17, 64, read_ints ), "one int more than payload" );
+	check ( read_count ( 16, 64, read_ints ), "exact payload" );
+
+	// variable elements. each holds at least a length, so the count is bounded by the payload
+	check ( !read_count ( INT_MAX, 64, read_words ), "INT_MAX strings" );
+	check ( !read_count ( 1 << 28, 64, read_words ), "2^28 strings" );
+	check ( !read_count ( 17, 64, read_words ), "one string more than payload" );
+	check ( read_count ( 16, 64, read_words ), "16 empty strings" );
+	check ( !read_count ( INT_MAX, 64, read_tags ), "INT_MAX nested schemas" );
+	check ( !read_count ( 9, 64, read_tags ), "one nested schema more than payload" );
+	check ( read_count ( 8, 64, read_tags ), "8 empty nested schemas" );
+
+	// count inside a nested element
+	Tags t;
+	t.tags = { { "k", { 1, 2 } } };
+	Event e;
+	new_event_schema ( e, t, 'app ', 'tSch', 0x0 );
+	int bad = INT_MAX;
+	memcpy ( e.mData + 2*sizeof(int) + 1, &bad, sizeof(int) );		// after tags count, key length and key
+	e.startRead ();
+	Tags r;
+	check ( !get_schema ( e, r ), "nested INT_MAX count" );
+}
+
+int main ( int argc, char* argv[] )
+{
+	test_roundtrip ();
+	test_truncate ();
+	test_counts ();
+
+	if ( g_fail == 0 ) printf ( "PASS\n" );
+	else printf ( "FAILED %d checks\n", g_fail );
+	return g_fail;
+}
@@ -0,0 +1,163 @@
+
+//-------------------------------------------------------------------------------------------
+// Socket slot and handle test
+//
+// Headless. Runs a server and clients in one process on loopback, and checks that a socket
+// handle stops resolving once its socket closes, including after the slot is reused.
+//
+//   reuse   - a client disconnects and a new one connects into the same (erased) slot
+//   free    - a slot in the middle of the list is reused from the free list
+//   length  - an event header with a negative, overflowing or too large length drops the
+//             connection, with the receive ring and with the legacy receive buffer
+//
+// Exits with the number of failed checks.
+//
+
+#include "network_system.h"
+#include <stdio.h>
+#include <string.h>
+#include <climits>
+#include <functional>
+
+#define TEST_PORT		16117
+
+int g_fail = 0;
+
+void check ( bool ok, const char* what )
+{
+	if ( !ok ) {
+		g_fail++;
+		printf ( "  FAIL: %s\n", what );
+	}
+}
+
+class Node : public NetworkSystem {
+public:
+	int		mSock = -1;
+
+	void StartServer ()
+	{
+		netSetSecurityLevel ( NET_SECURITY_PLAIN_TCP );
+		netInitialize ();
+		netShowVerbose ( false );
+		netShowFlow ( false );
+		netServerStart ( TEST_PORT );
+	}
+	void StartClient ()
+	{
+		netSetSecurityLevel ( NET_SECURITY_PLAIN_TCP );
+		netSetReconnectInterval ( 100 );
+		netInitialize ();
+		netShowVerbose ( false );
+		netShowFlow ( false );
+		netClientStart ();
+		mSock = netClientConnectToServer ( "127.0.0.1", TEST_PORT, false );
+	}
+	bool Ready ()		{ return netIsConnectComplete ( mSock ) && getServerSock ( mSock ) >= 0; }
+};
+
+// Process every node until done, or the time runs out
+bool pump ( std::vector<Node*> nodes, double sec, std::function<bool()> done )
+{
+	uint64_t end = TimeX::GetSystemNSec() + (uint64_t) ( sec * SEC_SCALAR );
+	while ( TimeX::GetSystemNSec() < end ) {
+		for ( Node* n : nodes ) n->netProcessQueue ();
+		if ( done () ) return true;
+	}
+	return false;
+}
+
+// Connect a client and return its socket on the server
+int connect_client ( Node& srv, Node& cli )
+{
+	cli.StartClient ();
+	if ( !pump ( { &srv, &cli }, 5, [&] { return cli.Ready(); } ) ) return -1;
+	return cli.getServerSock ( cli.mSock );
+}
+
+// Close a client and wait for the server to see it
+bool disconnect_client ( Node& srv, Node& cli, int srv_sock )
+{
+	xlong h = srv.netSockHandle ( srv_sock );
+	cli.netCloseConnection ( cli.mSock );
+	return pump ( { &srv, &cli }, 5, [&] { return srv.netSockFromHandle ( h ) < 0; } );
+}
+
+void test_reuse ( Node& srv )
+{
+	printf ( "reuse\n" );
+	for ( int n = 0; n < 3; n++ ) {
+		Node a, b;
+		int sa = connect_client ( srv, a );
+		check ( sa >= 0, "first client connects" );
+		xlong h = srv.netSockHandle ( sa );
+		check ( h != 0 && srv.netSockFromHandle ( h ) == sa, "handle resolves while open" );
+		check ( disconnect_client ( srv, a, sa ), "handle stops resolving on close" );
+
+		int sb = connect_client ( srv, b );
+		check ( sb == sa, "new client takes the same slot" );
+		check ( srv.netSockFromHandle ( h ) == -1, "stale handle does not resolve to the new client" );
+		xlong hb = srv.netSockHandle ( sb );
+		check ( hb != h && srv.netSockFromHandle ( hb ) == sb, "new handle resolves" );
+		check ( disconnect_client ( srv, b, sb ), "second client closes" );
+	}
+}
+
+void test_free ( Node& srv )
+{
+	printf ( "free\n" );
+	Node a, b, c;
+	int sa = connect_client ( srv, a );
+	int sb = connect_client ( srv, b );
+	check ( sa >= 0 && sb > sa, "two clients connect" );
+	xlong ha = srv.netSockHandle ( sa );
+	check ( disconnect_client ( srv, a, sa ), "first client closes" );
+
+	int sc = connect_client ( srv, c );
+	check ( sc == sa, "free slot reused" );
+	check ( srv.netSockFromHandle ( ha ) == -1, "stale handle does not resolve to the reused slot" );
+	check ( srv.netSockFromHandle ( srv.netSockHandle ( sb ) ) == sb, "other client unaffected" );
+	disconnect_client ( srv, b, sb );
+	disconnect_client ( srv, c, sc );
+}
+
+void test_length ( Node& srv )
+{
+	printf ( "length\n" );
+	int lens[] = { -5, INT_MAX - 8, 2048 };			// data lengths, max is 1024
+	srv.netSetMaxEventSize ( 1024 );
+	for ( int ring = 0; ring < 2; ring++ ) {
+		srv.netSetRecvRing ( ring ? 65536 : 0 );			// sockets accepted after this
+		for ( int len : lens ) {
+			Node a;
+			int sa = connect_client ( srv, a );
+			xlong h = srv.netSockHandle ( sa );
+
+			// raw header, then a few bytes of data, written to the socket under the library
+			char hdr[ 64 ];
+			int n = Event::staticSerializedHeaderSize() + 16;
+			memset ( hdr, 'x', n );
+			memcpy ( hdr + Event::staticOffsetLenInfo(), &len, sizeof(int) );
+			check ( send ( a.getSock ( a.mSock )->socket, hdr, n, 0 ) == n, "raw header sent" );
+
+			char what[ 64 ];
+			snprintf ( what, sizeof(what), "length %d dropped, %s", len, ring ? "ring" : "legacy" );
+			check ( pump ( { &srv, &a }, 5, [&] { return srv.netSockFromHandle ( h ) < 0; } ), what );
+		}
+	}
+	srv.netSetMaxEventSize ( 64*1024*1024 );
+	srv.netSetRecvRing ( 65536 );
+}
+
+int main ( int argc, char* argv[] )
+{
+	Node srv;
+	srv.StartServer ();
+	test_reuse ( srv );
+	test_free ( srv );
+	test_length ( srv );
+
+	if ( g_fail == 0 ) printf ( "PASS\n" );
+	else printf ( "FAILED %d checks\n", g_fail );
+	return g_fail;
+}
@@ -0,0 +1,220 @@
+
+//-------------------------------------------------------------------------------------------
+// TLS loopback test
+//
+// Headless. Makes a self-signed certificate, runs a TLS server and client in one process
+// on loopback, and checks:
+//
+//   connect  - full handshake, events both ways, small (queued) and large (written at once)
+//   resume   - the client reconnects after a close and resumes the session
+//   sigpipe  - the library leaves the SIGPIPE handler alone, and writes to a peer that has
+//              gone away fail without raising it (SIGPIPE would end this test)
+//
+// Needs BUILD_OPENSSL. Writes tls_test_cert.pem and tls_test_key.pem in the working
+// directory and removes them on exit. Exits with the number of failed checks.
+//
+
+#include "network_system.h"
+#include <stdio.h>
+#include <string.h>
+#include <functional>
+
+#ifdef BUILD_OPENSSL
+
+#include <openssl/evp.h>
+#include <openssl/pem.h>
+#include <openssl/x509.h>
+#include <openssl/x509v3.h>
+#ifndef _WIN32
+	#include <signal.h>
+	#include <unistd.h>
+#endif
+
+#define TEST_PORT		16119
+#define TEST_CERT		"tls_test_cert.pem"
+#define TEST_KEY		"tls_test_key.pem"
+#define TEST_LARGE		200000			// above the TLS write size, written without queuing
+
+int g_fail = 0;
+
+void check ( bool ok, const char* what )
+{
+	if ( !ok ) {
+		g_fail++;
+		printf ( "  FAIL: %s\n", what );
+	}
+}
+
+// Self-signed certificate for 127.0.0.1, used as its own trust anchor by the client
+bool make_cert ()
+{
+	EVP_PKEY* key = 0x0;
+	EVP_PKEY_CTX* kctx = EVP_PKEY_CTX_new_id ( EVP_PKEY_EC, 0x0 );
+	if ( kctx == 0x0 || EVP_PKEY_keygen_init ( kctx ) <= 0 || EVP_PKEY_CTX_set_ec_paramgen_curve_nid ( kctx, NID_X9_62_prime256v1 ) <= 0 || EVP_PKEY_keygen ( kctx, &key ) <= 0 ) {
+		EVP_PKEY_CTX_free ( kctx );
+		return false;
+	}
+	EVP_PKEY_CTX_free ( kctx );
+
+	X509* x = X509_new ();
+	X509_set_version ( x, 2 );
+	ASN1_INTEGER_set ( X509_get_serialNumber ( x ), 1 );
+	X509_gmtime_adj ( X509_getm_notBefore ( x ), -3600 );
+	X509_gmtime_adj ( X509_getm_notAfter ( x ), 24 * 3600 );
+	X509_set_pubkey ( x, key );
+	X509_NAME* name = X509_get_subject_name ( x );
+	X509_NAME_add_entry_by_txt ( name, "CN", MBSTRING_ASC, (const unsigned char*) "127.0.0.1", -1, -1, 0 );
+	X509_set_issuer_name ( x, name );
+	X509V3_CTX v3;
+	X509V3_set_ctx_nodb ( &v3 );
+	X509V3_set_ctx ( &v3, x, x, 0x0, 0x0, 0 );
+	X509_EXTENSION* ext = X509V3_EXT_conf_nid ( 0x0, &v3, NID_basic_constraints, "critical,CA:TRUE" );
+	if ( ext != 0x0 ) X509_add_ext ( x, ext, -1 );
+	X509_EXTENSION_free ( ext );
+	bool ok = X509_sign ( x, key, EVP_sha256() ) > 0;
+
+	FILE* fp = fopen ( TEST_CERT, "wb" );
+	ok = ok && fp != 0x0 && PEM_write_X509 ( fp, x ) == 1;
+	if ( fp ) fclose ( fp );
+	fp = fopen ( TEST_KEY, "wb" );
+	ok = ok && fp != 0x0 && PEM_write_PrivateKey ( fp, key, 0x0, 0x0, 0, 0x0, 0x0 ) == 1;
+	if ( fp ) fclose ( fp );
+	X509_free ( x );
+	EVP_PKEY_free ( key );
+	return ok;
+}
+
+class Node : public NetworkSystem {
+public:
+	int		mSock = -1;
+	int		mRecv = 0;				// 'app ' events received
+	int		mRecvBytes = 0;
+	int		mSrcSock = -1;		// socket of last event
+
+	static int Callback ( Event& e, void* this_ptr )
+	{
+		Node* self = (Node*) this_ptr;
+		if ( e.getTarget() != 'app ' || e.getName() != 'tMsg' ) return 0;
+		self->mRecv++;
+		self->mRecvBytes += e.getDataLength ();
+		self->mSrcSock = e.getSrcSock ();
+		return 1;
+	}
+	void Start ( bool server )
+	{
+		netSetSecurityLevel ( NET_SECURITY_OPENSSL );
+		netSetReconnectInterval ( 2000 );			// also the handshake timeout
+		netSetPathToPublicKey ( TEST_CERT );
+		if ( server ) netSetPathToPrivateKey ( TEST_KEY );
+		netInitialize ();
+		netShowVerbose ( false );
+		netShowFlow ( false );
+		netSetUserCallback ( &Callback );
+		netSetProcessInterval ( 1 );
+		if ( server ) {
+			netServerStart ( TEST_PORT, NET_SECURITY_OPENSSL );
+		} else {
+			netClientStart ();
+		}
+	}
+	void Connect ()		{ mSock = netClientConnectToServer ( "127.0.0.1", TEST_PORT, false ); }
+	bool Ready ()		{ return netIsConnectComplete ( mSock ) && getServerSock ( mSock ) >= 0; }
+	bool Send ( int sock, int len )
+	{
+		Event e;
+		new_event ( e, len + 16, 'app ', 'tMsg', 0, getNetPool() );
+		std::string s ( len, 'x' );
+		e.attachBuf ( (char*) s.data(), len );
+		return netSend ( e, sock );
+	}
+};
+
+bool pump ( Node& srv, Node& cli, double sec, std::function<bool()> done )
+{
+	uint64_t end = TimeX::GetSystemNSec() + (uint64_t) ( sec * SEC_SCALAR );
+	while ( TimeX::GetSystemNSec() < end ) {
+		srv.netProcessQueue ();
+		cli.netProcessQueue ();
+		if ( done () ) return true;
+	}
+	return false;
+}
+
+// Events both ways on a connected client
+void exchange ( Node& srv, Node& cli, const char* what )
+{
+	char msg[ 128 ];
+	int srv_got = srv.mRecv, cli_got = cli.mRecv;
+	check ( cli.Send ( cli.mSock, 100 ) && cli.Send ( cli.mSock, TEST_LARGE ), "client sends" );
+	bool ok = pump ( srv, cli, 5, [&] { return srv.mRecv == srv_got + 2; } );
+	snprintf ( msg, sizeof(msg), "%s, server receives", what );
+	check ( ok, msg );
+
+	check ( srv.Send ( srv.mSrcSock, 100 ) && srv.Send ( srv.mSrcSock, TEST_LARGE ), "server sends" );
+	ok = pump ( srv, cli, 5, [&] { return cli.mRecv == cli_got + 2; } );
+	snprintf ( msg, sizeof(msg), "%s, client receives", what );
+	check ( ok, msg );
+}
+
+int main ( int argc, char* argv[] )
+{
+	#ifndef _WIN32
+		struct sigaction before, after;
+		sigaction ( SIGPIPE, 0x0, &before );
+	#endif
+	if ( !make_cert () ) {
+		printf ( "  FAIL: make certificate\n" );
+		return 1;
+	}
+	Node srv, cli;
+	srv.Start ( true );
+	cli.Start ( false );
+
+	printf ( "connect\n" );
+	cli.Connect ();
+	check ( pump ( srv, cli, 5, [&] { return cli.Ready(); } ), "client connects" );
+	exchange ( srv, cli, "first connection" );
+	check ( cli.getStats().total.tls_full.get() == 1 && cli.getStats().total.tls_resumed.get() == 0, "full handshake" );
+
+	printf ( "resume\n" );
+	int srv_sock = srv.mSrcSock;
+	cli.netCloseConnection ( cli.mSock );					// client socket is kept and reconnects
+	pump ( srv, cli, 5, [&] { return !srv.netIsConnectComplete ( srv_sock ); } );
+	check ( pump ( srv, cli, 5, [&] { return cli.Ready(); } ), "client reconnects" );
+	exchange ( srv, cli, "resumed connection" );
+	check ( cli.getStats().total.tls_resumed.get() == 1, "client resumed" );
+	check ( srv.getStats().total.tls_resumed.get() == 1, "server resumed" );
+
+	printf ( "sigpipe\n" );
+	#ifndef _WIN32
+		sigaction ( SIGPIPE, 0x0, &after );
+		check ( after.sa_handler == before.sa_handler, "SIGPIPE handler unchanged" );
+
+		// close the client socket under the library, so the server writes to a peer that
+		// has gone away. Writes after the reset would raise SIGPIPE.
+		srv_sock = srv.mSrcSock;
+		close ( cli.getSock ( cli.mSock )->socket );
+		for ( int n = 0; n < 20 && srv.netIsConnectComplete ( srv_sock ); n++ ) {
+			srv.Send ( srv_sock, TEST_LARGE );
+			srv.netSendFlush ();
+			pump ( srv, srv, 0.01, [] { return false; } );
+		}
+		check ( !srv.netIsConnectComplete ( srv_sock ), "server closes the socket" );
+	#endif
+
+	remove ( TEST_CERT );
+	remove ( TEST_KEY );
+	if ( g_fail == 0 ) printf ( "PASS\n" );
+	else printf ( "FAILED %d checks\n", g_fail );
+	return g_fail;
+}
+
+#else
+
+int main ( int argc, char* argv[] )
+{
+	printf ( "Skipped, built without BUILD_OPENSSL.\n" );
+	return 0;
+}
+
+#endif
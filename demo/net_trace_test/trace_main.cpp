@@ -0,0 +1,219 @@
+
+//-------------------------------------------------------------------------------------------
+// Trace dump test
+//
+// Headless. Writes trace records, dumps them to a binary file and decodes it to text, and
+// checks that every record comes back.
+//
+//   roundtrip - records from two threads, dumped and decoded with names, sockets and args
+//   wrap      - a ring that overflows keeps its newest records, oldest first
+//   badfile   - decode refuses a missing file and a bad magic
+//   points    - with NET_TRACE_RING, events over loopback leave send and recv_event records
+//
+// Writes trace_test.bin and trace_test.txt in the working directory and removes them on
+// exit. Exits with the number of failed checks.
+//
+
+#include "network_system.h"
+#include "network_trace.h"
+#include <stdio.h>
+#include <string.h>
+#include <string>
+#include <vector>
+#include <thread>
+#include <functional>
+
+#define TEST_BIN		"trace_test.bin"
+#define TEST_TXT		"trace_test.txt"
+#define TEST_PORT		16125
+
+int g_fail = 0;
+
+void check ( bool ok, const char* what )
+{
+	if ( !ok ) {
+		g_fail++;
+		printf ( "  FAIL: %s\n", what );
+	}
+}
+
+struct Line {
+	double		usec;
+	unsigned	thread;
+	std::string	name;
+	int			sock;
+	std::string	arg;
+};
+
+// Decoded text, one line per record
+std::vector<Line> read_text ( const char* fn )
+{
+	std::vector<Line> lines;
+	FILE* fp = fopen ( fn, "rt" );
+	if ( fp == 0x0 ) return lines;
+	char buf[ 256 ], name[ 32 ], arg[ 64 ];
+	Line ln;
+	while ( fgets ( buf, sizeof(buf), fp ) ) {
+		if ( sscanf ( buf, "%lf T%u %31s sock %d %63s", &ln.usec, &ln.thread, name, &ln.sock, arg ) != 5 ) continue;
+		ln.name = name;
+		ln.arg = arg;
+		lines.push_back ( ln );
+	}
+	fclose ( fp );
+	return lines;
+}
+
+int count ( std::vector<Line>& lines, const char* name, int sock, const char* arg )
+{
+	int n = 0;
+	for ( Line& ln : lines )
+		if ( ln.name == name && ( sock < -1 || ln.sock == sock ) && ( arg == 0x0 || ln.arg == arg ) ) n++;
+	return n;
+}
+
+void test_roundtrip ()
+{
+	printf ( "roundtrip\n" );
+	netTraceStart ( 1024 );
+	for ( int n = 0; n < 100; n++ ) netTraceWrite ( NT_RECV, n, 1000 + n );
+	netTraceWrite ( NT_RECV_EVENT, 7, 'tMsg' );
+	std::thread t ( [] {
+		for ( int n = 0; n < 50; n++ ) netTraceWrite ( NT_SEND_FLUSH, 2, -n );
+		netTraceWrite ( NT_SEND, 3, 'sOkT' );
+	} );
+	t.join ();
+	netTraceStop ();
+	check ( netTraceDump ( TEST_BIN ), "dump" );
+
+	// binary header: magic, version, rings
+	FILE* fp = fopen ( TEST_BIN, "rb" );
+	uint32_t hdr[4] = { 0, 0, 0, 0 };
+	check ( fp != 0x0 && fread ( hdr, sizeof(hdr), 1, fp ) == 1, "read dump" );
+	if ( fp ) fclose ( fp );
+	check ( hdr[0] == 0x4352544E && hdr[1] == 1 && hdr[2] == 2, "dump header, two rings" );
+
+	check ( netTraceDecode ( TEST_BIN, TEST_TXT ), "decode" );
+	std::vector<Line> lines = read_text ( TEST_TXT );
+	check ( lines.size() == 152, "every record decoded" );
+	bool args = true;
+	for ( int n = 0; n < 100; n++ ) args &= ( count ( lines, "recv", n, std::to_string ( 1000 + n ).c_str() ) == 1 );
+	for ( int n = 0; n < 50; n++ ) args &= ( count ( lines, "send_flush", 2, std::to_string ( -n ).c_str() ) == 1 );
+	check ( args, "sockets and args kept" );
+	check ( count ( lines, "recv_event", 7, "tMsg" ) == 1 && count ( lines, "send", 3, "sOkT" ) == 1, "event names decoded" );
+	bool sorted = true, threads = true;
+	for ( int n = 1; n < (int) lines.size(); n++ ) sorted &= ( lines[ n ].usec >= lines[ n-1 ].usec );
+	for ( Line& ln : lines ) threads &= ( ln.thread == lines[0].thread ) == ( ln.name == "recv" || ln.name == "recv_event" );
+	check ( sorted, "merged in time order" );
+	check ( threads, "records tagged with their thread" );
+}
+
+void test_wrap ()
+{
+	printf ( "wrap\n" );
+	netTraceStart ( 1000 );											// rounded up to 1024
+	for ( int n = 0; n < 1500; n++ ) netTraceWrite ( NT_RECV, 1, n );
+	netTraceStop ();
+	check ( netTraceDump ( TEST_BIN ) && netTraceDecode ( TEST_BIN, TEST_TXT ), "dump and decode" );
+	std::vector<Line> lines = read_text ( TEST_TXT );
+	check ( lines.size() == 1024, "ring size kept" );
+	bool newest = true;
+	for ( int n = 0; n < (int) lines.size(); n++ ) newest &= ( lines[ n ].arg == std::to_string ( 1500 - 1024 + n ) );
+	check ( newest, "newest records, oldest first" );
+}
+
+void test_badfile ()
+{
+	printf ( "badfile\n" );
+	remove ( TEST_BIN );
+	check ( !netTraceDecode ( TEST_BIN, TEST_TXT ), "missing file refused" );
+	FILE* fp = fopen ( TEST_BIN, "wb" );
+	uint32_t hdr[4] = { 0x12345678, 1, 1, 0 };
+	if ( fp ) { fwrite ( hdr, sizeof(hdr), 1, fp ); fclose ( fp ); }
+	check ( !netTraceDecode ( TEST_BIN, TEST_TXT ), "bad magic refused" );
+}
+
+#ifdef NET_TRACE_RING
+
+class Node : public NetworkSystem {
+public:
+	int		mSock = -1;
+	int		mRecv = 0;
+
+	static int Callback ( Event& e, void* this_ptr )
+	{
+		Node* self = (Node*) this_ptr;
+		if ( e.getTarget() != 'app ' || e.getName() != 'tMsg' ) return 0;
+		self->mRecv++;
+		return 1;
+	}
+	void Start ( bool server )
+	{
+		netSetSecurityLevel ( NET_SECURITY_PLAIN_TCP );
+		netInitialize ();
+		netShowVerbose ( false );
+		netShowFlow ( false );
+		netSetUserCallback ( &Callback );
+		if ( server ) {
+			netServerStart ( TEST_PORT );
+		} else {
+			netClientStart ();
+			mSock = netClientConnectToServer ( "127.0.0.1", TEST_PORT, false );
+		}
+	}
+	bool Ready ()		{ return netIsConnectComplete ( mSock ) && getServerSock ( mSock ) >= 0; }
+};
+
+bool pump ( Node& srv, Node& cli, double sec, std::function<bool()> done )
+{
+	uint64_t end = TimeX::GetSystemNSec() + (uint64_t) ( sec * SEC_SCALAR );
+	while ( TimeX::GetSystemNSec() < end ) {
+		srv.netProcessQueue ();
+		cli.netProcessQueue ();
+		if ( done () ) return true;
+	}
+	return false;
+}
+
+void test_points ()
+{
+	printf ( "points\n" );
+	Node srv, cli;
+	srv.Start ( true );
+	cli.Start ( false );
+	check ( pump ( srv, cli, 5, [&] { return cli.Ready(); } ), "client connects" );
+
+	netTraceStart ();
+	for ( int n = 0; n < 3; n++ ) {
+		Event e;
+		new_event ( e, 64, 'app ', 'tMsg', 0, cli.getNetPool() );
+		e.attachInt ( n );
+		cli.netSend ( e, cli.mSock );
+	}
+	check ( pump ( srv, cli, 5, [&] { return srv.mRecv == 3; } ), "server receives" );
+	netTraceStop ();
+	check ( netTraceDump ( TEST_BIN ) && netTraceDecode ( TEST_BIN, TEST_TXT ), "dump and decode" );
+	std::vector<Line> lines = read_text ( TEST_TXT );
+	check ( count ( lines, "send", cli.mSock, "tMsg" ) == 3, "send traced" );
+	check ( count ( lines, "recv", -2, 0x0 ) >= 1, "recv traced" );
+	check ( count ( lines, "recv_event", cli.getServerSock ( cli.mSock ), "tMsg" ) == 3, "recv_event traced" );
+}
+
+#endif
+
+int main ( int argc, char* argv[] )
+{
+	test_roundtrip ();
+	test_wrap ();
+	test_badfile ();
+	#ifdef NET_TRACE_RING
+		test_points ();
+	#else
+		printf ( "points skipped, built without NET_TRACE_RING\n" );
+	#endif
+	remove ( TEST_BIN );
+	remove ( TEST_TXT );
+
+	if ( g_fail == 0 ) printf ( "PASS\n" );
+	else printf ( "FAILED %d checks\n", g_fail );
+	return g_fail;
+}
@@ -19,6 +19,7 @@
 	#define DEF_IMAGE
 
 	#include <string>	
+	#include <vector>
 	#include "common_defs.h"					
 	#include "vec.h"
 	#include "dataptr.h"
@@ -54,6 +55,14 @@
 			MipNoFilter = 2,
 			MipLinear = 3
 		};
+		enum Sampler {			// resampling filters
+			Nearest = 0,
+			Box = 1,
+			Bilinear = 2,
+			Bicubic = 3,
+			Lanczos = 4,
+			Kaiser = 5
+		};
 		enum Usage {
 			Light = 0,
 			Medium = 1,
@@ -137,7 +146,9 @@
 		ImageX ();
 		ImageX ( int xr, int yr, ImageOp::Format fmt, uchar use_flags=DT_CPU );
 		ImageX ( std::string name, int xr, int yr, ImageOp::Format fmt );
-		~ImageX ();
+		ImageX ( const ImageX& ) = delete;				// owns its pixels and mips. use Copy or CopyNew
+		ImageX& operator= ( const ImageX& ) = delete;
+		virtual ~ImageX ();
 		void Clear ();
 
     bool  isEmpty() { return (m_Pix.mCpu==0x0); }
@@ -210,22 +221,42 @@
 		void					 Line (float x0, float y0, float x1, float y1, Vec4F c );
 		void		       BlendPixel  ( int x, int y, Vec4F c, float alpha);
 		void		SetPixel  ( int x, int y, Vec4F c )			{ (this->*m_setPixelFunc) (x,y, c); }
-		void		SetPixelF ( int x, int y, float v )			{ *			(((float*) m_Pix.mCpu) + (y*mXres+x)) = v; }
-		float		GetPixelF ( int x, int y )								{ return *	(((float*) m_Pix.mCpu) + (y*mXres+x)); }
+		void		SetPixelF ( int x, int y, float v )			{ *			(((float*) m_Pix.mCpu) + ((size_t) y*mXres+x)) = v; }
+		float		GetPixelF ( int x, int y )								{ return *	(((float*) m_Pix.mCpu) + ((size_t) y*mXres+x)); }
 
 		// Pixel Ops - 16-bit grayscale only
-		float   GetPixel16 ( int x, int y )							{ return *(((uint16_t*) m_Pix.mCpu) + (y*mXres+x)) / 65535.0f; }
+		float   GetPixel16 ( int x, int y )							{ return *(((uint16_t*) m_Pix.mCpu) + ((size_t) y*mXres+x)) / 65535.0f; }
 		float	  GetPixelUV16 ( float u, float v );
 		float		GetPixelFilteredUV16 (float x, float y);
-		void		SetPixel16 ( int x, int y, uint16_t v )				{ *(((uint16_t*) m_Pix.mCpu) + (y*mXres+x)) = v; }
+		void		SetPixel16 ( int x, int y, uint16_t v )				{ *(((uint16_t*) m_Pix.mCpu) + ((size_t) y*mXres+x)) = v; }
 		
 		// Image Operations
 		void ChangeFormat ( ImageOp::Format fmt );
-		void Resample ( ImageX* src );
+		void Resample ( ImageX* src, ImageOp::Sampler filter = ImageOp::Bilinear, int threads = 0 );		// src scaled to this size
 		void Fill (float v);
 		void Fill (float r, float g, float b, float a);
+		void FillRect ( int x, int y, int w, int h, Vec4F c );		// clipped to the image
+		void FillRegion ( Vec4F c );								// fill the dirty region
+
+		// Blit and composite a rect of src at dx,dy. Clipped to both images.
+		// Blit copies, converting format. Composite puts src over this, straight or premultiplied alpha.
+		void Blit ( ImageX* src, int sx, int sy, int w, int h, int dx, int dy );
+		void Blit ( ImageX* src, int dx, int dy )		{ Blit ( src, 0, 0, src->GetWidth(), src->GetHeight(), dx, dy ); }
+		void Composite ( ImageX* src, int sx, int sy, int w, int h, int dx, int dy, bool premul = false );
+		void Composite ( ImageX* src, int dx, int dy, bool premul = false )	{ Composite ( src, 0, 0, src->GetWidth(), src->GetHeight(), dx, dy, premul ); }
 
-		void Scale ( int nx, int ny );
+		void Scale ( int nx, int ny, ImageOp::Sampler filter = ImageOp::Bilinear, int threads = 0 );
+
+		// Mipmaps
+		// Level 0 is this image, each level after is half size down to 1x1. Levels are kept
+		// until the image is resized, reformatted, filled, blitted or composited onto, or released.
+		// Build again after writing single pixels.
+		void BuildMips ( ImageOp::Sampler filter = ImageOp::Box, bool srgb = true, int threads = 0 );
+		void ClearMips ();
+		int GetNumMips ()						{ return 1 + (int) m_Mips.size(); }
+		ImageX* GetMip ( int lev )				{ return ( lev <= 0 ) ? this : m_Mips[ ( lev < (int) m_Mips.size() ? lev : (int) m_Mips.size() ) - 1 ]; }
+		float GetMipLOD ( float du, float dv );						// lod for a lookup covering du x dv in uv
+		Vec4F GetPixelFilteredUV ( float u, float v, float lod );	// trilinear. builds mips on first use
 
 		// Image Information 
 		int GetWidth ()							{ return mXres; }
@@ -261,7 +292,7 @@
 		inline int GetBytesPerPix ()			{ return mBitsPerPix >> 3; }
 		inline unsigned long GetBytesPerRow ()	{ return mBytesPerRow; }
 		inline unsigned long GetBytesPerRow (int x, ImageOp::Format ef )	{ return GetBitsPerPix(ef)*x >> 3; }
-		inline unsigned long GetSize ()			{ return (unsigned long) mBitsPerPix * (unsigned long) mXres * mYres >> 3; }
+		inline uint64_t GetSize ()				{ return (uint64_t) mBitsPerPix * mXres * mYres >> 3; }
 
 		// Essential Helper Functions		
 		void TransferFrom ( ImageX* new_img);				// Transfer data ownership from another image
@@ -280,6 +311,10 @@
 		Vec4F getDirtyRegion ()							{ return mDirtyRegion; }
 
 	private:
+		Vec4F sampleBilinearUV ( float u, float v );
+		bool encodePixel ( Vec4F c, XBYTE* pix );
+		bool clipRect ( ImageX* src, int& sx, int& sy, int& w, int& h, int& dx, int& dy );
+
 		// Pixel accessors
 		void (ImageX::*m_getPixelFunc) (int x, int y, Vec4F& c);
 		void (ImageX::*m_setPixelFunc) (int x, int y, Vec4F c);			
@@ -315,6 +350,7 @@
 		int							mXres, mYres;			// Image Resolution
 
 		DataPtr					m_Pix;
+		std::vector<ImageX*>	m_Mips;				// levels 1 and up
 
 		uchar						m_UseFlags;
 
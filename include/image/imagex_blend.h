@@ -0,0 +1,39 @@
+//--------------------------------------------------------------------------------
+// Copyright 2007-2022 (c) Quanta Sciences, Rama Hoetzlein, ramakarl.com
+//
+// * Derivative works may append the above copyright notice but should not remove or modify earlier notices.
+//
+// MIT License:
+// Permission is hereby granted, free of charge, to any person obtaining a copy of this software and
+// associated documentation files (the "Software"), to deal in the Software without restriction, including without
+// limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software,
+// and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+// The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+// OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+// BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF
+// OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+//
+
+#ifndef DEF_IMAGEX_BLEND
+	#define DEF_IMAGEX_BLEND
+
+	#include "imagex.h"
+
+	// Row fill and compositing
+	//
+	// fillPixels repeats one encoded pixel of bpp bytes, by memset or doubling copies.
+	// The count may cover a whole image.
+	//
+	// compositeRow puts src over dst, for any pair of formats with row converters, one row at a time.
+	//   straight	rgb = lerp ( dst, src, src.a ), a = src.a + dst.a * ( 1 - src.a )
+	//   premul		all channels = src + dst * ( 1 - src.a )
+	// Sources without alpha are opaque. RGBA8 over RGBA8 runs in SSE2 with exact rounding.
+	// RGBA8 over RGB8, BGR8 or BW8 goes through RGBA8 in small chunks. All other pairs
+	// blend in float.
+
+	HELPAPI void fillPixels ( XBYTE* dst, const XBYTE* pix, int bpp, int64_t cnt );
+	HELPAPI bool compositeRow ( const XBYTE* src, ImageOp::Format sfmt, XBYTE* dst, ImageOp::Format dfmt, int cnt, bool premul );		// false if not supported
+
+#endif
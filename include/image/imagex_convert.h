@@ -0,0 +1,51 @@
+//--------------------------------------------------------------------------------
+// Copyright 2007-2022 (c) Quanta Sciences, Rama Hoetzlein, ramakarl.com
+//
+// * Derivative works may append the above copyright notice but should not remove or modify earlier notices.
+//
+// MIT License:
+// Permission is hereby granted, free of charge, to any person obtaining a copy of this software and
+// associated documentation files (the "Software"), to deal in the Software without restriction, including without
+// limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software,
+// and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+// The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+// OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+// BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF
+// OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+//
+
+#ifndef DEF_IMAGEX_CONVERT
+	#define DEF_IMAGEX_CONVERT
+
+	#include "imagex.h"
+
+	// Row converters
+	// One function per (source, dest) format pair converts a run of pixels. Formats:
+	//   BW8, BW16, BW32, RGB8, RGBA8, RGB16, RGBA32F, BGR8, F32
+	//
+	// Values are normalized (0..1) for 8 and 16-bit channels. F32 and RGBA32F are copied
+	// unclamped, and BW32 holds raw values, as with the pixel accessors.
+	// Gray to color replicates the value, color to gray is luma ( 38r + 75g + 15b ) / 128.
+	// Alpha is 1 when the source has none. Float to integer clamps and rounds.
+	//
+	// Common pairs have SSE kernels (byte shuffles need SSSE3), with AVX2 for float conversions.
+	// The level is picked by cpu once per process. All other pairs convert through a small
+	// float buffer. Results are the same at every level.
+	//
+	// Counts are one row or less, so cnt times the pixel bytes fits in an int. Convert
+	// whole images row by row. When dest pixels are no larger than source pixels, dst may
+	// be src, or start before it in the same buffer.
+
+	#define IMG_SIMD_NONE		0
+	#define IMG_SIMD_SSSE3		1
+	#define IMG_SIMD_AVX2		2
+
+	typedef void (*funcRowConvert) ( const XBYTE* src, XBYTE* dst, int cnt );
+
+	HELPAPI funcRowConvert getRowConvert ( ImageOp::Format src, ImageOp::Format dst, int level = -1 );	// 0x0 if not supported. level -1 = best
+	HELPAPI int getRowConvertLevel ();				// best level for this cpu
+	HELPAPI int getFormatBytes ( ImageOp::Format fmt );			// bytes per pixel, 0 if not supported
+
+#endif
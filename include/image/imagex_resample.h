@@ -0,0 +1,49 @@
+//--------------------------------------------------------------------------------
+// Copyright 2007-2022 (c) Quanta Sciences, Rama Hoetzlein, ramakarl.com
+//
+// * Derivative works may append the above copyright notice but should not remove or modify earlier notices.
+//
+// MIT License:
+// Permission is hereby granted, free of charge, to any person obtaining a copy of this software and
+// associated documentation files (the "Software"), to deal in the Software without restriction, including without
+// limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software,
+// and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+// The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+// OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+// BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF
+// OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+//
+
+#ifndef DEF_IMAGEX_RESAMPLE
+	#define DEF_IMAGEX_RESAMPLE
+
+	#include "imagex.h"
+
+	// Resampling
+	// Scales an image to a new size in the same format. Formats:
+	//   BW8, BW16, BW32, RGB8, RGBA8, RGB16, RGBA32F, BGR8, F32
+	//
+	// Filters are applied as two separable passes, horizontal then vertical, with weight
+	// tables built once per call. When shrinking, the filter is widened by the scale so every
+	// source pixel contributes. Edges clamp. Integer formats clamp and round on output.
+	//   Nearest		pixel at the sample center, no filtering
+	//   Box			area average
+	//   Bilinear		tent, radius 1
+	//   Bicubic		Catmull-Rom, radius 2
+	//   Lanczos		Lanczos-3, radius 3
+	//   Kaiser		Kaiser-windowed sinc, radius 3, alpha 4 (mipmaps)
+	//
+	// With srgb, 8-bit color channels are decoded to linear light before filtering and
+	// encoded after. Alpha stays linear. Other formats are taken as linear already.
+	//
+	// Output rows are split in bands and run on threads (0 = one per core).
+	// Pitches are bytes per row, so sub-rects of larger images may be given.
+	// Level picks the SIMD kernels as with getRowConvert (-1 = best). Results are the same at every level.
+
+	HELPAPI bool resampleImage ( const XBYTE* src, int sw, int sh, int spitch,
+								 XBYTE* dst, int dw, int dh, int dpitch,
+								 ImageOp::Format fmt, ImageOp::Sampler filter, int threads = 0, bool srgb = false, int level = -1 );
+
+#endif
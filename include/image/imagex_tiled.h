@@ -0,0 +1,139 @@
+//--------------------------------------------------------------------------------
+// Copyright 2007-2022 (c) Quanta Sciences, Rama Hoetzlein, ramakarl.com
+//
+// * Derivative works may append the above copyright notice but should not remove or modify earlier notices.
+//
+// MIT License:
+// Permission is hereby granted, free of charge, to any person obtaining a copy of this software and
+// associated documentation files (the "Software"), to deal in the Software without restriction, including without
+// limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software,
+// and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+// The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+// OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+// BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF
+// OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+//
+
+#ifndef DEF_IMAGEX_TILED
+	#define DEF_IMAGEX_TILED
+
+	#include "imagex.h"
+	#include <string>
+	#include <vector>
+	#include <list>
+	#include <unordered_map>
+	#include <mutex>
+
+	// Tiled image, out of core
+	// Pixels live in a tile file and only a bounded set of tiles is resident, so images
+	// far larger than memory (100k x 100k and up) can be read and written by region.
+	// Formats: BW8, BW16, BW32, RGB8, RGBA8, RGB16, RGBA32F, BGR8, F32
+	//
+	// File layout: header, one state byte per tile, then tiles in row-major tile order.
+	// Each tile is tile x tile pixels (edge tiles are padded), at a stride rounded up to
+	// IMG_TILE_ALIGN so tiles can be mapped on their own. The file is sized on create and
+	// left sparse; tiles never written read as zero. Open fails if any tile would be
+	// unaligned or past the end of the file.
+	//
+	// Resident tiles are kept in an LRU cache up to the cache size. Tiles are mapped
+	// (posix) or read into memory (other platforms) on first use. Evicting a tile unmaps it,
+	// or writes it back if it changed. Locked tiles are never evicted, so the cache may go
+	// over its size while many are locked.
+	//
+	// Lazy decode: with a loader set, a tile that has never been filled is decoded by the
+	// loader on first touch and then kept in the file. Loaders run one at a time.
+	//
+	// All calls are thread-safe. Region copies lock one tile at a time.
+
+	#define IMG_TILE_SIZE		256					// default tile width and height
+	#define IMG_TILE_ALIGN		65536				// tile stride and data offset alignment
+	#define IMG_TILE_CACHE		(256*1024*1024)		// default cache size, bytes
+
+	// Decode pixels x,y,w,h of the full image into dst. false leaves the tile zero and retries next time.
+	typedef bool (*funcTileLoad) ( void* user, int x, int y, int w, int h, XBYTE* dst, int pitch );
+
+	class HELPAPI ImageTiled {
+	public:
+		ImageTiled ();
+		~ImageTiled ();
+
+		bool Create ( std::string path, int xres, int yres, ImageOp::Format fmt, int tile = IMG_TILE_SIZE );
+		bool Open ( std::string path, bool write = true );		// read-only keeps changes only while tiles are resident
+		void Close ();								// flush and release all tiles
+		void Flush ();								// write back changed tiles and tile states
+
+		void SetCacheSize ( uint64_t bytes );
+		void SetLoader ( funcTileLoad fn, void* user )	{ m_loadFunc = fn; m_loadUser = user; }
+
+		// Tiles. Data is tile x tile pixels with a pitch of GetTilePitch bytes.
+		XBYTE* LockTile ( int tx, int ty, bool write );		// 0x0 if out of range or not open
+		void UnlockTile ( int tx, int ty );
+
+		// Regions, clipped to the image. Pitch is bytes per row.
+		bool GetRegion ( int x, int y, int w, int h, XBYTE* dst, int pitch );
+		bool SetRegion ( int x, int y, int w, int h, const XBYTE* src, int pitch );
+		bool GetRegion ( int x, int y, int w, int h, ImageX* dst );		// dst resized to w x h in this format
+		bool SetRegion ( int x, int y, ImageX* src );					// src converted to this format
+		Vec4F GetPixel ( int x, int y );
+		void SetPixel ( int x, int y, Vec4F c );
+
+		// Information
+		bool IsOpen ()							{ return m_open; }
+		int GetWidth ()							{ return m_xres; }
+		int GetHeight ()						{ return m_yres; }
+		ImageOp::Format GetFormat ()			{ return m_fmt; }
+		int GetBytesPerPix ()					{ return m_bpp; }
+		int GetTileSize ()						{ return m_tile; }
+		int GetTilePitch ()						{ return m_tile * m_bpp; }
+		int GetTilesX ()						{ return m_ntx; }
+		int GetTilesY ()						{ return m_nty; }
+		uint64_t GetSize ()						{ return (uint64_t) m_xres * m_yres * m_bpp; }
+		int GetNumResident ();
+		uint64_t GetNumHits ()					{ return m_hits; }
+		uint64_t GetNumMisses ()				{ return m_misses; }
+		uint64_t GetNumLoads ()					{ return m_loads; }
+
+	private:
+		struct Tile {
+			XBYTE*		data;
+			int			pins;
+			bool		dirty;
+			std::list<int64_t>::iterator	lru;
+		};
+		bool	openFile ( std::string path, bool write, bool create );
+		bool	writeHeader ();
+		XBYTE*	mapTile ( int64_t t );
+		void	releaseTile ( int64_t t, Tile& e );
+		void	evictTiles ();
+		bool	copyRegion ( int x, int y, int w, int h, XBYTE* buf, int pitch, bool write );
+		int64_t	tileOffset ( int64_t t )		{ return m_dataOffset + t * m_tileStride; }
+
+		bool					m_open;
+		bool					m_write;
+		int						m_xres, m_yres;
+		ImageOp::Format			m_fmt;
+		int						m_bpp;
+		int						m_tile;
+		int						m_ntx, m_nty;
+		int64_t					m_tileStride;		// bytes per tile in the file
+		int64_t					m_dataOffset;
+		std::vector<XBYTE>		m_state;			// per tile, 1 = filled
+		bool					m_stateDirty;
+
+		FILE*					m_fp;
+		int						m_fd;
+
+		std::unordered_map<int64_t, Tile>	m_tiles;		// resident
+		std::list<int64_t>		m_lru;				// front = most recent
+		uint64_t				m_cacheSize;		// bytes
+		int						m_maxTiles;
+		std::mutex				m_mtx;
+
+		funcTileLoad			m_loadFunc;
+		void*					m_loadUser;
+		uint64_t				m_hits, m_misses, m_loads;
+	};
+
+#endif
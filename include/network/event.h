@@ -86,6 +86,8 @@
 		void				expand ( int s );
 		char*				serialize ();
 		void				deserialize ( char* buf, int len );		
+		void				borrow ( char* buf, int len, EventPool* pool );		// view of serialized bytes, no copy
+		bool				isBorrowed ()				{ return mData != 0x0 && !bOwn; }
 		void				rescope ( const char* scope )		{ memcpy ( mScope, scope, 4 ); mScope[4]='\0'; }
 		//int				getEventLenOffs ()			{ return int((char*) &mDataLen - (char*) &mTarget); }
 		char*				getData ()					{ return mData; }
@@ -155,6 +157,8 @@
 		// Serialized header length. Must match platform size of member vars
 		static int		staticSerializedHeaderSize()	{ return 2*sizeof(int) + 2*sizeof(eventStr_t) + sizeof(timeStamp_t); }
 		static int		staticOffsetLenInfo()			{ return 0; }   // <-- assumes mDataLen is first
+		static int		staticOffsetTarget()			{ return sizeof(int) + sizeof(eventStr_t); }
+		static int		staticOffsetCID()					{ return sizeof(int) + 2*sizeof(eventStr_t); }
 
 		// **** NOTE ***
 		// !! ORDER OF MEMBERS IS IMPORTANT HERE !!
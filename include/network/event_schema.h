@@ -0,0 +1,253 @@
+//--------------------------------------------------------------------------------
+// Copyright 2007-2022 (c) Quanta Sciences, Rama Hoetzlein, ramakarl.com
+//
+// * Derivative works may append the above copyright notice but should not remove or modify earlier notices.
+//
+// MIT License:
+// Permission is hereby granted, free of charge, to any person obtaining a copy of this software and
+// associated documentation files (the "Software"), to deal in the Software without restriction, including without
+// limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software,
+// and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+// The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+// OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+// BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF
+// OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+//
+
+#ifndef DEF_EVENT_SCHEMA_H
+	#define DEF_EVENT_SCHEMA_H
+
+	#include "event_system.h"
+	#include <string>
+	#include <vector>
+	#include <tuple>
+	#include <utility>
+	#include <type_traits>
+
+	// Event schema
+	// Describe a struct once, then write or read it as an event payload in one pass.
+	//
+	//   struct PlayerMsg { int id; Vec4F pos; std::string name; std::vector<float> path; };
+	//   EVENT_SCHEMA ( PlayerMsg, &PlayerMsg::id, &PlayerMsg::pos, &PlayerMsg::name, &PlayerMsg::path )
+	//
+	//   Event e;
+	//   new_event_schema ( e, msg, 'app ', 'pMsg', getNetPool() );	// one allocation, exact size
+	//   ...
+	//   e.startRead ();
+	//   PlayerMsg msg;
+	//   if ( !get_schema ( e, msg ) ) { ... }							// false if payload is short
+	//
+	// Fields are written in the order listed, with the same layout as the attach calls:
+	//   plain (int, float, xlong, Vec4F..)					raw bytes, as attachInt/attachFloat
+	//   std::string										int length + chars, as attachStr
+	//   std::vector<T>										int count + elements (one memcpy if T is plain)
+	//   struct with its own EVENT_SCHEMA					nested fields
+	// Schemas of only fixed size fields have a compile-time size, and are read with
+	// a single bounds check.
+
+	template<typename T> struct EventSchema {
+		static const bool defined = false;
+	};
+
+	// Must be used at global scope
+	#define EVENT_SCHEMA(type, ...) \
+		template<> struct EventSchema<type> { \
+			static const bool defined = true; \
+			static auto fields () -> decltype ( std::make_tuple ( __VA_ARGS__ ) ) { return std::make_tuple ( __VA_ARGS__ ); } \
+		};
+
+	// Plain fields are copied as raw bytes. Standard layout with no destructor covers
+	// arithmetic types and small structs like Vec4F, which have user copy constructors.
+	template<typename T> struct event_plain {
+		static const bool value = std::is_standard_layout<T>::value && std::is_trivially_destructible<T>::value && !std::is_pointer<T>::value;
+	};
+
+	template<typename M> struct event_member_type;
+	template<typename C, typename M> struct event_member_type<M C::*> { typedef M type; };
+
+	// Field codecs
+	// p is the write or read position. read returns false if the field would pass end.
+
+	template<typename T, typename Enable = void> struct EventField {
+		static_assert ( event_plain<T>::value, "Event schema field must be a plain type, std::string, std::vector or have an EVENT_SCHEMA" );
+		static const bool fixed = true;
+		static const int bytes = sizeof(T);
+		static int size ( const T& )										{ return sizeof(T); }
+		static void write ( char*& p, const T& v )			{ memcpy ( p, (const void*) &v, sizeof(T) ); p += sizeof(T); }
+		static void read_fixed ( char*& p, T& v )				{ memcpy ( (void*) &v, p, sizeof(T) ); p += sizeof(T); }
+		static bool read ( char*& p, char* end, T& v ) {
+			if ( end - p < (int) sizeof(T) ) return false;
+			read_fixed ( p, v );
+			return true;
+		}
+	};
+
+	template<> struct EventField<std::string> {
+		static const bool fixed = false;
+		static const int bytes = 0;
+		static int size ( const std::string& v )				{ return sizeof(int) + (int) v.length(); }
+		static void write ( char*& p, const std::string& v ) {
+			int len = (int) v.length();
+			memcpy ( p, &len, sizeof(int) );
+			memcpy ( p + sizeof(int), v.data(), len );
+			p += sizeof(int) + len;
+		}
+		static bool read ( char*& p, char* end, std::string& v ) {
+			int len;
+			if ( end - p < (int) sizeof(int) ) return false;
+			memcpy ( &len, p, sizeof(int) );
+			if ( len < 0 || end - p - (int) sizeof(int) < len ) return false;
+			v.assign ( p + sizeof(int), len );
+			p += sizeof(int) + len;
+			return true;
+		}
+	};
+
+	template<typename T> struct EventField< std::vector<T> > {
+		typedef EventField<T> elem;
+		typedef std::integral_constant<bool, event_plain<T>::value && !EventSchema<T>::defined> pod;
+		static const bool fixed = false;
+		static const int bytes = 0;
+		static const int elem_min = ( elem::fixed || elem::bytes >= (int) sizeof(int) ) ? elem::bytes : (int) sizeof(int);		// variable elements hold at least a count
+
+		static int size ( const std::vector<T>& v )								{ return sizeof(int) + size ( v, pod() ); }
+		static int size ( const std::vector<T>& v, std::true_type )		{ return (int) ( v.size() * sizeof(T) ); }
+		static int size ( const std::vector<T>& v, std::false_type ) {
+			int sz = 0;
+			for ( const T& x : v ) sz += elem::size ( x );
+			return sz;
+		}
+		static void write ( char*& p, const std::vector<T>& v ) {
+			int cnt = (int) v.size();
+			memcpy ( p, &cnt, sizeof(int) );
+			p += sizeof(int);
+			write ( p, v, pod() );
+		}
+		static void write ( char*& p, const std::vector<T>& v, std::true_type ) {
+			if ( !v.empty() ) memcpy ( p, (const void*) v.data(), v.size() * sizeof(T) );
+			p += v.size() * sizeof(T);
+		}
+		static void write ( char*& p, const std::vector<T>& v, std::false_type ) {
+			for ( const T& x : v ) elem::write ( p, x );
+		}
+		static bool read ( char*& p, char* end, std::vector<T>& v ) {
+			int cnt;
+			if ( end - p < (int) sizeof(int) ) return false;
+			memcpy ( &cnt, p, sizeof(int) );
+			if ( cnt < 0 || (int64_t) ( end - p ) - (int64_t) sizeof(int) < (int64_t) cnt * elem_min ) return false;		// before resize
+			p += sizeof(int);
+			v.resize ( cnt );
+			return read ( p, end, v, pod() );
+		}
+		static bool read ( char*& p, char* end, std::vector<T>& v, std::true_type ) {
+			if ( !v.empty() ) memcpy ( (void*) v.data(), p, v.size() * sizeof(T) );
+			p += v.size() * sizeof(T);
+			return true;
+		}
+		static bool read ( char*& p, char* end, std::vector<T>& v, std::false_type ) {
+			for ( T& x : v )
+				if ( !elem::read ( p, end, x ) ) return false;
+			return true;
+		}
+	};
+
+	// Schema field lists
+	template<typename T> struct EventSchemaInfo {
+		typedef decltype ( EventSchema<T>::fields() ) tuple_t;
+		static const size_t count = std::tuple_size<tuple_t>::value;
+		template<size_t I> using field_t = typename event_member_type< typename std::tuple_element<I, tuple_t>::type >::type;
+	};
+
+	// Sum of fixed field sizes, or not fixed
+	template<typename T, size_t I = 0, bool Last = ( I == EventSchemaInfo<T>::count )> struct EventSchemaFixed {
+		typedef EventField< typename EventSchemaInfo<T>::template field_t<I> > field;
+		typedef EventSchemaFixed<T, I+1> next;
+		static const bool fixed = field::fixed && next::fixed;
+		static const int bytes = field::bytes + next::bytes;
+	};
+	template<typename T, size_t I> struct EventSchemaFixed<T, I, true> {
+		static const bool fixed = true;
+		static const int bytes = 0;
+	};
+
+	template<typename T, typename F, size_t... I> inline void event_schema_each ( T& v, F&& f, std::index_sequence<I...> ) {
+		auto flds = EventSchema< typename std::remove_const<T>::type >::fields();
+		int order[] = { 0, ( f ( v.*std::get<I>(flds) ), 0 )... };			// in field order
+		(void) order;
+	}
+	template<typename T, typename F, size_t... I> inline bool event_schema_all ( T& v, F&& f, std::index_sequence<I...> ) {
+		auto flds = EventSchema<T>::fields();
+		bool ok = true;
+		int order[] = { 0, ( ok = ok && f ( v.*std::get<I>(flds) ), 0 )... };		// stops at first failure
+		(void) order;
+		return ok;
+	}
+
+	template<typename T> struct EventField< T, typename std::enable_if< EventSchema<T>::defined >::type > {
+		typedef EventSchemaFixed<T> layout;
+		typedef std::make_index_sequence< EventSchemaInfo<T>::count > seq;
+		static const bool fixed = layout::fixed;
+		static const int bytes = layout::bytes;
+
+		static int size ( const T& v ) {
+			if ( fixed ) return bytes;
+			int sz = 0;
+			event_schema_each ( v, [&sz] ( const auto& x ) { sz += EventField< typename std::decay<decltype(x)>::type >::size ( x ); }, seq() );
+			return sz;
+		}
+		static void write ( char*& p, const T& v ) {
+			event_schema_each ( v, [&p] ( const auto& x ) { EventField< typename std::decay<decltype(x)>::type >::write ( p, x ); }, seq() );
+		}
+		static bool read ( char*& p, char* end, T& v ) {
+			if ( end - p < bytes ) return false;			// fixed part, checked once
+			return read ( p, end, v, std::integral_constant<bool, fixed>() );
+		}
+		static bool read ( char*& p, char* end, T& v, std::true_type ) {
+			read_fixed ( p, v );
+			return true;
+		}
+		static bool read ( char*& p, char* end, T& v, std::false_type ) {
+			return event_schema_all ( v, [&p, end] ( auto& x ) { return EventField< typename std::decay<decltype(x)>::type >::read ( p, end, x ); }, seq() );
+		}
+		static void read_fixed ( char*& p, T& v ) {
+			event_schema_each ( v, [&p] ( auto& x ) { EventField< typename std::decay<decltype(x)>::type >::read_fixed ( p, x ); }, seq() );
+		}
+	};
+
+	// Payload bytes of a schema struct
+	template<typename T> inline int schema_size ( const T& v )
+	{
+		return EventField<T>::size ( v );
+	}
+
+	// Append a schema struct at the event write position. Expands at most once.
+	template<typename T> inline void attach_schema ( Event& e, const T& v )
+	{
+		int len = EventField<T>::size ( v );
+		if ( e.mDataLen + len > e.mMax ) e.expand ( e.mDataLen + len );
+		char* p = e.mPos;
+		EventField<T>::write ( p, v );
+		e.mPos += len;
+		e.mDataLen += len;
+	}
+
+	// Read a schema struct at the event read position.
+	// Returns false if the payload ends before the struct, and the read position is not moved.
+	template<typename T> inline bool get_schema ( Event& e, T& v )
+	{
+		char* p = e.mPos;
+		if ( !EventField<T>::read ( p, e.mData + e.mDataLen, v ) ) return false;
+		e.mPos = p;
+		return true;
+	}
+
+	// New event holding a schema struct, allocated at its exact size
+	template<typename T> inline void new_event_schema ( Event& e, const T& v, eventStr_t targ, eventStr_t name, EventPool* pool, const char* msg = 0 )
+	{
+		new_event ( e, schema_size ( v ), targ, name, 0, pool, msg );
+		attach_schema ( e, v );
+	}
+
+#endif
@@ -27,6 +27,10 @@
 	#include <map>
 	#include <set>
 	#include <queue>
+	#include <atomic>
+	#include <thread>
+	#include <mutex>
+	#include <vector>
 
 	#include "event.h"
 
@@ -57,23 +61,42 @@
 	#endif
 	
 	// Event queue - maintains a queue of events
+	// Lock-free multi-producer, single-consumer ring of event slots (Vyukov bounded queue).
+	// Events are acquired into a slot on push and out of it on pop, so queuing an event
+	// moves its payload without allocating. Any thread may push. Only the consumer pops.
+	// When the ring is full, the consumer thread spills to an overflow list (keeping its
+	// own order), and other threads wait for the consumer to make room. The consumer must
+	// call setConsumer before it pushes, or it waits on itself once the ring is full.
+	#define EVENT_QUEUE_SLOTS		4096
+
 	class HELPAPI EventQueue {
 	public:
-		EventQueue ();
+		EventQueue ( int slots = EVENT_QUEUE_SLOTS );
+		~EventQueue ();
 		
 		void Clear ();
-		void Push ( Event* e );
-		void Push_back ( Event* e );		
-		void PopFront ( Event*& dest );		
-		int getSize ()				 { return (int) mList.size(); }
+		bool Push ( Event& e, uint64_t time = 0 );				// any thread. event is acquired (detached from caller)
+		bool PopFront ( Event& dest, uint64_t* time = 0 );		// consumer thread. false if empty. time given to Push
+		int getSize ();								// approximate when producers are active
+		int getCapacity ()			{ return (int) mMask + 1; }
+		void setConsumer ()			{ mConsumer.store ( std::this_thread::get_id(), std::memory_order_relaxed ); }
 
 		//-- debugging
 		void startTrace ( char* fn );
 		void trace (); 
-		EventQueue& operator= ( EventQueue &op );
 
 	private:
-		std::queue < Event* >		mList;		
+		struct CACHE_ALIGNED Slot {
+			std::atomic<size_t>	seq;
+			Event			e;
+			uint64_t	time;
+		};
+		Slot*						mSlots;
+		size_t					mMask;
+		CACHE_ALIGNED std::atomic<size_t>	mTail;		// producers
+		CACHE_ALIGNED std::atomic<size_t>	mHead;		// consumer
+		std::atomic<std::thread::id> mConsumer;
+		std::queue < std::pair<Event*, uint64_t> >	mOverflow;			// consumer thread only
 		FILE*						mTraceFile;
 	};
 
@@ -83,110 +106,122 @@
 	// 	
 	// Event Pooling was designed for very fast event memory allocations.
 	// Whether it is actually faster than malloc/free must be evaluated per platform.
-	// The technique uses ten bins of power-of-two fixed width memory pools.
-	// Each set contains a linked list of pools. Within a single pool, events
-	// are assigned sequentially. When an event is deleted/expanded, it is removed
-	// from a pool and assigned to a different one. When all event slots in pools have
-	// been used, a new pool inserted in the linked list. When a pool is depleted
-	// then it is removed from the linked list. (Rama Hoetzlein)
+	// Items are grouped into power-of-two size classes (bins). Each bin carves items from 
+	// slabs, and keeps a central free list guarded by a per-bin lock. Each thread holds a 
+	// small magazine of free items per bin (tcmalloc-style), so most allocs and frees touch 
+	// no lock at all. An empty magazine refills a batch from the central bin, and a full 
+	// one returns half of its items. (Rama Hoetzlein)
 	// 
 	// Limitations:
-	// - 10 bins. (limited by log table lookup)
-	// - 64 min item size. (must be power of two)
-	// - 32768 max item size. (largest bin, limited by log table lookup, and efficient use of 65544 block size.)
-	// - 65544 block size. (ideal size to give 4x 16386 blocks, 2x 32770 blocks)
-	// - 64 byte header. (size of MBlock struct below, plus little extra)
+	// - 17 bins, 64 bytes to 4 MB. Larger requests use malloc (with a pool header).
+	// - Slabs of large bins (64 KB items or more) are 2 MB huge-page backed on linux.
+	// - Slabs are kept until the pool is cleared. See getStats for fragmentation.
+	// - 16 byte item header (slab offset, bin, requested size), preceding the item.
 
-	#define BIN_CNT			10			// Bins: 0..BIN_CNT-1
+	#define BIN_CNT			17			// Bins: 0..BIN_CNT-1
 
-	#define	MIN_WIDTH		64			// Smallest bin size. Minimum block width.
-	#define MIN_WIDTH_BITS	6			// (Why: Pool header is 64)
+	#define	MIN_WIDTH		64			// Smallest bin size. Minimum item width.
+	#define MIN_WIDTH_BITS	6
 	
-	#define MAX_BINS		8			// Largest bin number. (0..MAX_BINS). Limited by lookup table.
-	#define MAX_POOL_SIZE	16384		// 2^(MAX_BINS+6) = 2^(8+6) = 16384
+	#define MAX_POOL_SIZE	(MIN_WIDTH << (BIN_CNT-1))		// 4 MB, largest bin
 
-	#define BLOCK_SIZE		65536		// Total block size
+	#define BLOCK_SIZE		65536		// Slab size, small bins
+	#define HUGE_SLAB_SIZE	2097152		// Slab size unit, large bins (2 MB huge page)
+	#define MAG_SLOTS			64			// Magazine capacity, small bins
 
 	// Definitions:
-	// Pool -	Multiple blocks organized by bin
-	// Bin -	Linked list of blocks of a particular width
-	// Block -	List of items of a specific width
+	// Pool -	Set of bins
+	// Bin -	Central free list and slabs for one item width
+	// Slab -	Block of items of one width
+	// Magazine - Per-thread cache of free items of one bin
 	// Item	-	Unit of allocation. 
 	
-	// Memory Pool structure
-	//  - First item in a block is the MBlock Header
-	//	- Each item in a block has a freeword at the end of it (uint32_t)
-	// Block Size	Bin		Item Width 	Item Count	- Item Width = Data width + freeword (4 bytes)
-	//	65536		0		64			1024
-	//	65536		1		128			512
-	//	65536		2		256			256
-	//	65536		3		512			128
-	//	65536		4		1024		64
-	//	65536		5		2048		32
-	//	65536		6		4096		16	
-	//	65536		7		8192		8
-	//  65536		8		16384		4	
-	//  65536		9		32768		2
-	
 	typedef char*	itemPtr;	
 	
-	__declspec(align(64)) struct MBlock {
+	// Slab header
+	struct CACHE_ALIGNED MBlock {
 		uint32_t	mMagic;
-		itemPtr		mPos;		// Position of next alloc item		4 bytes
-		itemPtr		mEnd;		// End of block position			4 bytes
-		int			mBin;		// Bin number						4 bytes
-		int			mUsed;		// Number of used items in block	4 bytes
-		int			mWidth;		// Width of bin						4 bytes
-		int			mCount;		// Maximum items supported			4 bytes
-		MBlock*		mPrev;		// Previous block (linked list)		8 bytes
-		MBlock*		mNext;		// Next block (linked list)			8 bytes
-		bool		mbFull;		// Is block in a full list?			1 byte
-		char		mData;		// Start of data					1 byte
+		int			mBin;		// Bin number
+		int			mWidth;		// Item width
+		int			mCount;		// Items in slab
+		size_t		mSize;		// Slab size in bytes
+		bool		mHuge;		// Allocated by mmap
+		MBlock*		mNext;		// Next slab in bin
 	};
 	typedef MBlock*		blockPtr;
 
+	// Item header
+	struct MItem {
+		uint32_t	mOffset;		// offset back to slab header (0 = large, malloc)
+		uint16_t	mBin;
+		uint16_t	mMagic;			// in use or free
+		uint32_t	mSize;			// requested size
+		uint32_t	mPad;
+	};
+
+	struct HELPAPI EventPoolStats {
+		uint64_t	allocs;				// total allocations
+		uint64_t	frees;
+		uint64_t	hits;					// served from thread magazine
+		uint64_t	refills;			// magazine refills from central bin
+		uint64_t	large;				// above MAX_POOL_SIZE (malloc)
+		uint64_t	slabs;				// slabs held
+		uint64_t	reserved;			// bytes in slabs
+		uint64_t	used;					// bytes in live items (item width)
+		uint64_t	requested;		// bytes requested by live items
+		float			hit_rate;			// hits / allocs
+		float			fragmentation;	// 1 - requested / reserved
+	};
+
 	class HELPAPI EventPool {
 	public:
 		EventPool();
 		~EventPool();
-		void clear ();
+		void clear ();							// frees all slabs. no item may be in use, other threads may still hold magazines
 
-		// User functions
+		// User functions (thread-safe)
 		void* allocItem ( int size );
 		void freeItem ( void* item );
-
-		blockPtr addBlock ( int bin );
-		blockPtr makeFull ( blockPtr block );
-		blockPtr makeFree ( blockPtr block );
-		void setBlockHeader ( blockPtr block, int wid, int count, int bin );
+		void flushThread ();					// return calling thread's magazines to central bins
 
 		unsigned int getNumBins ()		{ return BIN_CNT; }
-		int getHeaderSize ()			{ return sizeof(MBlock); }
+		int getHeaderSize ()			{ return sizeof(MItem); }
 		int getBinWidth ( int bin )		{ return ( 1 << (bin + MIN_WIDTH_BITS) ); }
-
-		int getBlockSize ( int bin )	{ return BLOCK_SIZE; }					// total block size (not including header)
-		int getBlockWidth ( int bin )	{ return getBinWidth( bin ) ; }			// size of block.. power of 2
-		int getItemCount ( int bin )	{ return (BLOCK_SIZE / getBlockWidth ( bin )) - 1; } // number of items in block
-		int getItemWidth ( int bin )	{ return getBinWidth ( bin ) - sizeof(int); }		 // max size of item in block
-		int getItemMaxSize ( int sz )	{ return getItemWidth( getBin(sz) ); }		// maximum payload size (given intial size)
+		int getBlockSize ( int bin );													// slab size
+		int getItemCount ( int bin )	{ return ( getBlockSize(bin) - (int) sizeof(MBlock) ) / getBinWidth(bin); }	// items per slab
+		int getItemWidth ( int bin )	{ return getBinWidth ( bin ) - sizeof(MItem); }		// max size of item in bin
+		int getItemMaxSize ( int sz )	{ return (sz + (int) sizeof(MItem) > MAX_POOL_SIZE) ? sz : getItemWidth( getBin(sz + sizeof(MItem)) ); }		// maximum payload size (given intial size)
+		int getMagazineSize ( int bin )	{ return (bin < 8) ? MAG_SLOTS : (bin < 12) ? 16 : 4; }
 		
 		int getAllocated ( int bin );
+		EventPoolStats getStats ();
 
-		void print ()			{ integrity (); }		
+		void print ();
 		void integrity ();
 		int checkBlock ( blockPtr block );
 
-		blockPtr getFullBin (int n )	{ return mFullBins[n]; }
-		blockPtr getEmptyBin ( int n )	{ return mEmptyBins[n]; }
 		unsigned char getBin ( unsigned int v );
-		unsigned int getBinWidth ( unsigned char b );
+		uint32_t getID ()					{ return mID.load ( std::memory_order_acquire ); }
+
+		// central bins (used by magazines)
+		int refill ( int bin, itemPtr* dest, int cnt );
+		void release ( int bin, itemPtr* src, int cnt );
 						
 	private:
-		MBlock*		mFullBins[BIN_CNT];
-		MBlock*		mEmptyBins[BIN_CNT];
-		
-		static const char logtable512[];	
-		
+		blockPtr addBlock ( int bin );
+
+		struct CACHE_ALIGNED Bin {
+			std::mutex				mtx;
+			std::vector<itemPtr>	free;		// central free list
+			blockPtr				slabs;		// all slabs of this bin
+			itemPtr					pos;		// next uncarved item in newest slab
+			itemPtr					end;
+			std::atomic<int>		live;		// items in use
+		};
+		Bin			mBins[BIN_CNT];
+		std::atomic<uint32_t>	mID;		// unique pool id (thread caches), changed by clear
+
+		std::atomic<uint64_t>	mAllocs, mFrees, mHits, mRefills, mLarge, mSlabs, mReserved, mUsed, mRequested;
 	};
   #else
 		// Not building EventPool. Define empty class.
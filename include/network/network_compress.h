@@ -0,0 +1,38 @@
+//--------------------------------------------------------------------------------
+// Copyright 2007-2022 (c) Quanta Sciences, Rama Hoetzlein, ramakarl.com
+//
+// * Derivative works may append the above copyright notice but should not remove or modify earlier notices.
+//
+// MIT License:
+// Permission is hereby granted, free of charge, to any person obtaining a copy of this software and
+// associated documentation files (the "Software"), to deal in the Software without restriction, including without
+// limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software,
+// and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+// The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+// OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+// BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF
+// OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+//
+
+
+#ifndef DEF_NETWORK_COMPRESS_H
+	#define DEF_NETWORK_COMPRESS_H
+
+	#include "common_defs.h"
+
+	// Event payload compression
+	// Self-contained LZ4 block codec (format compatible with LZ4 blocks, no frame).
+	// Greedy single-probe matcher, tuned for speed over ratio.
+	// Compressed events are sent with the reserved target NET_EVENT_LZ4, and the payload
+	// holds the original length and target before the compressed bytes.
+
+	#define NET_EVENT_LZ4			'nLZ4'			// reserved target of a compressed event, not sent by apps
+	#define NET_COMPRESS_MAX	(256*1024*1024)	// largest original payload accepted on receive
+
+	HELPAPI int netCompressBound ( int len );			// worst case compressed size
+	HELPAPI int netCompress ( const char* src, int len, char* dst, int dst_max );		// bytes written, 0 = does not fit
+	HELPAPI int netDecompress ( const char* src, int len, char* dst, int dst_len );	// bytes written, -1 = corrupt
+
+#endif
@@ -0,0 +1,137 @@
+//--------------------------------------------------------------------------------
+// Copyright 2007-2022 (c) Quanta Sciences, Rama Hoetzlein, ramakarl.com
+//
+// * Derivative works may append the above copyright notice but should not remove or modify earlier notices.
+//
+// MIT License:
+// Permission is hereby granted, free of charge, to any person obtaining a copy of this software and
+// associated documentation files (the "Software"), to deal in the Software without restriction, including without
+// limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software,
+// and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+// The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+// OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+// BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF
+// OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+//
+
+
+#ifndef DEF_NETWORK_FILE_H
+	#define DEF_NETWORK_FILE_H
+
+	#include "network_system.h"
+	#include <string>
+	#include <map>
+	#include <mutex>
+
+	// File transfer over events
+	// Files are split into fixed size chunks, each sent as one 'file' event with its
+	// offset and CRC32. A window of unacknowledged chunks bounds memory on both sides,
+	// so files of any size stream with one chunk in memory per event.
+	//
+	// Sender reads by mmap (posix) or by file reads (other platforms). Receiver writes
+	// to <name>.part and renames on completion. An offer for a file with an existing
+	// .part resumes from it, if the .part came from the same file: size and modified
+	// time of the offer are kept in <name>.part.id. Otherwise the .part starts over.
+	// A chunk with a bad checksum is re-requested, and the sender goes back to it.
+	//
+	// Offers are refused until netFileSetAccept(true). Offered names must be plain file
+	// names, without path separators or "..", and are written to the receive directory
+	// (the working directory if not set), replacing a file of the same name.
+	//
+	// Usage: forward events to netFileEvent from the user callback (returns 1 if handled),
+	// and call netFileRun each loop after netProcessQueue. With server workers, netFileEvent
+	// runs on the worker or dispatch thread of the socket while netFileRun runs on the main
+	// thread; transfers are guarded by a lock, and file info is returned as a copy.
+	//
+	// Protocol (target 'file'):
+	//   fOfr  id, size, chunk, name, mtime		sender -> receiver
+	//   fAcc  id, resume offset (-1 = reject)	receiver -> sender
+	//   fChk  id, offset, crc, len, bytes		sender -> receiver
+	//   fAck  id, contiguous bytes received		receiver -> sender
+	//   fNak  id, offset to resend					receiver -> sender
+	//   fCan  id, sent by sender					either side
+
+	#define NET_FILE_CHUNK		(256*1024)		// default chunk size
+	#define NET_FILE_WINDOW		16						// default chunks in flight
+
+	enum NetFileState {
+		NET_FILE_OFFER = 0,		// waiting for accept
+		NET_FILE_ACTIVE,
+		NET_FILE_DONE,
+		NET_FILE_FAILED,
+		NET_FILE_CANCELED
+	};
+
+	struct HELPAPI NetFileInfo {
+		int				id;
+		int				sock;
+		bool			sending;
+		int				state;				// NetFileState
+		std::string	name;					// name sent to receiver
+		std::string	path;					// local path
+		int64_t			size;
+		int64_t			done;					// bytes acked (sender) or written (receiver)
+		int64_t			resumed;			// offset transfer started from
+		int				chunk;
+		int				retries;			// chunks resent after a bad checksum
+		double		start;				// sec
+		double		elapsed;			// sec, active time
+		float			mb_per_sec;		// throughput of this session (excludes resumed bytes)
+	};
+
+	class HELPAPI NetFileTransfer {
+	public:
+		NetFileTransfer ( NetworkSystem* net );
+		~NetFileTransfer ();
+
+		void	netFileSetChunk ( int bytes )			{ m_chunk = bytes; }
+		void	netFileSetWindow ( int chunks )		{ m_window = chunks; }
+		void	netFileSetRecvDir ( std::string dir )	{ std::lock_guard<std::mutex> lock ( m_mtx ); m_recvDir = dir; }
+		void	netFileSetAccept ( bool v )				{ std::lock_guard<std::mutex> lock ( m_mtx ); m_accept = v; }		// accept offers from peers, off by default
+
+		int		netFileSend ( std::string path, int sock_i, std::string name = "" );	// returns id, -1 = cannot open
+		void	netFileCancel ( int id, int sock_i, bool sending = true );
+		int		netFileEvent ( Event& e );		// 1 if handled
+		void	netFileRun ();							// send chunks, update rates
+
+		bool	getFileInfo ( int id, int sock_i, NetFileInfo& info, bool sending = true );	// copy, false if not found
+		int		getNumFiles ();
+		bool	getFileInfoByIndex ( int n, NetFileInfo& info );
+		void	netFileRemove ( int id, int sock_i, bool sending = true );		// forget finished transfer
+
+	private:
+		struct NetFileXfer {
+			NetFileInfo	info;
+			int64_t				next;					// next offset to send (sender) / expected (receiver)
+			FILE*				fp;
+			char*				map;					// mapped file (sender, posix)
+			int					fd;
+			bool				nak;					// resend requested (receiver)
+		};
+		typedef std::pair<int, int64_t> key_t;		// socket, id | sending flag
+
+		key_t	netFileKey ( int id, int sock_i, bool sending )	{ return key_t ( sock_i, ( (int64_t) id << 1 ) | (sending ? 1 : 0) ); }
+		NetFileXfer* netFileFind ( int id, int sock_i, bool sending );
+		void	netFileErase ( int id, int sock_i, bool sending );
+		void	netFileClose ( NetFileXfer& x, int state );
+		void	netFileStop ( NetFileXfer& x );
+		void	netFileSendChunk ( NetFileXfer& x );
+		void	netFileRecvOffer ( Event& e );
+		void	netFileRecvChunk ( Event& e );
+		void	netFileReply ( eventStr_t name, int id, int64_t offset, int sock_i );
+
+		NetworkSystem*	m_net;
+		std::mutex		m_mtx;					// guards m_files, events and netFileRun may be on different threads
+		std::map<key_t, NetFileXfer>	m_files;
+		int						m_nextId;
+		int						m_chunk;
+		int						m_window;
+		bool					m_accept;
+		std::string		m_recvDir;
+	};
+
+	HELPAPI uint32_t netCRC32 ( const char* buf, int len, uint32_t crc = 0 );
+
+#endif
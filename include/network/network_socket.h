@@ -9,6 +9,9 @@
 	#define DEF_NET_SOCK
 
 	#include <vector>	
+	#include <deque>
+	#include <map>
+	#include <atomic>
 
   #ifdef _WIN32
     #include <winsock2.h>			// Winsock Ver 2.0
@@ -22,6 +25,7 @@
 
 	#elif __ANDROID__
 		#include <sys/socket.h>			// Non-windows Platforms (Linux, Cygwin)
+		#include <sys/uio.h>				// iovec for vectored send
 		#include <netinet/in.h>
 		#include <arpa/inet.h>
 		#include <sys/time.h>
@@ -31,6 +35,7 @@
 		#include <fcntl.h>
 		#include <errno.h>
 		#include <sys/ioctl.h>
+		#include <sys/epoll.h>			// epoll readiness backend
 		#define CX_SOCKET		int
 		#define CX_SOCKLEN		socklen_t		
 		#define CX_SOCKOPT		int		
@@ -39,6 +44,7 @@
 
   #elif __linux__
     #include <sys/socket.h>			// Non-windows Platforms (Linux, Cygwin)
+		#include <sys/uio.h>				// iovec for vectored send
 		#include <netinet/in.h>
 		#include <arpa/inet.h>
 		#include <sys/time.h>
@@ -48,6 +54,7 @@
 		#include <fcntl.h>
 		#include <errno.h>
 		#include <sys/ioctl.h>
+		#include <sys/epoll.h>			// epoll readiness backend
 		#define CX_SOCKET		int
 		#define CX_SOCKLEN		socklen_t		
 		#define CX_SOCKOPT		int		
@@ -89,14 +96,25 @@
 	#define STATE_CONNECTED			3
 	#define STATE_FAILED				4
 	#define STATE_TERMINATED		5
+
+	#define NET_POLL_SELECT			0 // readiness backends
+	#define NET_POLL_EPOLL			1	// linux only, edge-triggered
+
+	#define NET_TX_IOV					64	// max segments per vectored send
+
+	#define NET_TIMER_HANDSHAKE	0 // socket timers (see NetTimerWheel)
+	#define NET_TIMER_IDLE			1
+	#define NET_TIMER_HEARTBEAT	2
+	#define NET_TIMER_RECONNECT	3
+	#define NET_TIMER_KINDS			4
 	
 
 	// Network Address Abstraction
 	struct HELPAPI NetAddr {
 	public:
-		NetAddr ()					{ type = STATE_NONE; name = ""; setAddress(AF_INET, 0, 0); }
-		NetAddr (char typ)	{ type = typ; name = ""; setAddress(AF_INET,0,0); }
-    NetAddr ( int t, std::string n, netIP i, int p ) { name = n; type = t; setAddress(AF_INET, i, p);}
+		NetAddr ()					{ type = STATE_NONE; name = ""; sock = -1; setAddress(AF_INET, 0, 0); }
+		NetAddr (char typ)	{ type = typ; name = ""; sock = -1; setAddress(AF_INET,0,0); }
+    NetAddr ( int t, std::string n, netIP i, int p ) { name = n; type = t; sock = -1; setAddress(AF_INET, i, p);}
 
 		void setAddress ( int inet, unsigned long i, unsigned short p ) 
 		{
@@ -122,17 +140,141 @@
 
 		std::string	name;
 		char				type;			// type (any, broadcast, search, connect)
-		int					sock;
+		int					sock;			// socket at the far end, -1 if unknown
 		int					port;
 		netIP				ip;
 		sockaddr_in	addr;
 	};
 
 	// Network Socket Abstraction
+	// Outbound segment
+	// Either bytes copied into txBuf (event=0), or a large event held by reference until sent.
+	struct HELPAPI NetTxSeg {
+		Event*			event;			// held event, or 0 for txBuf bytes
+		int					len;				// segment length
+		int					sent;				// bytes already sent
+	};
+
+	// Outbound datagram, queued for a batched UDP send
+	struct HELPAPI NetUdpMsg {
+		int					sock_i;			// socket holding the destination
+		int					off;				// offset in the UDP tx buffer
+		int					len;
+	};
+
+	// Reliable UDP channels
+	// Each datagram carries a trailer after the serialized event. Packet sequence numbers
+	// and selective acks (ack + 32 prior bits) are per socket, message sequence numbers per channel.
+	#define NET_REL_CHANNELS		8				// channels per socket
+	#define NET_REL_WINDOW			1024		// unacked or held messages per channel
+	#define NET_REL_SENT				1024		// sent packets tracked for acks
+	#define NET_REL_MAGIC				0x50445572	// 'rUDP'
+	#define NET_REL_ACKONLY			1				// trailer flags
+	#define NET_REL_HASACK			2				// ack fields valid (peer packet received)
+
+	struct HELPAPI NetRelHdr {
+		uint16_t		seq;				// packet sequence
+		uint16_t		ack;				// latest packet received from peer
+		uint32_t		ack_bits;		// bit n: packet ack-1-n received
+		uint16_t		msg_seq;		// message sequence on channel
+		uint8_t			channel;
+		uint8_t			flags;
+		uint32_t		magic;
+	};
+
+	// Sent reliable message, held until acked
+	struct HELPAPI NetRelMsg {
+		std::vector<char>	data;		// serialized event
+		uint64_t		sent;				// time of last send (nsec)
+		int					sends;
+	};
+
+	struct HELPAPI NetRel {
+		NetRel();
+		uint16_t		localSeq;							// next packet sequence
+		uint16_t		remoteSeq;						// latest packet from peer
+		uint32_t		remoteBits;						// acks to send
+		bool				remoteValid;
+		bool				ackPending;						// ack owed to peer
+		uint16_t		sendSeq[ NET_REL_CHANNELS ];		// next message sequence
+		uint16_t		recvSeq[ NET_REL_CHANNELS ];		// next expected (ordered) or latest (sequenced)
+		bool				recvValid[ NET_REL_CHANNELS ];
+		std::vector<uint32_t> recvMark;				// received messages, unordered channels
+		std::map< uint32_t, NetRelMsg > pending;	// key: channel << 16 | msg_seq
+		std::map< uint16_t, std::vector<char> > hold[ NET_REL_CHANNELS ];	// out of order messages
+		uint16_t		sentSeq[ NET_REL_SENT ];		// packet sent in slot
+		uint32_t		sentKey[ NET_REL_SENT ];		// message in packet, or NONE
+		uint64_t		sentTime[ NET_REL_SENT ];
+		float				srtt;									// smoothed round trip (ms)
+		uint64_t		numSent, numResent, numAcked, numDelivered;
+	};
+
+	// Network emulation (testing)
+	// Applied beneath recv. Received bytes are held and released later, as if they crossed
+	// a link with the given delay and rate. Loss and reorder apply to UDP only, since TCP is
+	// a byte stream. The send rate caps bytes handed to the kernel (TCP).
+	struct HELPAPI NetEmuConfig {
+		NetEmuConfig() : latency_ms(0), jitter_ms(0), loss(0), reorder(0), recv_bps(0), send_bps(0), queue_bytes(4*1024*1024), seed(1) {}
+		float				latency_ms;			// one-way delay
+		float				jitter_ms;			// +/- uniform delay
+		float				loss;						// datagram drop probability
+		float				reorder;				// probability a datagram skips the delay, arriving early
+		double			recv_bps;				// inbound rate, bytes/sec (0 = unlimited)
+		double			send_bps;				// outbound rate
+		int					queue_bytes;		// held bytes before TCP reads stop, or datagrams drop
+		uint32_t		seed;
+	};
+	struct HELPAPI NetEmuChunk {
+		std::vector<char>	data;
+		NetAddr			src;						// datagram source
+	};
+	struct HELPAPI NetEmu {
+		NetEmu ( NetEmuConfig& c ) : cfg(c), queued(0), throttled(false), lastRelease(0), linkFree(0), sendTime(0), sendTokens(0), 
+			numHeld(0), numDropped(0), numReordered(0), bytesHeld(0)	{ rng = (c.seed==0) ? 1 : c.seed; }
+		NetEmuConfig	cfg;
+		std::multimap< uint64_t, NetEmuChunk > queue;		// by release time (nsec)
+		int					queued;					// bytes held
+		bool				throttled;			// reads stopped at queue_bytes
+		uint64_t		lastRelease;		// in-order release
+		uint64_t		linkFree;				// inbound link busy until
+		uint64_t		sendTime;
+		double			sendTokens;			// outbound bytes allowed
+		uint32_t		rng;
+		uint64_t		numHeld, numDropped, numReordered, bytesHeld;
+	};
+
+	// Counter, written by the owning thread and read from any thread
+	struct HELPAPI NetCounter {
+		NetCounter() : v(0) {}
+		NetCounter( const NetCounter& c ) : v( c.get() ) {}
+		NetCounter& operator= ( const NetCounter& c )	{ set ( c.get() ); return *this; }
+		inline void			add ( uint64_t n )	{ v.store ( v.load(std::memory_order_relaxed) + n, std::memory_order_relaxed ); }
+		inline void			set ( uint64_t n )	{ v.store ( n, std::memory_order_relaxed ); }
+		inline uint64_t	get () const				{ return v.load ( std::memory_order_relaxed ); }
+		std::atomic<uint64_t>	v;
+	};
+
+	// Socket counters (also kept as totals per system)
+	struct HELPAPI NetSockStat {
+		void reset ()		{ events_in.set(0); events_out.set(0); bytes_in.set(0); bytes_out.set(0); partial_sends.set(0); send_fail.set(0); reconnects.set(0); tls_full.set(0); tls_resumed.set(0); }
+		NetCounter	events_in, events_out;			// events received, accepted for send
+		NetCounter	bytes_in, bytes_out;				// serialized bytes received, sent to kernel
+		NetCounter	partial_sends;							// sends which left bytes queued
+		NetCounter	send_fail;
+		NetCounter	reconnects;
+		NetCounter	tls_full, tls_resumed;			// TLS handshakes, full or resumed session
+		NetCounter	tx_queued;									// outbound queue depth, bytes (gauge)
+		NetCounter	rtt_us;											// last sampled round trip (gauge)
+	};
+
 	struct HELPAPI NetSock {
 		NetSock()	{
-			socket=0; txBuf=0;txPtr=0;rxBuf=0;rxPtr=0;pktBuf=0;pktPtr=0; num_udp=0;
+			socket=0; txBuf=0;txPtr=0;rxBuf=0;rxPtr=0;pktBuf=0;pktPtr=0; num_udp=0; rel=0; emu=0;
+			rxRing=0; rxRingMax=0; rxRingMirror=false; rxHead=0; rxTail=0; pktCounter=0;
+			txHead=0; txLen=0; txCount=0; txQueued=0; txPending=false; txBlocked=false;
 			stat_send_wait=0; stat_rtt=0; stat_congwin=-1; stat_unack=0; stat_retrans=0; 
+			compressMin=-1; gen=0; reconnectAttempt=0; rxLast=0; txLast=0;
+			for (int k=0; k < NET_TIMER_KINDS; k++) timers[k] = -1;
 		}
 	
 		std::string	srvAddr;
@@ -153,13 +295,25 @@
 		int					reconnectCount;			// remaining allowed reconnect attempts
 		int					reconnectInterval;	// interval for this socket
 		TimeX				lastStateChange;		// for tracking when timeouts should occur
+		uint32_t		gen;								// slot generation, incremented when the slot is reused
+		int					reconnectAttempt;		// reconnects since last connected, for backoff
+		int					timers[ NET_TIMER_KINDS ];	// timer ids, -1 if not set
+		uint64_t		rxLast, txLast;			// msec of last receive and send (idle, heartbeat)
 		
 		// Outgoing buffers
+		// txBuf holds copied events. Bytes [txHead, txLen) are unsent.
+		// txSegs gives the send order of copied bytes and large events held by reference.
 		char*		txBuf;					// transmit buffer (per socket)
 		char*		txPtr;				
 		int			txPktSize;
+		int			txHead;					// first unsent byte
 		int			txLen;					// transmit so far
 		int			txMax;					// transmit max (expandable)
+		int			txCount;				// events queued since queue was last empty
+		int			txQueued;				// total unsent bytes (copied + held)
+		std::deque<NetTxSeg> txSegs;	// outbound segments, in order
+		bool		txPending;			// on the pending send list
+		bool		txBlocked;			// last send would block, wait for writable
 
 		// Incoming buffers
 		char*		rxBuf;					// receive buffer (per socket)
@@ -167,6 +321,15 @@
 		int			rxLen;					// recv so far
 		int			rxMax;					// recv max (expandable)		
 
+		// Incoming ring (TCP)
+		// Bytes [rxHead, rxTail) are unparsed. A mirrored ring is mapped twice, so any
+		// span up to rxRingMax is contiguous. Positions wrap by mask when mirrored.
+		char*		rxRing;
+		int			rxRingMax;			// ring size (power of 2)
+		bool		rxRingMirror;
+		xlong		rxHead;					// read position
+		xlong		rxTail;					// write position
+
 		// Incoming packets & event
 		int			eventLen;
 		Event*	event;					// deserialized event	
@@ -176,7 +339,17 @@
 		int			pktMax;
 		int			pktCounter;		
 
+		// Reliable UDP channels (created on first use)
+		NetRel*	rel;
+
+		// Network emulation (testing)
+		NetEmu*	emu;
+
+		// Payload compression
+		int			compressMin;		// compress payloads this large, 0 = off, -1 = system default
+
 		// Socket statistics
+		NetSockStat	stats;					// counters, see netGetStatsJSON
 		double 	stat_send_wait;
 		double 	stat_rtt;
 		int 		stat_congwin;
@@ -190,5 +363,12 @@
 		#endif	
 	};
 
+	// Socket Readiness (result of a poll)
+	struct HELPAPI NetReady {
+		int					sock_i;			// socket index
+		bool				read;				// ready to read (or accept)
+		bool				write;			// ready to write
+	};
+
 
 #endif
@@ -16,12 +16,27 @@
 // - Events have attach/get methods to help serialize data
 // - Event memory pools to handle many, small events
 // - Arbitrary event size, regardless of TCP/IP buffer size
+// - Per-socket outbound queue, coalescing events into one send
+// - Zero-copy vectored send (sendmsg) of large events from pooled memory, opt-in by netSendAcquire
+// - Receive ring per socket (mirrored mmap on linux), events as borrowed views
 // - Graceful disconnect for unexpected shutdown of client or server
 // - Reconnect for clients
 // - Verbose error handling
 // - C++ class model allows for multiple client/server objects
 // - C++ class model with no inheritence (for simplicity)
 // - Cross-platform and tested on Windows, Linux and Android
+// - Readiness by epoll on Linux (edge-triggered), select fallback
+// - Optional server workers, sockets sharded across threads
+// - Batched UDP receive and send (recvmmsg/sendmmsg), optional GSO/GRO on linux
+// - Reliable UDP channels: ordered, unordered and sequenced, with selective acks
+// - In-process network emulation (delay, jitter, loss, reorder, rate) for testing
+// - Compile-time log levels, and a per-thread binary trace ring for the hot path
+// - Optional LZ4 compression of large TCP payloads
+// - Chunked, resumable file transfer with flow control (NetFileTransfer, network_file.h)
+// - Socket slots recycled from a free list, generation handles, lookup by destination
+// - Non-blocking TLS on the outbound queue, coalesced records, session resumption (tickets)
+// - Timer wheel for handshake timeouts, reconnect backoff, heartbeats and idle timeouts
+// - Event handlers by target and name, hashed table, optional thread affinity
 // 
 //----------------------------------------------------------------------------------------------------------------------
 // -> HEADER <-
@@ -32,6 +47,7 @@
 
 #include "common_defs.h"
 #include "network_socket.h"
+#include "network_timer.h"
 #include "event_system.h"
 #include "time.h"
 
@@ -42,6 +58,12 @@
 
 #include <cstdio>
 #include <map>
+#include <unordered_map>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <condition_variable>
 
 #define NET_NOT_CONNECTED		11002
 #define NET_DISCONNECTED		107
@@ -63,6 +85,24 @@
 
 #define NET_BUFSIZE			1500		// Typical UDP max packet size
 
+#define NET_UDP_BATCH				32			// default datagrams per recvmmsg/sendmmsg
+#define NET_UDP_BATCH_MAX		64
+#define NET_UDP_QUEUE_MAX		1024		// outbound datagrams queued before an early flush
+#define NET_UDP_GRO_SIZE		65536		// receive slot with GRO (coalesced datagrams)
+
+#define NET_CHAN_UNRELIABLE						0		// UDP channel types
+#define NET_CHAN_RELIABLE_ORDERED			1
+#define NET_CHAN_RELIABLE_UNORDERED		2
+#define NET_CHAN_UNRELIABLE_SEQUENCED	3
+#define NET_REL_MAX_SENDS							50	// sends before a reliable message is dropped
+
+#define NET_SHARD_SOCKS			4096		// socket ids per worker, global id = (worker+1)*NET_SHARD_SOCKS + local
+#define NET_MAX_WORKERS			15
+#define NET_ASSIGN_ROUNDROBIN	0			// worker assignment of accepted clients
+#define NET_ASSIGN_HASH				1
+#define NET_DISPATCH_WORKER		0			// callbacks run on owning worker
+#define NET_DISPATCH_POOL			1			// callbacks run on user thread pool
+
 // -- NOTES --
 // IP               = 20 bytes
 // UDP = IP + 8     = 28 bytes
@@ -73,8 +113,44 @@
 typedef int (*funcEventHandler) ( Event& e, void* this_ptr  );
 typedef std::string str;
 
+// Event handlers by target and name (see netAddHandler)
+#define NET_HANDLER_DEFAULT		-1			// run where the user callback would run
+#define NET_HANDLER_INLINE		-2			// run on the network thread, also with a dispatch pool
+
+struct NetHandler {
+	uint64_t					key;				// target << 32 | name
+	funcEventHandler	func;				// 0x0 = empty slot
+	int								thread;			// dispatch pool thread, or NET_HANDLER_ ..
+};
+
 class EventPool;
 
+// Latency histogram (HDR, log-linear)
+// Values below 64 have exact buckets. Above, each power of 2 is split into 32 buckets,
+// so a recorded value is within 3% of its bucket. Values are nsec, up to 2^40 (~18 min).
+// Recording is lock-free and may be done from any thread.
+#define NET_HIST_SUB				32
+#define NET_HIST_BITS				40
+#define NET_HIST_BUCKETS		( NET_HIST_SUB * (NET_HIST_BITS - 4) )
+
+struct HELPAPI NetHist {
+	NetHist()						{ reset(); }
+	void		reset ();
+	void		record ( uint64_t v );
+	void		merge ( const NetHist& h );
+	uint64_t	getCount () const			{ return count.load ( std::memory_order_relaxed ); }
+	uint64_t	getMax () const				{ return vmax.load ( std::memory_order_relaxed ); }
+	double		getMean () const;
+	uint64_t	getPercentile ( double q ) const;		// q in [0,1]
+	str			getJSON () const;
+
+	static int		bucket ( uint64_t v );
+	static uint64_t	bucketValue ( int b );				// highest value in bucket
+
+	std::atomic<uint64_t>	counts[ NET_HIST_BUCKETS ];
+	std::atomic<uint64_t>	count, sum, vmax;
+};
+
 struct NetStat {
 	float		 interval_ms;
 	uint64_t num_sent;
@@ -86,6 +162,39 @@ struct NetStat {
 	uint64_t failed_per_tick;
 	uint64_t bytes_sent_per_tick;
 	uint64_t bytes_recv_per_tick;
+
+	// Totals and latency (see netGetStatsJSON)
+	NetSockStat	total;							// summed over sockets, kept after close
+	NetHist			dispatch;						// netQueueEvent to user callback, nsec
+	NetHist			rtt;								// sampled TCP and reliable UDP round trip, nsec
+};
+
+// Command posted to a worker
+struct NetPost {
+	NetPost() : cmd(0), sock_i(-1), sock_h(0), ip(0), port(0), srv_port(0), security(0) {}
+	char				cmd;			// 'a' add client, 'c' close
+	int					sock_i;
+	CX_SOCKET		sock_h;
+	netIP				ip;
+	netPort			port;
+	str					name;
+	netPort			srv_port;
+	int					security;
+};
+
+// User thread for callback dispatch
+struct NetDispatchItem {
+	Event*						e;
+	uint64_t					queued;			// time queued (nsec)
+	funcEventHandler	func;
+};
+struct NetDispatch {
+	NetDispatch() : stop(false) {}
+	std::mutex	mtx;
+	std::condition_variable cv;
+	std::deque< NetDispatchItem > queue;
+	std::thread	thread;
+	bool				stop;
 };
 
 class HELPAPI NetworkSystem {
@@ -110,27 +219,52 @@ public:
 	void netShowStats ( bool v )		{ m_printStats = v; }
 	void netMeasureStats ();
 	void netMeasureSocketStats ( bool start, int sock_i );
+	void netSetStatInterval ( int time_ms )	{ m_statInterval = time_ms; }		// RTT sampling, 0 = off
+	void netResetStats ( );
+	str  netGetStatsJSON ( bool sockets = true );		// totals, histograms, and sockets of this system
 	void netList ( bool verbose = false ); // list all connections/sockets
 	str netPrintAddr ( NetAddr adr );
 	
 	// Miscellaneous config API
 	void netSetSelectInterval ( int time_ms ); 
+	bool netSetPollMode ( int mode );			// NET_POLL_SELECT or NET_POLL_EPOLL
+	int  netGetPollMode ( )							{ return m_pollMode; }
+	void netSetSendQueueLimit ( int max_bytes )	{ m_sendQueueMax = max_bytes; }
+	void netSetSendCoalesce ( bool v )				{ m_sendCoalesce = v; }
+	void netSetSendZeroCopy ( int min_bytes )	{ m_sendZeroCopyMin = min_bytes; }	// netSendAcquire holds events this large, 0 = always copy
+	void netSetCompression ( int min_bytes, int sock_i = -1 );		// compress TCP payloads this large, 0 = off, -1 = all sockets
+	void netSetRecvRing ( int bytes )					{ m_recvRingSize = bytes; }				// 0 = legacy rx buffer, new sockets only
+	void netSetRecvViews ( bool v )						{ m_recvViews = v; }							// deliver events as borrowed views
+	void netSetMaxEventSize ( int bytes )			{ m_maxEventSize = bytes; }				// larger received events drop the connection
+	void netSetUDPBatch ( int batch, bool offload = false );		// datagrams per syscall (1 = unbatched), GSO/GRO offload
+	void netSetChannel ( int channel, int type );							// UDP channel type, NET_CHAN_*
+	void netSetRetransmit ( int time_ms )			{ m_relRetransmit = time_ms; }	// minimum reliable resend time
+	void netSetLossModel ( float loss, uint32_t seed = 1 );		// drop received datagrams, for testing
+	void netSetEmulation ( NetEmuConfig cfg, int sock_i = -1 );	// emulated link, -1 = all sockets (and new ones)
+	void netClearEmulation ( );														// deliver held data, stop emulation
 	
 	// Security config API
 	bool netSetProcessInterval(int time_ms);	
 	bool netSetReconnectInterval ( int time_ms ); 
 	bool netSetReconnectLimit ( int limit );
 	bool netSetReconnectLimit ( int limit, int sock_i );	
+	void netSetReconnectBackoff ( int max_ms, float jitter );	// reconnect delay doubles per attempt up to max_ms, less up to jitter (0..1) of it
+	void netSetIdleTimeout ( int time_ms )		{ m_idleTimeout = time_ms; }		// close connections with nothing received for this long, 0 = off
+	void netSetHeartbeat ( int time_ms )			{ m_heartbeat = time_ms; }			// send a heartbeat when nothing was sent for this long, 0 = off
 	bool netSetSecurityLevel ( int levels );
 	bool netSetSecurityLevel ( int levels, int sock_i );
 	bool netSetPathToPublicKey ( str path );
 	bool netSetPathToPrivateKey ( str path );
 	bool netSetPathToCertDir ( str path );
 	bool netSetPathToCertFile ( str path );
+	void netSetTLSWrite ( int bytes );							// plaintext bytes per TLS write when draining the queue
+	void netSetTLSCoalesce ( bool v )					{ m_tlsCoalesce = v; }	// queue small events, written as full records once per tick
+	void netSetTLSResume ( bool v )						{ m_tlsResume = v; }		// session tickets and resumption, before first connection
+	bool netSetTLSTicketKeys ( str path );						// server ticket keys, kept in file so tickets survive a restart
 	
 	// Server API
 	bool netServerStart ( netPort srv_port, int security = NET_SECURITY_UNDEF );
-	void netServerAcceptClient ( int sock_i );
+	int  netServerAcceptClient ( int sock_i );
 	void netServerCheckConnectionHandshakes ( );
 	void netServerProcessIO ( );
 	void netServerCompleteConnection ( int sock_i );
@@ -139,7 +273,7 @@ public:
 	void netClientStart ();
 	int netClientConnectToServer ( str srv_name, netPort srv_port, bool block = false, int sock_i = -1 );
 	void netClientConnectUDP ( int tcp_sock_i );	
-	int  netClientStartUDP ();
+	int  netClientStartUDP ( int sock_i );
 	void netClientCheckConnectionHandshakes ( );
 	void netClientProcessIO ( );
 	void netClientHandshake ( int sock_i );
@@ -158,15 +292,36 @@ public:
 	void netReceiveData ( int sock_i );
 	void netReceiveUDP ();
 	void netReceiveByInjectedBuf ( int sock_i, char* buf, int buflen );
-	void netDeserializeUDP ( NetSock& s, int sock_i );
-	void netDeserializeEvents ( int sock_i );
+	void netReceiveUDPPacket ( char* buf, int len, NetAddr& recv_src, bool emulate = true );
+	void netDeserializeUDP ( NetSock& s, int sock_i, char* buf, int len );
+	bool netDeserializeEvents ( int sock_i );							// false if the connection was dropped
+	bool netDeserializeRing ( int sock_i );								// false if the connection was dropped
+	bool netDeserializeEvent ( Event& e, char* buf, int len );		// expands compressed events
+	bool netCompressEvent ( Event& e, Event& ce );
 	void netMakeEvent ( Event& e, eventStr_t name );	
-	bool netSend ( Event& e, int sock=-1 );
+	bool netSend ( Event& e, int sock=-1 );					// e is unchanged
+	bool netSendAcquire ( Event& e, int sock=-1 );			// zero copy for large events, e may be detached
 	bool netSendUDP ( Event& e, int sock_i=-1 );
+	bool netSend ( Event& e, int sock_i, int channel );		// send on UDP channel
 	bool netSendLiteral ( str str_lit, int sock_i );
+	void netSendFlush ( );							// drain queued events on all sockets
+	int  netSendFlushUDP ( );						// send queued datagrams, returns number sent
+	int  netGetSendQueued ( int sock_i );		// bytes queued on socket
+	bool netSendAsync ( Event& e, int sock_i );		// send from any thread, via post queue
+
+	// Server workers (multi-threaded, opt-in)
+	bool netServerStartWorkers ( int num_workers, int assign = NET_ASSIGN_ROUNDROBIN, int dispatch = NET_DISPATCH_WORKER, int pool_threads = 0 );
+	void netServerStopWorkers ( );
+	int  netGetNumWorkers ( )						{ return (int) m_workers.size(); }
+	int  netSockId ( int sock_i )				{ return m_sockBase + sock_i; }		// global socket id
+	xlong netSockHandle ( int sock_i );		// slot and generation, 0 = invalid
+	int  netSockFromHandle ( xlong h );		// socket index, or -1 if the slot was closed or reused
 	void netQueueEvent ( Event& e ); // Place incoming event on recv queue
 	int netEventCallback ( Event& e ); // Processes network events (dispatch)
 	void netSetUserCallback ( funcEventHandler userfunc )	{ m_userEventCallback = userfunc; }
+	bool netAddHandler ( eventStr_t targ, eventStr_t name, funcEventHandler func, int thread = NET_HANDLER_DEFAULT );
+	void netClearHandlers ( );
+	NetHandler* netGetHandler ( eventStr_t targ, eventStr_t name );
 	bool netIsConnectComplete ( int sock_i );
 	bool netCheckError ( int result, int sock_i );	
 
@@ -189,14 +344,22 @@ public:
 	float		getSockRTT ( int i );
 	EventPool*  	getNetPool ( )		{ return m_eventPool; }		
 	NetSock*	getSock ( int i );		// socket itself
+	NetRel*		getSockRel ( int i )	{ return valid_socket_index(i) ? m_socks[i].rel : 0x0; }	// reliable UDP state
+	uint64_t	getUDPLost ( )				{ return m_udpLost; }		// datagrams dropped by loss model
+	NetStat&	getStats ( )					{ return m_stat; }			// this system only (not workers)
+	NetSockStat* getSockStats ( int i )	{ return valid_socket_index(i) ? &m_socks[i].stats : 0x0; }
+	NetEmu*		getSockEmu ( int i )	{ return (i < 0) ? m_udp_sock.emu : valid_socket_index(i) ? m_socks[i].emu : 0x0; }	// -1 = UDP
 	str			getSockSrcIP(int i);			// src IP of socket
 	str			getSockDestIP ( int i );	// dest IP of socket	
 	int			getServerSock ( int i );	// client's socket on server
+	int			getUDPPeerSock ( int i )	{ return netRelPeerSock ( i ); }	// peer's socket, first int of each datagram to it
 	str 		getIPStr ( netIP ip );		// return IP as a string
 	netIP		getStrToIP ( str name );
 
 protected:
 	str			netPrintf ( int flag, const char* fmt, ... );
+	bool		netPrintOn ( int flag )	{ return (flag == DFLOW) ? m_printFlow : (flag == VERBOSE || flag == VERBOSE_HS) ? m_printVerbose : true; }
+	static constexpr int net_log_level ( int flag )	{ return (flag == DFLOW) ? 3 : (flag == VERBOSE || flag == VERBOSE_HS) ? 2 : 1; }
 	
 private: // MP: Move this stuff
 	funcEventHandler m_userEventCallback; // User event handler
@@ -212,6 +375,13 @@ private: // Functions
 		void netServerAcceptSSL ( int sock_i );
 		void netClientSetupHandshakeSSL ( int sock_i ); 
 		void netClientConnectSSL ( int sock_i );		
+		SSL_CTX* netGetServerCtxSSL ( );
+		SSL_CTX* netGetClientCtxSSL ( );
+		int netWriteSSL ( int sock_i, char* buf, int len );
+		void netSendResidualSSL ( int sock_i );
+		void netCheckHandshakesSSL ( );
+		void netHandshakeDoneSSL ( int sock_i );
+		static int netNewSessionSSL ( SSL* ssl, SSL_SESSION* sess );
   #endif
 
 	// Abtract socket functions
@@ -222,6 +392,16 @@ private: // Functions
 	int netFindSocket ( int side, int mode, int state, NetAddr& dest );
 	int netFindOrCreateSocket(str srv_name, netPort srv_port, netIP srv_ip, bool block );
 	int netFindOutgoingSocket ( bool bTcp );
+	int netSockSlot ( );
+	void netSockIndexAdd ( int sock_i );
+	void netSockIndexRemove ( int sock_i );
+	void netFreeSocketBufs ( NetSock& s );
+	void netTimerSet ( int sock_i, int kind, int time_ms );
+	void netTimerClear ( int sock_i, int kind = -1 );		// -1 = all
+	void netTimerRun ( );
+	void netTimerFire ( int sock_i, int kind );
+	void netTimerConnected ( int sock_i );
+	void netTimerReconnect ( int sock_i );
 	int netManageHandshakeError ( int sock_i, std::string reason );
 	int netManageTransmitError ( int sock_i, std::string reason, int force = 0 );
 	int netDeleteSocket ( int sock_i, int force=0 );
@@ -242,7 +422,56 @@ private: // Functions
 	bool netSocketIsConnected ( int sock_i );
 	bool netSocketIsSelected ( fd_set* sockSet, int sock_i );
 	int netSocketSelect ( fd_set* sockReadSet, fd_set* sockWriteSet );
+	int netSocketPoll ( );
+	void netSocketPollAdd ( int sock_i );
+	void netSocketPollRemove ( int sock_i );
+	void netWakeCreate ( );
+	void netWakeFree ( );
+	void netWake ( );									// interrupt the poll wait, any thread
+	void netWakeClear ( );
+	void netSocketUDPOffload ( );
 	void netSendResidualEvent ( int sock_i );
+	bool netSendQueueAppend ( int sock_i, char* buf, int len, bool force );
+	bool netSendEvent ( Event& e, int sock_i, bool acquire );
+	bool netSendQueueEvent ( int sock_i, Event& e, int sent, bool force, bool acquire );
+	void netSendQueueConsume ( int sock_i, int bytes );
+	void netSendQueuePending ( int sock_i );
+	void netSendQueueClear ( int sock_i );
+	int  netServerAddClient ( CX_SOCKET sock_h, netIP cli_ip, netPort cli_port, str srv_name, netPort srv_port, int security_level );
+	int  netUserCallback ( Event& e, uint64_t queued = 0 );
+	void netWorkerRun ( );
+	int  netWorkerAssign ( netIP cli_ip, netPort cli_port );
+	NetworkSystem* netWorkerFor ( int& sock_i );
+	bool netWorkerSend ( Event& e, int sock_i, bool acquire );
+	void netWorkerPublish ( );
+	int  netWorkerSockState ( int sock_i );
+	void netPost ( NetPost& p );
+	void netPostDrain ( );
+	void netDispatchPost ( Event& e, uint64_t queued, funcEventHandler func, int thread );
+	void netBuildHandlers ( );
+	void netDispatchRun ( int t );
+	bool netRingCreate ( NetSock& s, int size );
+	void netRingFree ( NetSock& s );
+	bool netRingReserve ( NetSock& s, int need );
+	char* netRingRead ( NetSock& s );
+	char* netRingWrite ( NetSock& s, int& avail );
+	int netRecvEventLen ( char* hdr );
+	bool netRecvBadLength ( int sock_i, char* hdr );
+	bool netSendUDPBuf ( char* buf, int len, int sock_i );
+	NetRel* netRelState ( int sock_i );
+	void netRelReceive ( int sock_i, char* buf, int len, NetRelHdr& h );
+	void netRelAck ( NetRel* r, uint16_t seq );
+	void netRelSendPacket ( int sock_i, char* buf, int len, int channel, uint16_t msg_seq, int flags );
+	void netRelUpdate ( );
+	int  netRelPeerSock ( int sock_i );
+	NetEmu* netEmuFor ( NetSock& s );
+	void netEmuHold ( NetEmu* emu, char* buf, int len, NetAddr* src );
+	void netEmuRelease ( bool all = false );
+	int  netEmuSendAllow ( NetEmu* emu );
+	void netStatSample ( );
+	inline void netStatRecv ( NetSock& s, int bytes )	{ s.stats.events_in.add ( 1 ); s.stats.bytes_in.add ( bytes ); m_stat.total.events_in.add ( 1 ); m_stat.total.bytes_in.add ( bytes ); s.rxLast = m_tickMs; }
+	inline void netStatEvent ( NetSock& s, bool ok )	{ if ( ok ) { s.stats.events_out.add ( 1 ); m_stat.total.events_out.add ( 1 ); } else { s.stats.send_fail.add ( 1 ); m_stat.total.send_fail.add ( 1 ); } }
+	inline void netStatSent ( NetSock& s, int bytes )	{ s.stats.bytes_out.add ( bytes ); m_stat.total.bytes_out.add ( bytes ); s.txLast = m_tickMs; }
 
 	// Short helpers, used to simplify the program elsewhere	
 	unsigned long get_read_ready_bytes ( CX_SOCKET sock_h );		
@@ -261,7 +490,7 @@ private: // Functions
 	void CXSocketApiInit ( );
 	void CXSocketSetBlockMode ( CX_SOCKET sock, bool block = false );
 	void CXSocketMakeNoDelay ( CX_SOCKET sock );
-	int CXSocketRecv ( CX_SOCKET sock, int secur, int state, char* buf, int bufmax );
+	int CXSocketRecv ( int sock_i, char* buf, int bufmax );
 	int CXSocketRecvFrom ( CX_SOCKET sock, char* buf, int bufmax, NetAddr& recv );
 
 	unsigned long CXSocketReadBytes ( CX_SOCKET sock );
@@ -285,15 +514,96 @@ private: // State
 	netIP			m_hostIp;	
 	int				m_readyServices;
 	timeval		m_rcvSelectTimout;	
-	TimeX			m_lastClientConnectCheck;
 	TimeX			m_lastNetProcess;
+	uint64_t	m_tickMs;					// msec at start of this tick
 	int				m_processInterval;
 	std::vector< NetSock > m_socks;
 	NetSock		m_udp_sock;
+
+	// Socket table
+	std::vector< int > m_sockFree;			// terminated slots to reuse (checked when taken)
+	std::vector< uint32_t > m_sockGen;		// last generation of each slot, kept when the slot is erased
+	std::unordered_map< uint64_t, std::vector<int> > m_sockDest;	// sockets by dest ip:port
+	int				m_sockOut;					// last outgoing socket found
+
+	// Readiness backend
+	int				m_pollMode;					// NET_POLL_SELECT or NET_POLL_EPOLL
+	int				m_pollFd;						// epoll instance (linux)
+	std::vector< NetReady > m_sockReady;		// sockets ready on last poll
+
+	// Outbound queues
+	int				m_sendQueueMax;			// max bytes queued per socket
+	bool			m_sendCoalesce;			// queue all events, flush once per tick
+	int				m_sendZeroCopyMin;	// events this large are held by reference by netSendAcquire
+	int				m_compressMin;			// compress payloads this large, 0 = off (default for sockets)
+
+	// Inbound rings
+	int				m_recvRingSize;			// initial receive ring per TCP socket
+	bool			m_recvViews;				// dispatch borrowed views from ring
+	int				m_maxEventSize;			// largest event accepted from the ring, with header
+	int				m_recvHandled;			// user events handled during receive
+
+	// Batched UDP
+	int				m_udpBatch;					// datagrams per recvmmsg/sendmmsg
+	bool			m_udpOffload;				// GSO send, GRO receive
+	std::vector< char > m_udpRxBuf;			// receive slots
+	std::vector< char > m_udpTxBuf;			// queued outbound datagrams
+	std::vector< NetUdpMsg > m_udpTx;
+
+	// Reliable UDP channels
+	int				m_relChannel[ NET_REL_CHANNELS ];	// channel types
+	int				m_relRetransmit;		// minimum resend time (ms)
+	std::vector< int > m_relSocks;		// sockets with channel state
+	std::vector< char > m_relPkt;			// datagram being built
+	float			m_udpLoss;					// loss model, probability of drop
+	uint32_t	m_udpLossSeed;
+	uint64_t	m_udpLost;
+
+	// Network emulation
+	bool			m_emuOn;						// default link for all sockets
+	NetEmuConfig m_emuConfig;
+	std::vector< char > m_emuBuf;			// recv staging
+
+	// Server workers
+	NetworkSystem*	m_owner;				// main system (app facing), this if not a worker
+	int				m_sockBase;					// global id of local socket 0
+	std::vector< NetworkSystem* > m_workers;
+	std::vector< std::thread > m_workerThreads;
+	std::atomic<bool> m_workerRun;
+	std::atomic<std::thread::id> m_threadId;	// worker thread, set before it gets sockets
+	int				m_wakeFd;						// eventfd in the poll set, wakes the worker for posts (linux)
+	int				m_assignMode;
+	int				m_assignNext;
+	std::mutex		m_postMtx;
+	std::vector< NetPost > m_posts;		// commands from other threads
+	std::atomic<int>* m_sockPub;			// per local socket, bytes queued if connected or -1, read by other threads
+	int				m_sockPubCnt;				// entries set on last publish
+	std::vector< NetDispatch* > m_dispatch;	// user thread pool
+
+	// Event handlers
+	std::vector< NetHandler > m_handlerList;	// as registered
+	std::vector< NetHandler > m_handlers;		// open addressed, power of 2, at most half full
+	int				m_handlerShift;			// 64 - log2 table size
+	std::vector< int > m_sendPending;		// sockets with queued bytes
+
+	// TLS
+	int				m_tlsWrite;					// max plaintext bytes per SSL_write from the queue
+	bool			m_tlsCoalesce;			// small events queued and written together
+	bool			m_tlsResume;				// session tickets
+	str				m_pathTicketKeys;
+	std::vector< char > m_tlsBuf;			// gathered queue bytes for one write
+	std::vector< int > m_tlsHandshakes;	// sockets in TLS handshake, stepped each tick
+	std::mutex		m_tlsMtx;
+	#ifdef BUILD_OPENSSL
+		SSL_CTX*	m_tlsCtxSrv;				// shared by all server sockets (and workers), holds ticket keys
+		SSL_CTX*	m_tlsCtxCli;
+		std::map< uint64_t, SSL_SESSION* > m_tlsSessions;		// client sessions by server ip:port
+	#endif
 	
 	// Event related
 	EventPool* m_eventPool; 
 	EventQueue m_eventQueue;
+	EventQueue m_postQueue;			// outbound events posted from other threads
 	
 	// Debug and trace related
 	int				m_check;
@@ -308,6 +618,15 @@ private: // State
 	int				m_security;
 	int				m_reconnectInterval;
 	int				m_reconnectMaxCount;
+	int				m_reconnectMax;					// backoff limit (ms)
+	float			m_reconnectJitter;
+	uint32_t	m_jitterSeed;
+
+	// Timers
+	NetTimerWheel	m_timers;
+	std::vector< NetTimerFire > m_timerFired;
+	int				m_idleTimeout;					// ms, 0 = off
+	int				m_heartbeat;						// ms, 0 = off
 	str				m_pathPublicKey;
 	str				m_pathPrivateKey;
 	str				m_pathCertDir;
@@ -315,6 +634,9 @@ private: // State
 
 	// Network statistics
 	NetStat m_stat;
+	int				m_statInterval;			// RTT sampling (ms)
+	TimeX			m_statLast;
+	uint64_t	m_dispatchTime;			// queue time of event being dispatched
 
 };
 
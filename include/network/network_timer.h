@@ -0,0 +1,79 @@
+//--------------------------------------------------------------------------------
+// Copyright 2007-2022 (c) Quanta Sciences, Rama Hoetzlein, ramakarl.com
+//
+// * Derivative works may append the above copyright notice but should not remove or modify earlier notices.
+//
+// MIT License:
+// Permission is hereby granted, free of charge, to any person obtaining a copy of this software and
+// associated documentation files (the "Software"), to deal in the Software without restriction, including without
+// limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software,
+// and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+// The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+// OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+// BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF
+// OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+//
+
+#ifndef DEF_NETWORK_TIMER_H
+	#define DEF_NETWORK_TIMER_H
+
+	#include "common_defs.h"
+	#include <stdint.h>
+	#include <vector>
+
+	// Hierarchical timer wheel
+	// Deadlines are kept in 4 wheels of 64 slots. Wheel 0 holds the next 64 ticks, one slot per tick.
+	// Each higher wheel holds 64x the span of the one below, and a slot is moved down (cascaded) when
+	// the lower wheel wraps. Add and cancel are O(1), advance touches only slots that are due.
+	// With the default 10 ms tick the wheels span 0.64 s, 41 s, 44 min and 46 hours; later deadlines
+	// are held in the last slot and placed again when it cascades.
+	//
+	// Timers carry a socket, its slot generation and a kind. Expired timers are returned from advance,
+	// for the caller to check against the socket (which may have been closed or reused).
+
+	#define NET_TIMER_TICK			10			// default msec per tick
+	#define NET_TIMER_LEVELS		4
+	#define NET_TIMER_BITS			6
+	#define NET_TIMER_SLOTS			(1 << NET_TIMER_BITS)
+
+	struct NetTimerFire {
+		int				id;
+		int				sock;
+		uint32_t	gen;
+		int				kind;
+	};
+
+	class HELPAPI NetTimerWheel {
+	public:
+		NetTimerWheel ();
+		void		init ( uint64_t now_ms, int tick_ms = NET_TIMER_TICK );
+		int			add ( uint64_t due_ms, int sock, uint32_t gen, int kind );		// returns timer id
+		void		cancel ( int id );
+		int			advance ( uint64_t now_ms, std::vector<NetTimerFire>& fired );	// appends expired timers, returns count
+		int			getCount ()				{ return m_count; }
+		int			getTickMS ()			{ return m_tickMs; }
+
+	private:
+		struct Timer {
+			uint64_t	due;				// tick
+			int				next, prev;
+			int				level, slot;		// level -1 if free
+			int				sock;
+			uint32_t	gen;
+			int				kind;
+		};
+		void		place ( int id, uint64_t base );
+		void		unlink ( int id );
+		void		cascade ( int level, uint64_t base );
+
+		std::vector<Timer>	m_timers;			// pool, indexed by timer id
+		std::vector<int>		m_free;
+		int				m_head[ NET_TIMER_LEVELS ][ NET_TIMER_SLOTS ];	// slot lists, -1 if empty
+		uint64_t	m_tick;				// last tick processed
+		int				m_tickMs;
+		int				m_count;
+	};
+
+#endif
@@ -0,0 +1,76 @@
+//--------------------------------------------------------------------------------
+// Copyright 2007-2022 (c) Quanta Sciences, Rama Hoetzlein, ramakarl.com
+//
+// * Derivative works may append the above copyright notice but should not remove or modify earlier notices.
+//
+// MIT License:
+// Permission is hereby granted, free of charge, to any person obtaining a copy of this software and
+// associated documentation files (the "Software"), to deal in the Software without restriction, including without
+// limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software,
+// and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+// The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+// OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+// BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF
+// OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+//
+
+//#define NET_TRACE_RING			// Enable/disable trace points in the network hot path
+
+#ifndef DEF_NETWORK_TRACE_H
+	#define DEF_NETWORK_TRACE_H
+
+	#include "common_defs.h"
+	#include <atomic>
+	#include <stdint.h>
+
+	// Binary trace ring
+	// Trace points write a fixed size record (time, id, socket, arg) to a ring owned by the
+	// calling thread, with no locks or formatting. netTraceDump writes all rings to a binary file,
+	// which netTraceDecode turns into text offline. The oldest records are overwritten.
+	// Trace points compile to nothing unless NET_TRACE_RING is defined.
+
+	#define NET_TRACE_RECORDS		65536			// default records per thread
+
+	enum NetTraceId {
+		NT_NONE = 0,
+		NT_POLL,					// arg: sockets ready
+		NT_RECV,					// arg: bytes
+		NT_RECV_EVENT,		// arg: event name, parsed from received bytes
+		NT_QUEUE,					// arg: event name
+		NT_DISPATCH,			// arg: event name
+		NT_SEND,					// arg: event name
+		NT_SEND_QUEUE,		// arg: bytes queued on socket
+		NT_SEND_PARTIAL,	// arg: bytes sent
+		NT_SEND_FLUSH,		// arg: bytes sent
+		NT_UDP_RECV,			// arg: datagrams
+		NT_UDP_SEND,			// arg: datagrams
+		NT_ACCEPT,
+		NT_CLOSE,
+		NT_MAX
+	};
+
+	struct NetTraceRec {
+		uint64_t	time;			// nsec
+		uint32_t	id;
+		int32_t		sock;
+		int64_t		arg;
+	};
+
+	HELPAPI void netTraceStart ( int records = NET_TRACE_RECORDS );		// enable, clear rings
+	HELPAPI void netTraceStop ();
+	HELPAPI bool netTraceDump ( const char* fn );										// binary, all threads
+	HELPAPI bool netTraceDecode ( const char* bin_fn, const char* txt_fn );		// text, merged by time
+	HELPAPI const char* netTraceName ( int id );
+	HELPAPI void netTraceWrite ( uint32_t id, int sock, int64_t arg );
+
+	extern HELPAPI std::atomic<bool> g_netTraceOn;
+
+	#ifdef NET_TRACE_RING
+		#define NET_TRACE(id, sock, arg)		do { if ( g_netTraceOn.load ( std::memory_order_relaxed ) ) netTraceWrite ( id, sock, (int64_t) (arg) ); } while (0)
+	#else
+		#define NET_TRACE(id, sock, arg)		((void) 0)
+	#endif
+
+#endif
@@ -22,6 +22,9 @@
 #include "file_tga.h"
 
 #include "imagex.h"
+#include "imagex_convert.h"
+#include "imagex_resample.h"
+#include "imagex_blend.h"
 #include "imageformat.h"
 #include "imageformat_png.h"
 #include "imageformat_tiff.h"
@@ -87,6 +90,7 @@ void ImageX::Release ()
 	mXres = 0;
 	mYres = 0;	
 	m_Pix.Clear();	
+	ClearMips ();
 }
 
 void ImageX::SetUsage ( uchar use_flags )
@@ -133,6 +137,8 @@ void ImageX::ResizeChannel ( int chan, int xr, int yr, ImageOp::Format fmt, ucha
 
 	if ( mXres != xr || mYres != yr || mFmt != fmt ) {
 
+		ClearMips ();
+
 		if ( use_flags==0 ) 
 			use_flags = m_UseFlags;		// use existing flags
 		else				
@@ -143,10 +149,10 @@ void ImageX::ResizeChannel ( int chan, int xr, int yr, ImageOp::Format fmt, ucha
 		SetFormat ( xr, yr, fmt );		
 		m_Pix.SetUsage (use_flags, dt, xr, yr, 1 );
 		
-		uint64_t sz = xr * yr * GetBytesPerPix();
+		uint64_t sz = (uint64_t) xr * yr * GetBytesPerPix();
 		m_Pix.Resize ( GetBytesPerPix(), sz, 0x0, use_flags );		
 
-		m_Pix.mNum = xr*yr;
+		m_Pix.mNum = (uint64_t) xr * yr;
 				
 		// Update formatting functions
 		SetFormatFunc ();
@@ -154,46 +160,68 @@ void ImageX::ResizeChannel ( int chan, int xr, int yr, ImageOp::Format fmt, ucha
 }
 
 
+// Convert pixels to another format with a row converter (see imagex_convert.h), a row at
+// a time. Runs in place when pixels get no larger, otherwise into a new buffer.
 void ImageX::ChangeFormat ( ImageOp::Format fmt )
 {
 	if ( GetFormat() == fmt ) return;
 
-	// save data in another image
-	ImageX save;
-	save.Copy ( this );			
-
-	// Resize to new format
-	Resize ( mXres, mYres, fmt );
-
-  float scalar = 1;
-  if (fmt == ImageOp::BW16) scalar = 256;
-
-	// Write existing to new
-	//  (uses format-specific get/set functions)
-	Vec4F c;
-	for (int y=0; y < mYres; y++) {
-		for (int x=0; x < mXres; x++) {
-			c = save.GetPixel (x, y);
-     		c *= scalar;
-			SetPixel ( x, y, c );
-		}
+	funcRowConvert cvt = getRowConvert ( mFmt, fmt );
+	if ( cvt == 0x0 ) {
+		dbgprintf ( "ERROR: ImageX::ChangeFormat. Unable to convert format %d to %d.\n", (int) mFmt, (int) fmt );
+		return;
+	}
+	int64_t cnt = (int64_t) mXres * mYres;
+	int dst_bpp = GetBitsPerPix ( fmt ) >> 3;
+	size_t spitch = GetBytesPerRow ();
+	size_t dpitch = (size_t) mXres * dst_bpp;
+
+	if ( dst_bpp <= GetBytesPerPix() ) {
+		// same buffer, keeps its allocation. each dest row starts at or before its source row
+		ClearMips ();
+		for ( int y = 0; y < mYres; y++ )
+			cvt ( GetData() + y * spitch, GetData() + y * dpitch, mXres );
+		SetFormat ( mXres, mYres, fmt );
+		m_Pix.SetUsage ( m_UseFlags, GetDataType ( fmt ), mXres, mYres, 1 );
+		m_Pix.mStride = dst_bpp;
+		m_Pix.mSize = (uint64_t) cnt * dst_bpp;
+		m_Pix.mMax = (int) cnt;
+		m_Pix.mNum = (int) cnt;
+		SetFormatFunc ();
+	} else {
+		// new buffer, old one released after
+		char* old = m_Pix.mCpu;
+		m_Pix.mCpu = 0x0;
+		Resize ( mXres, mYres, fmt );
+		for ( int y = 0; y < mYres; y++ )
+			cvt ( (XBYTE*) old + y * spitch, GetData() + y * dpitch, mXres );
+		free ( old );
 	}
 	if (mAutocommit) Commit();
-} 
+}
 
-void ImageX::Resample ( ImageX* src )
+// Resample src to the size of this image (see imagex_resample.h).
+// A different source format is resampled first, then converted.
+void ImageX::Resample ( ImageX* src, ImageOp::Sampler filter, int threads )
 {
-	Vec4F c;
-	float dx = float(src->GetWidth()) / mXres;
-	float dy = float(src->GetHeight()) / mYres;
+	if ( mXres <= 0 || mYres <= 0 ) return;
 
-	for (int y=0; y < mYres; y++) {
-		for (int x=0; x < mXres; x++) {
-			c = src->GetPixel (x * dx, y * dy);
-			SetPixel ( x, y, c );
+	if ( src->GetFormat() == mFmt ) {
+		resampleImage ( src->GetData(), src->GetWidth(), src->GetHeight(), src->GetBytesPerRow(),
+						GetData(), mXres, mYres, GetBytesPerRow(), mFmt, filter, threads );
+	} else {
+		funcRowConvert cvt = getRowConvert ( src->GetFormat(), mFmt );
+		if ( cvt == 0x0 ) {
+			dbgprintf ( "ERROR: ImageX::Resample. Unable to convert format %d to %d.\n", (int) src->GetFormat(), (int) mFmt );
+			return;
 		}
+		ImageX tmp ( mXres, mYres, src->GetFormat() );
+		resampleImage ( src->GetData(), src->GetWidth(), src->GetHeight(), src->GetBytesPerRow(),
+						tmp.GetData(), mXres, mYres, tmp.GetBytesPerRow(), src->GetFormat(), filter, threads );
+		for ( int y = 0; y < mYres; y++ )
+			cvt ( tmp.GetData() + (size_t) y * tmp.GetBytesPerRow(), GetData() + (size_t) y * GetBytesPerRow(), mXres );
 	}
-
+	if (mAutocommit) Commit();
 }
 
 
@@ -206,7 +234,7 @@ void ImageX::CopyToAlpha ()
 	// Transfer values in alpha
 	uchar* pix = GetData();
 	uchar v;
-	for (int n=0; n < mXres*mYres; n++ ) {
+	for (int64_t n=0; n < (int64_t) mXres*mYres; n++ ) {
 		v = *pix;
 		*pix++ = 255;
 		*pix++ = 255;
@@ -249,7 +277,7 @@ bool ImageX::LoadPng ( char* fname, bool bGrey )
 			return false;
 		}	
 		Create ( w, h, bGrey ? ImageOp::BW16 : ImageOp::RGBA8 );
-		int stride = GetSize() / mYres;
+		int stride = mBytesPerRow;
 
 		uchar* pix = GetData();
 
@@ -502,7 +530,9 @@ void ImageX::SetFormatFunc ( ImageOp::Format eFormat )
 		m_getPixelFunc = &ImageX::getPixelRGBA8;
 		m_setPixelFunc = &ImageX::setPixelRGBA8;		
 		break;
-	case ImageOp::RGB16:	
+	case ImageOp::RGB16:
+		m_getPixelFunc = &ImageX::getPixelRGB16;
+		m_setPixelFunc = &ImageX::setPixelRGB16;
 		break;
 	case ImageOp::RGBA32F:
 		m_getPixelFunc = &ImageX::getPixelRGBA32F;
@@ -541,9 +571,10 @@ void ImageX::TransferFrom ( ImageX* src_img )
 		unsigned int orig_flags = mFlags;
 		
 		uchar dt = src_img->GetDataType( src_img->GetFormat() );
+		ClearMips ();
 		SetFormat ( xr, yr, src_img->GetFormat() );				// Set new pixel format
 		m_Pix.SetUsage(m_UseFlags, dt, xr,yr,1);
-		m_Pix.mNum = xr * yr;
+		m_Pix.mNum = (uint64_t) xr * yr;
 
 		SetFlagEqual ( ImageOp::Channels, orig_flags );
 		SetFlagEqual ( ImageOp::FilterLo, orig_flags );
@@ -767,20 +798,105 @@ bool ImageX::Save (const char *filename)
 
 
 // Scales 'this' image with filtering.
-/*void ImageX::Scale (int nx, int ny)
+void ImageX::Scale ( int nx, int ny, ImageOp::Sampler filter, int threads )
 {
-	// Create new image data for rescaling
-	Image* new_img = new Image ( nx, ny, GetFormat () );
+	if ( nx == mXres && ny == mYres ) return;
 
-	// Rescale current data into new data buffer
-	{ (this->*m_ScaleFunc) ( new_img->GetData(), GetFormat(), nx, ny ); }
+	// keep the old buffer as the source
+	char* old = m_Pix.mCpu;
+	int ox = mXres, oy = mYres;
+	unsigned long opitch = GetBytesPerRow();
+	m_Pix.mCpu = 0x0;
+	Resize ( nx, ny, mFmt );
 
-	// Make new data the current data (transfer ownership)
-	TransferFrom ( new_img );
-	delete ( new_img );
-} */
+	if ( old != 0x0 && ox > 0 && oy > 0 && nx > 0 && ny > 0 )
+		resampleImage ( (XBYTE*) old, ox, oy, opitch, GetData(), nx, ny, GetBytesPerRow(), mFmt, filter, threads );
+	free ( old );
+	if (mAutocommit) Commit();
+}
+
+
+
+// Build mip levels, each from the one before (see imagex_resample.h for filters).
+// srgb applies to 8-bit formats only.
+void ImageX::BuildMips ( ImageOp::Sampler filter, bool srgb, int threads )
+{
+	ClearMips ();
 
+	ImageX* prev = this;
+	int w = mXres, h = mYres;
+	while ( w > 1 || h > 1 ) {
+		w = ( w > 1 ) ? w >> 1 : 1;
+		h = ( h > 1 ) ? h >> 1 : 1;
+		ImageX* mip = new ImageX ( w, h, mFmt, DT_CPU );
+		mip->mAutocommit = false;
+		if ( !resampleImage ( prev->GetData(), prev->mXres, prev->mYres, prev->GetBytesPerRow(),
+							  mip->GetData(), w, h, mip->GetBytesPerRow(), mFmt, filter, threads, srgb ) ) {
+			dbgprintf ( "ERROR: ImageX::BuildMips. Format %d not supported.\n", (int) mFmt );
+			delete mip;
+			ClearMips ();
+			return;
+		}
+		m_Mips.push_back ( mip );
+		prev = mip;
+	}
+}
+
+void ImageX::ClearMips ()
+{
+	for ( ImageX* mip : m_Mips ) delete mip;
+	m_Mips.clear ();
+}
+
+float ImageX::GetMipLOD ( float du, float dv )
+{
+	float tu = fabsf ( du ) * mXres;
+	float tv = fabsf ( dv ) * mYres;
+	float texels = ( tu > tv ) ? tu : tv;
+	return ( texels > 1 ) ? log2f ( texels ) : 0;
+}
+
+// Bilinear at texel centers, clamped at edges
+Vec4F ImageX::sampleBilinearUV ( float u, float v )
+{
+	float x = u * mXres - 0.5f;
+	float y = v * mYres - 0.5f;
+	int x0 = (int) floorf ( x );
+	int y0 = (int) floorf ( y );
+	x -= x0;
+	y -= y0;
+	int x1 = ( x0 + 1 < mXres ) ? ( x0 < 0 ? 0 : x0 + 1 ) : mXres - 1;
+	int y1 = ( y0 + 1 < mYres ) ? ( y0 < 0 ? 0 : y0 + 1 ) : mYres - 1;
+	x0 = ( x0 < 0 ) ? 0 : ( x0 >= mXres ) ? mXres - 1 : x0;
+	y0 = ( y0 < 0 ) ? 0 : ( y0 >= mYres ) ? mYres - 1 : y0;
+
+	Vec4F c[7];
+	(this->*m_getPixelFunc) ( x0, y0, c[0] );
+	(this->*m_getPixelFunc) ( x1, y0, c[1] );
+	(this->*m_getPixelFunc) ( x0, y1, c[2] );
+	(this->*m_getPixelFunc) ( x1, y1, c[3] );
+	c[4] = c[0] + (c[1]-c[0]) * x;
+	c[5] = c[2] + (c[3]-c[2]) * x;
+	c[6] = c[4] + (c[5]-c[4]) * y;
+	return c[6];
+}
+
+// Trilinear lookup, between the two mip levels around lod.
+// Mips are built with defaults on first use. Build them first when sampling from several threads.
+Vec4F ImageX::GetPixelFilteredUV ( float u, float v, float lod )
+{
+	if ( lod > 0 && m_Mips.empty() ) BuildMips ();
 
+	int top = (int) m_Mips.size();
+	if ( lod <= 0 || top == 0 ) return sampleBilinearUV ( u, v );
+	if ( lod >= top ) return GetMip ( top )->sampleBilinearUV ( u, v );
+
+	int lev = (int) lod;
+	float f = lod - lev;
+	Vec4F a = GetMip ( lev )->sampleBilinearUV ( u, v );
+	Vec4F b = GetMip ( lev + 1 )->sampleBilinearUV ( u, v );
+	return a + (b - a) * f;
+}
 
 // Copy another image to the current one
 //   (retains the original format)
@@ -788,6 +904,7 @@ void ImageX::Copy (ImageX* src )
 {
 	// resize self
 	Resize ( src->mXres, src->mYres, src->mFmt );
+	ClearMips ();
 
 	// copy data from src to self
 	memcpy ( GetData(), src->GetData(), src->GetSize() );	
@@ -952,14 +1069,108 @@ void ImageX::Fill (float v)
 }
 void ImageX::Fill (float r, float g, float b, float a)
 {
-	Vec4F c (r,g,b,a);
+	FillRect ( 0, 0, mXres, mYres, Vec4F(r,g,b,a) );
+}
+
+// Encode a color in this format with the row converters. Gray formats take the
+// first channel, as the pixel setters do.
+bool ImageX::encodePixel ( Vec4F c, XBYTE* pix )
+{
+	bool gray = ( mFmt == ImageOp::BW8 || mFmt == ImageOp::BW16 || mFmt == ImageOp::BW32 || mFmt == ImageOp::F32 );
+	funcRowConvert cvt = getRowConvert ( gray ? ImageOp::F32 : ImageOp::RGBA32F, mFmt );
+	if ( cvt == 0x0 ) return false;
+	float v[4] = { c.x, c.y, c.z, c.w };
+	cvt ( (const XBYTE*) v, pix, 1 );
+	return true;
+}
+
+void ImageX::FillRect ( int x, int y, int w, int h, Vec4F c )
+{
+	if ( x < 0 ) { w += x; x = 0; }
+	if ( y < 0 ) { h += y; y = 0; }
+	if ( x + w > mXres ) w = mXres - x;
+	if ( y + h > mYres ) h = mYres - y;
+	if ( w <= 0 || h <= 0 ) return;
+
+	XBYTE pix[16];
+	if ( !encodePixel ( c, pix ) ) return;
+	ClearMips ();
+	int bpp = GetBytesPerPix();
+	XBYTE* row = GetData() + (size_t) y * mBytesPerRow + (size_t) x * bpp;
+
+	if ( w == mXres ) {
+		fillPixels ( row, pix, bpp, (int64_t) w * h );			// rows are contiguous
+	} else {
+		fillPixels ( row, pix, bpp, w );
+		for ( int j = 1; j < h; j++ )
+			memcpy ( row + (size_t) j * mBytesPerRow, row, (size_t) w * bpp );
+	}
+	if (mAutocommit) Commit();
+}
+
+void ImageX::FillRegion ( Vec4F c )
+{
+	// dirty region is x0,y0,x1,y1 inclusive. FillRect clears the mips.
+	Vec4F& dr = mDirtyRegion;
+	FillRect ( int(dr.x), int(dr.y), int(dr.z) - int(dr.x) + 1, int(dr.w) - int(dr.y) + 1, c );
+}
 
-	// using format overloads for set pixel
-	// -- this is slow for now
-	for (int y=0; y < mYres; y++)
-		for (int x=0; x < mXres; x++) 
-			SetPixel ( x, y, c);
+bool ImageX::clipRect ( ImageX* src, int& sx, int& sy, int& w, int& h, int& dx, int& dy )
+{
+	if ( src == 0x0 || src->GetData() == 0x0 || GetData() == 0x0 ) return false;
+	if ( sx < 0 ) { w += sx; dx -= sx; sx = 0; }
+	if ( sy < 0 ) { h += sy; dy -= sy; sy = 0; }
+	if ( dx < 0 ) { w += dx; sx -= dx; dx = 0; }
+	if ( dy < 0 ) { h += dy; sy -= dy; dy = 0; }
+	if ( sx + w > src->mXres ) w = src->mXres - sx;
+	if ( sy + h > src->mYres ) h = src->mYres - sy;
+	if ( dx + w > mXres ) w = mXres - dx;
+	if ( dy + h > mYres ) h = mYres - dy;
+	return ( w > 0 && h > 0 );
+}
+
+void ImageX::Blit ( ImageX* src, int sx, int sy, int w, int h, int dx, int dy )
+{
+	if ( !clipRect ( src, sx, sy, w, h, dx, dy ) ) return;
 
+	funcRowConvert cvt = 0x0;
+	if ( src->mFmt != mFmt ) {
+		cvt = getRowConvert ( src->mFmt, mFmt );
+		if ( cvt == 0x0 ) { dbgprintf ( "ERROR: ImageX::Blit. Unable to convert format %d to %d.\n", (int) src->mFmt, (int) mFmt ); return; }
+	}
+	int sb = src->GetBytesPerPix();
+	int db = GetBytesPerPix();
+	bool up = ( src == this && dy > sy );						// overlapping, copy bottom rows first
+
+	for ( int j = 0; j < h; j++ ) {
+		int r = up ? h - 1 - j : j;
+		XBYTE* s = src->GetData() + (size_t) (sy + r) * src->mBytesPerRow + (size_t) sx * sb;
+		XBYTE* d = GetData() + (size_t) (dy + r) * mBytesPerRow + (size_t) dx * db;
+		if ( cvt ) cvt ( s, d, w );
+		else memmove ( d, s, (size_t) w * db );
+	}
+	ClearMips ();									// after the copy, src may be one of them
+	if (mAutocommit) Commit();
+}
+
+void ImageX::Composite ( ImageX* src, int sx, int sy, int w, int h, int dx, int dy, bool premul )
+{
+	if ( !clipRect ( src, sx, sy, w, h, dx, dy ) ) return;
+
+	int sb = src->GetBytesPerPix();
+	int db = GetBytesPerPix();
+	bool up = ( src == this && dy > sy );
+
+	for ( int j = 0; j < h; j++ ) {
+		int r = up ? h - 1 - j : j;
+		XBYTE* s = src->GetData() + (size_t) (sy + r) * src->mBytesPerRow + (size_t) sx * sb;
+		XBYTE* d = GetData() + (size_t) (dy + r) * mBytesPerRow + (size_t) dx * db;
+		if ( !compositeRow ( s, src->mFmt, d, mFmt, w, premul ) ) {
+			dbgprintf ( "ERROR: ImageX::Composite. Unable to blend format %d over %d.\n", (int) src->mFmt, (int) mFmt );
+			return;
+		}
+	}
+	ClearMips ();
 	if (mAutocommit) Commit();
 }
 
@@ -1030,6 +1241,7 @@ void ImageX::Line (float x0, float y0, float x1, float y1, Vec4F c)
 
 void ImageX::BlendPixel(int x, int y, Vec4F c, float alpha)
 {
+	if ( alpha <= 0 || x < 0 || y < 0 || x >= mXres || y >= mYres ) return;
 	Vec4F px;
 	(this->*m_getPixelFunc) (x, y, px);	
 	(this->*m_setPixelFunc) (x, y, c * alpha + px * (1-alpha) );
@@ -1042,14 +1254,14 @@ void ImageX::BlendPixel(int x, int y, Vec4F c, float alpha)
 void ImageX::setPixelBW8(int x, int y, Vec4F c)
 {
   if (x >= 0 && y >= 0 && x < mXres && y < mYres) {
-    XBYTE* pix = ((XBYTE*)GetData()) + (y * mXres + x);			// XBYTE stride
+    XBYTE* pix = ((XBYTE*)GetData()) + ((size_t) y * mXres + x);			// XBYTE stride
     *pix = c.x * 255.0f;
   }
 }
 void ImageX::getPixelBW8(int x, int y, Vec4F& c)
 {
   if (x >= 0 && y >= 0 && x < mXres && y < mYres) {
-    XBYTE* pix = ((XBYTE*)GetData()) + (y * mXres + x);			// XBYTE stride
+    XBYTE* pix = ((XBYTE*)GetData()) + ((size_t) y * mXres + x);			// XBYTE stride
     c.x = *pix / 255.0f;
     c.y = 0; c.z = 0; c.w = 1.0;
   }
@@ -1057,14 +1269,14 @@ void ImageX::getPixelBW8(int x, int y, Vec4F& c)
 void ImageX::setPixelBW16(int x, int y, Vec4F c)
 {
   if (x >= 0 && y >= 0 && x < mXres && y < mYres) {
-    XBYTE2* pix = ((XBYTE2*)GetData()) + (y * mXres + x);		// XBYTE2 stride
+    XBYTE2* pix = ((XBYTE2*)GetData()) + ((size_t) y * mXres + x);		// XBYTE2 stride
     *pix = c.x * 65535;
   }
 }
 void ImageX::getPixelBW16(int x, int y, Vec4F& c)
 {
   if (x >= 0 && y >= 0 && x < mXres && y < mYres) {
-    XBYTE2* pix = ((XBYTE2*)GetData()) + (y * mXres + x);		// XBYTE2 stride
+    XBYTE2* pix = ((XBYTE2*)GetData()) + ((size_t) y * mXres + x);		// XBYTE2 stride
     c.x = *pix / 65535.0f;
     c.y = 0; c.z = 0; c.w = 1;
   }
@@ -1072,7 +1284,7 @@ void ImageX::getPixelBW16(int x, int y, Vec4F& c)
 void ImageX::setPixelRGB8 (int x, int y, Vec4F c)
 {
 	if ( x>=0 && y>=0 && x < mXres && y < mYres ) {
-		XBYTE* pix = (XBYTE*) (GetData() + (y * mXres + x) * 3);
+		XBYTE* pix = (XBYTE*) (GetData() + ((size_t) y * mXres + x) * 3);
 		*pix++ = c.x * 255.0f;
 		*pix++ = c.y * 255.0f;
 		*pix++ = c.z * 255.0f;
@@ -1081,7 +1293,7 @@ void ImageX::setPixelRGB8 (int x, int y, Vec4F c)
 void ImageX::getPixelRGB8 (int x, int y, Vec4F& c )
 {
 	if ( x>=0 && y>=0 && x < mXres && y < mYres ) {
-		XBYTE* pix = (XBYTE*) (GetData() + (y * mXres + x) * 3);
+		XBYTE* pix = (XBYTE*) (GetData() + ((size_t) y * mXres + x) * 3);
     c.x = *pix++ / 255.0f;
     c.y = *pix++ / 255.0f;
     c.z = *pix++ / 255.0f;
@@ -1091,7 +1303,7 @@ void ImageX::getPixelRGB8 (int x, int y, Vec4F& c )
 void ImageX::setPixelRGBA8 (int x, int y, Vec4F c)
 {
 	if ( x>=0 && y>=0 && x < mXres && y < mYres ) {
-		XBYTE* pix = (XBYTE*) (GetData() + (y * mXres + x) * 4);
+		XBYTE* pix = (XBYTE*) (GetData() + ((size_t) y * mXres + x) * 4);
 		*pix++ = c.x * 255.0f;
 		*pix++ = c.y * 255.0f;
 		*pix++ = c.z * 255.0f;
@@ -1101,7 +1313,7 @@ void ImageX::setPixelRGBA8 (int x, int y, Vec4F c)
 void ImageX::getPixelRGBA8 (int x, int y, Vec4F& c )
 {
 	if ( x>=0 && y>=0 && x < mXres && y < mYres ) {
-		XBYTE* pix = (XBYTE*) (GetData() + (y * mXres + x) * 4);
+		XBYTE* pix = (XBYTE*) (GetData() + ((size_t) y * mXres + x) * 4);
     c.x = *pix++ / 255.0f;
     c.y = *pix++ / 255.0f;
     c.z = *pix++ / 255.0f;
@@ -1112,7 +1324,7 @@ void ImageX::getPixelRGBA8 (int x, int y, Vec4F& c )
 void ImageX::setPixelBGR8(int x, int y, Vec4F c)
 {
   if (x >= 0 && y >= 0 && x < mXres && y < mYres) {
-    XBYTE* pix = (XBYTE*)(GetData() + (y * mXres + x) * 3);
+    XBYTE* pix = (XBYTE*)(GetData() + ((size_t) y * mXres + x) * 3);
     *pix++ = c.z * 255;
     *pix++ = c.y * 255;
     *pix++ = c.x * 255;
@@ -1121,17 +1333,17 @@ void ImageX::setPixelBGR8(int x, int y, Vec4F c)
 void ImageX::getPixelBGR8(int x, int y, Vec4F& c)
 {
   if (x >= 0 && y >= 0 && x < mXres && y < mYres) {
-    XBYTE* pix = (XBYTE*)(GetData() + (y * mXres + x) * 3);
+    XBYTE* pix = (XBYTE*)(GetData() + ((size_t) y * mXres + x) * 3);
     c.z = *pix++ / 255.0f;
     c.y = *pix++ / 255.0f;
-    c.z = *pix++ / 255.0f;
+    c.x = *pix++ / 255.0f;
     c.w = 1.0f;
   }
 }
 void ImageX::setPixelRGB16(int x, int y, Vec4F c)
 {
   if (x >= 0 && y >= 0 && x < mXres && y < mYres) {
-    XBYTE2* pix = (XBYTE2*)(GetData() + (y * mXres + x) * GetBytesPerPix());
+    XBYTE2* pix = (XBYTE2*)(GetData() + ((size_t) y * mXres + x) * GetBytesPerPix());
     *pix++ = c.x * 65535.0f;
     *pix++ = c.y * 65535.0f;
     *pix++ = c.z * 65535.0f;
@@ -1141,7 +1353,7 @@ void ImageX::setPixelRGB16(int x, int y, Vec4F c)
 void ImageX::getPixelRGB16(int x, int y, Vec4F& c)
 {
   if (x >= 0 && y >= 0 && x < mXres && y < mYres) {
-    XBYTE2* pix = (XBYTE2*)(GetData() + (y * mXres + x) * GetBytesPerPix());
+    XBYTE2* pix = (XBYTE2*)(GetData() + ((size_t) y * mXres + x) * GetBytesPerPix());
     c.x = *pix++ / 65535.0f;
     c.y = *pix++ / 65535.0f;
     c.z = *pix++ / 65535.0f;
@@ -1153,14 +1365,14 @@ void ImageX::getPixelRGB16(int x, int y, Vec4F& c)
 void ImageX::setPixelBW32(int x, int y, Vec4F c)
 {
   if (x >= 0 && y >= 0 && x < mXres && y < mYres) {
-    XBYTE4* pix = ((XBYTE4*)GetData()) + (y * mXres + x);	// XBYTE4 stride
+    uint32_t* pix = ((uint32_t*)GetData()) + ((size_t) y * mXres + x);	// uint32 stride
     *pix = c.x;
   }
 }
 void ImageX::getPixelBW32(int x, int y, Vec4F& c)
 {
   if (x >= 0 && y >= 0 && x < mXres && y < mYres) {
-    XBYTE4* pix = ((XBYTE4*)GetData()) + (y * mXres + x);	// XBYTE4 stride
+    uint32_t* pix = ((uint32_t*)GetData()) + ((size_t) y * mXres + x);	// uint32 stride
     c.x = *pix;
     c.y = 0; c.z = 0; c.w = 1;
   }
@@ -1168,14 +1380,14 @@ void ImageX::getPixelBW32(int x, int y, Vec4F& c)
 void ImageX::setPixelF32(int x, int y, Vec4F c)
 {
   if (x >= 0 && y >= 0 && x < mXres && y < mYres) {
-    float* pix = ((float*)GetData()) + (y * mXres + x);		// float stride
+    float* pix = ((float*)GetData()) + ((size_t) y * mXres + x);		// float stride
     *pix = c.x;
   }
 }
 void ImageX::getPixelF32(int x, int y, Vec4F& c)
 {
   if (x >= 0 && y >= 0 && x < mXres && y < mYres) {
-    float* pix = ((float*)GetData()) + (y * mXres + x);		// float stride
+    float* pix = ((float*)GetData()) + ((size_t) y * mXres + x);		// float stride
     c.x = *pix;
     c.y = 0; c.z = 0; c.w = 1;
   }
@@ -1184,7 +1396,7 @@ void ImageX::getPixelF32(int x, int y, Vec4F& c)
 void ImageX::setPixelRGBA32F (int x, int y, Vec4F c )
 {
 	if ( x>=0 && y>=0 && x < mXres && y < mYres ) {
-		float* pix = (float*) (GetData() + (y * mXres + x) * GetBytesPerPix() );
+		float* pix = (float*) (GetData() + ((size_t) y * mXres + x) * GetBytesPerPix() );
 		*pix++ = c.x;
 		*pix++ = c.y;
 		*pix++ = c.z;
@@ -1194,7 +1406,7 @@ void ImageX::setPixelRGBA32F (int x, int y, Vec4F c )
 void ImageX::getPixelRGBA32F (int x, int y, Vec4F& c )
 {
 	if ( x>=0 && y>=0 && x < mXres && y < mYres ) {
-		float* pix = (float*) (GetData() + (y * mXres + x) * GetBytesPerPix() );
+		float* pix = (float*) (GetData() + ((size_t) y * mXres + x) * GetBytesPerPix() );
     c.x = *pix++;
     c.y = *pix++;
     c.z = *pix++;
@@ -0,0 +1,193 @@
+//--------------------------------------------------------------------------------
+// Copyright 2007-2022 (c) Quanta Sciences, Rama Hoetzlein, ramakarl.com
+//
+// * Derivative works may append the above copyright notice but should not remove or modify earlier notices.
+//
+// MIT License:
+// Permission is hereby granted, free of charge, to any person obtaining a copy of this software and
+// associated documentation files (the "Software"), to deal in the Software without restriction, including without
+// limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software,
+// and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+// The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+// OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+// BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF
+// OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+//
+
+#include "imagex_blend.h"
+#include "imagex_convert.h"
+#include <string.h>
+
+#if defined(__x86_64__) || defined(_M_X64)
+	#define IMG_SIMD_X86
+	#include <immintrin.h>
+	#ifdef _MSC_VER
+		#define IMG_TARGET(isa)
+	#else
+		#define IMG_TARGET(isa)		__attribute__((target(isa)))
+	#endif
+#endif
+
+#define BLEND_CHUNK			64					// pixels per pass through the chunk buffers
+#define FILL_BLOCK			4096				// largest copy when doubling a fill
+
+//---------------------------------------- FILL
+
+void fillPixels ( XBYTE* dst, const XBYTE* pix, int bpp, int64_t cnt )
+{
+	if ( cnt <= 0 || bpp <= 0 ) return;
+	size_t total = (size_t) cnt * bpp;
+
+	bool same = true;
+	for ( int i = 1; i < bpp; i++ ) if ( pix[i] != pix[0] ) same = false;
+	if ( same ) {
+		memset ( dst, pix[0], total );
+		return;
+	}
+	// double the filled part, then repeat a block that stays in cache
+	memcpy ( dst, pix, bpp );
+	size_t done = bpp;
+	size_t block = bpp;
+	while ( done < total ) {
+		size_t n = ( block < total - done ) ? block : total - done;
+		memcpy ( dst + done, dst, n );
+		done += n;
+		if ( block < FILL_BLOCK ) block = done;
+	}
+}
+
+//---------------------------------------- RGBA8 OVER RGBA8
+//
+// x / 255, rounded, for x up to 255 * 255
+
+static inline int div255 ( int x )		{ x += 128; return ( x + ( x >> 8 ) ) >> 8; }
+
+template<bool P> static void over8 ( const XBYTE* s, XBYTE* d, int cnt )
+{
+	for ( int i = 0; i < cnt; i++, s += 4, d += 4 ) {
+		int a = s[3], ia = 255 - a;
+		if ( P ) {
+			for ( int c = 0; c < 4; c++ ) {
+				int v = s[c] + div255 ( d[c] * ia );
+				d[c] = ( v > 255 ) ? 255 : v;
+			}
+		} else {
+			d[0] = div255 ( s[0] * a + d[0] * ia );
+			d[1] = div255 ( s[1] * a + d[1] * ia );
+			d[2] = div255 ( s[2] * a + d[2] * ia );
+			d[3] = div255 ( 255 * a + d[3] * ia );
+		}
+	}
+}
+
+#ifdef IMG_SIMD_X86
+
+// Four pixels at a time in 16-bit lanes. Runs of fully clear or opaque source skip the math.
+template<bool P> IMG_TARGET("sse2") static void over8_sse2 ( const XBYTE* src, XBYTE* dst, int cnt )
+{
+	const __m128i z = _mm_setzero_si128 ();
+	const __m128i k255 = _mm_set1_epi16 ( 255 );
+	const __m128i r128 = _mm_set1_epi16 ( 128 );
+	const __m128i alane = _mm_setr_epi16 ( 0, 0, 0, 255, 0, 0, 0, 255 );		// straight: alpha lane blends 255, not a
+	const __m128i amask = _mm_set1_epi32 ( (int) 0xFF000000 );
+	int i = 0;
+	for ( ; i + 4 <= cnt; i += 4 ) {
+		__m128i s = _mm_loadu_si128 ( (const __m128i*) (src + i*4) );
+		__m128i al = _mm_and_si128 ( s, amask );
+		if ( _mm_movemask_epi8 ( _mm_cmpeq_epi32 ( al, amask ) ) == 0xFFFF ) {			// opaque
+			_mm_storeu_si128 ( (__m128i*) (dst + i*4), s );
+			continue;
+		}
+		if ( !P && _mm_movemask_epi8 ( _mm_cmpeq_epi32 ( al, z ) ) == 0xFFFF ) continue;	// clear
+
+		__m128i d = _mm_loadu_si128 ( (const __m128i*) (dst + i*4) );
+		__m128i r[2];
+		for ( int h = 0; h < 2; h++ ) {
+			__m128i s16 = h ? _mm_unpackhi_epi8 ( s, z ) : _mm_unpacklo_epi8 ( s, z );
+			__m128i d16 = h ? _mm_unpackhi_epi8 ( d, z ) : _mm_unpacklo_epi8 ( d, z );
+			__m128i a = _mm_shufflehi_epi16 ( _mm_shufflelo_epi16 ( s16, 0xFF ), 0xFF );
+			__m128i t = _mm_mullo_epi16 ( d16, _mm_sub_epi16 ( k255, a ) );
+			if ( !P ) t = _mm_add_epi16 ( t, _mm_mullo_epi16 ( _mm_or_si128 ( s16, alane ), a ) );
+			t = _mm_add_epi16 ( t, r128 );
+			r[h] = _mm_srli_epi16 ( _mm_add_epi16 ( t, _mm_srli_epi16 ( t, 8 ) ), 8 );
+		}
+		__m128i o = _mm_packus_epi16 ( r[0], r[1] );
+		if ( P ) o = _mm_adds_epu8 ( o, s );
+		_mm_storeu_si128 ( (__m128i*) (dst + i*4), o );
+	}
+	over8<P> ( src + i*4, dst + i*4, cnt - i );
+}
+
+#endif
+
+static void overRGBA8 ( const XBYTE* src, XBYTE* dst, int cnt, bool premul )
+{
+	#ifdef IMG_SIMD_X86
+		if ( premul ) over8_sse2<true> ( src, dst, cnt );
+		else over8_sse2<false> ( src, dst, cnt );
+	#else
+		if ( premul ) over8<true> ( src, dst, cnt );
+		else over8<false> ( src, dst, cnt );
+	#endif
+}
+
+//---------------------------------------- FLOAT
+
+static void overFloat ( const float* s, float* d, int cnt, bool premul )
+{
+	for ( int i = 0; i < cnt; i++, s += 4, d += 4 ) {
+		float ia = 1 - s[3];
+		if ( premul ) {
+			d[0] = s[0] + d[0] * ia;
+			d[1] = s[1] + d[1] * ia;
+			d[2] = s[2] + d[2] * ia;
+			d[3] = s[3] + d[3] * ia;
+		} else {
+			d[0] += ( s[0] - d[0] ) * s[3];
+			d[1] += ( s[1] - d[1] ) * s[3];
+			d[2] += ( s[2] - d[2] ) * s[3];
+			d[3] = s[3] + d[3] * ia;
+		}
+	}
+}
+
+bool compositeRow ( const XBYTE* src, ImageOp::Format sfmt, XBYTE* dst, ImageOp::Format dfmt, int cnt, bool premul )
+{
+	if ( sfmt == ImageOp::RGBA8 && dfmt == ImageOp::RGBA8 ) {
+		overRGBA8 ( src, dst, cnt, premul );
+		return true;
+	}
+	int sb = getFormatBytes ( sfmt );
+	int db = getFormatBytes ( dfmt );
+	if ( sb == 0 || db == 0 ) return false;
+
+	if ( sfmt == ImageOp::RGBA8 && ( dfmt == ImageOp::RGB8 || dfmt == ImageOp::BGR8 || dfmt == ImageOp::BW8 ) ) {
+		// 8-bit dest, expanded to RGBA8 a chunk at a time
+		funcRowConvert to = getRowConvert ( dfmt, ImageOp::RGBA8 );
+		funcRowConvert back = getRowConvert ( ImageOp::RGBA8, dfmt );
+		XBYTE buf[ BLEND_CHUNK * 4 ];
+		for ( int i = 0; i < cnt; i += BLEND_CHUNK ) {
+			int n = ( cnt - i < BLEND_CHUNK ) ? cnt - i : BLEND_CHUNK;
+			to ( dst + i * db, buf, n );
+			overRGBA8 ( src + i * 4, buf, n, premul );
+			back ( buf, dst + i * db, n );
+		}
+		return true;
+	}
+
+	funcRowConvert tos = getRowConvert ( sfmt, ImageOp::RGBA32F );
+	funcRowConvert tod = getRowConvert ( dfmt, ImageOp::RGBA32F );
+	funcRowConvert back = getRowConvert ( ImageOp::RGBA32F, dfmt );
+	if ( tos == 0x0 || tod == 0x0 || back == 0x0 ) return false;
+	float sbuf[ BLEND_CHUNK * 4 ], dbuf[ BLEND_CHUNK * 4 ];
+	for ( int i = 0; i < cnt; i += BLEND_CHUNK ) {
+		int n = ( cnt - i < BLEND_CHUNK ) ? cnt - i : BLEND_CHUNK;
+		tos ( src + i * sb, (XBYTE*) sbuf, n );
+		tod ( dst + i * db, (XBYTE*) dbuf, n );
+		overFloat ( sbuf, dbuf, n, premul );
+		back ( (XBYTE*) dbuf, dst + i * db, n );
+	}
+	return true;
+}
@@ -0,0 +1,600 @@
+//--------------------------------------------------------------------------------
+// Copyright 2007-2022 (c) Quanta Sciences, Rama Hoetzlein, ramakarl.com
+//
+// * Derivative works may append the above copyright notice but should not remove or modify earlier notices.
+//
+// MIT License:
+// Permission is hereby granted, free of charge, to any person obtaining a copy of this software and
+// associated documentation files (the "Software"), to deal in the Software without restriction, including without
+// limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software,
+// and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+// The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+// OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+// BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF
+// OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+//
+
+#include "imagex_convert.h"
+#include <string.h>
+
+#if defined(__x86_64__) || defined(_M_X64)
+	#define IMG_SIMD_X86
+	#include <immintrin.h>
+	#ifdef _MSC_VER
+		#include <intrin.h>
+		#define IMG_TARGET(isa)
+	#else
+		#define IMG_TARGET(isa)		__attribute__((target(isa)))
+	#endif
+#endif
+
+#define CVT_FMTS		ImageOp::Custom
+#define CVT_CHUNK		64					// pixels per pass through the float buffer
+
+static const float k255 = 1.0f / 255.0f;
+static const float k65535 = 1.0f / 65535.0f;
+
+//---------------------------------------- SCALAR
+//
+// SIMD kernels below do the same arithmetic in the same order, so results match exactly.
+
+static inline XBYTE cvtU8 ( float v )
+{
+	v = ( v < 0 ) ? 0 : ( v > 1 ) ? 1 : v;
+	return (XBYTE) (int) ( v * 255.0f + 0.5f );
+}
+static inline uint16_t cvtU16 ( float v )
+{
+	v = ( v < 0 ) ? 0 : ( v > 1 ) ? 1 : v;
+	return (uint16_t) (int) ( v * 65535.0f + 0.5f );
+}
+static inline uint32_t cvtU32 ( float v )
+{
+	v = ( v < 0 ) ? 0 : ( v > 4294967040.0f ) ? 4294967040.0f : v;		// largest float below 2^32
+	return (uint32_t) ( v + 0.5f );
+}
+static inline XBYTE luma8 ( int r, int g, int b )		{ return (XBYTE) ( ( 38*r + 75*g + 15*b + 64 ) >> 7 ); }
+static inline float lumaF ( const float* c )			{ return c[0] * 0.296875f + c[1] * 0.5859375f + c[2] * 0.1171875f; }
+
+// Format layouts. unpack/pack go through float RGBA, load8/store8 through 8-bit RGBA.
+template<int F> struct PixFmt;
+
+template<> struct PixFmt<ImageOp::BW8> {
+	static const int bytes = 1;
+	static void unpack ( const XBYTE* s, float* c, int n )	{ for (int i=0; i < n; i++, c+=4) { c[0] = c[1] = c[2] = s[i] * k255; c[3] = 1; } }
+	static void pack ( const float* c, XBYTE* d, int n )		{ for (int i=0; i < n; i++, c+=4) d[i] = cvtU8 ( lumaF (c) ); }
+	static void load8 ( const XBYTE* s, int& r, int& g, int& b, int& a )	{ r = g = b = s[0]; a = 255; }
+	static void store8 ( XBYTE* d, int r, int g, int b, int a )				{ d[0] = luma8 ( r, g, b ); }
+};
+template<> struct PixFmt<ImageOp::RGB8> {
+	static const int bytes = 3;
+	static void unpack ( const XBYTE* s, float* c, int n )	{ for (int i=0; i < n; i++, c+=4, s+=3) { c[0] = s[0] * k255; c[1] = s[1] * k255; c[2] = s[2] * k255; c[3] = 1; } }
+	static void pack ( const float* c, XBYTE* d, int n )		{ for (int i=0; i < n; i++, c+=4, d+=3) { d[0] = cvtU8 ( c[0] ); d[1] = cvtU8 ( c[1] ); d[2] = cvtU8 ( c[2] ); } }
+	static void load8 ( const XBYTE* s, int& r, int& g, int& b, int& a )	{ r = s[0]; g = s[1]; b = s[2]; a = 255; }
+	static void store8 ( XBYTE* d, int r, int g, int b, int a )				{ d[0] = r; d[1] = g; d[2] = b; }
+};
+template<> struct PixFmt<ImageOp::BGR8> {
+	static const int bytes = 3;
+	static void unpack ( const XBYTE* s, float* c, int n )	{ for (int i=0; i < n; i++, c+=4, s+=3) { c[0] = s[2] * k255; c[1] = s[1] * k255; c[2] = s[0] * k255; c[3] = 1; } }
+	static void pack ( const float* c, XBYTE* d, int n )		{ for (int i=0; i < n; i++, c+=4, d+=3) { d[0] = cvtU8 ( c[2] ); d[1] = cvtU8 ( c[1] ); d[2] = cvtU8 ( c[0] ); } }
+	static void load8 ( const XBYTE* s, int& r, int& g, int& b, int& a )	{ r = s[2]; g = s[1]; b = s[0]; a = 255; }
+	static void store8 ( XBYTE* d, int r, int g, int b, int a )				{ d[0] = b; d[1] = g; d[2] = r; }
+};
+template<> struct PixFmt<ImageOp::RGBA8> {
+	static const int bytes = 4;
+	static void unpack ( const XBYTE* s, float* c, int n )	{ for (int i=0; i < n*4; i++) c[i] = s[i] * k255; }
+	static void pack ( const float* c, XBYTE* d, int n )		{ for (int i=0; i < n*4; i++) d[i] = cvtU8 ( c[i] ); }
+	static void load8 ( const XBYTE* s, int& r, int& g, int& b, int& a )	{ r = s[0]; g = s[1]; b = s[2]; a = s[3]; }
+	static void store8 ( XBYTE* d, int r, int g, int b, int a )				{ d[0] = r; d[1] = g; d[2] = b; d[3] = a; }
+};
+template<> struct PixFmt<ImageOp::BW16> {
+	static const int bytes = 2;
+	static void unpack ( const XBYTE* s, float* c, int n )	{ const uint16_t* p = (const uint16_t*) s; for (int i=0; i < n; i++, c+=4) { c[0] = c[1] = c[2] = p[i] * k65535; c[3] = 1; } }
+	static void pack ( const float* c, XBYTE* d, int n )		{ uint16_t* p = (uint16_t*) d; for (int i=0; i < n; i++, c+=4) p[i] = cvtU16 ( lumaF (c) ); }
+};
+template<> struct PixFmt<ImageOp::RGB16> {
+	static const int bytes = 6;
+	static void unpack ( const XBYTE* s, float* c, int n )	{ const uint16_t* p = (const uint16_t*) s; for (int i=0; i < n; i++, c+=4, p+=3) { c[0] = p[0] * k65535; c[1] = p[1] * k65535; c[2] = p[2] * k65535; c[3] = 1; } }
+	static void pack ( const float* c, XBYTE* d, int n )		{ uint16_t* p = (uint16_t*) d; for (int i=0; i < n; i++, c+=4, p+=3) { p[0] = cvtU16 ( c[0] ); p[1] = cvtU16 ( c[1] ); p[2] = cvtU16 ( c[2] ); } }
+};
+template<> struct PixFmt<ImageOp::BW32> {
+	static const int bytes = 4;
+	static void unpack ( const XBYTE* s, float* c, int n )	{ const uint32_t* p = (const uint32_t*) s; for (int i=0; i < n; i++, c+=4) { c[0] = c[1] = c[2] = (float) p[i]; c[3] = 1; } }
+	static void pack ( const float* c, XBYTE* d, int n )		{ uint32_t* p = (uint32_t*) d; for (int i=0; i < n; i++, c+=4) p[i] = cvtU32 ( lumaF (c) ); }
+};
+template<> struct PixFmt<ImageOp::F32> {
+	static const int bytes = 4;
+	static void unpack ( const XBYTE* s, float* c, int n )	{ const float* p = (const float*) s; for (int i=0; i < n; i++, c+=4) { c[0] = c[1] = c[2] = p[i]; c[3] = 1; } }
+	static void pack ( const float* c, XBYTE* d, int n )		{ float* p = (float*) d; for (int i=0; i < n; i++, c+=4) p[i] = lumaF (c); }
+};
+template<> struct PixFmt<ImageOp::RGBA32F> {
+	static const int bytes = 16;
+	static void unpack ( const XBYTE* s, float* c, int n )	{ memcpy ( c, s, n * 16 ); }
+	static void pack ( const float* c, XBYTE* d, int n )		{ memcpy ( d, c, n * 16 ); }
+};
+
+// Any pair, through float RGBA. Each chunk is read before it is written, so it may run in place.
+template<int S, int D> static void cvtFloat ( const XBYTE* src, XBYTE* dst, int cnt )
+{
+	float buf[ 4 * CVT_CHUNK ];
+	while ( cnt > 0 ) {
+		int n = ( cnt < CVT_CHUNK ) ? cnt : CVT_CHUNK;
+		PixFmt<S>::unpack ( src, buf, n );
+		PixFmt<D>::pack ( buf, dst, n );
+		src += n * PixFmt<S>::bytes;
+		dst += n * PixFmt<D>::bytes;
+		cnt -= n;
+	}
+}
+
+// 8-bit pairs, one pixel at a time
+template<int S, int D> static void cvtBytes ( const XBYTE* src, XBYTE* dst, int cnt )
+{
+	int r, g, b, a;
+	for ( int i = 0; i < cnt; i++ ) {
+		PixFmt<S>::load8 ( src, r, g, b, a );
+		PixFmt<D>::store8 ( dst, r, g, b, a );
+		src += PixFmt<S>::bytes;
+		dst += PixFmt<D>::bytes;
+	}
+}
+
+template<int B> static void cvtCopy ( const XBYTE* src, XBYTE* dst, int cnt )
+{
+	if ( src != dst ) memmove ( dst, src, (size_t) cnt * B );
+}
+
+// Per channel conversions, n = channels
+static void ewU8toF32 ( const XBYTE* s, float* d, int n )		{ for (int i=0; i < n; i++) d[i] = s[i] * k255; }
+static void ewF32toU8 ( const float* s, XBYTE* d, int n )		{ for (int i=0; i < n; i++) d[i] = cvtU8 ( s[i] ); }
+static void ewU16toF32 ( const uint16_t* s, float* d, int n )		{ for (int i=0; i < n; i++) d[i] = s[i] * k65535; }
+static void ewF32toU16 ( const float* s, uint16_t* d, int n )		{ for (int i=0; i < n; i++) d[i] = cvtU16 ( s[i] ); }
+static void ewU8toU16 ( const XBYTE* s, uint16_t* d, int n )		{ for (int i=0; i < n; i++) d[i] = s[i] * 257; }
+static void ewU16toU8 ( const uint16_t* s, XBYTE* d, int n )		{ for (int i=0; i < n; i++) { int v = s[i] + 128; d[i] = ( v - (v >> 8) ) >> 8; } }		// v / 257, rounded
+
+template<int C> static void cvtU8toF32 ( const XBYTE* src, XBYTE* dst, int cnt )		{ ewU8toF32 ( src, (float*) dst, cnt * C ); }
+template<int C> static void cvtF32toU8 ( const XBYTE* src, XBYTE* dst, int cnt )		{ ewF32toU8 ( (const float*) src, dst, cnt * C ); }
+template<int C> static void cvtU16toF32 ( const XBYTE* src, XBYTE* dst, int cnt )		{ ewU16toF32 ( (const uint16_t*) src, (float*) dst, cnt * C ); }
+template<int C> static void cvtF32toU16 ( const XBYTE* src, XBYTE* dst, int cnt )		{ ewF32toU16 ( (const float*) src, (uint16_t*) dst, cnt * C ); }
+template<int C> static void cvtU8toU16 ( const XBYTE* src, XBYTE* dst, int cnt )		{ ewU8toU16 ( src, (uint16_t*) dst, cnt * C ); }
+template<int C> static void cvtU16toU8 ( const XBYTE* src, XBYTE* dst, int cnt )		{ ewU16toU8 ( (const uint16_t*) src, dst, cnt * C ); }
+
+#ifdef IMG_SIMD_X86
+
+//---------------------------------------- SSE2 / SSSE3
+//
+// Byte shuffles do 16 pixels per step. 3-byte pixels are regrouped as 4 registers of 4 pixels (12 bytes).
+// Each step loads all of its source before storing, and stores only its own dest bytes.
+
+#define M8(a,b,c,d,e,f,g,h,i,j,k,l,m,n,o,p)		_mm_setr_epi8 ( a,b,c,d,e,f,g,h,i,j,k,l,m,n,o,p )
+
+IMG_TARGET("ssse3") static inline void load3x16 ( const XBYTE* s, __m128i* g )
+{
+	__m128i a = _mm_loadu_si128 ( (const __m128i*) s );
+	__m128i b = _mm_loadu_si128 ( (const __m128i*) (s + 16) );
+	__m128i c = _mm_loadu_si128 ( (const __m128i*) (s + 32) );
+	g[0] = a;
+	g[1] = _mm_alignr_epi8 ( b, a, 12 );
+	g[2] = _mm_alignr_epi8 ( c, b, 8 );
+	g[3] = _mm_srli_si128 ( c, 4 );
+}
+// g holds 12 bytes each, upper 4 bytes zero
+IMG_TARGET("ssse3") static inline void store3x16 ( XBYTE* d, const __m128i* g )
+{
+	_mm_storeu_si128 ( (__m128i*) d,				_mm_or_si128 ( g[0], _mm_slli_si128 ( g[1], 12 ) ) );
+	_mm_storeu_si128 ( (__m128i*) (d + 16), _mm_or_si128 ( _mm_srli_si128 ( g[1], 4 ), _mm_slli_si128 ( g[2], 8 ) ) );
+	_mm_storeu_si128 ( (__m128i*) (d + 32), _mm_or_si128 ( _mm_srli_si128 ( g[2], 8 ), _mm_slli_si128 ( g[3], 4 ) ) );
+}
+
+// RGB8, BGR8 -> RGBA8
+template<int S> IMG_TARGET("ssse3") static void cvt3to4_ssse3 ( const XBYTE* src, XBYTE* dst, int cnt )
+{
+	const __m128i m = ( S == ImageOp::BGR8 ) ? M8 ( 2,1,0,-1, 5,4,3,-1, 8,7,6,-1, 11,10,9,-1 ) : M8 ( 0,1,2,-1, 3,4,5,-1, 6,7,8,-1, 9,10,11,-1 );
+	const __m128i alpha = _mm_set1_epi32 ( (int) 0xFF000000 );
+	__m128i g[4];
+	int i = 0;
+	for ( ; i + 16 <= cnt; i += 16 ) {
+		load3x16 ( src + i*3, g );
+		for (int k=0; k < 4; k++)
+			_mm_storeu_si128 ( (__m128i*) (dst + i*4 + k*16), _mm_or_si128 ( _mm_shuffle_epi8 ( g[k], m ), alpha ) );
+	}
+	cvtBytes<S, ImageOp::RGBA8> ( src + i*3, dst + i*4, cnt - i );
+}
+
+// RGBA8 -> RGB8, BGR8
+template<int D> IMG_TARGET("ssse3") static void cvt4to3_ssse3 ( const XBYTE* src, XBYTE* dst, int cnt )
+{
+	const __m128i m = ( D == ImageOp::BGR8 ) ? M8 ( 2,1,0, 6,5,4, 10,9,8, 14,13,12, -1,-1,-1,-1 ) : M8 ( 0,1,2, 4,5,6, 8,9,10, 12,13,14, -1,-1,-1,-1 );
+	__m128i g[4];
+	int i = 0;
+	for ( ; i + 16 <= cnt; i += 16 ) {
+		for (int k=0; k < 4; k++)
+			g[k] = _mm_shuffle_epi8 ( _mm_loadu_si128 ( (const __m128i*) (src + i*4 + k*16) ), m );
+		store3x16 ( dst + i*3, g );
+	}
+	cvtBytes<ImageOp::RGBA8, D> ( src + i*4, dst + i*3, cnt - i );
+}
+
+// RGB8 <-> BGR8
+template<int S, int D> IMG_TARGET("ssse3") static void cvtSwap3_ssse3 ( const XBYTE* src, XBYTE* dst, int cnt )
+{
+	const __m128i m = M8 ( 2,1,0, 5,4,3, 8,7,6, 11,10,9, -1,-1,-1,-1 );
+	__m128i g[4];
+	int i = 0;
+	for ( ; i + 16 <= cnt; i += 16 ) {
+		load3x16 ( src + i*3, g );
+		for (int k=0; k < 4; k++) g[k] = _mm_shuffle_epi8 ( g[k], m );
+		store3x16 ( dst + i*3, g );
+	}
+	cvtBytes<S, D> ( src + i*3, dst + i*3, cnt - i );
+}
+
+// BW8 -> RGB8, BGR8
+template<int D> IMG_TARGET("ssse3") static void cvtGrayTo3_ssse3 ( const XBYTE* src, XBYTE* dst, int cnt )
+{
+	const __m128i m0 = M8 ( 0,0,0, 1,1,1, 2,2,2, 3,3,3, 4,4,4, 5 );
+	const __m128i m1 = M8 ( 5,5, 6,6,6, 7,7,7, 8,8,8, 9,9,9, 10,10 );
+	const __m128i m2 = M8 ( 10, 11,11,11, 12,12,12, 13,13,13, 14,14,14, 15,15,15 );
+	int i = 0;
+	for ( ; i + 16 <= cnt; i += 16 ) {
+		__m128i v = _mm_loadu_si128 ( (const __m128i*) (src + i) );
+		_mm_storeu_si128 ( (__m128i*) (dst + i*3),		  _mm_shuffle_epi8 ( v, m0 ) );
+		_mm_storeu_si128 ( (__m128i*) (dst + i*3 + 16), _mm_shuffle_epi8 ( v, m1 ) );
+		_mm_storeu_si128 ( (__m128i*) (dst + i*3 + 32), _mm_shuffle_epi8 ( v, m2 ) );
+	}
+	cvtBytes<ImageOp::BW8, D> ( src + i, dst + i*3, cnt - i );
+}
+
+// BW8 -> RGBA8
+IMG_TARGET("ssse3") static void cvtGrayTo4_ssse3 ( const XBYTE* src, XBYTE* dst, int cnt )
+{
+	const __m128i m[4] = { M8 ( 0,0,0,-1, 1,1,1,-1, 2,2,2,-1, 3,3,3,-1 ),			M8 ( 4,4,4,-1, 5,5,5,-1, 6,6,6,-1, 7,7,7,-1 ),
+												 M8 ( 8,8,8,-1, 9,9,9,-1, 10,10,10,-1, 11,11,11,-1 ),	M8 ( 12,12,12,-1, 13,13,13,-1, 14,14,14,-1, 15,15,15,-1 ) };
+	const __m128i alpha = _mm_set1_epi32 ( (int) 0xFF000000 );
+	int i = 0;
+	for ( ; i + 16 <= cnt; i += 16 ) {
+		__m128i v = _mm_loadu_si128 ( (const __m128i*) (src + i) );
+		for (int k=0; k < 4; k++)
+			_mm_storeu_si128 ( (__m128i*) (dst + i*4 + k*16), _mm_or_si128 ( _mm_shuffle_epi8 ( v, m[k] ), alpha ) );
+	}
+	cvtBytes<ImageOp::BW8, ImageOp::RGBA8> ( src + i, dst + i*4, cnt - i );
+}
+
+// RGB8, BGR8, RGBA8 -> BW8 (luma)
+// pmaddubsw gives 38r+75g and 15b per pixel, phaddw sums them.
+template<int S> IMG_TARGET("ssse3") static void cvtToGray_ssse3 ( const XBYTE* src, XBYTE* dst, int cnt )
+{
+	const int sb = PixFmt<S>::bytes;
+	const __m128i m = ( S == ImageOp::BGR8 ) ? M8 ( 2,1,0,-1, 5,4,3,-1, 8,7,6,-1, 11,10,9,-1 ) : M8 ( 0,1,2,-1, 3,4,5,-1, 6,7,8,-1, 9,10,11,-1 );
+	const __m128i w = _mm_set1_epi32 ( 0x000F4B26 );		// 38, 75, 15, 0
+	const __m128i rnd = _mm_set1_epi16 ( 64 );
+	__m128i p[4];
+	int i = 0;
+	for ( ; i + 16 <= cnt; i += 16 ) {
+		if ( sb == 4 ) {
+			for (int k=0; k < 4; k++) p[k] = _mm_loadu_si128 ( (const __m128i*) (src + i*4 + k*16) );
+		} else {
+			load3x16 ( src + i*3, p );
+			for (int k=0; k < 4; k++) p[k] = _mm_shuffle_epi8 ( p[k], m );
+		}
+		__m128i s0 = _mm_hadd_epi16 ( _mm_maddubs_epi16 ( p[0], w ), _mm_maddubs_epi16 ( p[1], w ) );
+		__m128i s1 = _mm_hadd_epi16 ( _mm_maddubs_epi16 ( p[2], w ), _mm_maddubs_epi16 ( p[3], w ) );
+		s0 = _mm_srli_epi16 ( _mm_add_epi16 ( s0, rnd ), 7 );
+		s1 = _mm_srli_epi16 ( _mm_add_epi16 ( s1, rnd ), 7 );
+		_mm_storeu_si128 ( (__m128i*) (dst + i), _mm_packus_epi16 ( s0, s1 ) );
+	}
+	cvtBytes<S, ImageOp::BW8> ( src + i*sb, dst + i, cnt - i );
+}
+
+// Per channel, SSE2
+IMG_TARGET("sse2") static void ewU8toF32_sse2 ( const XBYTE* s, float* d, int n )
+{
+	const __m128 k = _mm_set1_ps ( k255 );
+	const __m128i z = _mm_setzero_si128 ();
+	int i = 0;
+	for ( ; i + 16 <= n; i += 16 ) {
+		__m128i v = _mm_loadu_si128 ( (const __m128i*) (s + i) );
+		__m128i lo = _mm_unpacklo_epi8 ( v, z ), hi = _mm_unpackhi_epi8 ( v, z );
+		_mm_storeu_ps ( d + i,		 _mm_mul_ps ( _mm_cvtepi32_ps ( _mm_unpacklo_epi16 ( lo, z ) ), k ) );
+		_mm_storeu_ps ( d + i + 4,  _mm_mul_ps ( _mm_cvtepi32_ps ( _mm_unpackhi_epi16 ( lo, z ) ), k ) );
+		_mm_storeu_ps ( d + i + 8,  _mm_mul_ps ( _mm_cvtepi32_ps ( _mm_unpacklo_epi16 ( hi, z ) ), k ) );
+		_mm_storeu_ps ( d + i + 12, _mm_mul_ps ( _mm_cvtepi32_ps ( _mm_unpackhi_epi16 ( hi, z ) ), k ) );
+	}
+	ewU8toF32 ( s + i, d + i, n - i );
+}
+IMG_TARGET("sse2") static inline __m128i clampScale_sse2 ( const float* s, __m128 scale )
+{
+	__m128 v = _mm_max_ps ( _mm_min_ps ( _mm_loadu_ps ( s ), _mm_set1_ps ( 1.0f ) ), _mm_setzero_ps () );
+	return _mm_cvttps_epi32 ( _mm_add_ps ( _mm_mul_ps ( v, scale ), _mm_set1_ps ( 0.5f ) ) );
+}
+IMG_TARGET("sse2") static void ewF32toU8_sse2 ( const float* s, XBYTE* d, int n )
+{
+	const __m128 scale = _mm_set1_ps ( 255.0f );
+	int i = 0;
+	for ( ; i + 16 <= n; i += 16 ) {
+		__m128i a = _mm_packs_epi32 ( clampScale_sse2 ( s + i, scale ), clampScale_sse2 ( s + i + 4, scale ) );
+		__m128i b = _mm_packs_epi32 ( clampScale_sse2 ( s + i + 8, scale ), clampScale_sse2 ( s + i + 12, scale ) );
+		_mm_storeu_si128 ( (__m128i*) (d + i), _mm_packus_epi16 ( a, b ) );
+	}
+	ewF32toU8 ( s + i, d + i, n - i );
+}
+IMG_TARGET("sse2") static void ewU16toF32_sse2 ( const uint16_t* s, float* d, int n )
+{
+	const __m128 k = _mm_set1_ps ( k65535 );
+	const __m128i z = _mm_setzero_si128 ();
+	int i = 0;
+	for ( ; i + 8 <= n; i += 8 ) {
+		__m128i v = _mm_loadu_si128 ( (const __m128i*) (s + i) );
+		_mm_storeu_ps ( d + i,		_mm_mul_ps ( _mm_cvtepi32_ps ( _mm_unpacklo_epi16 ( v, z ) ), k ) );
+		_mm_storeu_ps ( d + i + 4, _mm_mul_ps ( _mm_cvtepi32_ps ( _mm_unpackhi_epi16 ( v, z ) ), k ) );
+	}
+	ewU16toF32 ( s + i, d + i, n - i );
+}
+IMG_TARGET("sse2") static void ewF32toU16_sse2 ( const float* s, uint16_t* d, int n )
+{
+	const __m128 scale = _mm_set1_ps ( 65535.0f );
+	const __m128i bias = _mm_set1_epi32 ( 32768 );
+	const __m128i flip = _mm_set1_epi16 ( (short) 0x8000 );
+	int i = 0;
+	for ( ; i + 8 <= n; i += 8 ) {
+		__m128i a = _mm_sub_epi32 ( clampScale_sse2 ( s + i, scale ), bias );			// no unsigned pack in sse2, pack signed and flip
+		__m128i b = _mm_sub_epi32 ( clampScale_sse2 ( s + i + 4, scale ), bias );
+		_mm_storeu_si128 ( (__m128i*) (d + i), _mm_xor_si128 ( _mm_packs_epi32 ( a, b ), flip ) );
+	}
+	ewF32toU16 ( s + i, d + i, n - i );
+}
+IMG_TARGET("sse2") static void ewU8toU16_sse2 ( const XBYTE* s, uint16_t* d, int n )
+{
+	int i = 0;
+	for ( ; i + 16 <= n; i += 16 ) {
+		__m128i v = _mm_loadu_si128 ( (const __m128i*) (s + i) );
+		_mm_storeu_si128 ( (__m128i*) (d + i),		_mm_unpacklo_epi8 ( v, v ) );		// v * 257
+		_mm_storeu_si128 ( (__m128i*) (d + i + 8), _mm_unpackhi_epi8 ( v, v ) );
+	}
+	ewU8toU16 ( s + i, d + i, n - i );
+}
+IMG_TARGET("sse2") static void ewU16toU8_sse2 ( const uint16_t* s, XBYTE* d, int n )
+{
+	const __m128i rnd = _mm_set1_epi16 ( 128 );
+	int i = 0;
+	for ( ; i + 16 <= n; i += 16 ) {
+		__m128i a = _mm_loadu_si128 ( (const __m128i*) (s + i) );
+		__m128i b = _mm_loadu_si128 ( (const __m128i*) (s + i + 8) );
+		a = _mm_adds_epu16 ( a, rnd );				// saturates only where the result is 255 anyway
+		b = _mm_adds_epu16 ( b, rnd );
+		a = _mm_srli_epi16 ( _mm_sub_epi16 ( a, _mm_srli_epi16 ( a, 8 ) ), 8 );
+		b = _mm_srli_epi16 ( _mm_sub_epi16 ( b, _mm_srli_epi16 ( b, 8 ) ), 8 );
+		_mm_storeu_si128 ( (__m128i*) (d + i), _mm_packus_epi16 ( a, b ) );
+	}
+	ewU16toU8 ( s + i, d + i, n - i );
+}
+
+template<int C> static void cvtU8toF32_sse2 ( const XBYTE* src, XBYTE* dst, int cnt )		{ ewU8toF32_sse2 ( src, (float*) dst, cnt * C ); }
+template<int C> static void cvtF32toU8_sse2 ( const XBYTE* src, XBYTE* dst, int cnt )		{ ewF32toU8_sse2 ( (const float*) src, dst, cnt * C ); }
+template<int C> static void cvtU16toF32_sse2 ( const XBYTE* src, XBYTE* dst, int cnt )		{ ewU16toF32_sse2 ( (const uint16_t*) src, (float*) dst, cnt * C ); }
+template<int C> static void cvtF32toU16_sse2 ( const XBYTE* src, XBYTE* dst, int cnt )		{ ewF32toU16_sse2 ( (const float*) src, (uint16_t*) dst, cnt * C ); }
+template<int C> static void cvtU8toU16_sse2 ( const XBYTE* src, XBYTE* dst, int cnt )		{ ewU8toU16_sse2 ( src, (uint16_t*) dst, cnt * C ); }
+template<int C> static void cvtU16toU8_sse2 ( const XBYTE* src, XBYTE* dst, int cnt )		{ ewU16toU8_sse2 ( (const uint16_t*) src, dst, cnt * C ); }
+
+//---------------------------------------- AVX2
+//
+// Float conversions, 8 channels per register. Byte shuffles stay on SSSE3, 3-byte pixels
+// do not split evenly across the 128-bit lanes of pshufb.
+
+IMG_TARGET("avx2") static void ewU8toF32_avx2 ( const XBYTE* s, float* d, int n )
+{
+	const __m256 k = _mm256_set1_ps ( k255 );
+	int i = 0;
+	for ( ; i + 32 <= n; i += 32 ) {
+		for (int j=0; j < 32; j += 8)
+			_mm256_storeu_ps ( d + i + j, _mm256_mul_ps ( _mm256_cvtepi32_ps ( _mm256_cvtepu8_epi32 ( _mm_loadl_epi64 ( (const __m128i*) (s + i + j) ) ) ), k ) );
+	}
+	ewU8toF32 ( s + i, d + i, n - i );
+}
+IMG_TARGET("avx2") static inline __m256i clampScale_avx2 ( const float* s, __m256 scale )
+{
+	__m256 v = _mm256_max_ps ( _mm256_min_ps ( _mm256_loadu_ps ( s ), _mm256_set1_ps ( 1.0f ) ), _mm256_setzero_ps () );
+	return _mm256_cvttps_epi32 ( _mm256_add_ps ( _mm256_mul_ps ( v, scale ), _mm256_set1_ps ( 0.5f ) ) );
+}
+IMG_TARGET("avx2") static void ewF32toU8_avx2 ( const float* s, XBYTE* d, int n )
+{
+	const __m256 scale = _mm256_set1_ps ( 255.0f );
+	const __m256i order = _mm256_setr_epi32 ( 0, 4, 1, 5, 2, 6, 3, 7 );		// packs interleave lanes
+	int i = 0;
+	for ( ; i + 32 <= n; i += 32 ) {
+		__m256i a = _mm256_packs_epi32 ( clampScale_avx2 ( s + i, scale ), clampScale_avx2 ( s + i + 8, scale ) );
+		__m256i b = _mm256_packs_epi32 ( clampScale_avx2 ( s + i + 16, scale ), clampScale_avx2 ( s + i + 24, scale ) );
+		_mm256_storeu_si256 ( (__m256i*) (d + i), _mm256_permutevar8x32_epi32 ( _mm256_packus_epi16 ( a, b ), order ) );
+	}
+	ewF32toU8 ( s + i, d + i, n - i );
+}
+IMG_TARGET("avx2") static void ewU16toF32_avx2 ( const uint16_t* s, float* d, int n )
+{
+	const __m256 k = _mm256_set1_ps ( k65535 );
+	int i = 0;
+	for ( ; i + 16 <= n; i += 16 ) {
+		_mm256_storeu_ps ( d + i,		 _mm256_mul_ps ( _mm256_cvtepi32_ps ( _mm256_cvtepu16_epi32 ( _mm_loadu_si128 ( (const __m128i*) (s + i) ) ) ), k ) );
+		_mm256_storeu_ps ( d + i + 8, _mm256_mul_ps ( _mm256_cvtepi32_ps ( _mm256_cvtepu16_epi32 ( _mm_loadu_si128 ( (const __m128i*) (s + i + 8) ) ) ), k ) );
+	}
+	ewU16toF32 ( s + i, d + i, n - i );
+}
+IMG_TARGET("avx2") static void ewF32toU16_avx2 ( const float* s, uint16_t* d, int n )
+{
+	const __m256 scale = _mm256_set1_ps ( 65535.0f );
+	int i = 0;
+	for ( ; i + 16 <= n; i += 16 ) {
+		__m256i v = _mm256_packus_epi32 ( clampScale_avx2 ( s + i, scale ), clampScale_avx2 ( s + i + 8, scale ) );
+		_mm256_storeu_si256 ( (__m256i*) (d + i), _mm256_permute4x64_epi64 ( v, _MM_SHUFFLE ( 3, 1, 2, 0 ) ) );
+	}
+	ewF32toU16 ( s + i, d + i, n - i );
+}
+
+template<int C> static void cvtU8toF32_avx2 ( const XBYTE* src, XBYTE* dst, int cnt )		{ ewU8toF32_avx2 ( src, (float*) dst, cnt * C ); }
+template<int C> static void cvtF32toU8_avx2 ( const XBYTE* src, XBYTE* dst, int cnt )		{ ewF32toU8_avx2 ( (const float*) src, dst, cnt * C ); }
+template<int C> static void cvtU16toF32_avx2 ( const XBYTE* src, XBYTE* dst, int cnt )		{ ewU16toF32_avx2 ( (const uint16_t*) src, (float*) dst, cnt * C ); }
+template<int C> static void cvtF32toU16_avx2 ( const XBYTE* src, XBYTE* dst, int cnt )		{ ewF32toU16_avx2 ( (const float*) src, (uint16_t*) dst, cnt * C ); }
+
+#endif
+
+//---------------------------------------- DISPATCH
+//
+
+static int getCpuLevel ()
+{
+	#ifdef IMG_SIMD_X86
+		#ifdef _MSC_VER
+			int info[4];
+			__cpuid ( info, 1 );
+			if ( !( info[2] & (1 << 9) ) ) return IMG_SIMD_NONE;			// ssse3
+			bool ymm = ( info[2] & (1 << 27) ) && ( info[2] & (1 << 28) ) && ( ( _xgetbv ( 0 ) & 6 ) == 6 );	// osxsave, avx, os saves ymm
+			__cpuidex ( info, 7, 0 );
+			return ( ymm && ( info[1] & (1 << 5) ) ) ? IMG_SIMD_AVX2 : IMG_SIMD_SSSE3;
+		#else
+			__builtin_cpu_init ();
+			if ( !__builtin_cpu_supports ( "ssse3" ) ) return IMG_SIMD_NONE;
+			return __builtin_cpu_supports ( "avx2" ) ? IMG_SIMD_AVX2 : IMG_SIMD_SSSE3;
+		#endif
+	#else
+		return IMG_SIMD_NONE;
+	#endif
+}
+
+typedef funcRowConvert RowTable[ CVT_FMTS ][ CVT_FMTS ];
+
+template<int S> static void setFloatRow ( RowTable& t )
+{
+	t[S][ImageOp::BW8]		 = &cvtFloat<S, ImageOp::BW8>;
+	t[S][ImageOp::BW16]		 = &cvtFloat<S, ImageOp::BW16>;
+	t[S][ImageOp::BW32]		 = &cvtFloat<S, ImageOp::BW32>;
+	t[S][ImageOp::RGB8]		 = &cvtFloat<S, ImageOp::RGB8>;
+	t[S][ImageOp::RGBA8]	 = &cvtFloat<S, ImageOp::RGBA8>;
+	t[S][ImageOp::RGB16]	 = &cvtFloat<S, ImageOp::RGB16>;
+	t[S][ImageOp::RGBA32F] = &cvtFloat<S, ImageOp::RGBA32F>;
+	t[S][ImageOp::BGR8]		 = &cvtFloat<S, ImageOp::BGR8>;
+	t[S][ImageOp::F32]		 = &cvtFloat<S, ImageOp::F32>;
+	t[S][S]								 = &cvtCopy< PixFmt<S>::bytes >;
+}
+template<int S> static void setByteRow ( RowTable& t )
+{
+	t[S][ImageOp::BW8]		 = &cvtBytes<S, ImageOp::BW8>;
+	t[S][ImageOp::RGB8]		 = &cvtBytes<S, ImageOp::RGB8>;
+	t[S][ImageOp::RGBA8]	 = &cvtBytes<S, ImageOp::RGBA8>;
+	t[S][ImageOp::BGR8]		 = &cvtBytes<S, ImageOp::BGR8>;
+	t[S][S]								 = &cvtCopy< PixFmt<S>::bytes >;
+}
+
+struct RowConvertTables {
+	RowConvertTables ();
+	int				best;
+	RowTable	level[3];
+};
+
+RowConvertTables::RowConvertTables ()
+{
+	best = getCpuLevel ();
+	RowTable& t = level[ IMG_SIMD_NONE ];
+	memset ( &t, 0, sizeof(RowTable) );
+
+	// all pairs
+	setFloatRow<ImageOp::BW8> ( t );
+	setFloatRow<ImageOp::BW16> ( t );
+	setFloatRow<ImageOp::BW32> ( t );
+	setFloatRow<ImageOp::RGB8> ( t );
+	setFloatRow<ImageOp::RGBA8> ( t );
+	setFloatRow<ImageOp::RGB16> ( t );
+	setFloatRow<ImageOp::RGBA32F> ( t );
+	setFloatRow<ImageOp::BGR8> ( t );
+	setFloatRow<ImageOp::F32> ( t );
+
+	// direct pairs
+	setByteRow<ImageOp::BW8> ( t );
+	setByteRow<ImageOp::RGB8> ( t );
+	setByteRow<ImageOp::RGBA8> ( t );
+	setByteRow<ImageOp::BGR8> ( t );
+	t[ImageOp::BW8][ImageOp::F32]				= &cvtU8toF32<1>;
+	t[ImageOp::RGBA8][ImageOp::RGBA32F] = &cvtU8toF32<4>;
+	t[ImageOp::F32][ImageOp::BW8]				= &cvtF32toU8<1>;
+	t[ImageOp::RGBA32F][ImageOp::RGBA8] = &cvtF32toU8<4>;
+	t[ImageOp::BW16][ImageOp::F32]			= &cvtU16toF32<1>;
+	t[ImageOp::F32][ImageOp::BW16]			= &cvtF32toU16<1>;
+	t[ImageOp::BW8][ImageOp::BW16]			= &cvtU8toU16<1>;
+	t[ImageOp::RGB8][ImageOp::RGB16]		= &cvtU8toU16<3>;
+	t[ImageOp::BW16][ImageOp::BW8]			= &cvtU16toU8<1>;
+	t[ImageOp::RGB16][ImageOp::RGB8]		= &cvtU16toU8<3>;
+
+	#ifdef IMG_SIMD_X86
+		RowTable& s = level[ IMG_SIMD_SSSE3 ];
+		memcpy ( &s, &t, sizeof(RowTable) );
+		s[ImageOp::RGB8][ImageOp::RGBA8]		= &cvt3to4_ssse3<ImageOp::RGB8>;
+		s[ImageOp::BGR8][ImageOp::RGBA8]		= &cvt3to4_ssse3<ImageOp::BGR8>;
+		s[ImageOp::RGBA8][ImageOp::RGB8]		= &cvt4to3_ssse3<ImageOp::RGB8>;
+		s[ImageOp::RGBA8][ImageOp::BGR8]		= &cvt4to3_ssse3<ImageOp::BGR8>;
+		s[ImageOp::RGB8][ImageOp::BGR8]			= &cvtSwap3_ssse3<ImageOp::RGB8, ImageOp::BGR8>;
+		s[ImageOp::BGR8][ImageOp::RGB8]			= &cvtSwap3_ssse3<ImageOp::BGR8, ImageOp::RGB8>;
+		s[ImageOp::BW8][ImageOp::RGB8]			= &cvtGrayTo3_ssse3<ImageOp::RGB8>;
+		s[ImageOp::BW8][ImageOp::BGR8]			= &cvtGrayTo3_ssse3<ImageOp::BGR8>;
+		s[ImageOp::BW8][ImageOp::RGBA8]			= &cvtGrayTo4_ssse3;
+		s[ImageOp::RGB8][ImageOp::BW8]			= &cvtToGray_ssse3<ImageOp::RGB8>;
+		s[ImageOp::BGR8][ImageOp::BW8]			= &cvtToGray_ssse3<ImageOp::BGR8>;
+		s[ImageOp::RGBA8][ImageOp::BW8]			= &cvtToGray_ssse3<ImageOp::RGBA8>;
+		s[ImageOp::BW8][ImageOp::F32]				= &cvtU8toF32_sse2<1>;
+		s[ImageOp::RGBA8][ImageOp::RGBA32F] = &cvtU8toF32_sse2<4>;
+		s[ImageOp::F32][ImageOp::BW8]				= &cvtF32toU8_sse2<1>;
+		s[ImageOp::RGBA32F][ImageOp::RGBA8] = &cvtF32toU8_sse2<4>;
+		s[ImageOp::BW16][ImageOp::F32]			= &cvtU16toF32_sse2<1>;
+		s[ImageOp::F32][ImageOp::BW16]			= &cvtF32toU16_sse2<1>;
+		s[ImageOp::BW8][ImageOp::BW16]			= &cvtU8toU16_sse2<1>;
+		s[ImageOp::RGB8][ImageOp::RGB16]		= &cvtU8toU16_sse2<3>;
+		s[ImageOp::BW16][ImageOp::BW8]			= &cvtU16toU8_sse2<1>;
+		s[ImageOp::RGB16][ImageOp::RGB8]		= &cvtU16toU8_sse2<3>;
+
+		RowTable& a = level[ IMG_SIMD_AVX2 ];
+		memcpy ( &a, &s, sizeof(RowTable) );
+		a[ImageOp::BW8][ImageOp::F32]				= &cvtU8toF32_avx2<1>;
+		a[ImageOp::RGBA8][ImageOp::RGBA32F] = &cvtU8toF32_avx2<4>;
+		a[ImageOp::F32][ImageOp::BW8]				= &cvtF32toU8_avx2<1>;
+		a[ImageOp::RGBA32F][ImageOp::RGBA8] = &cvtF32toU8_avx2<4>;
+		a[ImageOp::BW16][ImageOp::F32]			= &cvtU16toF32_avx2<1>;
+		a[ImageOp::F32][ImageOp::BW16]			= &cvtF32toU16_avx2<1>;
+	#else
+		memcpy ( &level[ IMG_SIMD_SSSE3 ], &t, sizeof(RowTable) );
+		memcpy ( &level[ IMG_SIMD_AVX2 ], &t, sizeof(RowTable) );
+	#endif
+}
+
+static RowConvertTables& getTables ()
+{
+	static RowConvertTables tables;				// built once, on first use
+	return tables;
+}
+
+int getRowConvertLevel ()
+{
+	return getTables().best;
+}
+
+funcRowConvert getRowConvert ( ImageOp::Format src, ImageOp::Format dst, int level )
+{
+	RowConvertTables& t = getTables ();
+	if ( src <= ImageOp::FmtNone || src >= CVT_FMTS || dst <= ImageOp::FmtNone || dst >= CVT_FMTS ) return 0x0;
+	if ( level < 0 || level > t.best ) level = t.best;
+	return t.level[ level ][ src ][ dst ];
+}
+
+int getFormatBytes ( ImageOp::Format fmt )
+{
+	switch ( fmt ) {
+	case ImageOp::BW8:		return PixFmt<ImageOp::BW8>::bytes;
+	case ImageOp::BW16:		return PixFmt<ImageOp::BW16>::bytes;
+	case ImageOp::BW32:		return PixFmt<ImageOp::BW32>::bytes;
+	case ImageOp::RGB8:		return PixFmt<ImageOp::RGB8>::bytes;
+	case ImageOp::RGBA8:	return PixFmt<ImageOp::RGBA8>::bytes;
+	case ImageOp::RGB16:	return PixFmt<ImageOp::RGB16>::bytes;
+	case ImageOp::RGBA32F:	return PixFmt<ImageOp::RGBA32F>::bytes;
+	case ImageOp::BGR8:		return PixFmt<ImageOp::BGR8>::bytes;
+	case ImageOp::F32:		return PixFmt<ImageOp::F32>::bytes;
+	default:				return 0;
+	}
+}
@@ -0,0 +1,573 @@
+//--------------------------------------------------------------------------------
+// Copyright 2007-2022 (c) Quanta Sciences, Rama Hoetzlein, ramakarl.com
+//
+// * Derivative works may append the above copyright notice but should not remove or modify earlier notices.
+//
+// MIT License:
+// Permission is hereby granted, free of charge, to any person obtaining a copy of this software and
+// associated documentation files (the "Software"), to deal in the Software without restriction, including without
+// limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software,
+// and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+// The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+// OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+// BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF
+// OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+//
+
+#include "imagex_resample.h"
+#include "imagex_convert.h"
+#include <string.h>
+#include <math.h>
+#include <vector>
+#include <thread>
+#include <atomic>
+#include <algorithm>
+
+#if defined(__x86_64__) || defined(_M_X64)
+	#define IMG_SIMD_X86
+	#include <immintrin.h>
+	#ifdef _MSC_VER
+		#define IMG_TARGET(isa)
+	#else
+		#define IMG_TARGET(isa)		__attribute__((target(isa)))
+	#endif
+#endif
+
+#define RESAMPLE_BAND		64					// source rows per job, roughly
+#define RESAMPLE_MIN_BAND	4					// dest rows per job, at least
+#define RESAMPLE_MIN_PIX	( 256 * 256 )		// smaller outputs run on the calling thread
+
+//---------------------------------------- FILTERS
+
+static float filterBox ( float x )			{ return ( x >= -0.5f && x < 0.5f ) ? 1.0f : 0.0f; }
+static float filterTent ( float x )			{ x = fabsf ( x ); return ( x < 1 ) ? 1 - x : 0; }
+static float filterCubic ( float x )		// Catmull-Rom, a = -0.5
+{
+	x = fabsf ( x );
+	if ( x < 1 ) return ( 1.5f * x - 2.5f ) * x * x + 1;
+	if ( x < 2 ) return ( ( -0.5f * x + 2.5f ) * x - 4 ) * x + 2;
+	return 0;
+}
+static float sinc ( float x )
+{
+	if ( x == 0 ) return 1;
+	x *= 3.14159265358979f;
+	return sinf ( x ) / x;
+}
+static float filterLanczos ( float x )		{ return ( fabsf ( x ) < 3 ) ? sinc ( x ) * sinc ( x / 3 ) : 0; }
+static float bessel0 ( float x )
+{
+	float sum = 1, term = 1, h = x * 0.5f;
+	for ( int k = 1; k < 20; k++ ) {
+		term *= h / k;
+		sum += term * term;
+	}
+	return sum;
+}
+static float filterKaiser ( float x )		// Kaiser-windowed sinc, radius 3, alpha 4
+{
+	float t = x / 3;
+	if ( t <= -1 || t >= 1 ) return 0;
+	return sinc ( x ) * bessel0 ( 4 * sqrtf ( 1 - t * t ) ) / bessel0 ( 4 );
+}
+
+typedef float (*funcFilter) ( float x );
+
+// Weights along one axis. Every output has the same tap count, from start.
+// Zero weights are trimmed from the window ends, so starts do not always increase.
+struct ResampleAxis {
+	int					src;
+	int					taps;
+	std::vector<int>	start;
+	std::vector<float>	w;					// taps per output
+};
+
+static void buildAxis ( ResampleAxis& ax, int src, int dst, ImageOp::Sampler filter )
+{
+	funcFilter f;
+	float radius;
+	switch ( filter ) {
+	case ImageOp::Box:		f = filterBox;		radius = 0.5f;	break;
+	case ImageOp::Bicubic:	f = filterCubic;	radius = 2;		break;
+	case ImageOp::Lanczos:	f = filterLanczos;	radius = 3;		break;
+	case ImageOp::Kaiser:	f = filterKaiser;	radius = 3;		break;
+	default:				f = filterTent;		radius = 1;		break;
+	}
+	double scale = double(dst) / src;
+	float fs = ( scale < 1 ) ? float( 1.0 / scale ) : 1.0f;		// filter widens when shrinking
+	float r = radius * fs;
+	int maxw = std::min ( src, (int) ceilf ( 2 * r ) + 2 );
+
+	// weights per output over its clamped window
+	std::vector<float> win ( (size_t) dst * maxw, 0.0f );
+	std::vector<int> lo ( dst ), off ( dst ), cnt ( dst );
+	ax.taps = 1;
+	for ( int i = 0; i < dst; i++ ) {
+		float c = float( ( i + 0.5 ) / scale - 0.5 );			// sample center in source pixels
+		int j0 = (int) floorf ( c - r );
+		int j1 = (int) ceilf ( c + r );
+		int a = std::max ( 0, std::min ( src - 1, j0 ) );
+		float* wi = &win[ (size_t) i * maxw ];
+		float sum = 0;
+		for ( int j = j0; j <= j1; j++ ) {
+			float v = f ( ( j - c ) / fs );
+			if ( v == 0 ) continue;
+			wi[ std::max ( 0, std::min ( src - 1, j ) ) - a ] += v;		// edges clamp
+			sum += v;
+		}
+		if ( sum == 0 ) {
+			wi[ std::max ( 0, std::min ( src - 1, (int) floorf ( c + 0.5f ) ) ) - a ] = 1;
+			sum = 1;
+		}
+		int first = 0, last = maxw - 1;
+		while ( wi[first] == 0 ) first++;
+		while ( wi[last] == 0 ) last--;
+		for ( int k = first; k <= last; k++ ) wi[k] /= sum;
+		lo[i] = a + first;
+		off[i] = first;
+		cnt[i] = last - first + 1;
+		ax.taps = std::max ( ax.taps, cnt[i] );
+	}
+	// repack at a fixed tap count, shifting windows that would pass the edge
+	ax.src = src;
+	ax.start.resize ( dst );
+	ax.w.assign ( (size_t) dst * ax.taps, 0.0f );
+	for ( int i = 0; i < dst; i++ ) {
+		ax.start[i] = std::min ( lo[i], src - ax.taps );
+		memcpy ( &ax.w[ (size_t) i * ax.taps + lo[i] - ax.start[i] ], &win[ (size_t) i * maxw + off[i] ], cnt[i] * sizeof(float) );
+	}
+}
+
+//---------------------------------------- SRGB
+//
+// 8-bit color is decoded to linear for filtering and encoded after. Linear values keep the
+// 0..255 scale so alpha, which stays linear, shares the same rows.
+
+#define SRGB_ENC		16384				// encode table entries over linear 0..255
+#define SRGB_SCALE		( ( SRGB_ENC - 1 ) / 255.0f )
+
+struct SRGBTables {
+	float	dec[256];						// code to linear
+	float	thresh[257];					// linear value where code k starts, k >= 1. last is past 255
+	XBYTE	enc[ SRGB_ENC ];				// code at the start of each bucket, within one of exact
+	SRGBTables ();
+};
+SRGBTables::SRGBTables ()
+{
+	for ( int k = 0; k < 256; k++ ) {
+		double c = k / 255.0, h = ( k - 0.5 ) / 255.0;
+		dec[k] = float( 255.0 * ( ( c <= 0.04045 ) ? c / 12.92 : pow ( ( c + 0.055 ) / 1.055, 2.4 ) ) );
+		thresh[k] = ( k == 0 ) ? 0 : float( 255.0 * ( ( h <= 0.04045 ) ? h / 12.92 : pow ( ( h + 0.055 ) / 1.055, 2.4 ) ) );
+	}
+	thresh[256] = 1e30f;
+	int k = 0;
+	for ( int i = 0; i < SRGB_ENC; i++ ) {
+		float v = i / SRGB_SCALE;
+		while ( k < 255 && v >= thresh[k+1] ) k++;
+		enc[i] = k;
+	}
+}
+static const SRGBTables gSRGB;
+
+static inline XBYTE encodeSRGB ( float v )			// v clamped to 0..255
+{
+	int k = gSRGB.enc[ (int) ( v * SRGB_SCALE ) ];
+	k += int( v >= gSRGB.thresh[k+1] ) - int( v < gSRGB.thresh[k] );			// thresh[0] is 0, so k stays >= 0
+	return (XBYTE) k;
+}
+
+//---------------------------------------- HORIZONTAL
+//
+// One source row to float, dw * C values. Values stay in source units (0..255 for 8-bit).
+// The load policy reads channel c of a pixel.
+
+template<typename T> struct LoadRaw {
+	typedef T type;
+	static inline float get ( const T* p, int c )			{ return (float) p[c]; }
+};
+template<int C> struct LoadSRGB {
+	typedef XBYTE type;
+	static inline float get ( const XBYTE* p, int c )		{ return ( C == 4 && c == 3 ) ? (float) p[c] : gSRGB.dec[ p[c] ]; }		// alpha stays linear
+};
+
+template<typename L, int C> static void hpass ( const typename L::type* src, float* dst, const ResampleAxis& ax, int n )
+{
+	const int taps = ax.taps;
+	const float* w = ax.w.data();
+	for ( int x = 0; x < n; x++, w += taps, dst += C ) {
+		const typename L::type* p = src + ax.start[x] * C;
+		float acc[C];
+		for ( int c = 0; c < C; c++ ) acc[c] = 0;
+		for ( int k = 0; k < taps; k++, p += C )
+			for ( int c = 0; c < C; c++ ) acc[c] += w[k] * L::get ( p, c );
+		for ( int c = 0; c < C; c++ ) dst[c] = acc[c];
+	}
+}
+
+#ifdef IMG_SIMD_X86
+
+// Four channels to float. Three channel pixels read one value past the pixel.
+IMG_TARGET("sse2") static inline __m128 load4 ( const XBYTE* p )
+{
+	int v;
+	memcpy ( &v, p, 4 );
+	__m128i z = _mm_setzero_si128 ();
+	return _mm_cvtepi32_ps ( _mm_unpacklo_epi16 ( _mm_unpacklo_epi8 ( _mm_cvtsi32_si128 ( v ), z ), z ) );
+}
+IMG_TARGET("sse2") static inline __m128 load4 ( const uint16_t* p )
+{
+	return _mm_cvtepi32_ps ( _mm_unpacklo_epi16 ( _mm_loadl_epi64 ( (const __m128i*) p ), _mm_setzero_si128 () ) );
+}
+IMG_TARGET("sse2") static inline __m128 load4 ( const float* p )		{ return _mm_loadu_ps ( p ); }
+
+template<typename T> IMG_TARGET("sse2") static inline __m128 load4 ( LoadRaw<T>, const T* p )	{ return load4 ( p ); }
+template<int C> IMG_TARGET("sse2") static inline __m128 load4 ( LoadSRGB<C>, const XBYTE* p )
+{
+	return _mm_setr_ps ( gSRGB.dec[ p[0] ], gSRGB.dec[ p[1] ], gSRGB.dec[ p[2] ], ( C == 4 ) ? (float) p[3] : 0.0f );
+}
+
+// Same sums as hpass, one pixel per vector. Three channel windows that reach the last
+// source pixel, and the last output, fall back to scalar to stay inside the rows.
+template<typename L, int C> IMG_TARGET("sse2") static void hpass_sse2 ( const typename L::type* src, float* dst, const ResampleAxis& ax, int n )
+{
+	const int taps = ax.taps;
+	const float* w = ax.w.data();
+	for ( int x = 0; x < n; x++, w += taps, dst += C ) {
+		const typename L::type* p = src + ax.start[x] * C;
+		if ( C == 3 && ( ax.start[x] + taps >= ax.src || x == n - 1 ) ) {
+			float acc[3] = { 0, 0, 0 };
+			for ( int k = 0; k < taps; k++, p += 3 ) {
+				acc[0] += w[k] * L::get ( p, 0 );
+				acc[1] += w[k] * L::get ( p, 1 );
+				acc[2] += w[k] * L::get ( p, 2 );
+			}
+			dst[0] = acc[0]; dst[1] = acc[1]; dst[2] = acc[2];
+			continue;
+		}
+		__m128 acc = _mm_setzero_ps ();
+		for ( int k = 0; k < taps; k++, p += C )
+			acc = _mm_add_ps ( acc, _mm_mul_ps ( _mm_set1_ps ( w[k] ), load4 ( L(), p ) ) );
+		_mm_storeu_ps ( dst, acc );				// fourth value of a three channel pixel is overwritten by the next
+	}
+}
+
+#endif
+
+//---------------------------------------- VERTICAL
+//
+// dst[i] = sum of w[k] * rows[k][i], in tap order at every level.
+
+static void vpass ( const float* const* rows, const float* w, int taps, float* dst, int n )
+{
+	for ( int i = 0; i < n; i++ ) {
+		float acc = w[0] * rows[0][i];
+		for ( int k = 1; k < taps; k++ ) acc += w[k] * rows[k][i];
+		dst[i] = acc;
+	}
+}
+
+#ifdef IMG_SIMD_X86
+
+IMG_TARGET("sse2") static void vpass_sse2 ( const float* const* rows, const float* w, int taps, float* dst, int n )
+{
+	int i = 0;
+	for ( ; i + 8 <= n; i += 8 ) {
+		__m128 wk = _mm_set1_ps ( w[0] );
+		__m128 a = _mm_mul_ps ( wk, _mm_loadu_ps ( rows[0] + i ) );
+		__m128 b = _mm_mul_ps ( wk, _mm_loadu_ps ( rows[0] + i + 4 ) );
+		for ( int k = 1; k < taps; k++ ) {
+			wk = _mm_set1_ps ( w[k] );
+			a = _mm_add_ps ( a, _mm_mul_ps ( wk, _mm_loadu_ps ( rows[k] + i ) ) );
+			b = _mm_add_ps ( b, _mm_mul_ps ( wk, _mm_loadu_ps ( rows[k] + i + 4 ) ) );
+		}
+		_mm_storeu_ps ( dst + i, a );
+		_mm_storeu_ps ( dst + i + 4, b );
+	}
+	for ( ; i < n; i++ ) {
+		float acc = w[0] * rows[0][i];
+		for ( int k = 1; k < taps; k++ ) acc += w[k] * rows[k][i];
+		dst[i] = acc;
+	}
+}
+
+IMG_TARGET("avx2") static void vpass_avx2 ( const float* const* rows, const float* w, int taps, float* dst, int n )
+{
+	int i = 0;
+	for ( ; i + 16 <= n; i += 16 ) {
+		__m256 wk = _mm256_set1_ps ( w[0] );
+		__m256 a = _mm256_mul_ps ( wk, _mm256_loadu_ps ( rows[0] + i ) );
+		__m256 b = _mm256_mul_ps ( wk, _mm256_loadu_ps ( rows[0] + i + 8 ) );
+		for ( int k = 1; k < taps; k++ ) {
+			wk = _mm256_set1_ps ( w[k] );
+			a = _mm256_add_ps ( a, _mm256_mul_ps ( wk, _mm256_loadu_ps ( rows[k] + i ) ) );
+			b = _mm256_add_ps ( b, _mm256_mul_ps ( wk, _mm256_loadu_ps ( rows[k] + i + 8 ) ) );
+		}
+		_mm256_storeu_ps ( dst + i, a );
+		_mm256_storeu_ps ( dst + i + 8, b );
+	}
+	for ( ; i < n; i++ ) {
+		float acc = w[0] * rows[0][i];
+		for ( int k = 1; k < taps; k++ ) acc += w[k] * rows[k][i];
+		dst[i] = acc;
+	}
+}
+
+#endif
+
+//---------------------------------------- PACK
+//
+// Float row back to the format, clamped and rounded for integers.
+
+static void packU8 ( const float* s, XBYTE* d, int n )
+{
+	for ( int i = 0; i < n; i++ ) {
+		float v = ( s[i] < 0 ) ? 0 : ( s[i] > 255.0f ) ? 255.0f : s[i];
+		d[i] = (XBYTE) (int) ( v + 0.5f );
+	}
+}
+static void packU16 ( const float* s, XBYTE* dst, int n )
+{
+	uint16_t* d = (uint16_t*) dst;
+	for ( int i = 0; i < n; i++ ) {
+		float v = ( s[i] < 0 ) ? 0 : ( s[i] > 65535.0f ) ? 65535.0f : s[i];
+		d[i] = (uint16_t) (int) ( v + 0.5f );
+	}
+}
+static void packU32 ( const float* s, XBYTE* dst, int n )
+{
+	uint32_t* d = (uint32_t*) dst;
+	for ( int i = 0; i < n; i++ ) {
+		float v = ( s[i] < 0 ) ? 0 : ( s[i] > 4294967040.0f ) ? 4294967040.0f : s[i];		// largest float below 2^32
+		d[i] = (uint32_t) ( v + 0.5f );
+	}
+}
+static void packF32 ( const float* s, XBYTE* d, int n )		{ memcpy ( d, s, n * sizeof(float) ); }
+template<int C> static void packSRGB ( const float* s, XBYTE* d, int n )
+{
+	for ( int i = 0; i < n; i += C ) {
+		for ( int c = 0; c < C && c < 3; c++ ) {
+			float v = ( s[i+c] < 0 ) ? 0 : ( s[i+c] > 255.0f ) ? 255.0f : s[i+c];
+			d[i+c] = encodeSRGB ( v );
+		}
+		if ( C == 4 ) {
+			float v = ( s[i+3] < 0 ) ? 0 : ( s[i+3] > 255.0f ) ? 255.0f : s[i+3];
+			d[i+3] = (XBYTE) (int) ( v + 0.5f );				// alpha stays linear
+		}
+	}
+}
+
+#ifdef IMG_SIMD_X86
+
+IMG_TARGET("sse2") static inline __m128i roundClamp_sse2 ( const float* s, __m128 hi )
+{
+	__m128 v = _mm_max_ps ( _mm_min_ps ( _mm_loadu_ps ( s ), hi ), _mm_setzero_ps () );
+	return _mm_cvttps_epi32 ( _mm_add_ps ( v, _mm_set1_ps ( 0.5f ) ) );
+}
+IMG_TARGET("sse2") static void packU8_sse2 ( const float* s, XBYTE* d, int n )
+{
+	const __m128 hi = _mm_set1_ps ( 255.0f );
+	int i = 0;
+	for ( ; i + 16 <= n; i += 16 ) {
+		__m128i a = _mm_packs_epi32 ( roundClamp_sse2 ( s + i, hi ), roundClamp_sse2 ( s + i + 4, hi ) );
+		__m128i b = _mm_packs_epi32 ( roundClamp_sse2 ( s + i + 8, hi ), roundClamp_sse2 ( s + i + 12, hi ) );
+		_mm_storeu_si128 ( (__m128i*) (d + i), _mm_packus_epi16 ( a, b ) );
+	}
+	packU8 ( s + i, d + i, n - i );
+}
+IMG_TARGET("sse2") static void packU16_sse2 ( const float* s, XBYTE* dst, int n )
+{
+	const __m128 hi = _mm_set1_ps ( 65535.0f );
+	const __m128i bias = _mm_set1_epi32 ( 32768 );
+	const __m128i flip = _mm_set1_epi16 ( (short) 0x8000 );
+	uint16_t* d = (uint16_t*) dst;
+	int i = 0;
+	for ( ; i + 8 <= n; i += 8 ) {
+		__m128i a = _mm_sub_epi32 ( roundClamp_sse2 ( s + i, hi ), bias );		// signed pack, then flip back
+		__m128i b = _mm_sub_epi32 ( roundClamp_sse2 ( s + i + 4, hi ), bias );
+		_mm_storeu_si128 ( (__m128i*) (d + i), _mm_xor_si128 ( _mm_packs_epi32 ( a, b ), flip ) );
+	}
+	packU16 ( s + i, dst + i * 2, n - i );
+}
+
+#endif
+
+//---------------------------------------- FORMATS
+
+typedef void (*funcResampleH) ( const XBYTE* src, float* dst, const ResampleAxis& ax, int n );
+typedef void (*funcResampleV) ( const float* const* rows, const float* w, int taps, float* dst, int n );
+typedef void (*funcResamplePack) ( const float* src, XBYTE* dst, int n );
+
+struct ResampleOps {
+	int					chan;
+	int					bytes;				// per pixel
+	funcResampleH		hpass;
+	funcResampleV		vpass;
+	funcResamplePack	pack;
+};
+
+template<typename L, int C> static void hpassRow ( const XBYTE* src, float* dst, const ResampleAxis& ax, int n )		{ hpass<L, C> ( (const typename L::type*) src, dst, ax, n ); }
+#ifdef IMG_SIMD_X86
+template<typename L, int C> static void hpassRow_sse2 ( const XBYTE* src, float* dst, const ResampleAxis& ax, int n )	{ hpass_sse2<L, C> ( (const typename L::type*) src, dst, ax, n ); }
+#endif
+
+static bool getOps ( ImageOp::Format fmt, bool srgb, int level, ResampleOps& ops )
+{
+	switch ( fmt ) {
+	case ImageOp::BW8:		ops.chan = 1;	ops.bytes = 1;	ops.hpass = &hpassRow<LoadRaw<XBYTE>, 1>;		ops.pack = &packU8;		break;
+	case ImageOp::RGB8:
+	case ImageOp::BGR8:		ops.chan = 3;	ops.bytes = 3;	ops.hpass = &hpassRow<LoadRaw<XBYTE>, 3>;		ops.pack = &packU8;		break;
+	case ImageOp::RGBA8:	ops.chan = 4;	ops.bytes = 4;	ops.hpass = &hpassRow<LoadRaw<XBYTE>, 4>;		ops.pack = &packU8;		break;
+	case ImageOp::BW16:		ops.chan = 1;	ops.bytes = 2;	ops.hpass = &hpassRow<LoadRaw<uint16_t>, 1>;	ops.pack = &packU16;	break;
+	case ImageOp::RGB16:	ops.chan = 3;	ops.bytes = 6;	ops.hpass = &hpassRow<LoadRaw<uint16_t>, 3>;	ops.pack = &packU16;	break;
+	case ImageOp::BW32:		ops.chan = 1;	ops.bytes = 4;	ops.hpass = &hpassRow<LoadRaw<uint32_t>, 1>;	ops.pack = &packU32;	break;
+	case ImageOp::F32:		ops.chan = 1;	ops.bytes = 4;	ops.hpass = &hpassRow<LoadRaw<float>, 1>;		ops.pack = &packF32;	break;
+	case ImageOp::RGBA32F:	ops.chan = 4;	ops.bytes = 16;	ops.hpass = &hpassRow<LoadRaw<float>, 4>;		ops.pack = &packF32;	break;
+	default:				return false;
+	}
+	ops.vpass = &vpass;
+
+	#ifdef IMG_SIMD_X86
+	if ( level < 0 || level > getRowConvertLevel () ) level = getRowConvertLevel ();
+	if ( level >= IMG_SIMD_SSSE3 ) {
+		// sse2 is always present on x86-64
+		switch ( fmt ) {
+		case ImageOp::RGB8: case ImageOp::BGR8:	ops.hpass = &hpassRow_sse2<LoadRaw<XBYTE>, 3>;		break;
+		case ImageOp::RGBA8:						ops.hpass = &hpassRow_sse2<LoadRaw<XBYTE>, 4>;		break;
+		case ImageOp::RGB16:						ops.hpass = &hpassRow_sse2<LoadRaw<uint16_t>, 3>;	break;
+		case ImageOp::RGBA32F:						ops.hpass = &hpassRow_sse2<LoadRaw<float>, 4>;		break;
+		default: break;
+		}
+		if ( ops.pack == &packU8 ) ops.pack = &packU8_sse2;
+		if ( ops.pack == &packU16 ) ops.pack = &packU16_sse2;
+		ops.vpass = ( level >= IMG_SIMD_AVX2 ) ? &vpass_avx2 : &vpass_sse2;
+	}
+	#endif
+
+	if ( srgb ) {
+		switch ( fmt ) {
+		case ImageOp::BW8:		ops.hpass = &hpassRow<LoadSRGB<1>, 1>;	ops.pack = &packSRGB<1>;	break;
+		case ImageOp::RGB8:
+		case ImageOp::BGR8:		ops.hpass = &hpassRow<LoadSRGB<3>, 3>;	ops.pack = &packSRGB<3>;	break;
+		case ImageOp::RGBA8:	ops.hpass = &hpassRow<LoadSRGB<4>, 4>;	ops.pack = &packSRGB<4>;	break;
+		default: break;
+		}
+		#ifdef IMG_SIMD_X86
+		if ( level >= IMG_SIMD_SSSE3 ) {
+			if ( ops.hpass == &hpassRow<LoadSRGB<3>, 3> ) ops.hpass = &hpassRow_sse2<LoadSRGB<3>, 3>;
+			if ( ops.hpass == &hpassRow<LoadSRGB<4>, 4> ) ops.hpass = &hpassRow_sse2<LoadSRGB<4>, 4>;
+		}
+		#endif
+	}
+	return true;
+}
+
+//---------------------------------------- BANDS
+//
+// Jobs are bands of output rows, taken in turn by each thread.
+
+struct ResampleScratch {
+	std::vector<float>			hbuf;		// horizontal results for the band's source rows
+	std::vector<float>			vbuf;		// one output row, before packing
+	std::vector<const float*>	rows;
+};
+
+template<typename F> static void runJobs ( int jobs, int threads, F fn )
+{
+	std::atomic<int> next ( 0 );
+	auto work = [&] () {
+		ResampleScratch scr;
+		for ( int j; ( j = next++ ) < jobs; ) fn ( j, scr );
+	};
+	std::vector<std::thread> pool;
+	for ( int t = 1; t < threads; t++ ) pool.push_back ( std::thread ( work ) );
+	work ();
+	for ( std::thread& t : pool ) t.join ();
+}
+
+static int getThreads ( int threads, int dw, int dh )
+{
+	if ( threads <= 0 ) {
+		if ( (int64_t) dw * dh < RESAMPLE_MIN_PIX ) return 1;
+		threads = (int) std::thread::hardware_concurrency ();
+	}
+	return std::max ( 1, threads );
+}
+
+template<int B> static void nearestRow ( const XBYTE* src, XBYTE* dst, const int* xs, int n )
+{
+	for ( int x = 0; x < n; x++, dst += B ) memcpy ( dst, src + xs[x], B );
+}
+
+static bool resampleNearest ( const XBYTE* src, int sw, int sh, int spitch, XBYTE* dst, int dw, int dh, int dpitch, int bpp, int threads )
+{
+	void (*row) ( const XBYTE*, XBYTE*, const int*, int );
+	switch ( bpp ) {
+	case 1:		row = &nearestRow<1>;	break;
+	case 2:		row = &nearestRow<2>;	break;
+	case 3:		row = &nearestRow<3>;	break;
+	case 4:		row = &nearestRow<4>;	break;
+	case 6:		row = &nearestRow<6>;	break;
+	case 16:	row = &nearestRow<16>;	break;
+	default:	return false;
+	}
+	std::vector<int> xs ( dw );
+	for ( int x = 0; x < dw; x++ ) xs[x] = std::min ( sw - 1, (int) ( ( x + 0.5 ) * sw / dw ) ) * bpp;
+
+	threads = getThreads ( threads, dw, dh );
+	int band = std::max ( RESAMPLE_MIN_BAND, dh / ( threads * 4 ) );
+	int jobs = ( dh + band - 1 ) / band;
+	runJobs ( jobs, std::min ( threads, jobs ), [&] ( int j, ResampleScratch& ) {
+		int y1 = std::min ( dh, ( j + 1 ) * band );
+		for ( int y = j * band; y < y1; y++ ) {
+			int sy = std::min ( sh - 1, (int) ( ( y + 0.5 ) * sh / dh ) );
+			row ( src + (size_t) sy * spitch, dst + (size_t) y * dpitch, xs.data(), dw );
+		}
+	} );
+	return true;
+}
+
+bool resampleImage ( const XBYTE* src, int sw, int sh, int spitch, XBYTE* dst, int dw, int dh, int dpitch, ImageOp::Format fmt, ImageOp::Sampler filter, int threads, bool srgb, int level )
+{
+	ResampleOps ops;
+	if ( src == 0x0 || dst == 0x0 || sw <= 0 || sh <= 0 || dw <= 0 || dh <= 0 ) return false;
+	if ( !getOps ( fmt, srgb, level, ops ) ) return false;
+
+	if ( filter == ImageOp::Nearest )
+		return resampleNearest ( src, sw, sh, spitch, dst, dw, dh, dpitch, ops.bytes, threads );
+
+	ResampleAxis ax, ay;
+	buildAxis ( ax, sw, dw, filter );
+	buildAxis ( ay, sh, dh, filter );
+
+	// bands of about RESAMPLE_BAND source rows, with a few jobs per thread
+	threads = getThreads ( threads, dw, dh );
+	int band = (int) std::min ( (int64_t) dh, std::max ( (int64_t) 1, (int64_t) RESAMPLE_BAND * dh / sh ) );
+	band = std::max ( RESAMPLE_MIN_BAND, std::min ( band, dh / ( threads * 4 ) ) );
+	int jobs = ( dh + band - 1 ) / band;
+	int rowlen = dw * ops.chan;
+
+	runJobs ( jobs, std::min ( threads, jobs ), [&] ( int j, ResampleScratch& scr ) {
+		int y0 = j * band;
+		int y1 = std::min ( dh, y0 + band );
+		int lo = ay.start[ y0 ], hi = lo;
+		for ( int y = y0; y < y1; y++ ) {						// source rows the band reads
+			lo = std::min ( lo, ay.start[y] );
+			hi = std::max ( hi, ay.start[y] + ay.taps );
+		}
+
+		scr.hbuf.resize ( (size_t) ( hi - lo ) * rowlen );
+		scr.vbuf.resize ( rowlen );
+		scr.rows.resize ( ay.taps );
+		for ( int sy = lo; sy < hi; sy++ )
+			ops.hpass ( src + (size_t) sy * spitch, &scr.hbuf[ (size_t) ( sy - lo ) * rowlen ], ax, dw );
+
+		for ( int y = y0; y < y1; y++ ) {
+			for ( int k = 0; k < ay.taps; k++ ) scr.rows[k] = &scr.hbuf[ (size_t) ( ay.start[y] + k - lo ) * rowlen ];
+			ops.vpass ( scr.rows.data(), &ay.w[ (size_t) y * ay.taps ], ay.taps, scr.vbuf.data(), rowlen );
+			ops.pack ( scr.vbuf.data(), dst + (size_t) y * dpitch, rowlen );
+		}
+	} );
+	return true;
+}
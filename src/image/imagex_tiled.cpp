@@ -0,0 +1,475 @@
+//--------------------------------------------------------------------------------
+// Copyright 2007-2022 (c) Quanta Sciences, Rama Hoetzlein, ramakarl.com
+//
+// * Derivative works may append the above copyright notice but should not remove or modify earlier notices.
+//
+// MIT License:
+// Permission is hereby granted, free of charge, to any person obtaining a copy of this software and
+// associated documentation files (the "Software"), to deal in the Software without restriction, including without
+// limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software,
+// and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+// The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+// OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+// BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF
+// OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+//
+
+#include "imagex_tiled.h"
+#include "imagex_convert.h"
+#include <string.h>
+#include <stdio.h>
+
+#ifdef _WIN32
+	#include <io.h>
+	#include <sys/stat.h>
+	#define img_fseek		_fseeki64
+#else
+	#include <sys/mman.h>
+	#include <sys/stat.h>
+	#include <fcntl.h>
+	#include <unistd.h>
+#endif
+
+#define TILE_MAGIC		"IMGTILE1"
+
+struct TileFileHeader {
+	char		magic[8];
+	int32_t		xres, yres;
+	int32_t		fmt;
+	int32_t		tile;
+	int64_t		stride;				// bytes per tile
+	int64_t		offset;				// first tile
+};
+
+static int64_t alignTile ( int64_t v )		{ return ( v + IMG_TILE_ALIGN - 1 ) / IMG_TILE_ALIGN * IMG_TILE_ALIGN; }
+
+// Positioned reads and writes, on the fd (posix) or the FILE (other platforms)
+static bool readAt ( FILE* fp, int fd, int64_t off, void* buf, size_t len )
+{
+	#ifdef _WIN32
+		if ( img_fseek ( fp, off, SEEK_SET ) != 0 ) return false;
+		return fread ( buf, 1, len, fp ) == len;
+	#else
+		return pread ( fd, buf, len, (off_t) off ) == (ssize_t) len;
+	#endif
+}
+static bool writeAt ( FILE* fp, int fd, int64_t off, const void* buf, size_t len )
+{
+	#ifdef _WIN32
+		if ( img_fseek ( fp, off, SEEK_SET ) != 0 ) return false;
+		return fwrite ( buf, 1, len, fp ) == len;
+	#else
+		return pwrite ( fd, buf, len, (off_t) off ) == (ssize_t) len;
+	#endif
+}
+
+static int64_t fileSize ( FILE* fp, int fd )
+{
+	#ifdef _WIN32
+		struct _stat64 st;
+		return ( _fstat64 ( _fileno ( fp ), &st ) == 0 ) ? (int64_t) st.st_size : -1;
+	#else
+		struct stat st;
+		return ( fstat ( fd, &st ) == 0 ) ? (int64_t) st.st_size : -1;
+	#endif
+}
+
+ImageTiled::ImageTiled ()
+{
+	m_open = false;
+	m_write = false;
+	m_xres = 0; m_yres = 0;
+	m_fmt = ImageOp::FmtNone;
+	m_bpp = 0;
+	m_tile = 0;
+	m_ntx = 0; m_nty = 0;
+	m_tileStride = 0;
+	m_dataOffset = 0;
+	m_stateDirty = false;
+	m_fp = 0x0;
+	m_fd = -1;
+	m_cacheSize = IMG_TILE_CACHE;
+	m_maxTiles = 1;
+	m_loadFunc = 0x0;
+	m_loadUser = 0x0;
+	m_hits = 0; m_misses = 0; m_loads = 0;
+}
+
+ImageTiled::~ImageTiled ()
+{
+	Close ();
+}
+
+bool ImageTiled::openFile ( std::string path, bool write, bool create )
+{
+	#ifdef _WIN32
+		m_fp = fopen ( path.c_str(), create ? "w+b" : ( write ? "r+b" : "rb" ) );
+		if ( m_fp == 0x0 ) return false;
+	#else
+		int flags = create ? ( O_RDWR | O_CREAT | O_TRUNC ) : ( write ? O_RDWR : O_RDONLY );
+		m_fd = open ( path.c_str(), flags, 0644 );
+		if ( m_fd < 0 ) return false;
+	#endif
+	m_write = write || create;
+	return true;
+}
+
+bool ImageTiled::writeHeader ()
+{
+	TileFileHeader hdr;
+	memset ( &hdr, 0, sizeof(hdr) );
+	memcpy ( hdr.magic, TILE_MAGIC, 8 );
+	hdr.xres = m_xres;
+	hdr.yres = m_yres;
+	hdr.fmt = (int32_t) m_fmt;
+	hdr.tile = m_tile;
+	hdr.stride = m_tileStride;
+	hdr.offset = m_dataOffset;
+	if ( !writeAt ( m_fp, m_fd, 0, &hdr, sizeof(hdr) ) ) return false;
+	if ( !writeAt ( m_fp, m_fd, sizeof(hdr), &m_state[0], m_state.size() ) ) return false;
+	m_stateDirty = false;
+	return true;
+}
+
+bool ImageTiled::Create ( std::string path, int xres, int yres, ImageOp::Format fmt, int tile )
+{
+	Close ();
+	int bpp = getFormatBytes ( fmt );
+	if ( xres <= 0 || yres <= 0 || tile <= 0 || bpp == 0 ) {
+		dbgprintf ( "ERROR: ImageTiled::Create. Unsupported size or format %d.\n", (int) fmt );
+		return false;
+	}
+	m_xres = xres; m_yres = yres;
+	m_fmt = fmt;
+	m_bpp = bpp;
+	m_tile = tile;
+	m_ntx = (int) ( ( (int64_t) xres + tile - 1 ) / tile );
+	m_nty = (int) ( ( (int64_t) yres + tile - 1 ) / tile );
+	int64_t ntiles = (int64_t) m_ntx * m_nty;
+	m_tileStride = alignTile ( (int64_t) tile * tile * bpp );
+	m_dataOffset = alignTile ( sizeof(TileFileHeader) + ntiles );
+	m_state.assign ( (size_t) ntiles, 0 );
+
+	if ( !openFile ( path, true, true ) ) {
+		dbgprintf ( "ERROR: ImageTiled::Create. Unable to create %s.\n", path.c_str() );
+		return false;
+	}
+	int64_t total = tileOffset ( ntiles );					// sparse, tiles read as zero
+	#ifdef _WIN32
+		bool ok = ( _chsize_s ( _fileno ( m_fp ), total ) == 0 );
+	#else
+		bool ok = ( ftruncate ( m_fd, (off_t) total ) == 0 );
+	#endif
+	m_open = true;
+	if ( !ok || !writeHeader () ) {
+		dbgprintf ( "ERROR: ImageTiled::Create. Unable to size %s.\n", path.c_str() );
+		Close ();
+		return false;
+	}
+	SetCacheSize ( m_cacheSize );
+	return true;
+}
+
+bool ImageTiled::Open ( std::string path, bool write )
+{
+	Close ();
+	if ( !openFile ( path, write, false ) ) {
+		dbgprintf ( "ERROR: ImageTiled::Open. Unable to open %s.\n", path.c_str() );
+		return false;
+	}
+	m_open = true;
+
+	TileFileHeader hdr;
+	ImageOp::Format fmt = ImageOp::FmtNone;
+	bool ok = readAt ( m_fp, m_fd, 0, &hdr, sizeof(hdr) ) && memcmp ( hdr.magic, TILE_MAGIC, 8 ) == 0;
+	if ( ok ) {
+		fmt = (ImageOp::Format) hdr.fmt;
+		m_bpp = getFormatBytes ( fmt );
+		ok = ( m_bpp > 0 && hdr.xres > 0 && hdr.yres > 0 && hdr.tile > 0 && hdr.stride / hdr.tile / hdr.tile >= m_bpp );
+	}
+	if ( ok ) {
+		// tiles are mapped, so every one must be aligned and inside the file
+		int64_t ntiles = ( ( (int64_t) hdr.xres + hdr.tile - 1 ) / hdr.tile ) * ( ( (int64_t) hdr.yres + hdr.tile - 1 ) / hdr.tile );
+		int64_t size = fileSize ( m_fp, m_fd );
+		ok = ( hdr.stride % IMG_TILE_ALIGN == 0 && hdr.offset % IMG_TILE_ALIGN == 0 &&
+			   hdr.offset >= (int64_t) sizeof(hdr) + ntiles && hdr.offset <= size && ntiles <= ( size - hdr.offset ) / hdr.stride );
+	}
+	if ( ok ) {
+		m_xres = hdr.xres; m_yres = hdr.yres;
+		m_fmt = fmt;
+		m_tile = hdr.tile;
+		m_ntx = (int) ( ( (int64_t) m_xres + m_tile - 1 ) / m_tile );
+		m_nty = (int) ( ( (int64_t) m_yres + m_tile - 1 ) / m_tile );
+		m_tileStride = hdr.stride;
+		m_dataOffset = hdr.offset;
+		m_state.assign ( (size_t) m_ntx * m_nty, 0 );
+		ok = readAt ( m_fp, m_fd, sizeof(hdr), &m_state[0], m_state.size() );
+	}
+	if ( !ok ) {
+		dbgprintf ( "ERROR: ImageTiled::Open. Not a tile file: %s.\n", path.c_str() );
+		Close ();
+		return false;
+	}
+	SetCacheSize ( m_cacheSize );
+	return true;
+}
+
+void ImageTiled::Flush ()
+{
+	if ( !m_open ) return;
+	std::lock_guard<std::mutex> lock ( m_mtx );
+	if ( !m_write ) return;										// changes stay in memory
+
+	for ( auto& it : m_tiles ) {
+		Tile& e = it.second;
+		if ( !e.dirty ) continue;
+		#ifdef _WIN32
+			writeAt ( m_fp, m_fd, tileOffset ( it.first ), e.data, (size_t) m_tileStride );
+		#else
+			msync ( e.data, (size_t) m_tileStride, MS_SYNC );
+		#endif
+		e.dirty = false;
+	}
+	if ( m_stateDirty ) writeHeader ();
+	#ifdef _WIN32
+		fflush ( m_fp );
+	#endif
+}
+
+void ImageTiled::Close ()
+{
+	if ( !m_open ) return;
+	Flush ();
+	{
+		std::lock_guard<std::mutex> lock ( m_mtx );
+		for ( auto& it : m_tiles )
+			releaseTile ( it.first, it.second );
+		m_tiles.clear ();
+		m_lru.clear ();
+	}
+	#ifdef _WIN32
+		if ( m_fp ) fclose ( m_fp );
+	#else
+		if ( m_fd >= 0 ) close ( m_fd );
+	#endif
+	m_fp = 0x0;
+	m_fd = -1;
+	m_open = false;
+	m_state.clear ();
+}
+
+void ImageTiled::SetCacheSize ( uint64_t bytes )
+{
+	std::lock_guard<std::mutex> lock ( m_mtx );
+	m_cacheSize = bytes;
+	if ( m_tileStride > 0 ) {
+		uint64_t n = bytes / (uint64_t) m_tileStride;
+		m_maxTiles = ( n < 1 ) ? 1 : ( n > 0x7FFFFFFF ? 0x7FFFFFFF : (int) n );
+		evictTiles ();
+	}
+}
+
+int ImageTiled::GetNumResident ()
+{
+	std::lock_guard<std::mutex> lock ( m_mtx );
+	return (int) m_tiles.size();
+}
+
+//---------------------------------------- TILE CACHE
+
+XBYTE* ImageTiled::mapTile ( int64_t t )
+{
+	#ifdef _WIN32
+		XBYTE* data = (XBYTE*) malloc ( (size_t) m_tileStride );
+		if ( data == 0x0 ) return 0x0;
+		if ( m_state[t] == 0 || !readAt ( m_fp, m_fd, tileOffset ( t ), data, (size_t) m_tileStride ) )
+			memset ( data, 0, (size_t) m_tileStride );
+		return data;
+	#else
+		// read-only files map private, so changes stay in memory
+		void* m = mmap ( 0x0, (size_t) m_tileStride, PROT_READ | PROT_WRITE, m_write ? MAP_SHARED : MAP_PRIVATE, m_fd, (off_t) tileOffset ( t ) );
+		return ( m == MAP_FAILED ) ? 0x0 : (XBYTE*) m;
+	#endif
+}
+
+void ImageTiled::releaseTile ( int64_t t, Tile& e )
+{
+	#ifdef _WIN32
+		if ( e.dirty && m_write ) writeAt ( m_fp, m_fd, tileOffset ( t ), e.data, (size_t) m_tileStride );
+		free ( e.data );
+	#else
+		munmap ( e.data, (size_t) m_tileStride );				// shared pages are written back by the os
+	#endif
+	e.data = 0x0;
+}
+
+// Drop least recently used tiles that are not locked, down to the cache size
+void ImageTiled::evictTiles ()
+{
+	auto it = m_lru.end ();
+	while ( (int) m_tiles.size() > m_maxTiles && it != m_lru.begin() ) {
+		--it;
+		int64_t t = *it;
+		Tile& e = m_tiles[ t ];
+		if ( e.pins > 0 ) continue;
+		releaseTile ( t, e );
+		m_tiles.erase ( t );
+		it = m_lru.erase ( it );
+	}
+}
+
+XBYTE* ImageTiled::LockTile ( int tx, int ty, bool write )
+{
+	if ( !m_open || tx < 0 || ty < 0 || tx >= m_ntx || ty >= m_nty ) return 0x0;
+	std::lock_guard<std::mutex> lock ( m_mtx );
+	int64_t t = (int64_t) ty * m_ntx + tx;
+
+	auto it = m_tiles.find ( t );
+	if ( it != m_tiles.end() ) {
+		m_hits++;
+		m_lru.splice ( m_lru.begin(), m_lru, it->second.lru );
+	} else {
+		m_misses++;
+		XBYTE* data = mapTile ( t );
+		if ( data == 0x0 ) {
+			dbgprintf ( "ERROR: ImageTiled::LockTile. Unable to map tile %d,%d.\n", tx, ty );
+			return 0x0;
+		}
+		Tile e;
+		e.data = data;
+		e.pins = 0;
+		e.dirty = false;
+		m_lru.push_front ( t );
+		e.lru = m_lru.begin ();
+		it = m_tiles.emplace ( t, e ).first;
+
+		// lazy decode. read-only files decode again after eviction
+		if ( m_state[t] == 0 && m_loadFunc != 0x0 ) {
+			int x = tx * m_tile, y = ty * m_tile;
+			int w = ( x + m_tile > m_xres ) ? m_xres - x : m_tile;
+			int h = ( y + m_tile > m_yres ) ? m_yres - y : m_tile;
+			if ( m_loadFunc ( m_loadUser, x, y, w, h, data, GetTilePitch() ) ) {
+				m_loads++;
+				it->second.dirty = true;
+				if ( m_write ) { m_state[t] = 1; m_stateDirty = true; }
+			}
+		}
+	}
+	Tile& e = it->second;
+	e.pins++;
+	if ( write ) {
+		e.dirty = true;
+		if ( m_state[t] == 0 && m_write ) { m_state[t] = 1; m_stateDirty = true; }
+	}
+	evictTiles ();
+	return e.data;
+}
+
+void ImageTiled::UnlockTile ( int tx, int ty )
+{
+	if ( !m_open ) return;
+	std::lock_guard<std::mutex> lock ( m_mtx );
+	auto it = m_tiles.find ( (int64_t) ty * m_ntx + tx );
+	if ( it == m_tiles.end() ) return;
+	if ( it->second.pins > 0 ) it->second.pins--;
+	if ( (int) m_tiles.size() > m_maxTiles ) evictTiles ();
+}
+
+//---------------------------------------- REGIONS
+
+bool ImageTiled::copyRegion ( int x, int y, int w, int h, XBYTE* buf, int pitch, bool write )
+{
+	if ( !m_open ) return false;
+	int x0 = ( x < 0 ) ? 0 : x;
+	int y0 = ( y < 0 ) ? 0 : y;
+	int x1 = ( (int64_t) x + w > m_xres ) ? m_xres : x + w;
+	int y1 = ( (int64_t) y + h > m_yres ) ? m_yres : y + h;
+	if ( x0 >= x1 || y0 >= y1 ) return true;					// nothing inside the image
+	int tpitch = GetTilePitch ();
+
+	for ( int ty = y0 / m_tile; ty <= ( y1 - 1 ) / m_tile; ty++ ) {
+		for ( int tx = x0 / m_tile; tx <= ( x1 - 1 ) / m_tile; tx++ ) {
+			XBYTE* data = LockTile ( tx, ty, write );
+			if ( data == 0x0 ) return false;
+			int ax = ( x0 > tx * m_tile ) ? x0 : tx * m_tile;
+			int bx = ( x1 < ( tx + 1 ) * m_tile ) ? x1 : ( tx + 1 ) * m_tile;
+			int ay = ( y0 > ty * m_tile ) ? y0 : ty * m_tile;
+			int by = ( y1 < ( ty + 1 ) * m_tile ) ? y1 : ( ty + 1 ) * m_tile;
+			size_t n = (size_t) ( bx - ax ) * m_bpp;
+			for ( int py = ay; py < by; py++ ) {
+				XBYTE* tp = data + (size_t) ( py - ty * m_tile ) * tpitch + (size_t) ( ax - tx * m_tile ) * m_bpp;
+				XBYTE* bp = buf + (size_t) ( py - y ) * pitch + (size_t) ( ax - x ) * m_bpp;
+				if ( write ) memcpy ( tp, bp, n );
+				else memcpy ( bp, tp, n );
+			}
+			UnlockTile ( tx, ty );
+		}
+	}
+	return true;
+}
+
+bool ImageTiled::GetRegion ( int x, int y, int w, int h, XBYTE* dst, int pitch )
+{
+	return copyRegion ( x, y, w, h, dst, pitch, false );
+}
+
+bool ImageTiled::SetRegion ( int x, int y, int w, int h, const XBYTE* src, int pitch )
+{
+	return copyRegion ( x, y, w, h, (XBYTE*) src, pitch, true );
+}
+
+bool ImageTiled::GetRegion ( int x, int y, int w, int h, ImageX* dst )
+{
+	if ( !m_open || dst == 0x0 || w <= 0 || h <= 0 ) return false;
+	dst->Resize ( w, h, m_fmt );
+	memset ( dst->GetData(), 0, (size_t) dst->GetSize() );		// outside the image reads as zero
+	bool ok = copyRegion ( x, y, w, h, dst->GetData(), (int) dst->GetBytesPerRow(), false );
+	if ( dst->mAutocommit ) dst->Commit ();
+	return ok;
+}
+
+bool ImageTiled::SetRegion ( int x, int y, ImageX* src )
+{
+	if ( !m_open || src == 0x0 || src->GetData() == 0x0 ) return false;
+	int w = src->GetWidth(), h = src->GetHeight();
+	int spitch = (int) src->GetBytesPerRow();
+	if ( src->GetFormat() == m_fmt )
+		return copyRegion ( x, y, w, h, src->GetData(), spitch, true );
+
+	funcRowConvert cvt = getRowConvert ( src->GetFormat(), m_fmt );
+	if ( cvt == 0x0 ) {
+		dbgprintf ( "ERROR: ImageTiled::SetRegion. Unable to convert format %d to %d.\n", (int) src->GetFormat(), (int) m_fmt );
+		return false;
+	}
+	// convert a band of rows at a time
+	int band = m_tile;
+	int pitch = w * m_bpp;
+	std::vector<XBYTE> buf ( (size_t) pitch * band );
+	for ( int j = 0; j < h; j += band ) {
+		int n = ( h - j < band ) ? h - j : band;
+		for ( int r = 0; r < n; r++ )
+			cvt ( src->GetData() + (size_t) ( j + r ) * spitch, &buf[ (size_t) r * pitch ], w );
+		if ( !copyRegion ( x, y + j, w, n, &buf[0], pitch, true ) ) return false;
+	}
+	return true;
+}
+
+Vec4F ImageTiled::GetPixel ( int x, int y )
+{
+	float c[4] = { 0, 0, 0, 0 };
+	XBYTE pix[16];
+	if ( x >= 0 && y >= 0 && x < m_xres && y < m_yres && copyRegion ( x, y, 1, 1, pix, m_bpp, false ) )
+		getRowConvert ( m_fmt, ImageOp::RGBA32F ) ( pix, (XBYTE*) c, 1 );
+	return Vec4F ( c[0], c[1], c[2], c[3] );
+}
+
+void ImageTiled::SetPixel ( int x, int y, Vec4F c )
+{
+	if ( !m_open || x < 0 || y < 0 || x >= m_xres || y >= m_yres ) return;
+	float v[4] = { c.x, c.y, c.z, c.w };
+	XBYTE pix[16];
+	getRowConvert ( ImageOp::RGBA32F, m_fmt ) ( (XBYTE*) v, pix, 1 );
+	copyRegion ( x, y, 1, 1, pix, m_bpp, true );
+}
@@ -17,6 +17,7 @@
 //
 #include "event.h"
 #include "string_helper.h"
+#include <atomic>
 
 static char mbuf [ 16384 ];
 
@@ -24,7 +25,7 @@ extern char* new_event_data ( size_t size, int& max, EventPool* pool, eventStr_t
 extern void free_event_data ( char*& data, EventPool* pool, eventStr_t name, int cid, const char* msg=0 );
 extern void free_event ( Event& e, const char* msg=0 );
 extern void expand_event ( Event& e, size_t size );
-extern int event_alloc;
+extern std::atomic<int> event_alloc;
 #ifdef DEBUG_EVENT_MEM
 	extern void emem_rename ( Event& e, eventStr_t oldname, eventStr_t newname, const char* msg );
 #endif
@@ -216,6 +217,11 @@ void Event::copy ( const Event& src )
 // - this func efficiently transfers ownership to another event (not a deep copy)
 void Event::acquire ( Event& src)
 {
+	// borrowed data cannot be transferred, take a deep copy
+	if ( src.isBorrowed() ) {
+		copy ( src );
+		return;
+	}
 	// any prior data on dest event is discarded
 	if ( bOwn && mData != 0x0 ) {
 		free_event_data ( mData, mOwner, mName, mCID, "~acq" );
@@ -644,6 +650,30 @@ void Event::deserialize (char* buf, int serial_len )
 	mCID = cid;			// restore cid
 }
 
+// Borrow a serialized event in place
+// The event views the buffer (header followed by payload) without copying or owning it,
+// so the buffer must outlive the event. Acquire or copy of a borrowed event is a deep copy.
+void Event::borrow ( char* buf, int serial_len, EventPool* pool )
+{
+	const int hsz = Event::staticSerializedHeaderSize();
+
+	if ( bOwn && mData != 0x0 ) {
+		free_event_data ( mData, mOwner, mName, mCID, "~borrow" );
+	}
+	// Transfer serialized header into Event pointer
+	memcpy ( (char*) this + Event::staticOffsetLenInfo(), buf, hsz );
+
+	mData = buf + hsz;
+	mDataLen = serial_len - hsz;
+	mMax = mDataLen;
+	mPos = mData;
+	mOwner = pool;
+	mRefs = 0;
+	mCID = -1;
+	bOwn = false;					// not owned, never freed
+	bDestroy = false;
+}
+
 void Event::setTime ( unsigned long t )
 {
 	mTimeStamp.SetSJT ( t );
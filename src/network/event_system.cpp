@@ -22,8 +22,8 @@
 #include <cmath>
 #include <stdio.h>
 
-int event_alloc = 0;
-int event_free = 0;
+std::atomic<int> event_alloc ( 0 );			// counted across threads
+std::atomic<int> event_free ( 0 );
 #ifdef DEBUG_EVENT_MEM
 	vecTrack_t event_tracks;
 #endif
@@ -40,7 +40,7 @@ char* new_event_data ( size_t size, int& max, EventPool* pool, eventStr_t name,
 	size += Event::staticSerializedHeaderSize();	// additional memory for serial header
 
 	// allocate payload
-	if ( size > MAX_POOL_SIZE || pool==0x0 ) {
+	if ( pool==0x0 ) {
 		
 		// standard allocation
 		data = (char*) malloc ( size );
@@ -57,8 +57,13 @@ char* new_event_data ( size_t size, int& max, EventPool* pool, eventStr_t name,
 		
 	} else {
 		#ifdef BUILD_EVENT_POOLING
-			// optional Event Pooling
+			// optional Event Pooling. thread-safe, large sizes handled by pool
 			data = (char*) pool->allocItem ( (int) size );
+			if ( data==0 ) {
+				dbgprintf ("ERROR: Unable to allocate pooled event.\n");
+				exit(-2);
+			}
+			event_alloc++;
 			max = pool->getItemMaxSize ( (int) size );
 			max -= Event::staticSerializedHeaderSize();
 		#endif
@@ -87,8 +92,11 @@ void new_event ( Event& p, size_t size, eventStr_t targ, eventStr_t name, eventS
 	p.mCID = event_alloc;			// creation ID
 	
 	// reuse payload
-	if (p.mData == 0x0 || size > p.mMax ) {
+	if (p.mData == 0x0 || size > p.mMax || !p.bOwn ) {
+		if ( p.mData != 0x0 && p.bOwn ) 
+			free_event_data ( p.mData, p.mOwner, p.mName, p.mCID, msg );		// release with its own pool
 		p.mData = new_event_data ( size, p.mMax, pool, name, msg );	  // payload allocation			
+		p.mOwner = pool;
 	}
 	// memset ( p.mData, '0', p.mMax );			//--- debugging
 
@@ -152,6 +160,7 @@ void free_event_data ( char*& data, EventPool* pool, eventStr_t name, int cid, c
 
 	} else {
 		#ifdef BUILD_EVENT_POOLING
+			event_free++;
 			pool->freeItem ( data );
 		#endif
 	}	
@@ -172,7 +181,7 @@ void free_event_data ( char*& data, EventPool* pool, eventStr_t name, int cid, c
 		}
 		std::string tag = std::to_string(cid) + ":" + nameToStr(name);
 		event_tracks.push_back ( eventTrack(tag,msg) );
-		printf ( "%p: +%s, %d/%d +%d, %s\n", data, tag.c_str(), event_alloc, event_free, event_alloc-event_free, msg );			
+		printf ( "%p: +%s, %d/%d +%d, %s\n", data, tag.c_str(), (int) event_alloc, (int) event_free, event_alloc-event_free, msg );			
 	}
 
 	void emem_track_free ( char* data, int cid, eventStr_t name, const char* msg ) 
@@ -185,7 +194,7 @@ void free_event_data ( char*& data, EventPool* pool, eventStr_t name, int cid, c
 		if ( found >= 0 ) {
 			event_tracks.erase ( event_tracks.begin() + found );		// remove from list
 		}
-		printf ( "%p: -%s, %d/%d +%d, %s\n", data, tag.c_str(), event_alloc, event_free, event_alloc-event_free, msg );					
+		printf ( "%p: -%s, %d/%d +%d, %s\n", data, tag.c_str(), (int) event_alloc, (int) event_free, event_alloc-event_free, msg );					
 	}
 
 	void emem_rename ( Event& e, eventStr_t oldname, eventStr_t newname, const char* msg )
@@ -210,86 +219,125 @@ void free_event_data ( char*& data, EventPool* pool, eventStr_t name, int cid, c
 
 //---------------------------------------------- Event Queue
 
-EventQueue::EventQueue ()
+EventQueue::EventQueue ( int slots )
 {
-	bool e = mList.empty ();
+	size_t n = 16;
+	while ( n < (size_t) slots ) n <<= 1;		// power of 2
+	mSlots = new Slot[ n ];
+	mMask = n - 1;
+	for ( size_t i = 0; i < n; i++ ) 
+		mSlots[ i ].seq.store ( i, std::memory_order_relaxed );
+	mTail.store ( 0, std::memory_order_relaxed );
+	mHead.store ( 0, std::memory_order_relaxed );
+	mConsumer.store ( std::thread::id() );
 	mTraceFile = 0x0;
 }
 
-void EventQueue::startTrace ( char* fn )
-{
-	mTraceFile = fopen ( fn, "w+t" );
-}
-// safe pull of front event 
-// (event acquire, does not call const copy)
-void EventQueue::PopFront ( Event*& dest )
+EventQueue::~EventQueue ()
 {
-	dest = mList.front ();			// get first element
-	mList.pop ();								// pop from list
+	Clear ();
+	delete [] mSlots;
 }
 
-void EventQueue::Push ( Event* e )
+void EventQueue::startTrace ( char* fn )
 {
-	e->incRefs ();				// Added to queue. Increment ref count.
-	mList.push ( e );
+	mTraceFile = fopen ( fn, "w+t" );
 }
 
-void EventQueue::Push_back ( Event* e )
+// Push event
+// Acquires the event into a free slot. The caller's event is left detached.
+// Until setConsumer is called no thread may spill, so every producer waits when full.
+bool EventQueue::Push ( Event& e, uint64_t time )
 {
-	std::queue < Event* >	q;
-
-	while ( mList.size() > 0 ) {
-		q.push ( mList.front() );
-		mList.pop ();
+	// consumer keeps its own order behind spilled events
+	std::thread::id consumer = mConsumer.load ( std::memory_order_relaxed );
+	bool is_consumer = ( consumer != std::thread::id() && consumer == std::this_thread::get_id() );
+	if ( is_consumer && !mOverflow.empty() ) {
+		Event* ev = new Event;
+		ev->acquire ( e );
+		mOverflow.push ( std::make_pair ( ev, time ) );
+		return true;
 	}
-	mList.push ( e );
-	while ( q.size() > 0 ) {
-		mList.push ( q.front() );
-		q.pop ();
+	size_t pos = mTail.load ( std::memory_order_relaxed );
+	Slot* slot;
+	for (;;) {
+		slot = &mSlots[ pos & mMask ];
+		size_t seq = slot->seq.load ( std::memory_order_acquire );
+		intptr_t dif = (intptr_t) seq - (intptr_t) pos;
+		if ( dif == 0 ) {
+			if ( mTail.compare_exchange_weak ( pos, pos + 1, std::memory_order_relaxed ) ) break;		// claimed
+		} else if ( dif < 0 ) {
+			// full
+			if ( is_consumer ) {
+				Event* ev = new Event;
+				ev->acquire ( e );
+				mOverflow.push ( std::make_pair ( ev, time ) );
+				return true;
+			}
+			std::this_thread::yield ();		// wait for consumer
+			pos = mTail.load ( std::memory_order_relaxed );
+		} else {
+			pos = mTail.load ( std::memory_order_relaxed );
+		}
 	}
+	slot->e.acquire ( e );
+	slot->time = time;
+	slot->seq.store ( pos + 1, std::memory_order_release );		// publish
+	return true;
 }
 
-EventQueue& EventQueue::operator= ( EventQueue &op )
+// Pop front event
+// Acquires the event out of its slot into dest. 
+bool EventQueue::PopFront ( Event& dest, uint64_t* time )
 {
-	Event e;
-	while ( op.getSize() > 0 ) {
-		e = op.mList.front();
-		mList.push ( &e );
-		op.mList.pop();
+	size_t pos = mHead.load ( std::memory_order_relaxed );
+	Slot* slot = &mSlots[ pos & mMask ];
+	size_t seq = slot->seq.load ( std::memory_order_acquire );
+	
+	if ( (intptr_t) seq - (intptr_t) (pos + 1) < 0 ) {
+		// ring empty, take spilled events
+		if ( mOverflow.empty() ) return false;
+		Event* ev = mOverflow.front ().first;
+		if ( time != 0x0 ) *time = mOverflow.front ().second;
+		mOverflow.pop ();
+		dest.acquire ( *ev );
+		delete ev;
+		return true;
 	}
-	return *this;
+	dest.acquire ( slot->e );
+	if ( time != 0x0 ) *time = slot->time;
+	slot->seq.store ( pos + mMask + 1, std::memory_order_release );		// release slot
+	mHead.store ( pos + 1, std::memory_order_relaxed );
+	return true;
 }
 
-void EventQueue::Clear ()
+int EventQueue::getSize ()
 {
-	while ( mList.size() > 0 )
-		mList.pop ();
+	size_t tail = mTail.load ( std::memory_order_relaxed );
+	size_t head = mHead.load ( std::memory_order_relaxed );
+	return (int) ( tail - head ) + (int) mOverflow.size();
 }
 
-
-void EventQueue::trace ()
+// Clear queue (consumer thread)
+void EventQueue::Clear ()
 {
 	Event e;
-	std::queue<Event> temp;
+	while ( PopFront ( e ) );
+}
 
+void EventQueue::trace ()
+{
 	if ( mTraceFile == 0x0 ) return;
 
-	fflush ( mTraceFile );
-
-	while (!mList.empty()) {
-		e = mList.front ();
-		fprintf ( mTraceFile, "%s ", e.NameToStr().c_str() );
-		fflush ( mTraceFile );
-		temp.push ( e );
-		mList.pop ();
+	// consumer thread only. names of published events, in order
+	size_t tail = mTail.load ( std::memory_order_acquire );
+	for ( size_t pos = mHead.load ( std::memory_order_relaxed ); pos != tail; pos++ ) {
+		Slot& slot = mSlots[ pos & mMask ];
+		if ( slot.seq.load ( std::memory_order_acquire ) != pos + 1 ) break;		// not yet published
+		fprintf ( mTraceFile, "%s ", slot.e.NameToStr().c_str() );
 	}
 	fprintf ( mTraceFile, "\n");
 	fflush ( mTraceFile );
-	while (!temp.empty() ) {
-		e = temp.front ();
-		mList.push ( &e );
-		temp.pop ();
-	}
 }
 
 
@@ -297,355 +345,372 @@ void EventQueue::trace ()
 
 //------------------------------------------- EVENT POOLING [optional]
 
+#ifndef _WIN32
+	#include <sys/mman.h>
+#endif
+#include <map>
+
+#define ITEM_USED		0xE5E5
+#define ITEM_FREE		0xFFFF
+#define MAG_POOLS		4				// pools cached per thread
+
+// Pool registry
+// Pools are identified by a unique id, so a thread cache never matches a pool which was destroyed or cleared.
+static std::mutex										g_poolMtx;
+static std::map< uint32_t, EventPool* >	g_pools;
+static uint32_t											g_poolNext = 1;
+
+static uint32_t pool_register ( EventPool* pool )
+{
+	std::lock_guard<std::mutex> lock ( g_poolMtx );
+	uint32_t id = g_poolNext++;
+	g_pools[ id ] = pool;
+	return id;
+}
+static void pool_unregister ( uint32_t id )
+{
+	std::lock_guard<std::mutex> lock ( g_poolMtx );
+	g_pools.erase ( id );
+}
+
+// Thread magazines
+// Each thread caches free items for up to MAG_POOLS pools. On thread exit, 
+// cached items go back to their pool if it still exists.
+struct MagCache {
+	uint32_t	id;
+	int				cnt[ BIN_CNT ];
+	itemPtr		items[ BIN_CNT ][ MAG_SLOTS ];
+};
+struct ThreadMags {
+	MagCache	cache[ MAG_POOLS ];
+	ThreadMags ()		{ memset ( cache, 0, sizeof(cache) ); }
+	~ThreadMags () {
+		std::lock_guard<std::mutex> lock ( g_poolMtx );
+		for ( int i = 0; i < MAG_POOLS; i++ ) {
+			auto it = g_pools.find ( cache[i].id );
+			if ( cache[i].id == 0 || it == g_pools.end() ) continue;
+			for ( int b = 0; b < BIN_CNT; b++ ) 
+				it->second->release ( b, cache[i].items[b], cache[i].cnt[b] );
+		}
+	}
+};
+static thread_local ThreadMags t_mags;
+
+static MagCache* pool_cache ( uint32_t id )
+{
+	MagCache* empty = 0x0;
+	for ( int i = 0; i < MAG_POOLS; i++ ) {
+		if ( t_mags.cache[i].id == id ) return &t_mags.cache[i];
+		if ( empty == 0x0 && t_mags.cache[i].id == 0 ) empty = &t_mags.cache[i];
+	}
+	if ( empty == 0x0 ) {
+		// reclaim the cache of a pool that no longer exists
+		std::lock_guard<std::mutex> lock ( g_poolMtx );
+		for ( int i = 0; i < MAG_POOLS && empty == 0x0; i++ ) {
+			if ( g_pools.find ( t_mags.cache[i].id ) == g_pools.end() ) empty = &t_mags.cache[i];
+		}
+		if ( empty == 0x0 ) return 0x0;		// use central bins directly
+	}
+	memset ( empty, 0, sizeof(MagCache) );
+	empty->id = id;
+	return empty;
+}
+
 EventPool :: EventPool()
 {
-	// Preallocate empty bins.
 	for (int n=0; n < BIN_CNT; n++) {
-		mFullBins[n] = 0x0;
-		mEmptyBins[n] = 0x0;
+		mBins[n].slabs = 0x0;
+		mBins[n].pos = 0x0;
+		mBins[n].end = 0x0;
+		mBins[n].live = 0;
 	}
-	for (int n=0; n < BIN_CNT; n++)
-		addBlock ( n );
+	mAllocs = mFrees = mHits = mRefills = mLarge = mSlabs = mReserved = mUsed = mRequested = 0;
+	mID = pool_register ( this );
 }
 EventPool :: ~EventPool()
 {
+	pool_unregister ( mID.load ( std::memory_order_relaxed ) );
 	clear ();
 }
 
 void EventPool::clear ()
 {
-	blockPtr block;
-	blockPtr next;
+	// new id, so items cached by threads are never returned to this pool.
+	// the id is atomic, but slabs are freed below, so no item may still be in use.
+	pool_unregister ( mID.load ( std::memory_order_relaxed ) );
+	mID.store ( pool_register ( this ), std::memory_order_release );
 
 	for (int n=0; n < BIN_CNT; n++) {
-		block = mFullBins[n];
-		while (block != 0x0) {			// traverse linked list
-			next = block->mNext;
-			free ( block );
-			block = next;
-		}
-		block = mEmptyBins[n];
+		std::lock_guard<std::mutex> lock ( mBins[n].mtx );
+		blockPtr block = mBins[n].slabs;
 		while (block != 0x0) {			// traverse linked list
-			next = block->mNext;
+			blockPtr next = block->mNext;
+			#ifndef _WIN32
+				if ( block->mHuge ) { munmap ( block, block->mSize ); block = next; continue; }
+			#endif
 			free ( block );
 			block = next;
 		}
-		mFullBins[n] = 0x0;
-		mEmptyBins[n] = 0x0;
+		mBins[n].slabs = 0x0;
+		mBins[n].pos = mBins[n].end = 0x0;
+		mBins[n].free.clear ();
+		mBins[n].live = 0;
 	}
+	mSlabs = mReserved = mUsed = mRequested = 0;
 }
 
-// Allocate.
-// * Compiles down to 11 asm ops *
-void* EventPool::allocItem ( int size )
+unsigned char EventPool::getBin ( unsigned int v )
 {
-	#ifdef DEBUG_MEMPOOL
-		integrity();
+	// smallest bin with width >= v
+	if ( v <= MIN_WIDTH ) return 0;
+	#if defined(__GNUC__)
+		return (unsigned char) ( 32 - __builtin_clz ( v - 1 ) - MIN_WIDTH_BITS );
+	#else
+		unsigned char b = 0;
+		for ( unsigned int w = MIN_WIDTH; w < v; w <<= 1 ) b++;
+		return b;
 	#endif
-
-	size += sizeof(uint32_t);
-
-	if ( size > MAX_POOL_SIZE ) {
-		dbgprintf ( "  ERROR: Alloc size, %d, greater than MAX_POOL_SIZE (%d).\n", size, MAX_POOL_SIZE );
-	}
-	// include space for freebyte
-	register blockPtr block = mEmptyBins[ getBin ( size ) ];	// Determine bin & block (given alloc size)
-
-	if ( block->mPos == block->mEnd )		// Check if position is beyond end of block
-		block = makeFull ( block );			//    ( if so, make full and make new block )
-
-	block->mPos += block->mWidth;			// Get next item position
-	block->mUsed++;							// Increment used items in block
-
-	#ifdef MEM_CHECK
-		if ( block->mUsed > block->mCount ) {
-			dbgprintf ( "Bad end position. %p %p (%d/%d)\n", block->mPos, block->mEnd, block->mUsed, block->mCount );
-			debug.Exit ( -2 );
-		}
-		dbgprintf ( 'memp', INFO, "  alloc: %p %d/%d, pos %d, item %p\n", block, block->mUsed, block->mCount, (char*) block->mPos - (char*) block, block->mPos );
-		checkBlock ( block );
-	#endif
-	return block->mPos - block->mWidth;
 }
 
-// Free
-void EventPool::freeItem ( void* item )
+int EventPool::getBlockSize ( int bin )
 {
-	#ifdef DEBUG_MEMPOOL
-		integrity();
-	#endif
-	uint32_t* freeword = (uint32_t*) ((char*) item - sizeof(uint32_t));
-	if ( *freeword == 0xFFFF ) { dbgprintf ( "Already freed, %p\n", item );  }
-	register blockPtr block = (blockPtr) ((char*) item - *freeword);	// find the start of block
-
-	*freeword = 0xFFFF;							// mark item as freed
-
-	block->mUsed--;								// Decrement used items in block
-	if ( block->mUsed == 0 ) {					// Check if used items goes to zero
-		block = makeFree ( block );				//    (if so, free the block)
-	}
-	#ifdef MEM_CHECK
-		printE ( 'memp', INFO, "   free: %p %d/%d, pos %d, item %p\n", block, block->mUsed, block->mCount, (char*) item - (char*) block, item );
-		checkBlock ( block );
-	#endif
+	int w = getBinWidth ( bin );
+	if ( w < 65536 ) return BLOCK_SIZE;
+	
+	// large bins. whole huge pages, at least two items
+	int cnt = imax ( 2, HUGE_SLAB_SIZE / w );
+	size_t sz = (size_t) cnt * w + sizeof(MBlock);
+	return (int) ( ( sz + HUGE_SLAB_SIZE - 1 ) / HUGE_SLAB_SIZE * HUGE_SLAB_SIZE );
 }
 
-// Add Block
-blockPtr EventPool::addBlock ( int bin )
+// Allocate.
+// Fast path is a pop from the thread magazine (no lock).
+void* EventPool::allocItem ( int size )
 {
-	// block = add block to front of EmptyBin list
-	blockPtr block = (blockPtr) malloc ( getHeaderSize() + BLOCK_SIZE );	// Malloc block
-	#ifdef MEM_CHECK
-		dbgprintf ( 'memp', INFO,"  BLOCK addBlock: %p\n", block );
-	#endif
-
-	if ( block == 0x0 ) {
-		dbgprintf ( "ERROR: Out of memory.\n" );
+	mAllocs.fetch_add ( 1, std::memory_order_relaxed );
+	unsigned int total = size + sizeof(MItem);
+
+	if ( total > MAX_POOL_SIZE ) {
+		// large item, malloc with pool header
+		MItem* hdr = (MItem*) malloc ( total );
+		if ( hdr == 0x0 ) { dbgprintf ( "ERROR: Out of memory.\n" ); return 0x0; }
+		hdr->mOffset = 0;
+		hdr->mBin = 0;
+		hdr->mMagic = ITEM_USED;
+		hdr->mSize = size;
+		mLarge.fetch_add ( 1, std::memory_order_relaxed );
+		mRequested.fetch_add ( size, std::memory_order_relaxed );
+		return (char*) hdr + sizeof(MItem);
 	}
-	int w = getBlockWidth ( bin );				// Determine block bin, width & count
-	int c = getItemCount ( bin );
-	if ( mEmptyBins[bin] == 0x0 ) {				// Setup header
-		setBlockHeader ( block, w, c, bin );
-		mEmptyBins[bin] = block;
+	int bin = getBin ( total );
+	itemPtr item;
+	MagCache* mag = pool_cache ( getID() );
+	
+	if ( mag != 0x0 && mag->cnt[bin] > 0 ) {
+		item = mag->items[bin][ --mag->cnt[bin] ];						// magazine hit
+		mHits.fetch_add ( 1, std::memory_order_relaxed );
+	} else if ( mag != 0x0 ) {
+		int n = refill ( bin, mag->items[bin], imax ( 1, getMagazineSize(bin) / 2 ) );	// batch from central
+		if ( n == 0 ) return 0x0;
+		mag->cnt[bin] = n - 1;
+		item = mag->items[bin][ n - 1 ];
 	} else {
-		blockPtr next = mEmptyBins[bin];
-		setBlockHeader ( block, w, c, bin);
-		next->mPrev = block;
-		block->mNext = next;
-		mEmptyBins[bin] = block;
+		if ( refill ( bin, &item, 1 ) == 0 ) return 0x0;
 	}
-	// Set freewords on all items
-	// - Header item does not have a freeword
-	// - Freeword is 4 bytes *before* the item, invading the end of previous item
-	// - Freeword stores the negative offset to find the block (during freeItem)
-	uint32_t* freeword = (uint32_t*) ((char*) block + getBlockWidth(bin) - sizeof(uint32_t));
-	for (int n=0; n < c; n++) {
-		*freeword = (char*) (freeword+1) - (char*) block;	// freeword+1 = next 4 bytes
-		freeword += w / sizeof(uint32_t);				// next freeword (in units of uint32_t)
-	}
-	#ifdef MEM_CHECK
-		integrity ();
-	#endif
-	return block;
+	MItem* hdr = (MItem*) item;
+	hdr->mMagic = ITEM_USED;
+	hdr->mSize = size;
+	mBins[bin].live.fetch_add ( 1, std::memory_order_relaxed );
+	mUsed.fetch_add ( getBinWidth(bin), std::memory_order_relaxed );
+	mRequested.fetch_add ( size, std::memory_order_relaxed );
+	return item + sizeof(MItem);
 }
 
-// Make Block a Full block
-blockPtr EventPool::makeFull ( blockPtr block )
+// Free
+// Pushes to the thread magazine. A full magazine returns half its items to the central bin.
+void EventPool::freeItem ( void* ptr )
 {
-	// block = guaranteed to be the front (head) of the EmptyBin linked list
-	#ifdef MEM_CHECK
-		dbgprintf ( "  BLOCK makeFull: %p\n", block );
-	#endif
-
-	int bin = block->mBin;
-	blockPtr next_empty = block->mNext;
-
-	// Make current block full
-	//   (linked list add to front of Full)
-	block->mbFull = true;					// Mark as full
-	if ( mFullBins[bin] == 0x0 ) {
-		block->mNext = 0x0;
-	} else {
-		blockPtr next = mFullBins[bin];		// Linked list insert into full bin
-		next->mPrev = block;
-		block->mNext = next;
+	MItem* hdr = (MItem*) ((char*) ptr - sizeof(MItem));
+	if ( hdr->mMagic != ITEM_USED ) { dbgprintf ( "Already freed, %p\n", ptr ); return; }
+	hdr->mMagic = ITEM_FREE;
+	mFrees.fetch_add ( 1, std::memory_order_relaxed );
+	mRequested.fetch_sub ( hdr->mSize, std::memory_order_relaxed );
+
+	if ( hdr->mOffset == 0 ) {
+		free ( hdr );				// large item
+		return;
 	}
-	block->mPrev = 0x0;
-	mFullBins[bin] = block;
-
-	// Make sure we still have empty blocks
-	//   (linked list remove from front of Empty)
-	if ( next_empty == 0x0 ) {
-		mEmptyBins[bin] = 0x0;
-		next_empty = addBlock ( bin );
-	} else {
-		next_empty->mPrev = 0x0;
-		mEmptyBins[bin] = next_empty;
+	int bin = hdr->mBin;
+	itemPtr item = (itemPtr) hdr;
+	mBins[bin].live.fetch_sub ( 1, std::memory_order_relaxed );
+	mUsed.fetch_sub ( getBinWidth(bin), std::memory_order_relaxed );
+
+	MagCache* mag = pool_cache ( getID() );
+	if ( mag == 0x0 ) {
+		release ( bin, &item, 1 );
+		return;
 	}
-	#ifdef MEM_CHECK
-		integrity ();
-	#endif
-	return mEmptyBins[bin];
+	int max = getMagazineSize ( bin );
+	if ( mag->cnt[bin] >= max ) {
+		int half = max / 2;
+		release ( bin, mag->items[bin] + (max - half), half );
+		mag->cnt[bin] = max - half;
+	}
+	mag->items[bin][ mag->cnt[bin]++ ] = item;
 }
 
-
-// Make Block a Free block
-blockPtr EventPool::makeFree ( blockPtr block )
+void EventPool::flushThread ()
 {
-	// block = any block, in either Full or Empty list
-	#ifdef MEM_CHECK
-		dbgprintf ( "  BLOCK makeFree: %p\n", block );
-	#endif
-
-	int bin = block->mBin;
-	blockPtr prev = block->mPrev;
-	blockPtr next = block->mNext;
+	MagCache* mag = pool_cache ( getID() );
+	if ( mag == 0x0 ) return;
+	for ( int b = 0; b < BIN_CNT; b++ ) {
+		release ( b, mag->items[b], mag->cnt[b] );
+		mag->cnt[b] = 0;
+	}
+}
 
-	if ( next != 0x0 ) {		// Linked list remove from free or full bin (block may be in either)
-		next->mPrev = prev;
+// Take up to cnt free items from a central bin
+int EventPool::refill ( int bin, itemPtr* dest, int cnt )
+{
+	Bin& b = mBins[ bin ];
+	int w = getBinWidth ( bin );
+	int got = 0;
+	std::lock_guard<std::mutex> lock ( b.mtx );
+	mRefills.fetch_add ( 1, std::memory_order_relaxed );
+
+	while ( got < cnt && !b.free.empty() ) {
+		dest[ got++ ] = b.free.back ();
+		b.free.pop_back ();
 	}
-	if ( prev != 0x0 ) {
-		prev->mNext = next;
-	} else {
-		// First block
-		if ( block->mbFull ) {
-			mFullBins[bin] = 0x0;
-		} else {
-			mEmptyBins[bin] = 0x0;
+	while ( got < cnt ) {
+		if ( b.pos + w > b.end ) {
+			if ( addBlock ( bin ) == 0x0 ) break;
 		}
+		// carve new item, header points back to slab
+		MItem* hdr = (MItem*) b.pos;
+		hdr->mOffset = (uint32_t) ( b.pos - (char*) b.slabs );
+		hdr->mBin = bin;
+		hdr->mMagic = ITEM_FREE;
+		dest[ got++ ] = b.pos;
+		b.pos += w;
 	}
-	block->mPrev = 0x0;					// (just to be safe)
-	block->mNext = 0x0;
-	free ( block );						// Free the block
-
-	#ifdef MEM_CHECK
-		integrity ();
-	#endif
+	return got;
+}
 
-	if ( mEmptyBins[bin] == 0x0 )
-		addBlock ( bin );			// Allocate new empty bin if necessary
-	return mEmptyBins[bin];
+// Return items to a central bin
+void EventPool::release ( int bin, itemPtr* src, int cnt )
+{
+	if ( cnt <= 0 ) return;
+	std::lock_guard<std::mutex> lock ( mBins[bin].mtx );
+	mBins[bin].free.insert ( mBins[bin].free.end(), src, src + cnt );
 }
 
-// Setup block header
-void EventPool::setBlockHeader ( blockPtr block, int wid, int count, int bin )
+// Add slab to bin (bin locked)
+blockPtr EventPool::addBlock ( int bin )
 {
+	size_t sz = getBlockSize ( bin );
+	blockPtr block = 0x0;
+	bool huge = false;
+
+	#ifndef _WIN32
+		if ( sz >= HUGE_SLAB_SIZE ) {
+			void* mem = MAP_FAILED;
+			#ifdef MAP_HUGETLB
+				mem = mmap ( NULL, sz, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0 );		// reserved huge pages
+			#endif
+			if ( mem == MAP_FAILED ) {
+				mem = mmap ( NULL, sz, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0 );
+				#ifdef MADV_HUGEPAGE
+					if ( mem != MAP_FAILED ) madvise ( mem, sz, MADV_HUGEPAGE );		// transparent huge pages
+				#endif
+			}
+			if ( mem != MAP_FAILED ) { block = (blockPtr) mem; huge = true; }
+		}
+	#endif
+	if ( block == 0x0 ) block = (blockPtr) malloc ( sz );
+	if ( block == 0x0 ) {
+		dbgprintf ( "ERROR: Out of memory.\n" );
+		return 0x0;
+	}
 	block->mMagic = 'LUNA';
-
-	block->mPos = (itemPtr) block + wid;			// first item position skips the header item
-	block->mEnd = (itemPtr) block + (count-1)*wid;
-	block->mUsed = 0;
-	block->mbFull = false;
 	block->mBin = bin;
-	block->mWidth = wid;
-	block->mCount = count;
-	block->mPrev = 0x0;
-	block->mNext = 0x0;
+	block->mWidth = getBinWidth ( bin );
+	block->mCount = getItemCount ( bin );
+	block->mSize = sz;
+	block->mHuge = huge;
+	block->mNext = mBins[bin].slabs;			// newest slab at front
+	mBins[bin].slabs = block;
+	mBins[bin].pos = (itemPtr) block + sizeof(MBlock);
+	mBins[bin].end = mBins[bin].pos + (size_t) block->mCount * block->mWidth;
+
+	mSlabs.fetch_add ( 1, std::memory_order_relaxed );
+	mReserved.fetch_add ( sz, std::memory_order_relaxed );
+	return block;
 }
 
+// Check carved items of a slab point back to it (bin locked)
 int EventPool::checkBlock ( blockPtr block )
 {
-	int w = block->mWidth;
-	int offset;
-
-	uint32_t* freeword = (uint32_t*) ((char*) block + getBlockWidth(block->mBin) - sizeof(uint32_t));
-	char* item = (char*) block + w;
-	for (int n=0; n < block->mCount; n++) {
-		if ( *freeword == 0xFFFF) continue;		// skip this one
-		blockPtr block_chk = (blockPtr) (item - (char*) *freeword);	 // find the start of block
-		if ( block_chk != block ) {
-			dbgprintf ( "ERROR: Block %d, Item %d, Block (correct) %p, Freeword (wrong) %p\n", n, item, block, block_chk );
+	int bin = block->mBin;
+	itemPtr item = (itemPtr) block + sizeof(MBlock);
+	itemPtr end = ( block == mBins[bin].slabs ) ? mBins[bin].pos : item + (size_t) block->mCount * block->mWidth;
+	int cnt = 0;
+	for ( ; item < end; item += block->mWidth ) {
+		MItem* hdr = (MItem*) item;
+		if ( (itemPtr) block + hdr->mOffset != item || hdr->mBin != bin ) {
+			dbgprintf ( "ERROR: Block %p, Item %p, bad header (offset %u, bin %d)\n", block, item, hdr->mOffset, hdr->mBin );
 			return 0;
 		}
-		freeword += w / sizeof(uint32_t);		// next freeword (in units of uint32_t)
-		item += w;								// next item
+		cnt++;
 	}
-	return block->mCount;
+	return cnt;
 }
 
-
 void EventPool::integrity ()
 {
-	char msg[50];
-	blockPtr block;
-
 	dbgprintf ( "MEMPOOL INTEGRITY\n" );
-	int iOk;
 	for (int n=0; n < BIN_CNT; n++) {
-		block = mEmptyBins[n];
-		dbgprintf ( "  Bin: %d, wid %d, cnt %d. ", n, getItemWidth(n), block->mUsed );
-		iOk = 0;
-		while (block != 0x0) {			// traverse linked list
-            /*#ifdef _MSC_VER
-			sprintf_s ( msg, 50, " %p (%d), ", block, block->mUsed );
-            #else
-			snprintf ( msg, 50, "%p (%d), ", block, block->mUsed );
-            #endif
-			debug.Print ( msg );			*/
-			iOk += checkBlock ( block );
-			block = block->mNext;
-		}
-		dbgprintf ( "%s. %d\n", iOk>0 ? "OK" : "BAD", iOk );
-
-		/*printf ( "  Empty (bin %d, %05d): ", n, getItemWidth(n) );
-		block = mEmptyBins[n];
-		while (block != 0x0) {			// traverse linked list
-            #ifdef _MSC_VER
-			sprintf_s ( msg, 50, "%p (%d), ", block, block->mUsed );
-            #else
-			snprintf ( msg, 50, "%p (%d), ", block, block->mUsed );
-            #endif
-			debug.Print ( msg );
-			checkBlock ( block );
-			block = block->mNext;
+		std::lock_guard<std::mutex> lock ( mBins[n].mtx );
+		int iOk = 0, bad = 0;
+		for ( blockPtr block = mBins[n].slabs; block != 0x0; block = block->mNext ) {
+			int c = checkBlock ( block );
+			if ( c == 0 ) bad++;
+			iOk += c;
 		}
-		debug.Print ( "\n" );*/
+		if ( mBins[n].slabs != 0x0 ) 
+			dbgprintf ( "  Bin: %d, wid %d, live %d. %s. %d\n", n, getItemWidth(n), (int) mBins[n].live, bad==0 ? "OK" : "BAD", iOk );
 	}
 }
 
-// Compute number of allocated items in a bin
-// (Add all items in both full and in use lists)
-int EventPool::getAllocated ( int bin )
+void EventPool::print ()
 {
-	blockPtr block;
-	int bin_cnt=0;
-
-	block = mFullBins[bin];
-	while (block != 0x0) {
-		bin_cnt += block->mUsed;
-		block = block->mNext;
-	}
-	block = mEmptyBins[bin];
-	while (block != 0x0) {
-		bin_cnt += block->mUsed;
-		block = block->mNext;
-	}
-	return bin_cnt;
-}
-
-
-
-//-- Standard log table. Matches width to bin
-const char EventPool::logtable512[] = {
- 0, 1, 2, 2, 3, 3, 3, 3, 4, 4, 4, 4, 4, 4, 4, 4,
- 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5,
- 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6,
- 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6,
- 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7,
- 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7,
- 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7,
- 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7,
- 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8,
- 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8,
- 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8,
- 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8,
- 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8,
- 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8,
- 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8,
- 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8,
- 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9,
- 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9,
- 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9,
- 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9,
- 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9,
- 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9,
- 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9,
- 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9,
- 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9,
- 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9,
- 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9,
- 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9,
- 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9,
- 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9,
- 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9,
- 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9
-};
+	EventPoolStats st = getStats ();
+	dbgprintf ( "EventPool: allocs %llu, hit rate %.1f%%, refills %llu, large %llu, slabs %llu, reserved %llu KB, used %llu KB, frag %.1f%%\n",
+		(unsigned long long) st.allocs, st.hit_rate*100.0f, (unsigned long long) st.refills, (unsigned long long) st.large, 
+		(unsigned long long) st.slabs, (unsigned long long) st.reserved/1024, (unsigned long long) st.used/1024, st.fragmentation*100.0f );
+}
 
-unsigned char EventPool::getBin ( unsigned int v )
+EventPoolStats EventPool::getStats ()
 {
-	// Find integer log base 2 of given width (v).
-	return logtable512[ ((v-1) >> MIN_WIDTH_BITS) ];	// max ( 0, ceil[ log2(v / 64) ] )
+	EventPoolStats st;
+	st.allocs = mAllocs;
+	st.frees = mFrees;
+	st.hits = mHits;
+	st.refills = mRefills;
+	st.large = mLarge;
+	st.slabs = mSlabs;
+	st.reserved = mReserved;
+	st.used = mUsed;
+	st.requested = mRequested;
+	st.hit_rate = ( st.allocs > 0 ) ? float(st.hits) / float(st.allocs) : 0;
+	st.fragmentation = ( st.reserved > 0 ) ? 1.0f - float( imin( st.requested, st.reserved ) ) / float(st.reserved) : 0;
+	return st;
 }
 
+// Number of allocated items in a bin
+int EventPool::getAllocated ( int bin )
+{
+	return mBins[bin].live;
+}
 
 #endif
@@ -0,0 +1,181 @@
+//--------------------------------------------------------------------------------
+// Copyright 2007-2022 (c) Quanta Sciences, Rama Hoetzlein, ramakarl.com
+//
+// * Derivative works may append the above copyright notice but should not remove or modify earlier notices.
+//
+// MIT License:
+// Permission is hereby granted, free of charge, to any person obtaining a copy of this software and
+// associated documentation files (the "Software"), to deal in the Software without restriction, including without
+// limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software,
+// and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+// The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+// OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+// BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF
+// OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+//
+
+
+#include "network_compress.h"
+
+#include <string.h>
+#include <stdint.h>
+
+// LZ4 block format
+// Sequence: token (4 bits literals, 4 bits match-4), extra literal length bytes,
+// literals, 16-bit match offset, extra match length bytes. Lengths of 15 continue in
+// bytes of 255. The last sequence holds only literals, and the last 5 bytes of a block
+// are always literals.
+
+#define LZ4_HASH_LOG		12
+#define LZ4_MIN_MATCH		4
+#define LZ4_MF_LIMIT		12				// last match starts at least this far from end
+#define LZ4_LAST_LITERALS	5
+#define LZ4_MAX_OFFSET		65535
+
+static inline uint32_t lz4_read32 ( const uint8_t* p )
+{
+	uint32_t v;
+	memcpy ( &v, p, 4 );
+	return v;
+}
+static inline uint64_t lz4_read64 ( const uint8_t* p )
+{
+	uint64_t v;
+	memcpy ( &v, p, 8 );
+	return v;
+}
+static inline uint32_t lz4_hash ( uint32_t v )
+{
+	return ( v * 2654435761u ) >> ( 32 - LZ4_HASH_LOG );
+}
+static inline uint8_t* lz4_write_len ( uint8_t* op, int len )
+{
+	for ( ; len >= 255; len -= 255 ) *op++ = 255;
+	*op++ = (uint8_t) len;
+	return op;
+}
+
+int netCompressBound ( int len )
+{
+	return len + len / 255 + 16;
+}
+
+int netCompress ( const char* src_buf, int len, char* dst_buf, int dst_max )
+{
+	const uint8_t* src = (const uint8_t*) src_buf;
+	const uint8_t* ip = src;
+	const uint8_t* anchor = src;
+	const uint8_t* end = src + len;
+	uint8_t* op = (uint8_t*) dst_buf;
+	uint8_t* oend = op + dst_max;
+
+	if ( len > LZ4_MF_LIMIT ) {
+		const uint8_t* mflimit = end - LZ4_MF_LIMIT;
+		const uint8_t* matchlimit = end - LZ4_LAST_LITERALS;
+		int32_t table[ 1 << LZ4_HASH_LOG ];
+		memset ( table, 0xFF, sizeof(table) );				// -1 = empty
+
+		while ( ip < mflimit ) {
+			uint32_t seq = lz4_read32 ( ip );
+			uint32_t h = lz4_hash ( seq );
+			int32_t ref = table[ h ];
+			table[ h ] = (int32_t) ( ip - src );
+			if ( ref < 0 || ( ip - src ) - ref > LZ4_MAX_OFFSET || lz4_read32 ( src + ref ) != seq ) {
+				ip += 1 + ( ( ip - anchor ) >> 6 );			// skip faster through incompressible data
+				continue;
+			}
+			const uint8_t* match = src + ref;
+
+			// extend backward and forward
+			while ( ip > anchor && match > src && ip[-1] == match[-1] ) { ip--; match--; }
+			const uint8_t* p = ip + LZ4_MIN_MATCH;
+			const uint8_t* m = match + LZ4_MIN_MATCH;
+			while ( p + 8 <= matchlimit && lz4_read64 ( p ) == lz4_read64 ( m ) ) { p += 8; m += 8; }
+			while ( p < matchlimit && *p == *m ) { p++; m++; }
+
+			int lit = (int) ( ip - anchor );
+			int mlen = (int) ( p - ip ) - LZ4_MIN_MATCH;
+			if ( oend - op < 1 + lit / 255 + 1 + lit + 2 + mlen / 255 + 1 ) return 0;
+
+			uint8_t* token = op++;
+			*token = (uint8_t) ( ( lit >= 15 ? 15 : lit ) << 4 );
+			if ( lit >= 15 ) op = lz4_write_len ( op, lit - 15 );
+			memcpy ( op, anchor, lit );
+			op += lit;
+			int off = (int) ( ip - match );
+			*op++ = (uint8_t) ( off & 0xFF );
+			*op++ = (uint8_t) ( off >> 8 );
+			*token |= (uint8_t) ( mlen >= 15 ? 15 : mlen );
+			if ( mlen >= 15 ) op = lz4_write_len ( op, mlen - 15 );
+
+			ip = p;
+			anchor = p;
+		}
+	}
+	// last literals
+	int lit = (int) ( end - anchor );
+	if ( oend - op < 1 + lit / 255 + 1 + lit ) return 0;
+	*op++ = (uint8_t) ( ( lit >= 15 ? 15 : lit ) << 4 );
+	if ( lit >= 15 ) op = lz4_write_len ( op, lit - 15 );
+	memcpy ( op, anchor, lit );
+	op += lit;
+
+	return (int) ( op - (uint8_t*) dst_buf );
+}
+
+int netDecompress ( const char* src_buf, int len, char* dst_buf, int dst_len )
+{
+	const uint8_t* ip = (const uint8_t*) src_buf;
+	const uint8_t* iend = ip + len;
+	uint8_t* dst = (uint8_t*) dst_buf;
+	uint8_t* op = dst;
+	uint8_t* oend = dst + dst_len;
+
+	while ( ip < iend ) {
+		int token = *ip++;
+
+		// literals
+		int lit = token >> 4;
+		if ( lit == 15 ) {
+			int b;
+			do {
+				if ( ip >= iend ) return -1;
+				b = *ip++;
+				lit += b;
+			} while ( b == 255 && lit < dst_len );
+		}
+		if ( lit > iend - ip || lit > oend - op ) return -1;
+		memcpy ( op, ip, lit );
+		op += lit;
+		ip += lit;
+		if ( ip >= iend ) break;						// last sequence
+
+		// match
+		if ( iend - ip < 2 ) return -1;
+		int off = ip[0] | ( ip[1] << 8 );
+		ip += 2;
+		if ( off == 0 || off > op - dst ) return -1;
+		int mlen = token & 15;
+		if ( mlen == 15 ) {
+			int b;
+			do {
+				if ( ip >= iend ) return -1;
+				b = *ip++;
+				mlen += b;
+			} while ( b == 255 && mlen < dst_len );
+		}
+		mlen += LZ4_MIN_MATCH;
+		if ( mlen > oend - op ) return -1;
+		// overlapping runs repeat with period off, so copy in growing non-overlapping chunks
+		const uint8_t* m = op - off;
+		while ( mlen > 0 ) {
+			int n = (int) ( op - m ) < mlen ? (int) ( op - m ) : mlen;
+			memcpy ( op, m, n );
+			op += n;
+			mlen -= n;
+		}
+	}
+	return (int) ( op - dst );
+}
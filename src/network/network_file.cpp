@@ -0,0 +1,503 @@
+//--------------------------------------------------------------------------------
+// Copyright 2007-2022 (c) Quanta Sciences, Rama Hoetzlein, ramakarl.com
+//
+// * Derivative works may append the above copyright notice but should not remove or modify earlier notices.
+//
+// MIT License:
+// Permission is hereby granted, free of charge, to any person obtaining a copy of this software and
+// associated documentation files (the "Software"), to deal in the Software without restriction, including without
+// limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software,
+// and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+// The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+// OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+// BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF
+// OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+//
+
+
+#include "network_file.h"
+
+#ifdef _WIN32
+	#define net_fseek		_fseeki64
+	#define net_ftell		_ftelli64
+#else
+	#include <sys/mman.h>
+	#include <sys/stat.h>
+	#include <fcntl.h>
+	#include <unistd.h>
+	#define net_fseek		fseeko
+	#define net_ftell		ftello
+#endif
+
+//----------------------------------------------------------------------------------------------------------------------
+// -> CRC32 <-
+//----------------------------------------------------------------------------------------------------------------------
+
+static uint32_t g_crcTable[ 4 ][ 256 ];
+static bool g_crcInit = false;
+
+static void netCRCInit ()
+{
+	for ( uint32_t n = 0; n < 256; n++ ) {
+		uint32_t c = n;
+		for ( int k = 0; k < 8; k++ ) c = ( c & 1 ) ? 0xEDB88320u ^ ( c >> 1 ) : ( c >> 1 );
+		g_crcTable[ 0 ][ n ] = c;
+	}
+	for ( uint32_t n = 0; n < 256; n++ ) {
+		uint32_t c = g_crcTable[ 0 ][ n ];
+		for ( int t = 1; t < 4; t++ ) {
+			c = g_crcTable[ 0 ][ c & 0xFF ] ^ ( c >> 8 );
+			g_crcTable[ t ][ n ] = c;
+		}
+	}
+	g_crcInit = true;
+}
+
+// CRC32 (IEEE), slice-by-4
+uint32_t netCRC32 ( const char* buf, int len, uint32_t crc )
+{
+	if ( !g_crcInit ) netCRCInit ();
+	const uint8_t* p = (const uint8_t*) buf;
+	crc = ~crc;
+	for ( ; len >= 4; len -= 4, p += 4 ) {
+		crc ^= (uint32_t) p[0] | ( (uint32_t) p[1] << 8 ) | ( (uint32_t) p[2] << 16 ) | ( (uint32_t) p[3] << 24 );
+		crc = g_crcTable[ 3 ][ crc & 0xFF ] ^ g_crcTable[ 2 ][ ( crc >> 8 ) & 0xFF ] ^ g_crcTable[ 1 ][ ( crc >> 16 ) & 0xFF ] ^ g_crcTable[ 0 ][ crc >> 24 ];
+	}
+	for ( ; len > 0; len--, p++ ) crc = g_crcTable[ 0 ][ ( crc ^ *p ) & 0xFF ] ^ ( crc >> 8 );
+	return ~crc;
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+// -> FILE TRANSFER <-
+//----------------------------------------------------------------------------------------------------------------------
+
+static double net_file_sec ()
+{
+	return TimeX::GetSystemNSec () / 1.0e9;
+}
+
+// Resume stamp, the size and modified time of the offer a .part was received from
+static bool net_file_stamp_match ( std::string path, int64_t size, int64_t mtime )
+{
+	FILE* fp = fopen ( path.c_str(), "rb" );
+	if ( fp == 0x0 ) return false;
+	int64_t v[2];
+	bool ok = ( fread ( v, sizeof(v), 1, fp ) == 1 && v[0] == size && v[1] == mtime );
+	fclose ( fp );
+	return ok;
+}
+
+static bool net_file_stamp_write ( std::string path, int64_t size, int64_t mtime )
+{
+	FILE* fp = fopen ( path.c_str(), "wb" );
+	if ( fp == 0x0 ) return false;
+	int64_t v[2] = { size, mtime };
+	bool ok = ( fwrite ( v, sizeof(v), 1, fp ) == 1 );
+	fclose ( fp );
+	return ok;
+}
+
+NetFileTransfer::NetFileTransfer ( NetworkSystem* net )
+{
+	m_net = net;
+	m_nextId = 1;
+	m_chunk = NET_FILE_CHUNK;
+	m_window = NET_FILE_WINDOW;
+	m_accept = false;
+	netCRCInit ();
+}
+
+NetFileTransfer::~NetFileTransfer ()
+{
+	for ( auto& it : m_files ) {
+		if ( it.second.info.state <= NET_FILE_ACTIVE ) netFileClose ( it.second, NET_FILE_CANCELED );
+	}
+}
+
+NetFileTransfer::NetFileXfer* NetFileTransfer::netFileFind ( int id, int sock_i, bool sending )
+{
+	auto it = m_files.find ( netFileKey ( id, sock_i, sending ) );
+	return ( it == m_files.end() ) ? 0x0 : &it->second;
+}
+
+bool NetFileTransfer::getFileInfo ( int id, int sock_i, NetFileInfo& info, bool sending )
+{
+	std::lock_guard<std::mutex> lock ( m_mtx );
+	NetFileXfer* x = netFileFind ( id, sock_i, sending );
+	if ( x == 0x0 ) return false;
+	info = x->info;
+	return true;
+}
+
+int NetFileTransfer::getNumFiles ()
+{
+	std::lock_guard<std::mutex> lock ( m_mtx );
+	return (int) m_files.size();
+}
+
+bool NetFileTransfer::getFileInfoByIndex ( int n, NetFileInfo& info )
+{
+	std::lock_guard<std::mutex> lock ( m_mtx );
+	if ( n < 0 || n >= (int) m_files.size() ) return false;
+	auto it = m_files.begin ();
+	std::advance ( it, n );
+	info = it->second.info;
+	return true;
+}
+
+void NetFileTransfer::netFileRemove ( int id, int sock_i, bool sending )
+{
+	std::lock_guard<std::mutex> lock ( m_mtx );
+	netFileErase ( id, sock_i, sending );
+}
+
+void NetFileTransfer::netFileErase ( int id, int sock_i, bool sending )
+{
+	auto it = m_files.find ( netFileKey ( id, sock_i, sending ) );
+	if ( it == m_files.end() ) return;
+	if ( it->second.info.state <= NET_FILE_ACTIVE ) netFileClose ( it->second, NET_FILE_CANCELED );
+	m_files.erase ( it );
+}
+
+// Release file handles, and finish the receive file
+void NetFileTransfer::netFileClose ( NetFileXfer& x, int state )
+{
+	NetFileInfo& f = x.info;
+	#ifndef _WIN32
+		if ( x.map != 0x0 ) munmap ( x.map, (size_t) f.size );
+		if ( x.fd >= 0 ) close ( x.fd );
+	#endif
+	x.map = 0x0;
+	x.fd = -1;
+	if ( x.fp != 0x0 ) fclose ( x.fp );
+	x.fp = 0x0;
+
+	if ( !f.sending && state == NET_FILE_DONE ) {
+		std::string part = f.path + ".part";
+		remove ( f.path.c_str() );
+		if ( rename ( part.c_str(), f.path.c_str() ) != 0 ) state = NET_FILE_FAILED;
+		else remove ( ( part + ".id" ).c_str() );
+	}
+	f.state = state;
+}
+
+void NetFileTransfer::netFileReply ( eventStr_t name, int id, int64_t offset, int sock_i )
+{
+	Event e;
+	new_event ( e, sizeof(int) + sizeof(int64_t), 'file', name, 0, m_net->getNetPool() );
+	e.attachInt ( id );
+	e.attachInt64 ( (xlong) offset );
+	m_net->netSend ( e, sock_i );
+}
+
+// Offer a file to the peer on sock_i. Chunks follow once the peer accepts.
+int NetFileTransfer::netFileSend ( std::string path, int sock_i, std::string name )
+{
+	NetFileXfer x;
+	x.fp = 0x0;
+	x.map = 0x0;
+	x.fd = -1;
+	x.nak = false;
+	int64_t size = 0;
+	int64_t mtime = 0;
+
+	#ifdef _WIN32
+		x.fp = fopen ( path.c_str(), "rb" );
+		if ( x.fp == 0x0 ) return -1;
+		net_fseek ( x.fp, 0, SEEK_END );
+		size = net_ftell ( x.fp );
+		net_fseek ( x.fp, 0, SEEK_SET );
+		struct _stat64 st;
+		if ( _stat64 ( path.c_str(), &st ) == 0 ) mtime = (int64_t) st.st_mtime;
+	#else
+		x.fd = open ( path.c_str(), O_RDONLY );
+		if ( x.fd < 0 ) return -1;
+		struct stat st;
+		if ( fstat ( x.fd, &st ) != 0 ) { close ( x.fd ); return -1; }
+		size = st.st_size;
+		mtime = (int64_t) st.st_mtime;
+		if ( size > 0 ) {
+			void* m = mmap ( 0x0, (size_t) size, PROT_READ, MAP_SHARED, x.fd, 0 );
+			if ( m == MAP_FAILED ) { close ( x.fd ); return -1; }
+			x.map = (char*) m;
+			madvise ( m, (size_t) size, MADV_SEQUENTIAL );
+		}
+	#endif
+
+	if ( name.empty() ) {
+		size_t slash = path.find_last_of ( "/\\" );
+		name = ( slash == std::string::npos ) ? path : path.substr ( slash + 1 );
+	}
+	std::lock_guard<std::mutex> lock ( m_mtx );
+	NetFileInfo& f = x.info;
+	f.id = m_nextId++;
+	f.sock = sock_i;
+	f.sending = true;
+	f.state = NET_FILE_OFFER;
+	f.name = name;
+	f.path = path;
+	f.size = size;
+	f.done = 0;
+	f.resumed = 0;
+	f.chunk = m_chunk;
+	f.retries = 0;
+	f.start = net_file_sec ();
+	f.elapsed = 0;
+	f.mb_per_sec = 0;
+	x.next = 0;
+
+	Event e;
+	new_event ( e, 64 + name.length(), 'file', 'fOfr', 0, m_net->getNetPool() );
+	e.attachInt ( f.id );
+	e.attachInt64 ( (xlong) size );
+	e.attachInt ( f.chunk );
+	e.attachStr ( name );
+	e.attachInt64 ( (xlong) mtime );
+	if ( !m_net->netSend ( e, sock_i ) ) {
+		netFileClose ( x, NET_FILE_FAILED );
+		return -1;
+	}
+	m_files[ netFileKey ( f.id, sock_i, true ) ] = x;
+	return f.id;
+}
+
+void NetFileTransfer::netFileCancel ( int id, int sock_i, bool sending )
+{
+	std::lock_guard<std::mutex> lock ( m_mtx );
+	NetFileXfer* x = netFileFind ( id, sock_i, sending );
+	if ( x == 0x0 || x->info.state > NET_FILE_ACTIVE ) return;
+	netFileStop ( *x );
+}
+
+// Cancel a transfer and tell the peer
+void NetFileTransfer::netFileStop ( NetFileXfer& x )
+{
+	NetFileInfo& f = x.info;
+	netFileClose ( x, NET_FILE_CANCELED );				// receiver keeps .part for resume
+
+	Event e;
+	new_event ( e, 2*sizeof(int), 'file', 'fCan', 0, m_net->getNetPool() );
+	e.attachInt ( f.id );
+	e.attachInt ( f.sending ? 1 : 0 );
+	m_net->netSend ( e, f.sock );
+}
+
+// Send one chunk at x.next
+void NetFileTransfer::netFileSendChunk ( NetFileXfer& x )
+{
+	NetFileInfo& f = x.info;
+	int len = (int) std::min ( (int64_t) f.chunk, f.size - x.next );
+
+	Event e;
+	new_event ( e, sizeof(int)*3 + sizeof(int64_t) + len, 'file', 'fChk', 0, m_net->getNetPool() );
+	e.attachInt ( f.id );
+	e.attachInt64 ( (xlong) x.next );
+	char* crc_pos = e.getPos ();
+	e.attachUInt ( 0 );
+	e.attachInt ( len );
+	char* data = e.getPos ();
+	if ( x.map != 0x0 ) {
+		e.attachBuf ( x.map + x.next, len );					// from mapped file
+	} else {
+		net_fseek ( x.fp, x.next, SEEK_SET );
+		e.attachFromFile ( x.fp, len );
+	}
+	uint32_t crc = netCRC32 ( data, len );
+	memcpy ( crc_pos, &crc, sizeof(uint32_t) );
+
+	if ( m_net->netSendAcquire ( e, f.sock ) ) x.next += len;			// chunk is not reused, send without a copy
+}
+
+void NetFileTransfer::netFileRecvOffer ( Event& e )
+{
+	int sock_i = e.getSrcSock ();
+	int id = e.getInt ();
+	int64_t size = (int64_t) e.getInt64 ();
+	int chunk = e.getInt ();
+	std::string name = e.getStr ();
+	int64_t mtime = (int64_t) e.getInt64 ();
+
+	// plain file names only, never a path out of the receive directory
+	bool plain = !name.empty() && name != "." && name.find_first_of ( "/\\:" ) == std::string::npos && name.find ( ".." ) == std::string::npos;
+	if ( !m_accept || !plain || chunk <= 0 || size < 0 ) {
+		netFileReply ( 'fAcc', id, -1, sock_i );
+		return;
+	}
+
+	// repeated offer replaces the transfer, releasing its file first
+	netFileErase ( id, sock_i, false );
+
+	NetFileXfer x;
+	x.map = 0x0;
+	x.fd = -1;
+	x.nak = false;
+	NetFileInfo& f = x.info;
+	f.id = id;
+	f.sock = sock_i;
+	f.sending = false;
+	f.state = NET_FILE_ACTIVE;
+	f.name = name;
+	f.path = m_recvDir.empty() ? name : m_recvDir + "/" + name;
+	f.size = size;
+	f.chunk = chunk;
+	f.retries = 0;
+	f.start = net_file_sec ();
+	f.elapsed = 0;
+	f.mb_per_sec = 0;
+
+	// resume from a partial file of the same offer, at a whole chunk
+	std::string part = f.path + ".part";
+	std::string stamp = part + ".id";
+	int64_t resume = 0;
+	x.fp = net_file_stamp_match ( stamp, size, mtime ) ? fopen ( part.c_str(), "r+b" ) : 0x0;
+	if ( x.fp != 0x0 ) {
+		net_fseek ( x.fp, 0, SEEK_END );
+		resume = net_ftell ( x.fp );
+		if ( resume > size ) {
+			fclose ( x.fp );							// longer than the file, start over
+			x.fp = 0x0;
+			resume = 0;
+		} else {
+			resume -= resume % chunk;
+		}
+	}
+	if ( x.fp == 0x0 ) {
+		x.fp = fopen ( part.c_str(), "wb" );		// new or truncated
+		if ( x.fp != 0x0 && !net_file_stamp_write ( stamp, size, mtime ) ) {
+			fclose ( x.fp );
+			x.fp = 0x0;
+		}
+	}
+	if ( x.fp == 0x0 ) {
+		netFileReply ( 'fAcc', id, -1, sock_i );
+		return;
+	}
+	f.done = resume;
+	f.resumed = resume;
+	x.next = resume;
+
+	NetFileXfer& nx = m_files[ netFileKey ( id, sock_i, false ) ] = x;
+	netFileReply ( 'fAcc', id, resume, sock_i );
+	if ( resume == size ) netFileClose ( nx, NET_FILE_DONE );
+}
+
+void NetFileTransfer::netFileRecvChunk ( Event& e )
+{
+	int sock_i = e.getSrcSock ();
+	int id = e.getInt ();
+	int64_t offset = (int64_t) e.getInt64 ();
+	uint32_t crc = e.getUInt ();
+	int len = e.getInt ();
+	NetFileXfer* x = netFileFind ( id, sock_i, false );
+	if ( x == 0x0 || x->info.state != NET_FILE_ACTIVE ) return;
+	if ( offset != x->next ) return;						// in flight after a resend request, dropped
+
+	NetFileInfo& f = x->info;
+	char* data = e.getPos ();
+	if ( len < 0 || len > (int) ( e.getDataLength() - e.getPosInt() ) || offset + len > f.size || netCRC32 ( data, len ) != crc ) {
+		f.retries++;
+		netFileReply ( 'fNak', id, x->next, sock_i );
+		return;
+	}
+	net_fseek ( x->fp, offset, SEEK_SET );
+	if ( fwrite ( data, 1, len, x->fp ) != (size_t) len ) {
+		netFileStop ( *x );
+		f.state = NET_FILE_FAILED;
+		return;
+	}
+	x->next += len;
+	f.done = x->next;
+	netFileReply ( 'fAck', id, x->next, sock_i );
+	if ( x->next == f.size ) netFileClose ( *x, NET_FILE_DONE );
+}
+
+int NetFileTransfer::netFileEvent ( Event& e )
+{
+	if ( e.getTarget() != 'file' ) return 0;
+	e.startRead ();
+
+	std::lock_guard<std::mutex> lock ( m_mtx );
+
+	NetFileXfer* x;
+	int sock_i = e.getSrcSock ();
+	switch ( e.getName () ) {
+	case 'fOfr':	netFileRecvOffer ( e );		return 1;
+	case 'fChk':	netFileRecvChunk ( e );		return 1;
+	case 'fAcc': {
+		int id = e.getInt ();
+		int64_t offset = (int64_t) e.getInt64 ();
+		x = netFileFind ( id, sock_i, true );
+		if ( x == 0x0 || x->info.state != NET_FILE_OFFER ) return 1;
+		if ( offset < 0 || offset > x->info.size ) {
+			netFileClose ( *x, NET_FILE_FAILED );
+			return 1;
+		}
+		x->info.state = NET_FILE_ACTIVE;
+		x->info.resumed = offset;
+		x->info.done = offset;
+		x->info.start = net_file_sec ();
+		x->next = offset;
+		if ( offset == x->info.size ) netFileClose ( *x, NET_FILE_DONE );
+		return 1;
+	}
+	case 'fAck': {
+		int id = e.getInt ();
+		int64_t offset = (int64_t) e.getInt64 ();
+		x = netFileFind ( id, sock_i, true );
+		if ( x == 0x0 || x->info.state != NET_FILE_ACTIVE ) return 1;
+		if ( offset > x->info.done ) x->info.done = offset;
+		if ( x->info.done >= x->info.size ) netFileClose ( *x, NET_FILE_DONE );
+		return 1;
+	}
+	case 'fNak': {
+		int id = e.getInt ();
+		int64_t offset = (int64_t) e.getInt64 ();
+		x = netFileFind ( id, sock_i, true );
+		if ( x == 0x0 || x->info.state != NET_FILE_ACTIVE ) return 1;
+		if ( offset >= x->info.done && offset < x->next ) {
+			x->next = offset;											// go back
+			x->info.retries++;
+		}
+		return 1;
+	}
+	case 'fCan': {
+		int id = e.getInt ();
+		bool from_sender = e.getInt () != 0;
+		x = netFileFind ( id, sock_i, !from_sender );
+		if ( x != 0x0 && x->info.state <= NET_FILE_ACTIVE ) netFileClose ( *x, NET_FILE_CANCELED );
+		return 1;
+	}
+	};
+	return 1;
+}
+
+// Fill the send window of each active transfer, and update rates
+void NetFileTransfer::netFileRun ()
+{
+	std::lock_guard<std::mutex> lock ( m_mtx );
+	double now = net_file_sec ();
+	for ( auto& it : m_files ) {
+		NetFileXfer& x = it.second;
+		NetFileInfo& f = x.info;
+		if ( f.state > NET_FILE_ACTIVE ) continue;
+
+		if ( !m_net->netIsConnectComplete ( f.sock ) ) {
+			netFileClose ( x, NET_FILE_FAILED );			// resumed by a new offer after reconnect
+			continue;
+		}
+		if ( f.state != NET_FILE_ACTIVE ) continue;
+
+		f.elapsed = now - f.start;
+		if ( f.elapsed > 0 ) f.mb_per_sec = float ( ( f.done - f.resumed ) / f.elapsed / ( 1024.0 * 1024.0 ) );
+
+		if ( !f.sending ) continue;
+		int64_t window = (int64_t) m_window * f.chunk;
+		while ( x.next < f.size && x.next - f.done < window && m_net->netGetSendQueued ( f.sock ) < window ) {
+			int64_t prev = x.next;
+			netFileSendChunk ( x );
+			if ( x.next == prev ) break;							// send queue full
+		}
+	}
+}
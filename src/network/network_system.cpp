@@ -16,6 +16,8 @@
 // -DFLOW netShowFlow					// enable detailed trace flow (via arg or func)
 // -DSTAT netShowStats				// enable network performance stats
 #define DEBUG_NETPRINT			// enable printf calls throughout net system
+// #define NET_LOG_LEVEL	2			// highest NPRINTF level compiled in: 0 none, 1 errors, 2 verbose, 3 flow (default)
+// #define NET_TRACE_RING			// enable binary trace points (see network_trace.h)
 // #define DEBUG_STREAM				// enable read/write network stream to disk file
 // #define DEBUG_SIM_LATENCY		// simulate high latency (adds 100 ms before send)
 // #define TRACE_FUNCTION_CALLS		// enable detailed flow tracing
@@ -23,13 +25,27 @@
 
 //---------
 
-#ifdef DEBUG_NETPRINT
-	#define NPRINTF(flag, fmt, ...) 	netPrintf ( flag, fmt, ##__VA_ARGS__ );
+#ifndef NET_LOG_LEVEL
+	#ifdef DEBUG_NETPRINT
+		#define NET_LOG_LEVEL		3
+	#else
+		#define NET_LOG_LEVEL		0
+	#endif
+#endif
+
+// Levels above NET_LOG_LEVEL compile out. Runtime flags are tested before
+// the arguments are evaluated, so disabled prints cost no formatting.
+#if NET_LOG_LEVEL > 0
+	#define NPRINTF(flag, fmt, ...) 	do { if ( net_log_level ( flag ) <= NET_LOG_LEVEL && netPrintOn ( flag ) ) netPrintf ( flag, fmt, ##__VA_ARGS__ ); } while (0)
 #else
 	#define NPRINTF(flag, fmt, ...) 	((void) 0)
 #endif
 
 #include "network_system.h"
+#include "network_trace.h"
+#include "network_compress.h"
+#include <algorithm>
+#include <climits>
 
 #ifdef __linux__
 	#include <net/if.h> 	
@@ -45,6 +61,30 @@
 	#include <netinet/tcp.h> 
 #endif
 
+#ifdef __linux__
+	#include <sys/eventfd.h>
+	#define NET_WAKE_ID					0xFFFFFFFF		// epoll data of the wake fd
+#endif
+
+#if defined(__linux__) && !defined(__ANDROID__)
+	#include <sys/mman.h>
+	#define NET_RING_MIRROR				// mirrored receive ring (memfd + double mmap)
+#endif
+
+#if defined(__linux__) && ( !defined(__ANDROID__) || __ANDROID_API__ >= 21 )
+	#include <netinet/udp.h>
+	#define NET_UDP_MMSG					// batched datagrams (recvmmsg/sendmmsg)
+	#ifndef SOL_UDP
+		#define SOL_UDP				17
+	#endif
+	#ifndef UDP_SEGMENT
+		#define UDP_SEGMENT		103		// GSO, linux 4.18
+	#endif
+	#ifndef UDP_GRO
+		#define UDP_GRO				104		// GRO, linux 5.0
+	#endif
+#endif
+
 //#undef BUILD_OPENSSL
 
 #ifdef BUILD_OPENSSL
@@ -55,8 +95,24 @@
 	#include <openssl/md5.h>
 	#include <openssl/ssl.h>	
 	#include <openssl/x509v3.h>
+	#include <openssl/rand.h>
+#endif
+
+// Flags of TCP sends. A send to a closed peer fails with EPIPE instead of raising SIGPIPE,
+// so the app keeps its own SIGPIPE handler. Without MSG_NOSIGNAL, CXSocketCreate sets
+// SO_NOSIGPIPE where the platform has it (windows has no SIGPIPE).
+#ifdef MSG_NOSIGNAL
+	#define NET_SEND_FLAGS				MSG_NOSIGNAL
+#else
+	#define NET_SEND_FLAGS				0
 #endif
 
+// Key of a socket destination (ip:port), for the destination index and TLS sessions
+static inline uint64_t net_dest_key ( netIP ip, int port )
+{
+	return ( (uint64_t) (uint32_t) ip << 16 ) | (uint16_t) port;
+}
+
 
 //----------------------------------------------------------------------------------------------------------------------
 // TRACING FUNCTIONS
@@ -394,16 +450,63 @@ inline str NetworkSystem::CXGetIpStr ( netIP ip )
 // -> MAIN CODE <-
 //----------------------------------------------------------------------------------------------------------------------
 
-NetworkSystem::NetworkSystem ( const char* trace_file_name )
+NetworkSystem::NetworkSystem ( const char* trace_file_name ) : m_postQueue ( 256 )
 {
 	m_hostType = ' ';
 	m_hostIp = 0;
 	m_readyServices = 0;
 	m_userEventCallback = 0;
+	m_handlerShift = 64;
 	m_rcvSelectTimout.tv_sec = 0;
 	m_rcvSelectTimout.tv_usec = 1e3;
-	m_lastClientConnectCheck.SetTimeNSec ( );
 	m_udp_sock.state = STATE_NONE;	
+	m_sockOut = -1;
+
+	#ifdef __linux__
+		m_pollMode = NET_POLL_EPOLL;		// default to epoll on linux
+	#else
+		m_pollMode = NET_POLL_SELECT;
+	#endif
+	m_pollFd = -1;
+	m_wakeFd = -1;
+	m_sendQueueMax = 4*1024*1024;		// 4 MB queued per socket
+	m_sendCoalesce = false;
+	m_sendZeroCopyMin = 16384;		// hold events of 16 KB or more by reference
+	m_compressMin = 0;						// no compression
+	m_tlsWrite = 65536;						// 4 full TLS records per write
+	m_tlsCoalesce = true;
+	m_tlsResume = true;
+	#ifdef BUILD_OPENSSL
+		m_tlsCtxSrv = 0x0;
+		m_tlsCtxCli = 0x0;
+	#endif
+	m_recvRingSize = 65536;				// 64 KB initial receive ring
+	m_recvViews = false;
+	m_maxEventSize = 64*1024*1024;		// 64 MB largest received event
+	m_recvHandled = 0;
+	#ifdef NET_UDP_MMSG
+		m_udpBatch = NET_UDP_BATCH;
+	#else
+		m_udpBatch = 1;
+	#endif
+	m_udpOffload = false;
+	for (int c=0; c < NET_REL_CHANNELS; c++) 
+		m_relChannel[ c ] = (c <= NET_CHAN_UNRELIABLE_SEQUENCED) ? c : NET_CHAN_RELIABLE_ORDERED;		// channel id = type for first four
+	m_relRetransmit = 100;				// 100 msec, or twice round trip
+	m_udpLoss = 0;
+	m_udpLossSeed = 1;
+	m_udpLost = 0;
+	m_emuOn = false;
+	m_statInterval = 1000;				// 1 sec, RTT sampling
+	m_statLast.SetTimeNSec ();
+	m_dispatchTime = 0;
+	m_owner = this;
+	m_sockBase = 0;
+	m_sockPub = 0x0;
+	m_sockPubCnt = 0;
+	m_workerRun = false;
+	m_assignMode = NET_ASSIGN_ROUNDROBIN;
+	m_assignNext = 0;
 
 	m_security = NET_SECURITY_PLAIN_TCP;
 	m_pathPublicKey = str("");
@@ -422,12 +525,18 @@ NetworkSystem::NetworkSystem ( const char* trace_file_name )
 	// default timings
 	m_reconnectInterval = 1000;		// 1 seconds
 	m_reconnectMaxCount = 10;			// 10x tries
+	m_reconnectMax = 30000;				// backoff to 30 seconds
+	m_reconnectJitter = 0.5f;			// less up to half
 	m_processInterval = 50;	 	  // 50 msec, packet interval
+	m_idleTimeout = 0;						// off
+	m_heartbeat = 0;							// off
 
 	TimeX curr_time;
 	curr_time.SetTimeNSec();
-	m_lastClientConnectCheck = curr_time;
 	m_lastNetProcess = curr_time;
+	m_tickMs = TimeX::GetSystemNSec ( ) / MSEC_SCALAR;
+	m_timers.init ( m_tickMs );
+	m_jitterSeed = (uint32_t) TimeX::GetSystemNSec ( ) | 1;
 
 	NPRINTF(VERBOSE, "SERIALIZED HEADER SIZE: %d\n", Event::staticSerializedHeaderSize());
 	
@@ -485,6 +594,69 @@ bool NetworkSystem::valid_socket_index ( int i )
 //----------------------------------------------------------------------------------------------------------------------
 
 #ifdef BUILD_OPENSSL
+
+// Socket BIO
+// As the OpenSSL socket BIO, but sends with NET_SEND_FLAGS, so a TLS write to a closed peer
+// fails rather than raising SIGPIPE. The socket is not closed when the BIO is freed.
+static bool net_bio_retry ( )
+{
+	#ifdef _WIN32
+		int err = WSAGetLastError ( );
+		return err == WSAEWOULDBLOCK || err == WSAEINTR;
+	#else
+		return errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR;
+	#endif
+}
+
+static int net_bio_write ( BIO* b, const char* buf, int len )
+{
+	BIO_clear_retry_flags ( b );
+	int ret = (int) send ( (CX_SOCKET) (intptr_t) BIO_get_data ( b ), buf, len, NET_SEND_FLAGS );
+	if ( ret < 0 && net_bio_retry ( ) ) BIO_set_retry_write ( b );
+	return ret;
+}
+
+static int net_bio_read ( BIO* b, char* buf, int len )
+{
+	BIO_clear_retry_flags ( b );
+	int ret = (int) recv ( (CX_SOCKET) (intptr_t) BIO_get_data ( b ), buf, len, 0 );
+	if ( ret < 0 && net_bio_retry ( ) ) BIO_set_retry_read ( b );
+	if ( ret == 0 ) BIO_set_flags ( b, BIO_FLAGS_IN_EOF );			// peer closed, seen by SSL as an unexpected eof
+	return ret;
+}
+
+static long net_bio_ctrl ( BIO* b, int cmd, long num, void* ptr )
+{
+	switch ( cmd ) {
+	case BIO_C_GET_FD:						// SSL_get_fd
+		if ( ptr != 0x0 ) *(int*) ptr = (int) (intptr_t) BIO_get_data ( b );
+		return (long) (intptr_t) BIO_get_data ( b );
+	case BIO_CTRL_EOF:		return BIO_test_flags ( b, BIO_FLAGS_IN_EOF ) ? 1 : 0;
+	case BIO_CTRL_FLUSH:	return 1;
+	case BIO_CTRL_DUP:		return 1;
+	}
+	return 0;
+}
+
+static BIO_METHOD* net_bio_create_method ( )
+{
+	BIO_METHOD* m = BIO_meth_new ( BIO_get_new_index ( ) | BIO_TYPE_SOURCE_SINK | BIO_TYPE_DESCRIPTOR, "libmin socket" );
+	if ( m == 0x0 ) return 0x0;
+	BIO_meth_set_write ( m, net_bio_write );
+	BIO_meth_set_read ( m, net_bio_read );
+	BIO_meth_set_ctrl ( m, net_bio_ctrl );
+	return m;
+}
+
+static BIO* net_bio_new ( CX_SOCKET sock )
+{
+	static BIO_METHOD* meth = net_bio_create_method ( );		// once, shared by all systems and workers
+	BIO* b = ( meth == 0x0 ) ? 0x0 : BIO_new ( meth );
+	if ( b == 0x0 ) return 0x0;
+	BIO_set_data ( b, (void*) (intptr_t) sock );
+	BIO_set_init ( b, 1 );
+	return b;
+}
 	
 str NetworkSystem::netGetErrorStringSSL ( int ret, SSL* ssl ) 
 {		 
@@ -552,95 +724,158 @@ void NetworkSystem::netFreeSSL ( int sock_i )
 	TRACE_EXIT ( (__func__) );
 }
 
-void NetworkSystem::netServerSetupHandshakeSSL ( int sock_i ) 
+// TLS ticket keys
+// 80 bytes: key name, HMAC secret, AES key. Created on first use and kept in the file,
+// so tickets issued before a server restart can still be decrypted after it.
+static bool tls_ticket_keys ( SSL_CTX* ctx, str path )
+{
+	unsigned char keys[ 80 ];
+	FILE* fp = fopen ( path.c_str(), "rb" );
+	bool ok = ( fp != 0x0 && fread ( keys, 1, 80, fp ) == 80 );
+	if ( fp != 0x0 ) fclose ( fp );
+	if ( !ok ) {
+		if ( RAND_bytes ( keys, 80 ) != 1 ) return false;
+		fp = fopen ( path.c_str(), "wb" );
+		if ( fp == 0x0 ) return false;
+		#ifndef _WIN32
+			chmod ( path.c_str(), 0600 );			// secret
+		#endif
+		ok = ( fwrite ( keys, 1, 80, fp ) == 80 );
+		fclose ( fp );
+	}
+	ok = ok && SSL_CTX_set_tlsext_ticket_keys ( ctx, keys, 80 ) == 1;
+	OPENSSL_cleanse ( keys, 80 );
+	return ok;
+}
+
+// Server context
+// Created once and shared by all server sockets, including those of workers, so the
+// certificate and key are loaded once, and a ticket issued on one socket resumes on any.
+SSL_CTX* NetworkSystem::netGetServerCtxSSL ( )
 {
 	TRACE_ENTER ( (__func__) );
-	char msg[ 2048 ];
-	NetSock& s = m_socks [ sock_i ];
-	CXSocketMakeNoDelay ( s.socket );
+	NetworkSystem* sys = m_owner;
+	std::lock_guard<std::mutex> lock ( sys->m_tlsMtx );
+	if ( sys->m_tlsCtxSrv != 0x0 ) {
+		TRACE_EXIT ( (__func__) );
+		return sys->m_tlsCtxSrv;
+	}
 	int ret = 0, exp;
-	CXSocketSetBlockMode ( s.socket, false);		// non-blocking	
-
-	s.security |= NET_SECURITY_FAIL; 
-	s.state = STATE_FAILED; 
-	s.lastStateChange.SetTimeNSec ( );
-
-	if ( ( s.ctx = SSL_CTX_new ( TLS_server_method ( ) ) ) == 0 ) {
-		NPRINTF ( ERROR_HS, "Failed at new ssl ctx" );
-		netFreeSSL ( s.socket );
+	SSL_CTX* ctx = SSL_CTX_new ( TLS_server_method ( ) );
+	if ( ctx == 0 ) {
+		NPRINTF ( DERROR_HS, "Failed at new ssl ctx" );
 		TRACE_EXIT ( (__func__) );
-		return;
+		return 0x0;
 	}
 
 	exp = SSL_OP_SINGLE_DH_USE;
-	if ( ( ( ret = SSL_CTX_set_options ( s.ctx, exp ) ) & exp ) != exp ) {
-		NPRINTF ( ERROR_HS, "Failed at: set ssl option: Return: %d", ret );
-		netFreeSSL ( sock_i );
+	if ( ( ( ret = SSL_CTX_set_options ( ctx, exp ) ) & exp ) != exp ) {
+		NPRINTF ( DERROR_HS, "Failed at: set ssl option: Return: %d", ret );
+		SSL_CTX_free ( ctx );
 		TRACE_EXIT ( (__func__) );
-		return;
+		return 0x0;
 	} else {
 		NPRINTF ( VERBOSE_HS, "Call to set ssl option succeded" );
 	}
 
-	if ( ( ret = SSL_CTX_set_default_verify_paths ( s.ctx ) ) <= 0 ) { // Set CA veryify locations for trusted certs
-		NPRINTF ( ERROR_HS, "Default verify paths failed: Return: %d", ret );
+	if ( ( ret = SSL_CTX_set_default_verify_paths ( ctx ) ) <= 0 ) { // Set CA veryify locations for trusted certs
+		NPRINTF ( DERROR_HS, "Default verify paths failed: Return: %d", ret );
 	} else {
 		NPRINTF ( VERBOSE_HS, "Call to default verify paths succeded" );
 	}
 	const char* fmt = "Trusted cert paths. CA file = %s, CA dir = %s";
-	NPRINTF ( VERBOSE_HS, fmt, m_pathCertFile.c_str ( ), m_pathCertDir.c_str ( ) );
+	NPRINTF ( VERBOSE_HS, fmt, sys->m_pathCertFile.c_str ( ), sys->m_pathCertDir.c_str ( ) );
 
-	if ( ! m_pathCertFile.empty ( ) || ! m_pathCertDir.empty ( ) ) {
-		ret = ret = SSL_CTX_load_verify_locations ( s.ctx, m_pathCertFile.c_str ( ) , m_pathCertDir.c_str ( ) );
+	if ( ! sys->m_pathCertFile.empty ( ) || ! sys->m_pathCertDir.empty ( ) ) {
+		ret = SSL_CTX_load_verify_locations ( ctx, sys->m_pathCertFile.c_str ( ) , sys->m_pathCertDir.c_str ( ) );
 		if ( ret <= 0 ) {
-			NPRINTF ( ERROR_HS, "Load verify locations failed on cert file: %s", m_pathCertFile.c_str ( ) );
+			NPRINTF ( DERROR_HS, "Load verify locations failed on cert file: %s", sys->m_pathCertFile.c_str ( ) );
 		} else {
 			NPRINTF ( VERBOSE_HS, "Call to load verify locations succeded" );
 		}
 	}
 
+	SSL_CTX_set_verify ( ctx, SSL_VERIFY_PEER, NULL );
 
-	SSL_CTX_set_verify ( s.ctx, SSL_VERIFY_PEER, NULL );
-
-	if ( ( ret = SSL_CTX_use_certificate_file ( s.ctx, m_pathPublicKey.c_str ( ), SSL_FILETYPE_PEM ) ) <= 0 ) {
-		NPRINTF ( ERROR_HS, "Use certificate failed on public key: %s", m_pathPublicKey.c_str ( ) );	
-		netFreeSSL ( sock_i ); 
-		s.lastStateChange.SetTimeNSec ( );
+	if ( ( ret = SSL_CTX_use_certificate_file ( ctx, sys->m_pathPublicKey.c_str ( ), SSL_FILETYPE_PEM ) ) <= 0 ) {
+		NPRINTF ( DERROR_HS, "Use certificate failed on public key: %s", sys->m_pathPublicKey.c_str ( ) );	
+		SSL_CTX_free ( ctx );
 		TRACE_EXIT ( (__func__) );	
-		return;
+		return 0x0;
 	} else {
 		NPRINTF ( VERBOSE_HS, "Call to use certificate succeded" );
 	}
 
-	if ( ( ret = SSL_CTX_use_PrivateKey_file ( s.ctx, m_pathPrivateKey.c_str ( ), SSL_FILETYPE_PEM ) ) <= 0 ) {			
-		NPRINTF ( ERROR_HS, "Use private key failed on %s", m_pathPrivateKey.c_str ( ) );	
-		netFreeSSL ( sock_i ); 
+	if ( ( ret = SSL_CTX_use_PrivateKey_file ( ctx, sys->m_pathPrivateKey.c_str ( ), SSL_FILETYPE_PEM ) ) <= 0 ) {			
+		NPRINTF ( DERROR_HS, "Use private key failed on %s", sys->m_pathPrivateKey.c_str ( ) );	
+		SSL_CTX_free ( ctx );
 		TRACE_EXIT ( (__func__) );
-		return;
+		return 0x0;
 	} else {
 		NPRINTF ( VERBOSE_HS, "Call to use private key succeded" );
 	}
 
+	// Session resumption (TLS 1.3 tickets, or TLS 1.2 tickets and session ids)
+	SSL_CTX_set_session_id_context ( ctx, (const unsigned char*) "libmin", 6 );		// required with SSL_VERIFY_PEER
+	if ( sys->m_tlsResume ) {
+		SSL_CTX_set_session_cache_mode ( ctx, SSL_SESS_CACHE_SERVER );
+		if ( ! sys->m_pathTicketKeys.empty ( ) && ! tls_ticket_keys ( ctx, sys->m_pathTicketKeys ) ) {
+			NPRINTF ( DERROR_HS, "Ticket keys failed on %s, using keys for this run only", sys->m_pathTicketKeys.c_str ( ) );
+		}
+	} else {
+		SSL_CTX_set_session_cache_mode ( ctx, SSL_SESS_CACHE_OFF );
+		SSL_CTX_set_options ( ctx, SSL_OP_NO_TICKET );
+		SSL_CTX_set_num_tickets ( ctx, 0 );
+	}
+	sys->m_tlsCtxSrv = ctx;
+	TRACE_EXIT ( (__func__) );
+	return ctx;
+}
+
+void NetworkSystem::netServerSetupHandshakeSSL ( int sock_i ) 
+{
+	TRACE_ENTER ( (__func__) );
+	NetSock& s = m_socks [ sock_i ];
+	CXSocketMakeNoDelay ( s.socket );
+	CXSocketSetBlockMode ( s.socket, false);		// non-blocking	
+
+	s.security |= NET_SECURITY_FAIL; 
+	s.state = STATE_FAILED; 
+	s.lastStateChange.SetTimeNSec ( );
+
+	SSL_CTX* ctx = netGetServerCtxSSL ( );
+	if ( ctx == 0x0 ) {
+		TRACE_EXIT ( (__func__) );
+		return;
+	}
+	SSL_CTX_up_ref ( ctx );			// released by netFreeSSL
+	s.ctx = ctx;
+
 	s.ssl = SSL_new ( s.ctx );
-	long lret = SSL_set_mode ( s.ssl, SSL_MODE_ENABLE_PARTIAL_WRITE );
-	if ( lret & SSL_MODE_ENABLE_PARTIAL_WRITE == 0 ) {
-		std::cout << "SSL_MODE_ENABLE_PARTIAL_WRITE = 0" << std::endl;
-		exit (0);
+	if ( s.ssl == 0 ) {
+		NPRINTF ( DERROR_HS, "Failed at new ssl" );
+		netFreeSSL ( sock_i ); 
+		TRACE_EXIT ( (__func__) );
+		return;
 	}
+	SSL_set_mode ( s.ssl, SSL_MODE_ACCEPT_MOVING_WRITE_BUFFER );		// retried from the queue, see netSendResidualSSL
 	
-	if ( ( ret = SSL_set_fd ( s.ssl, s.socket ) ) <= 0 ) {
-		str msg = netGetErrorStringSSL ( ret, s.ssl );
-		NPRINTF ( ERROR_HS, "Failed at set ssl fd: Return: %d: %s", ret, msg.c_str ( ) );
+	BIO* bio = net_bio_new ( s.socket );			// socket BIO without SIGPIPE
+	if ( bio == 0x0 ) {
+		NPRINTF ( DERROR_HS, "Failed at new ssl bio" );
 		netFreeSSL ( sock_i ); 
 		TRACE_EXIT ( (__func__) );
 		return;
 	} else {
-		NPRINTF ( VERBOSE_HS, "Call to set ssl fd succeded" );
+		NPRINTF ( VERBOSE_HS, "Call to new ssl bio succeded" );
 	}
+	SSL_set_bio ( s.ssl, bio, bio );
+	SSL_set_accept_state ( s.ssl );
 	
 	s.security &= ~NET_SECURITY_FAIL;
 	s.state = STATE_HANDSHAKE;
 	s.lastStateChange.SetTimeNSec ( );
+	m_tlsHandshakes.push_back ( sock_i );
 
 	TRACE_EXIT ( (__func__) );
 }
@@ -657,7 +892,7 @@ void NetworkSystem::netServerAcceptSSL ( int sock_i )
 	
 	if ( ret <= 0 ) { // SSL fatal error		
 		str msg = netGetErrorStringSSL ( ret, s.ssl );
-		NPRINTF ( ERROR_HS, "SSL_accept failed (1): Return: %d: %s", ret, msg.c_str ( ) );
+		NPRINTF ( DERROR_HS, "SSL_accept failed (1): Return: %d: %s", ret, msg.c_str ( ) );
 		netFreeSSL ( sock_i );
 		s.security |= NET_SECURITY_FAIL; // Handshake failed
 		netManageHandshakeError ( sock_i, "SSL accept failed" );
@@ -730,6 +965,9 @@ bool NetworkSystem::netServerStart ( netPort srv_port, int security )
 
 	// Start accept handshake
 	m_socks[ srv_sock_i ].state = STATE_HANDSHAKE;
+	if ( m_socks[ srv_sock_i ].security & NET_SECURITY_PLAIN_TCP ) {
+		netTimerSet ( srv_sock_i, NET_TIMER_HANDSHAKE, m_reconnectInterval );		// accept retry
+	}
 
 	if ( security == NET_SECURITY_UNDEF ) {
 		if ( ( m_security > NET_SECURITY_PLAIN_TCP ) && ( m_security & NET_SECURITY_PLAIN_TCP ) ) {
@@ -748,7 +986,7 @@ bool NetworkSystem::netServerStart ( netPort srv_port, int security )
 	return true;
 }
 
-void NetworkSystem::netServerAcceptClient ( int sock_i )
+int NetworkSystem::netServerAcceptClient ( int sock_i )
 {
 	TRACE_ENTER ( (__func__) );
 	/* int srv_sock_svc = netFindSocket ( NET_SRV, NET_TCP, NTYPE_ANY ); // MP: Check that this is OK
@@ -775,61 +1013,93 @@ void NetworkSystem::netServerAcceptClient ( int sock_i )
 		// Accept error.
 		netManageHandshakeError ( sock_i, "connection not accepted" );		
 		TRACE_EXIT ( (__func__) );
-		return;
+		return result;
 	} else if ( result==0 ) {
 		// Waiting. Not yet accepted.		
 
 	} else if (result > 0) {
-		// Add socket for client
-		netIP srv_ip = m_hostIp; // Listen/accept on ANY address (0.0.0.0), final connection needs the server IP
-		NetAddr addr1 ( NTYPE_CONNECT, srv_name, srv_ip, srv_port );
-		NetAddr addr2 ( NTYPE_CONNECT, "", cli_ip, cli_port );
-		int cli_sock_i = netAddSocket ( NET_SRV, NET_TCP, STATE_START, false, addr1, addr2 ); // Create new socket
-
-		// Set socket origin & info
-		NetSock& s = m_socks[ cli_sock_i ];
-		CXSocketSetBlockMode ( sock_h, false);  // non-blocking
-		s.security = security_level;						// security level
-		s.socket = sock_h;											// assign literal socket
-		s.dest.ip = cli_ip;											// assign client IP
-		s.dest.port = cli_port;									// assign client port
-		s.state = STATE_START;
-		s.lastStateChange.SetTimeNSec ( );
-		
-		// Start of handshake
-		if (security_level & NET_SECURITY_OPENSSL) {
-			#ifdef BUILD_OPENSSL
-				NPRINTF(VERBOSE, "HANDSHAKE OpenSSL: %s", OPENSSL_VERSION_TEXT); // Openssl version 
-			#endif	
+		NET_TRACE ( NT_ACCEPT, sock_i, cli_port );
+		if ( !m_workers.empty() ) {
+			// Hand off to a worker
+			NetPost p;
+			p.cmd = 'a';
+			p.sock_h = sock_h;
+			p.ip = cli_ip;
+			p.port = cli_port;
+			p.name = srv_name;
+			p.srv_port = srv_port;
+			p.security = security_level;
+			m_workers[ netWorkerAssign ( cli_ip, cli_port ) ]->netPost ( p );
 		} else {
-			NPRINTF(VERBOSE, "HANDSHAKE TCP/IP");
-		}
-
-		// OpenSSL handshake or TCP complete
-		if ( s.security & NET_SECURITY_OPENSSL ) {		
-			#ifdef BUILD_OPENSSL
-				netServerSetupHandshakeSSL ( cli_sock_i );
-				if ( s.security & NET_SECURITY_FAIL ) {
-					netManageHandshakeError ( sock_i, "SSL handshake failed");
-				}
-			#endif	
-		} else if ( s.security & NET_SECURITY_PLAIN_TCP ) { 		
-			netServerCompleteConnection ( cli_sock_i );
+			netServerAddClient ( sock_h, cli_ip, cli_port, srv_name, srv_port, security_level );
 		}
 	}
 	TRACE_EXIT ( (__func__) ); 	
+	return result;
 } 
 	
+// Add socket for an accepted client
+// Called on the accepting system, or on a worker which the connection was handed to.
+//
+int NetworkSystem::netServerAddClient ( CX_SOCKET sock_h, netIP cli_ip, netPort cli_port, str srv_name, netPort srv_port, int security_level )
+{
+	TRACE_ENTER ( (__func__) );
+	netIP srv_ip = m_hostIp; // Listen/accept on ANY address (0.0.0.0), final connection needs the server IP
+	NetAddr addr1 ( NTYPE_CONNECT, srv_name, srv_ip, srv_port );
+	NetAddr addr2 ( NTYPE_CONNECT, "", cli_ip, cli_port );
+	int cli_sock_i = netAddSocket ( NET_SRV, NET_TCP, STATE_START, false, addr1, addr2 ); // Create new socket
+
+	// Set socket origin & info
+	NetSock& s = m_socks[ cli_sock_i ];
+	CXSocketSetBlockMode ( sock_h, false);  // non-blocking
+	s.security = security_level;						// security level
+	netSocketPollRemove ( cli_sock_i );			// release placeholder socket made by netAddSocket
+	CXSocketClose ( s.socket );
+	s.socket = sock_h;											// assign literal socket
+	netSocketPollAdd ( cli_sock_i );
+	netSockIndexRemove ( cli_sock_i );
+	s.dest.ip = cli_ip;											// assign client IP
+	s.dest.port = cli_port;									// assign client port
+	netSockIndexAdd ( cli_sock_i );
+	s.state = STATE_START;
+	s.lastStateChange.SetTimeNSec ( );
+	
+	// Start of handshake
+	if (security_level & NET_SECURITY_OPENSSL) {
+		#ifdef BUILD_OPENSSL
+			NPRINTF(VERBOSE, "HANDSHAKE OpenSSL: %s", OPENSSL_VERSION_TEXT); // Openssl version 
+		#endif	
+	} else {
+		NPRINTF(VERBOSE, "HANDSHAKE TCP/IP");
+	}
+
+	// OpenSSL handshake or TCP complete
+	if ( s.security & NET_SECURITY_OPENSSL ) {		
+		#ifdef BUILD_OPENSSL
+			netServerSetupHandshakeSSL ( cli_sock_i );
+			if ( s.security & NET_SECURITY_FAIL ) {
+				netManageHandshakeError ( cli_sock_i, "SSL handshake failed");
+			} else {
+				netTimerSet ( cli_sock_i, NET_TIMER_HANDSHAKE, m_reconnectInterval );
+			}
+		#endif	
+	} else if ( s.security & NET_SECURITY_PLAIN_TCP ) { 		
+		netServerCompleteConnection ( cli_sock_i );
+	}
+	TRACE_EXIT ( (__func__) ); 	
+	return cli_sock_i;
+}
+
 void NetworkSystem::netServerCompleteConnection ( int sock_i )
 {
 	TRACE_ENTER ( (__func__) );
 	int srv_sock_svc = netFindSocket ( NET_SRV, NET_TCP, NTYPE_ANY );
-	if ( srv_sock_svc == -1 ) {
+	if ( srv_sock_svc == -1 && m_owner == this ) {
 	   NPRINTF ( DERROR_HS, "Unable to find server listen socket" );
 	}
-	netPort srv_port;
-	srv_port = m_socks[ srv_sock_svc ].src.port;
 	NetSock& s = m_socks [ sock_i ];	
+	netPort srv_port;
+	srv_port = ( srv_sock_svc >= 0 ) ? m_socks[ srv_sock_svc ].src.port : s.src.port;		// workers have no listen socket
 
 	assert(s.side != NET_CLI);
 
@@ -840,22 +1110,24 @@ void NetworkSystem::netServerCompleteConnection ( int sock_i )
 	e.attachInt64 ( s.dest.port );	// Client port
 	e.attachInt64 ( m_hostIp );		// Server IP
 	e.attachInt64 ( srv_port );		// Server port
-	e.attachInt ( sock_i );			// Connection ID (goes back to the client)
+	e.attachInt ( netSockId ( sock_i ) );			// Connection ID (goes back to the client)
 	netSend ( e, sock_i );			// Send TCP connected event to client
 
 	NPRINTF(VERBOSE, "  Sent sOkT event to client." );
 
 	// Send verify event to server
 	Event ue ( 120, 'app ', 'sOkT', 0, m_eventPool, "netSrvCompl" ); // Inform the user-app (server) of the event	
-	ue.attachInt ( sock_i );
+	ue.attachInt ( netSockId ( sock_i ) );
 	ue.attachInt ( -1 ); // cli_sock not known
+	ue.setSrcSock ( netSockId ( sock_i ) );
 	ue.startRead ( );
-	(*m_userEventCallback) ( ue, this ); // Send to application
+	netUserCallback ( ue ); // Send to application
 
 	// Last step. Set socket as CONNECTED.
 	// (we assume the netSend of 'sOkT' succeeded)
 	s.state = STATE_CONNECTED;
 	s.lastStateChange.SetTimeNSec();
+	netTimerConnected ( sock_i );
 
 	// Accept succeeded
 	bool ssl = (s.security & NET_SECURITY_OPENSSL) == NET_SECURITY_OPENSSL;
@@ -864,37 +1136,12 @@ void NetworkSystem::netServerCompleteConnection ( int sock_i )
 	TRACE_EXIT ( (__func__) );
 }
 
+// Server timeouts
+// Handshake timeouts of accepted sockets, and accept retries on the listen socket,
+// are timers. See netTimerFire.
 void NetworkSystem::netServerCheckConnectionHandshakes ( ) 
 {
-	TimeX current_time;
-	current_time.SetTimeNSec();
-		
-	for ( int sock_i = 0; sock_i < (int) m_socks.size ( ); sock_i++ ) { 
-		NetSock& s = m_socks[ sock_i ];
-
-		if (current_time.GetElapsedMSec(s.lastStateChange) > m_reconnectInterval ) {
-
-			s.lastStateChange = current_time;
-
-			// OpenSSL
-			if (s.security & NET_SECURITY_OPENSSL) {
-				if (s.state==STATE_HANDSHAKE) {
-					netManageHandshakeError(sock_i, "server SSL timeout");
-				}
-			}
-
-			// TCP/IP protocols
-			if ( s.security & NET_SECURITY_PLAIN_TCP ) {
-				// Check listening socket
-				if ( s.state == STATE_HANDSHAKE && s.src.type == NTYPE_ANY ) {
-					//printf ( "Listening: %d\n", sock_i );
-					netServerAcceptClient(sock_i);
-				}			
-			}
-		}
-		
-		
-	}
+	netTimerRun ( );
 }
 
 void NetworkSystem::netServerProcessIO ( )
@@ -905,43 +1152,57 @@ void NetworkSystem::netServerProcessIO ( )
 	m_stat.interval_ms = current_time.GetElapsedMSec(m_lastNetProcess);
 	if (m_stat.interval_ms < m_processInterval) return;
 	m_lastNetProcess = current_time;
+	m_tickMs = TimeX::GetSystemNSec ( ) / MSEC_SCALAR;
 
 	// connection handling
 	netServerCheckConnectionHandshakes ( );
+	#ifdef BUILD_OPENSSL
+		netCheckHandshakesSSL ( );
+	#endif
 
 	// TCP data handling
 	TRACE_ENTER ( (__func__) );
-	fd_set sockReadSet;
-	fd_set sockWriteSet;
-	int rcv_events = netSocketSelect ( &sockReadSet, &sockWriteSet );
+	int rcv_events = netSocketPoll ( );
 
 	NET_PERF_PUSH ( "findsocks" );
-	for ( int sock_i = 0; sock_i < (int) m_socks.size ( ); sock_i++ ) { 
-		NetSock& s = m_socks[ sock_i ];
+	for ( int n = 0; n < (int) m_sockReady.size ( ); n++ ) { 
+		int sock_i = m_sockReady[ n ].sock_i;
+		if ( !valid_socket_index ( sock_i ) ) continue;		// removed during this pass
 
-		if ( netSocketIsSelected ( &sockReadSet, sock_i ) ) {
+		if ( m_sockReady[ n ].read ) {
 			
+			// Listening socket. Accept all pending clients.
+			if ( m_socks[ sock_i ].src.type == NTYPE_ANY ) {
+				if ( m_socks[ sock_i ].state == STATE_HANDSHAKE ) {
+					while ( netServerAcceptClient ( sock_i ) > 0 );
+				}
+				continue;
+			}
+
 			// OpenSSL
-			if (s.security & NET_SECURITY_OPENSSL) {				
+			if (m_socks[ sock_i ].security & NET_SECURITY_OPENSSL) {				
 				#ifdef BUILD_OPENSSL
-					if (s.state == STATE_HANDSHAKE && s.src.type == NTYPE_CONNECT) {
+					if (m_socks[ sock_i ].state == STATE_HANDSHAKE) {
 						netServerAcceptSSL(sock_i);								// SSL accept, has STATE_HANDSHAKE. (NTYPE_CONNECT because TCP accept completed)
 					}
 				#endif
 			} 			
 
 			// All protocols
-			if (s.src.type == NTYPE_CONNECT) {								
+			if ( valid_socket_index ( sock_i ) && m_socks[ sock_i ].src.type == NTYPE_CONNECT ) {
 				netReceiveData (sock_i);			// TCP and OpenSSL
 			}
 		}
-		if ( netSocketIsSelected ( &sockWriteSet, sock_i ) ) {
+		if ( m_sockReady[ n ].write && valid_socket_index ( sock_i ) ) {
 			// Send pending data
 			netSendResidualEvent ( sock_i );
 		}
 	}
 	NET_PERF_POP ( );
 
+	// Send queued events
+	netSendFlush ( );
+
 	// UDP data handling
 	if (m_udp_sock.state==STATE_CONNECTED) 
 		netReceiveUDP ();
@@ -968,115 +1229,532 @@ void NetworkSystem::netServerProcessIO ( )
 
 
 //----------------------------------------------------------------------------------------------------------------------
-// -> OPENSSL CLIENT <-
+// -> SERVER WORKERS <-
 //----------------------------------------------------------------------------------------------------------------------
-
-#ifdef BUILD_OPENSSL
-	
-void NetworkSystem::netClientSetupHandshakeSSL ( int sock_i ) 
-{ 
-	char msg[2048];
-
+//
+// Opt-in multi-threaded server. The main system keeps the listening socket and hands each
+// accepted connection to one of N worker systems, each running its own readiness loop, 
+// event pool and event queue on a thread. Socket ids seen by the app are global:
+//   id = (worker+1) * NET_SHARD_SOCKS + local socket
+// so netSend/netCloseConnection on the main system route to the owning worker.
+// Callbacks run on the owning worker (NET_DISPATCH_WORKER), or on a pool of user threads 
+// (NET_DISPATCH_POOL) where each socket is pinned to one thread to keep its events in order.
+//
+bool NetworkSystem::netServerStartWorkers ( int num_workers, int assign, int dispatch, int pool_threads )
+{
 	TRACE_ENTER ( (__func__) );
-	NetSock& s = m_socks[ sock_i ];
-	if ( s.ctx != 0 ) {
-		netFreeSSL ( sock_i ); 
-		NPRINTF ( VERBOSE_HS, "    Handshake SSL reusing socket. Call to free old context made (1)" );
-	}
-	
-	int ret = 0, exp;
-	CXSocketMakeNoDelay ( s.socket );
-	CXSocketSetBlockMode ( s.socket, false);
-	s.security |= NET_SECURITY_FAIL; // Assume failure until end of this function
-	s.state = STATE_FAILED; 
-	s.lastStateChange.SetTimeNSec ( );
-	
-	#if OPENSSL_VERSION_NUMBER < 0x10100000L // Version 1.1
-		SSL_load_error_strings ( );	 
-		SSL_library_init ( );
-	#else // version 3.0+
-		OPENSSL_init_ssl ( OPENSSL_INIT_LOAD_SSL_STRINGS, NULL );
-	#endif
-
-	//s.bio = BIO_new_socket ( s.socket, BIO_NOCLOSE );
-
-	s.ctx = SSL_CTX_new ( TLS_client_method ( ) );
-	if ( ! s.ctx ) {
-		NPRINTF ( ERROR_HS, "Failed at: new ctx" );
-		netFreeSSL ( sock_i );
+	if ( !isServer() || !m_workers.empty() || num_workers < 1 || num_workers > NET_MAX_WORKERS ) {
+		NPRINTF ( DERROR, "Unable to start %d workers (server started, max %d).", num_workers, NET_MAX_WORKERS );
 		TRACE_EXIT ( (__func__) );
-		return;
-	} else {
-		NPRINTF ( VERBOSE_HS, "Call to ctx succeded" );
+		return false;
 	}
-
-	// Use TLS 1.2+ only, since we have custom client-server protocols
-	SSL_CTX_set_min_proto_version ( s.ctx, TLS1_2_VERSION );
-	SSL_CTX_set_max_proto_version ( s.ctx, TLS1_3_VERSION );
-	SSL_CTX_set_verify ( s.ctx, SSL_VERIFY_PEER, NULL );
-
-	if ( !SSL_CTX_load_verify_locations( s.ctx, m_pathPublicKey.c_str ( ), NULL ) ) {
-		str msg = netGetErrorStringSSL ( ret, s.ssl );
-		NPRINTF ( ERROR_HS, "Load verify failed on public key: %s", msg.c_str ( ) );
-		netFreeSSL ( sock_i );
-		TRACE_EXIT ( (__func__) );
-		return;
-	} else {
-		NPRINTF ( VERBOSE_HS, "Call to load verify locations succeded" );
-	}		
-
-	s.ssl = SSL_new ( s.ctx );
-	long lret = SSL_set_mode ( s.ssl, SSL_MODE_ENABLE_PARTIAL_WRITE );
-	if ( lret & SSL_MODE_ENABLE_PARTIAL_WRITE == 0 ) {
-		std::cout << "SSL_MODE_ENABLE_PARTIAL_WRITE = 0" << std::endl;
-		exit (0);
+	m_assignMode = assign;
+	m_assignNext = 0;
+	m_workerRun = true;
+
+	// user thread pool
+	if ( dispatch == NET_DISPATCH_POOL ) {
+		if ( pool_threads <= 0 ) pool_threads = num_workers;
+		for ( int t = 0; t < pool_threads; t++ ) m_dispatch.push_back ( new NetDispatch );
+		for ( int t = 0; t < pool_threads; t++ ) m_dispatch[ t ]->thread = std::thread ( &NetworkSystem::netDispatchRun, this, t );
 	}
-	
-	if ( ! s.ssl ) {
-		str msg = netGetErrorStringSSL ( ret, s.ssl );
-		NPRINTF ( ERROR_HS, "Failed at new ssl: %s", msg.c_str ( ) );
-		netFreeSSL ( sock_i ); 
-		TRACE_EXIT ( (__func__) );
-		return;
-	} else {
-		NPRINTF ( VERBOSE_HS, "Call to ssl succeded" );
-	}	
-
-	if ( ( ret = SSL_set_fd ( s.ssl, s.socket ) ) != 1 ) {
-		str msg = netGetErrorStringSSL ( ret, s.ssl );
-		NPRINTF ( ERROR_HS, "Failed at set fd failed: Return: %d: %s", ret, msg.c_str ( ) );
-		netFreeSSL ( sock_i );
-		TRACE_EXIT ( (__func__) ); 	
-		return;
-	} else {
-		NPRINTF ( VERBOSE_HS, "Call to ssl set fd succeded" );
-	}	
 
-	s.security &= ~NET_SECURITY_FAIL;
-	s.state = STATE_HANDSHAKE;
-	s.lastStateChange.SetTimeNSec ( );
+	// workers inherit config from this system
+	for ( int w = 0; w < num_workers; w++ ) {
+		NetworkSystem* ws = new NetworkSystem;
+		ws->m_pollMode = m_pollMode;
+		ws->netInitialize ();
+		ws->netWakeCreate ();
+		ws->m_hostType = 's';
+		ws->m_owner = this;
+		ws->m_sockBase = (w+1) * NET_SHARD_SOCKS;
+		ws->m_sockPub = new std::atomic<int> [ NET_SHARD_SOCKS ];
+		for ( int n = 0; n < NET_SHARD_SOCKS; n++ ) ws->m_sockPub[ n ] = -1;
+		ws->m_userEventCallback = m_userEventCallback;
+		ws->m_security = m_security;
+		ws->m_processInterval = 0;				// paced by poll timeout
+		ws->m_rcvSelectTimout = m_rcvSelectTimout;
+		ws->m_reconnectInterval = m_reconnectInterval;
+		ws->m_idleTimeout = m_idleTimeout;
+		ws->m_heartbeat = m_heartbeat;
+		ws->m_sendQueueMax = m_sendQueueMax;
+		ws->m_sendCoalesce = m_sendCoalesce;
+		ws->m_sendZeroCopyMin = m_sendZeroCopyMin;
+		ws->m_compressMin = m_compressMin;
+		ws->m_tlsWrite = m_tlsWrite;
+		ws->m_tlsCoalesce = m_tlsCoalesce;
+		ws->m_tlsResume = m_tlsResume;
+		ws->m_recvRingSize = m_recvRingSize;
+		ws->m_recvViews = m_recvViews;
+		ws->m_maxEventSize = m_maxEventSize;
+		ws->m_emuOn = m_emuOn;
+		ws->m_emuConfig = m_emuConfig;
+		ws->m_statInterval = m_statInterval;
+		ws->m_printVerbose = m_printVerbose;
+		ws->m_printFlow = m_printFlow;
+		m_workers.push_back ( ws );
+	}
+	for ( int w = 0; w < num_workers; w++ ) {
+		std::thread t ( &NetworkSystem::netWorkerRun, m_workers[ w ] );
+		m_workers[ w ]->m_threadId = t.get_id ();			// before any connection is assigned
+		m_workerThreads.push_back ( std::move ( t ) );
+	}
+	NPRINTF ( VERBOSE, "Started %d workers, %s assign, %s dispatch.", num_workers, (assign==NET_ASSIGN_HASH) ? "hash" : "round-robin", m_dispatch.empty() ? "worker" : "pool" );
 	TRACE_EXIT ( (__func__) );
-}	
+	return true;
+}
 
-void NetworkSystem::netClientConnectSSL ( int sock_i )
+void NetworkSystem::netServerStopWorkers ( )
 {
 	TRACE_ENTER ( (__func__) );
-	int exp;
-	NetSock& s = m_socks[ sock_i ];
+	m_workerRun = false;
+	for ( std::thread& t : m_workerThreads ) t.join ();
+	m_workerThreads.clear ();
+
+	for ( NetDispatch* d : m_dispatch ) {
+		{ std::lock_guard<std::mutex> lock ( d->mtx ); d->stop = true; }
+		d->cv.notify_one ();
+		d->thread.join ();
+		for ( NetDispatchItem& it : d->queue ) delete it.e;
+		delete d;
+	}
+	m_dispatch.clear ();
 
-	// check if finished (on this socket)
-	int finished = SSL_is_init_finished(s.ssl);
-	if ( finished ) return;
+	// worker event pools are released last, events allocated from them must not outlive the workers
+	for ( NetworkSystem* ws : m_workers ) {
+		for ( int n = (int) ws->m_socks.size()-1; n >= 0; n-- ) {
+			if ( ws->m_socks[ n ].state != STATE_TERMINATED ) ws->netDeleteSocket ( n, 1 );
+		}
+		ws->netPostDrain ();
+		ws->netWakeFree ();
+		ws->netSetPollMode ( NET_POLL_SELECT );		// release epoll
+		delete [] ws->m_sockPub;
+		#ifdef BUILD_EVENT_POOLING
+			EventPool* pool = ws->m_eventPool;
+			delete ws;
+			delete pool;
+		#else
+			delete ws;
+		#endif
+	}
+	m_workers.clear ();
+	TRACE_EXIT ( (__func__) );
+}
 
-	// otherwise try SSL connect
-	int ret = SSL_connect ( s.ssl );
-	if ( ret < 0 ) {
-		ret = netNonFatalErrorSSL ( sock_i, ret ); // ret = 2, want read/write
+// Worker thread loop
+void NetworkSystem::netWorkerRun ( )
+{
+	while ( m_owner->m_workerRun ) {
+		netPostDrain ();
+		netProcessQueue ();
+		netWorkerPublish ();
 	}
+}
 
-	if ( ret <= 0 ) { // SSL connect error.
-		str msg = netGetErrorStringSSL ( ret, s.ssl );
-		NPRINTF(ERROR_HS, "Call to ssl connect failed: Return: %d: %s", ret, msg.c_str ( ) );
+// Publish socket state for other threads (worker thread)
+// The main system cannot read worker sockets, which change on the worker. Connected sockets
+// publish their bytes queued, others -1, once per loop.
+void NetworkSystem::netWorkerPublish ( )
+{
+	int cnt = imin ( (int) m_socks.size(), NET_SHARD_SOCKS );
+	for ( int n = 0; n < cnt; n++ ) {
+		NetSock& s = m_socks[ n ];
+		m_sockPub[ n ].store ( ( s.state == STATE_CONNECTED ) ? s.txQueued : -1, std::memory_order_relaxed );
+	}
+	for ( int n = cnt; n < m_sockPubCnt; n++ ) m_sockPub[ n ].store ( -1, std::memory_order_relaxed );		// erased
+	m_sockPubCnt = cnt;
+}
+
+// State of a worker socket, by global id (any thread)
+// Bytes queued if connected, or -1. Read directly on the owning worker, otherwise as of its last loop.
+int NetworkSystem::netWorkerSockState ( int sock_i )
+{
+	NetworkSystem* ws = netWorkerFor ( sock_i );
+	if ( ws == 0x0 ) return -1;
+	if ( std::this_thread::get_id() == ws->m_threadId ) {
+		if ( !ws->valid_socket_index ( sock_i ) || ws->m_socks[ sock_i ].state != STATE_CONNECTED ) return -1;
+		return ws->m_socks[ sock_i ].txQueued;
+	}
+	return ws->m_sockPub[ sock_i ].load ( std::memory_order_relaxed );
+}
+
+// Choose worker for an accepted connection
+int NetworkSystem::netWorkerAssign ( netIP cli_ip, netPort cli_port )
+{
+	int n = (int) m_workers.size();
+	if ( m_assignMode == NET_ASSIGN_HASH ) {
+		uint32_t h = (uint32_t) cli_ip * 2654435761u ^ (uint32_t) cli_port * 40503u;		// multiplicative hash
+		return (int) ( h % n );
+	}
+	return ( m_assignNext++ ) % n;
+}
+
+// Post a command to a worker (any thread)
+void NetworkSystem::netPost ( NetPost& p )
+{
+	{
+		std::lock_guard<std::mutex> lock ( m_postMtx );
+		m_posts.push_back ( p );
+	}
+	netWake ();
+}
+
+// Run posted commands (worker thread)
+void NetworkSystem::netPostDrain ( )
+{
+	std::vector<NetPost> posts;
+	{
+		std::lock_guard<std::mutex> lock ( m_postMtx );
+		if ( m_posts.empty() ) return;
+		posts.swap ( m_posts );
+	}
+	for ( NetPost& p : posts ) {
+		switch ( p.cmd ) {
+		case 'a':	netServerAddClient ( p.sock_h, p.ip, p.port, p.name, p.srv_port, p.security );	break;
+		case 'c':	netCloseConnection ( p.sock_i );	break;
+		}
+	}
+}
+
+// Route a global socket id to the owning worker
+// Returns the worker, and sets the local socket index.
+NetworkSystem* NetworkSystem::netWorkerFor ( int& sock_i )
+{
+	int w = sock_i / NET_SHARD_SOCKS - 1;
+	if ( w < 0 || w >= (int) m_workers.size() ) return 0x0;
+	sock_i = sock_i % NET_SHARD_SOCKS;
+	return m_workers[ w ];
+}
+
+bool NetworkSystem::netWorkerSend ( Event& e, int sock_i, bool acquire )
+{
+	NetworkSystem* ws = netWorkerFor ( sock_i );
+	if ( ws == 0x0 ) return false;
+
+	if ( std::this_thread::get_id() == ws->m_threadId ) {
+		return ws->netSendEvent ( e, sock_i, acquire );		// on owning worker
+	}
+	if ( acquire ) return ws->netSendAsync ( e, sock_i );		// event data moves to the worker
+
+	Event c;
+	c.copy ( e );									// caller keeps its event
+	return ws->netSendAsync ( c, sock_i );
+}
+
+// Send from any thread
+// The event is posted to the network thread without locks, and sent on its next 
+// netProcessQueue. The caller's event is detached.
+bool NetworkSystem::netSendAsync ( Event& e, int sock_i )
+{
+	if ( !m_workers.empty() && sock_i >= NET_SHARD_SOCKS ) {
+		return netWorkerSend ( e, sock_i, true );
+	}
+	if ( sock_i < 0 || sock_i >= NET_SHARD_SOCKS ) return false;
+	e.setSrcSock ( sock_i );		// destination, until sent
+	bool ok = m_postQueue.Push ( e );
+	netWake ();
+	return ok;
+}
+
+// Deliver an event to the app
+// Callbacks always receive the main system, which the app owns.
+// A handler registered for the event target and name is called in place of the user callback.
+int NetworkSystem::netUserCallback ( Event& e, uint64_t queued )
+{
+	NetHandler* h = m_owner->netGetHandler ( e.getTarget(), e.getName() );
+	funcEventHandler func = ( h != 0x0 ) ? h->func : m_userEventCallback;
+	int thread = ( h != 0x0 ) ? h->thread : NET_HANDLER_DEFAULT;
+	if ( func == 0x0 ) return 0;
+
+	if ( !m_owner->m_dispatch.empty() && thread != NET_HANDLER_INLINE ) {
+		m_owner->netDispatchPost ( e, queued, func, thread );
+		return 0;
+	}
+	if ( queued != 0 ) m_stat.dispatch.record ( TimeX::GetSystemNSec() - queued );		// time on event queue
+	NET_TRACE ( NT_DISPATCH, e.getSrcSock(), e.getName() );
+	return (*func) ( e, m_owner );
+}
+
+void NetworkSystem::netDispatchPost ( Event& e, uint64_t queued, funcEventHandler func, int thread )
+{
+	// pin socket to a pool thread, or handler to its own thread
+	int t = ( thread >= 0 ) ? thread : e.getSrcSock();
+	NetDispatch* d = m_dispatch[ t % m_dispatch.size() ];
+	Event* ep = new Event;
+	netIP ip = e.getSrcIP ();
+	ep->acquire ( e );
+	ep->setSrcIP ( ip );
+	ep->startRead ();
+	{
+		std::lock_guard<std::mutex> lock ( d->mtx );
+		d->queue.push_back ( { ep, queued, func } );
+	}
+	d->cv.notify_one ();
+}
+
+// User thread pool loop
+void NetworkSystem::netDispatchRun ( int t )
+{
+	NetDispatch* d = m_dispatch[ t ];
+	for (;;) {
+		NetDispatchItem it;
+		{
+			std::unique_lock<std::mutex> lock ( d->mtx );
+			d->cv.wait ( lock, [d] { return d->stop || !d->queue.empty(); } );
+			if ( d->queue.empty() ) return;		// stopped
+			it = d->queue.front ();
+			d->queue.pop_front ();
+		}
+		if ( it.queued != 0 ) m_stat.dispatch.record ( TimeX::GetSystemNSec() - it.queued );
+		(*it.func) ( *it.e, this );
+		delete it.e;
+	}
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+// -> EVENT HANDLERS <-
+//----------------------------------------------------------------------------------------------------------------------
+
+// Register a handler for events with this target and name.
+// Events with a handler skip the user callback, so an app can replace a switch on e.getName()
+// with one handler per message. Lookup is one hash and usually one probe.
+//
+// thread - NET_HANDLER_DEFAULT runs the handler where the user callback would run.
+//          NET_HANDLER_INLINE always runs it on the network thread, for short handlers with a dispatch pool.
+//          0..N runs it on that pool thread, so all of its events are handled in turn on one thread.
+//          Events of one socket stay in order only among handlers with the same setting.
+//
+// Replaces an earlier handler for the same target and name. A null func removes it.
+// Handlers are read by workers without locks, so register them before netServerStartWorkers.
+bool NetworkSystem::netAddHandler ( eventStr_t targ, eventStr_t name, funcEventHandler func, int thread )
+{
+	if ( !m_workers.empty() ) {
+		NPRINTF ( DERROR, "Unable to add event handler, workers are running." );
+		return false;
+	}
+	uint64_t key = ( uint64_t(targ) << 32 ) | uint32_t(name);
+	int n = 0;
+	while ( n < (int) m_handlerList.size() && m_handlerList[ n ].key != key ) n++;
+	if ( func == 0x0 ) {
+		if ( n < (int) m_handlerList.size() ) m_handlerList.erase ( m_handlerList.begin() + n );
+	} else {
+		if ( n == (int) m_handlerList.size() ) m_handlerList.push_back ( NetHandler() );
+		m_handlerList[ n ].key = key;
+		m_handlerList[ n ].func = func;
+		m_handlerList[ n ].thread = thread;
+	}
+	netBuildHandlers ();
+	return true;
+}
+
+void NetworkSystem::netClearHandlers ( )
+{
+	if ( !m_workers.empty() ) return;
+	m_handlerList.clear ();
+	netBuildHandlers ();
+}
+
+// Rebuild lookup table from registered handlers
+void NetworkSystem::netBuildHandlers ( )
+{
+	m_handlers.clear ();
+	m_handlerShift = 64;
+	if ( m_handlerList.empty() ) return;
+
+	int bits = 1;
+	while ( ( 1 << bits ) < 2 * (int) m_handlerList.size() ) bits++;
+	m_handlers.assign ( size_t(1) << bits, NetHandler() );
+	m_handlerShift = 64 - bits;
+	size_t mask = m_handlers.size() - 1;
+
+	for ( NetHandler& h : m_handlerList ) {
+		size_t i = ( h.key * 0x9E3779B97F4A7C15ULL ) >> m_handlerShift;
+		while ( m_handlers[ i ].func != 0x0 ) i = ( i + 1 ) & mask;		// linear probe
+		m_handlers[ i ] = h;
+	}
+}
+
+NetHandler* NetworkSystem::netGetHandler ( eventStr_t targ, eventStr_t name )
+{
+	if ( m_handlers.empty() ) return 0x0;
+	uint64_t key = ( uint64_t(targ) << 32 ) | uint32_t(name);
+	size_t mask = m_handlers.size() - 1;
+	size_t i = ( key * 0x9E3779B97F4A7C15ULL ) >> m_handlerShift;
+	for (;;) {
+		NetHandler& h = m_handlers[ i ];
+		if ( h.func == 0x0 ) return 0x0;			// table is never full
+		if ( h.key == key ) return &h;
+		i = ( i + 1 ) & mask;
+	}
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+// -> OPENSSL CLIENT <-
+//----------------------------------------------------------------------------------------------------------------------
+
+#ifdef BUILD_OPENSSL
+	
+// Client context
+// Created once and shared by all client sockets. Sessions issued by a server are kept
+// by netNewSessionSSL, and offered on the next connect to the same server.
+SSL_CTX* NetworkSystem::netGetClientCtxSSL ( )
+{
+	TRACE_ENTER ( (__func__) );
+	if ( m_tlsCtxCli != 0x0 ) {
+		TRACE_EXIT ( (__func__) );
+		return m_tlsCtxCli;
+	}
+	#if OPENSSL_VERSION_NUMBER < 0x10100000L // Version 1.1
+		SSL_load_error_strings ( );	 
+		SSL_library_init ( );
+	#else // version 3.0+
+		OPENSSL_init_ssl ( OPENSSL_INIT_LOAD_SSL_STRINGS, NULL );
+	#endif
+
+	SSL_CTX* ctx = SSL_CTX_new ( TLS_client_method ( ) );
+	if ( ! ctx ) {
+		NPRINTF ( DERROR_HS, "Failed at: new ctx" );
+		TRACE_EXIT ( (__func__) );
+		return 0x0;
+	} else {
+		NPRINTF ( VERBOSE_HS, "Call to ctx succeded" );
+	}
+
+	// Use TLS 1.2+ only, since we have custom client-server protocols
+	SSL_CTX_set_min_proto_version ( ctx, TLS1_2_VERSION );
+	SSL_CTX_set_max_proto_version ( ctx, TLS1_3_VERSION );
+	SSL_CTX_set_verify ( ctx, SSL_VERIFY_PEER, NULL );
+
+	if ( !SSL_CTX_load_verify_locations( ctx, m_pathPublicKey.c_str ( ), NULL ) ) {
+		str msg = netGetErrorStringSSL ( 0, 0x0 );
+		NPRINTF ( DERROR_HS, "Load verify failed on public key: %s", msg.c_str ( ) );
+		SSL_CTX_free ( ctx );
+		TRACE_EXIT ( (__func__) );
+		return 0x0;
+	} else {
+		NPRINTF ( VERBOSE_HS, "Call to load verify locations succeded" );
+	}		
+
+	// Session resumption. Sessions are kept per server by netNewSessionSSL, not in the ctx cache.
+	if ( m_tlsResume ) {
+		SSL_CTX_set_session_cache_mode ( ctx, SSL_SESS_CACHE_CLIENT | SSL_SESS_CACHE_NO_INTERNAL_STORE );
+		SSL_CTX_sess_set_new_cb ( ctx, netNewSessionSSL );
+		SSL_CTX_set_app_data ( ctx, this );
+	} else {
+		SSL_CTX_set_session_cache_mode ( ctx, SSL_SESS_CACHE_OFF );
+		SSL_CTX_set_options ( ctx, SSL_OP_NO_TICKET );
+	}
+	m_tlsCtxCli = ctx;
+	TRACE_EXIT ( (__func__) );
+	return ctx;
+}
+
+// New session from server
+// Keep a copy per server (dest ip:port). The session held by the connection is marked
+// not resumable if the connection is later closed without a TLS shutdown.
+int NetworkSystem::netNewSessionSSL ( SSL* ssl, SSL_SESSION* sess )
+{
+	NetworkSystem* sys = (NetworkSystem*) SSL_CTX_get_app_data ( SSL_get_SSL_CTX ( ssl ) );
+	int sock_i = (int) (intptr_t) SSL_get_app_data ( ssl );
+	if ( sys == 0x0 || !sys->valid_socket_index ( sock_i ) ) return 0;
+
+	NetSock& s = sys->m_socks[ sock_i ];
+	uint64_t key = net_dest_key ( s.dest.ip, s.dest.port );
+	SSL_SESSION* copy = SSL_SESSION_dup ( sess );
+	if ( copy == 0x0 ) return 0;
+	std::map<uint64_t, SSL_SESSION*>::iterator it = sys->m_tlsSessions.find ( key );
+	if ( it != sys->m_tlsSessions.end ( ) ) {
+		SSL_SESSION_free ( it->second );
+		it->second = copy;
+	} else {
+		sys->m_tlsSessions[ key ] = copy;
+	}
+	return 0;			// session not kept by caller
+}
+
+void NetworkSystem::netClientSetupHandshakeSSL ( int sock_i ) 
+{ 
+	TRACE_ENTER ( (__func__) );
+	NetSock& s = m_socks[ sock_i ];
+	if ( s.ctx != 0 ) {
+		netFreeSSL ( sock_i ); 
+		NPRINTF ( VERBOSE_HS, "    Handshake SSL reusing socket. Call to free old context made (1)" );
+	}
+	
+	int ret = 0;
+	CXSocketMakeNoDelay ( s.socket );
+	CXSocketSetBlockMode ( s.socket, false);
+	s.security |= NET_SECURITY_FAIL; // Assume failure until end of this function
+	s.state = STATE_FAILED; 
+	s.lastStateChange.SetTimeNSec ( );
+
+	SSL_CTX* ctx = netGetClientCtxSSL ( );
+	if ( ctx == 0x0 ) {
+		TRACE_EXIT ( (__func__) );
+		return;
+	}
+	SSL_CTX_up_ref ( ctx );			// released by netFreeSSL
+	s.ctx = ctx;
+
+	s.ssl = SSL_new ( s.ctx );
+	if ( ! s.ssl ) {
+		str msg = netGetErrorStringSSL ( ret, s.ssl );
+		NPRINTF ( DERROR_HS, "Failed at new ssl: %s", msg.c_str ( ) );
+		netFreeSSL ( sock_i ); 
+		TRACE_EXIT ( (__func__) );
+		return;
+	} else {
+		NPRINTF ( VERBOSE_HS, "Call to ssl succeded" );
+	}	
+	SSL_set_mode ( s.ssl, SSL_MODE_ACCEPT_MOVING_WRITE_BUFFER );		// retried from the queue, see netSendResidualSSL
+	SSL_set_app_data ( s.ssl, (char*) (intptr_t) sock_i );
+
+	// Resume last session with this server
+	if ( m_tlsResume ) {
+		std::map<uint64_t, SSL_SESSION*>::iterator it = m_tlsSessions.find ( net_dest_key ( s.dest.ip, s.dest.port ) );
+		if ( it != m_tlsSessions.end ( ) && SSL_SESSION_is_resumable ( it->second ) ) {
+			SSL_set_session ( s.ssl, it->second );
+		}
+	}
+
+	BIO* bio = net_bio_new ( s.socket );			// socket BIO without SIGPIPE
+	if ( bio == 0x0 ) {
+		NPRINTF ( DERROR_HS, "Failed at new ssl bio" );
+		netFreeSSL ( sock_i );
+		TRACE_EXIT ( (__func__) ); 	
+		return;
+	} else {
+		NPRINTF ( VERBOSE_HS, "Call to new ssl bio succeded" );
+	}	
+	SSL_set_bio ( s.ssl, bio, bio );
+	SSL_set_connect_state ( s.ssl );
+
+	s.security &= ~NET_SECURITY_FAIL;
+	s.state = STATE_HANDSHAKE;
+	s.lastStateChange.SetTimeNSec ( );
+	m_tlsHandshakes.push_back ( sock_i );
+	TRACE_EXIT ( (__func__) );
+}	
+
+void NetworkSystem::netClientConnectSSL ( int sock_i )
+{
+	TRACE_ENTER ( (__func__) );
+	int exp;
+	NetSock& s = m_socks[ sock_i ];
+
+	// check if finished (on this socket)
+	int finished = SSL_is_init_finished(s.ssl);
+	if ( finished ) return;
+
+	// otherwise try SSL connect
+	int ret = SSL_connect ( s.ssl );
+	if ( ret < 0 ) {
+		ret = netNonFatalErrorSSL ( sock_i, ret ); // ret = 2, want read/write
+	}
+
+	if ( ret <= 0 ) { // SSL connect error.
+		str msg = netGetErrorStringSSL ( ret, s.ssl );
+		NPRINTF(DERROR_HS, "Call to ssl connect failed: Return: %d: %s", ret, msg.c_str ( ) );
 		netFreeSSL ( sock_i );
 		s.security |= NET_SECURITY_FAIL; // Handshake error
 		netManageHandshakeError ( sock_i, "SSL connect failed");
@@ -1097,6 +1775,48 @@ void NetworkSystem::netClientConnectSSL ( int sock_i )
 	TRACE_EXIT ( (__func__) );
 }
 
+// Step pending TLS handshakes
+// Called every tick, so a handshake does not depend on the socket being polled
+// ready (e.g. a client connect still in progress).
+void NetworkSystem::netCheckHandshakesSSL ( )
+{
+	if ( m_tlsHandshakes.empty ( ) ) return;
+	TRACE_ENTER ( (__func__) );
+	std::vector<int> pending;
+	pending.swap ( m_tlsHandshakes );			// steps may add or close sockets
+
+	for ( int sock_i : pending ) {
+		if ( !valid_socket_index ( sock_i ) ) continue;
+		NetSock& s = m_socks[ sock_i ];
+		if ( s.ssl == 0x0 || s.state == STATE_NONE || s.state == STATE_TERMINATED || s.state == STATE_FAILED ) continue;
+		if ( !SSL_is_init_finished ( s.ssl ) ) {
+			if ( s.side == NET_SRV ) netServerAcceptSSL ( sock_i );
+			else										 netClientConnectSSL ( sock_i );
+		}
+		if ( !valid_socket_index ( sock_i ) || m_socks[ sock_i ].ssl == 0x0 ) continue;
+		if ( SSL_is_init_finished ( m_socks[ sock_i ].ssl ) ) {
+			netHandshakeDoneSSL ( sock_i );
+		} else if ( std::find ( m_tlsHandshakes.begin(), m_tlsHandshakes.end(), sock_i ) == m_tlsHandshakes.end() ) {
+			m_tlsHandshakes.push_back ( sock_i );
+		}
+	}
+	TRACE_EXIT ( (__func__) );
+}
+
+void NetworkSystem::netHandshakeDoneSSL ( int sock_i )
+{
+	NetSock& s = m_socks[ sock_i ];
+	bool resumed = ( SSL_session_reused ( s.ssl ) == 1 );
+	if ( resumed ) {
+		s.stats.tls_resumed.add ( 1 );
+		m_stat.total.tls_resumed.add ( 1 );
+	} else {
+		s.stats.tls_full.add ( 1 );
+		m_stat.total.tls_full.add ( 1 );
+	}
+	NPRINTF ( VERBOSE_HS, "TLS handshake done: sock %d, %s, %s", sock_i, SSL_get_version ( s.ssl ), resumed ? "resumed" : "full" );
+}
+
 #endif
 
 //----------------------------------------------------------------------------------------------------------------------
@@ -1131,6 +1851,7 @@ int NetworkSystem::netAddSocketsUDP ( int sock_i )
 	if (m_udp_sock.state == STATE_NONE ) {
 		m_udp_sock = netCreateSocket ( (m_hostType=='c' ? NET_CLI : NET_SRV), NET_UDP, STATE_NONE, false, src, dst );
 		CXSocketSetBlockMode ( m_udp_sock.socket, false );
+		netSocketUDPOffload ( );
 	}	
 
 	if (m_hostType=='s') {
@@ -1277,6 +1998,8 @@ int NetworkSystem::netClientConnectToServer ( str srv_name, netPort srv_port, bo
 		NPRINTF(VERBOSE, "HANDSHAKE TCP/IP");
 	}	
 	s.state = STATE_START;					// no longer in reuse STATE_NONE (stops triggering of reconnect)
+	netTimerClear ( cli_sock_i, NET_TIMER_RECONNECT );
+	netTimerSet ( cli_sock_i, NET_TIMER_HANDSHAKE, s.reconnectInterval );
 
 	// TCP connect here
 	ret = netSocketConnect ( cli_sock_i );
@@ -1284,22 +2007,22 @@ int NetworkSystem::netClientConnectToServer ( str srv_name, netPort srv_port, bo
 		// Connect error.
 		netManageHandshakeError ( cli_sock_i, "TCP handshake failed" );		
 	
+	} else if (s.security & NET_SECURITY_OPENSSL) {
+		// TCP connected, or waiting to connect. The TLS handshake is stepped by netCheckHandshakesSSL,
+		// and waits (want write) until the TCP connect completes.
+		#ifdef BUILD_OPENSSL
+			netClientSetupHandshakeSSL(cli_sock_i);			// state may change to STATE_HANDSHAKE
+			if (s.security & NET_SECURITY_FAIL) {
+				netManageHandshakeError(cli_sock_i, "SSL handshake failed");
+			}
+		#endif
+
 	} else if (ret == 0) {
 		// Waiting to connect. Start TCP handshake. 
 
-
-
 	} else if (ret > 0 ) {
-
 		// TCP connected ok.
-		if (s.security & NET_SECURITY_OPENSSL) {
-			#ifdef BUILD_OPENSSL
-				netClientSetupHandshakeSSL(cli_sock_i);			// state may change to STATE_HANDSHAKE
-				if (s.security & NET_SECURITY_FAIL) {
-					netManageHandshakeError(cli_sock_i, "SSL handshake failed");
-				}
-			#endif
-		} else if (s.security & NET_SECURITY_PLAIN_TCP) {
+		if (s.security & NET_SECURITY_PLAIN_TCP) {
 			netClientCompleteConnection(cli_sock_i);
 		}
 	}
@@ -1321,13 +2044,12 @@ void NetworkSystem::netClientConnectUDP ( int tcp_sock_i )
 	m_socks[tcp_sock_i].num_udp = 1;
 }
 
-int NetworkSystem::netClientStartUDP ()
+int NetworkSystem::netClientStartUDP ( int sock_i )
 {
-	int sock_i = 1;
-
 	// Set udp address & port
 	NetSock& cliSock = m_socks[sock_i];
 	cliSock.udp_dest.type = NTYPE_CONNECT;
+	cliSock.udp_dest.sock = getServerSock ( sock_i );		// session id of datagrams to server
 	cliSock.udp_dest.ip = cliSock.dest.ip;					// Server IP
 	cliSock.udp_dest.port = cliSock.srvPort + 1;		// Server UDP port
 	CXSocketUpdateAddr ( cliSock.udp_dest );
@@ -1354,6 +2076,7 @@ int NetworkSystem::netClientStartUDP ()
 	netMakeEvent (e, 'cONU' );
 	e.attachInt( getServerSock(sock_i) );		// UDP must include session (server socket)
 	e.attachInt ( 12774 );
+	e.attachInt ( sock_i );							// client socket, session of datagrams from server
 	netSendUDP ( e, sock_i );
 
 	// Confirm over TCP 
@@ -1395,48 +2118,11 @@ void NetworkSystem::netClientHandshake ( int sock_i )
 }
 
 
+// Client timeouts and reconnects
+// Handshake timeouts and reconnects (with backoff) are timers. See netTimerFire.
 void NetworkSystem::netClientCheckConnectionHandshakes ( )
 {
-	TRACE_ENTER ( (__func__) );
-	TimeX current_time;
-	current_time.SetTimeNSec ( );	
-	if ( current_time.GetElapsedMSec ( m_lastClientConnectCheck ) > m_reconnectInterval ) {
-		m_lastClientConnectCheck.SetTimeNSec ( );
-
-		for ( int sock_i = 1; sock_i < (int) m_socks.size ( ); sock_i++ ) {
-			NetSock& s = m_socks[ sock_i ];
-			
-			if ( s.security & NET_SECURITY_OPENSSL) {				
-				// OpenSSL - retry connect during handshake
-				#ifdef BUILD_OPENSSL					
-				if ( s.state == STATE_HANDSHAKE ) {
-					netClientConnectSSL(sock_i);	// This call is MORE important than the others
-				}
-				#endif
-			} else if (s.security & NET_SECURITY_PLAIN_TCP) {
-				// TCP/IP - retry connect during handshake
-				if (s.state == STATE_HANDSHAKE) {
-					netClientHandshake ( sock_i );
-				}
-			}
-			
-			// All protocols
-			if (s.state == STATE_START || s.state == STATE_HANDSHAKE ) {
-				// Check for timeout
-				TimeX current_time;
-				current_time.SetTimeNSec();
-				if (current_time.GetElapsedMSec(s.lastStateChange) > s.reconnectInterval ) {
-					netManageHandshakeError(sock_i, "Client timed out");
-				}
-			} else if (s.state == STATE_NONE && s.reconnectCount > 0 ) {	
-				// Auto-reconnect if desired
-				s.reconnectCount--;
-				netClientConnectToServer ( s.srvAddr, s.srvPort, false, sock_i ); // If disconnected, try and reconnect
-			}			
-		}
-	}
-
-	TRACE_EXIT ( (__func__) );
+	netTimerRun ( );
 }
 	
 void NetworkSystem::netClientProcessIO ( )
@@ -1446,29 +2132,35 @@ void NetworkSystem::netClientProcessIO ( )
 	current_time.SetTimeNSec();
 	if (current_time.GetElapsedMSec(m_lastNetProcess) < m_processInterval) return;
 	m_lastNetProcess = current_time;
+	m_tickMs = TimeX::GetSystemNSec ( ) / MSEC_SCALAR;
 
 	// connection handling
 	netClientCheckConnectionHandshakes ( );
+	#ifdef BUILD_OPENSSL
+		netCheckHandshakesSSL ( );
+	#endif
 
 	// TCP data handling
 	TRACE_ENTER ( (__func__) );
-	fd_set sockReadSet;
-	fd_set sockWriteSet;
-	int rcv_events = netSocketSelect ( &sockReadSet, &sockWriteSet );
+	int rcv_events = netSocketPoll ( );
 	NET_PERF_PUSH ( "findsocks" );
 	
-	for ( int sock_i = 0; sock_i < (int) m_socks.size ( ); sock_i++ ) { 		
-		if ( netSocketIsSelected ( &sockReadSet, sock_i ) ) {			
+	for ( int n = 0; n < (int) m_sockReady.size ( ); n++ ) { 		
+		int sock_i = m_sockReady[ n ].sock_i;
+		if ( m_sockReady[ n ].read && valid_socket_index ( sock_i ) ) {			
 			// Receive any pending data
 			netReceiveData(sock_i);
 		}
-		if ( netSocketIsSelected ( &sockWriteSet, sock_i ) ) {
+		if ( m_sockReady[ n ].write && valid_socket_index ( sock_i ) ) {
 			// Send any pending data
 			netSendResidualEvent( sock_i );
 		}
 	}	
 	NET_PERF_POP ( );
 
+	// Send queued events
+	netSendFlush ( );
+
 	// UDP data handling
 	if (m_udp_sock.state==STATE_CONNECTED) 
 		netReceiveUDP ();
@@ -1488,6 +2180,11 @@ void NetworkSystem::netClientProcessIO ( )
 bool NetworkSystem::netIsConnectComplete ( int sock_i )
 {
 	TRACE_ENTER ( (__func__) );
+	if ( !m_workers.empty() && sock_i >= NET_SHARD_SOCKS ) {
+		bool outcome = netWorkerSockState ( sock_i ) >= 0;		// socket owned by a worker
+		TRACE_EXIT ( (__func__) );
+		return outcome;
+	}
 	bool outcome = valid_socket_index(sock_i) && m_socks[ sock_i ].state == STATE_CONNECTED;
 	TRACE_EXIT ( (__func__) );
 	return outcome;
@@ -1507,6 +2204,17 @@ int NetworkSystem::netCloseAll ( )
 int NetworkSystem::netCloseConnection ( int sock_i )
 {
 	TRACE_ENTER ( (__func__) );
+	if ( !m_workers.empty() && sock_i >= NET_SHARD_SOCKS ) {
+		NetworkSystem* ws = netWorkerFor ( sock_i );
+		if ( ws != 0x0 ) {
+			NetPost p;
+			p.cmd = 'c';
+			p.sock_i = sock_i;
+			ws->netPost ( p );			// closed on owning worker
+		}
+		TRACE_EXIT ( (__func__) );
+		return ws != 0x0;
+	}
 	if ( sock_i < 0 || sock_i >= m_socks.size ( ) ) {
 		TRACE_EXIT ( (__func__) );
 		return 0;
@@ -1558,29 +2266,165 @@ int NetworkSystem::netNonFatalErrorSSL ( int sock, int ret )
 #endif
 
 //----------------------------------------------------------------------------------------------------------------------
-// -> CORE CODE <-
+// -> TIMERS <-
 //----------------------------------------------------------------------------------------------------------------------
+// Per-socket deadlines are kept in a timer wheel, so each tick touches only sockets whose 
+// timers are due, rather than scanning every socket.
+//   NET_TIMER_HANDSHAKE	handshake timeout. On the listen socket, accept retry.
+//   NET_TIMER_RECONNECT	client reconnect, with exponential backoff and jitter
+//   NET_TIMER_IDLE				close a connection with nothing received for m_idleTimeout
+//   NET_TIMER_HEARTBEAT	send 'nHbt' when nothing was sent for m_heartbeat
+// Idle and heartbeat timers are not moved on every send or receive. When one fires early
+// (there was traffic) it is set again for the remaining time.
+
+void NetworkSystem::netTimerSet ( int sock_i, int kind, int time_ms )
+{
+	NetSock& s = m_socks[ sock_i ];
+	m_tickMs = TimeX::GetSystemNSec ( ) / MSEC_SCALAR;			// may be called outside a tick
+	if ( s.timers[ kind ] >= 0 ) m_timers.cancel ( s.timers[ kind ] );
+	s.timers[ kind ] = m_timers.add ( m_tickMs + imax ( time_ms, 0 ), sock_i, s.gen, kind );
+}
 
-
-void NetworkSystem::netClientCompleteConnection(int sock_i)
+void NetworkSystem::netTimerClear ( int sock_i, int kind )
 {
-	// We do not mark the client connection fully complete until client has 
-	// received 'sOkT' event. See netProcessEvents.
-	//
-	m_socks[ sock_i ].state = STATE_HANDSHAKE;
+	NetSock& s = m_socks[ sock_i ];
+	for ( int k = 0; k < NET_TIMER_KINDS; k++ ) {
+		if ( ( kind < 0 || k == kind ) && s.timers[ k ] >= 0 ) {
+			m_timers.cancel ( s.timers[ k ] );
+			s.timers[ k ] = -1;
+		}
+	}
 }
 
-void NetworkSystem::netProcessEvents ( Event& e )
+void NetworkSystem::netTimerRun ( )
 {
-	TRACE_ENTER ( (__func__) );
-	switch ( e.getName ( ) ) {
-		case 'sOkT': {
-			// Server sent OK for this client. Connection complete.			
-			netIP cli_ip = e.getInt64 ( );		// Client IP completed
-			netPort cli_port = e.getInt64 ( );  // Client port
-			netIP srv_ip = e.getInt64 ( );		// Server IP
-			int srv_port = e.getInt64 ( );		// Server port
-			int srv_sock = e.getInt ( );		// Server sock which maintains this client
+	m_timerFired.clear ( );
+	if ( m_timers.advance ( m_tickMs, m_timerFired ) == 0 ) return;
+
+	TRACE_ENTER ( (__func__) );
+	for ( int n = 0; n < (int) m_timerFired.size ( ); n++ ) {
+		NetTimerFire f = m_timerFired[ n ];
+		if ( !valid_socket_index ( f.sock ) ) continue;
+		NetSock& s = m_socks[ f.sock ];
+		if ( s.gen != f.gen || s.timers[ f.kind ] != f.id ) continue;		// socket closed, reused, or timer reset
+		s.timers[ f.kind ] = -1;
+		netTimerFire ( f.sock, f.kind );
+	}
+	TRACE_EXIT ( (__func__) );
+}
+
+void NetworkSystem::netTimerFire ( int sock_i, int kind )
+{
+	NetSock& s = m_socks[ sock_i ];
+	uint64_t quiet;
+
+	switch ( kind ) {
+	case NET_TIMER_HANDSHAKE:
+		if ( s.src.type == NTYPE_ANY ) {
+			// listen socket, accept clients not seen by the poll
+			if ( s.state == STATE_HANDSHAKE ) {
+				netTimerSet ( sock_i, NET_TIMER_HANDSHAKE, m_reconnectInterval );
+				netServerAcceptClient ( sock_i );
+			}
+			break;
+		}
+		if ( s.side == NET_CLI && s.state == STATE_HANDSHAKE && !( s.security & NET_SECURITY_OPENSSL ) ) {
+			netClientHandshake ( sock_i );						// TCP/IP - check connect complete
+		}
+		if ( s.state == STATE_START || s.state == STATE_HANDSHAKE ) {
+			netManageHandshakeError ( sock_i, ( s.side == NET_CLI ) ? "Client timed out" : "server SSL timeout" );
+		}
+		break;
+
+	case NET_TIMER_RECONNECT:
+		if ( s.state == STATE_NONE && s.reconnectCount > 0 ) {
+			s.reconnectCount--;
+			s.reconnectAttempt++;
+			s.stats.reconnects.add ( 1 );
+			m_stat.total.reconnects.add ( 1 );
+			netClientConnectToServer ( s.srvAddr, s.srvPort, false, sock_i );
+		}
+		break;
+
+	case NET_TIMER_IDLE:
+		if ( s.state != STATE_CONNECTED || m_idleTimeout <= 0 ) break;
+		quiet = m_tickMs - s.rxLast;
+		if ( quiet >= (uint64_t) m_idleTimeout ) {
+			NPRINTF ( VERBOSE, "Idle timeout, sock %d (%d ms)", sock_i, (int) quiet );
+			netManageTransmitError ( sock_i, "idle timeout" );
+		} else {
+			netTimerSet ( sock_i, NET_TIMER_IDLE, m_idleTimeout - (int) quiet );
+		}
+		break;
+
+	case NET_TIMER_HEARTBEAT:
+		if ( s.state != STATE_CONNECTED || m_heartbeat <= 0 ) break;
+		quiet = m_tickMs - s.txLast;
+		if ( quiet >= (uint64_t) m_heartbeat ) {
+			Event e;
+			netMakeEvent ( e, 'nHbt' );
+			netSend ( e, sock_i );
+			quiet = 0;
+		}
+		if ( valid_socket_index ( sock_i ) && m_socks[ sock_i ].state == STATE_CONNECTED ) {
+			netTimerSet ( sock_i, NET_TIMER_HEARTBEAT, m_heartbeat - (int) quiet );
+		}
+		break;
+	}
+}
+
+// Connection complete. Start idle and heartbeat timers.
+void NetworkSystem::netTimerConnected ( int sock_i )
+{
+	NetSock& s = m_socks[ sock_i ];
+	netTimerClear ( sock_i, NET_TIMER_HANDSHAKE );
+	s.reconnectAttempt = 0;
+	s.rxLast = s.txLast = m_tickMs;
+	if ( m_idleTimeout > 0 )	netTimerSet ( sock_i, NET_TIMER_IDLE, m_idleTimeout );
+	if ( m_heartbeat > 0 )		netTimerSet ( sock_i, NET_TIMER_HEARTBEAT, m_heartbeat );
+}
+
+// Client socket retained for reuse. Schedule the next reconnect.
+// Delay doubles with each attempt since the last connection, up to m_reconnectMax, and is 
+// reduced by a random part (up to m_reconnectJitter) so clients of a restarted server spread out.
+void NetworkSystem::netTimerReconnect ( int sock_i )
+{
+	NetSock& s = m_socks[ sock_i ];
+	netTimerClear ( sock_i );
+	if ( s.side != NET_CLI || s.reconnectCount <= 0 ) return;
+
+	int64_t delay = (int64_t) s.reconnectInterval << imin ( s.reconnectAttempt, 16 );
+	delay = imin ( delay, (int64_t) imax ( m_reconnectMax, s.reconnectInterval ) );
+	m_jitterSeed ^= m_jitterSeed << 13;  m_jitterSeed ^= m_jitterSeed >> 17;  m_jitterSeed ^= m_jitterSeed << 5;	// xorshift
+	float r = ( m_jitterSeed & 0xFFFFFF ) / float(0x1000000);
+	delay -= (int64_t) ( delay * m_reconnectJitter * r );
+	netTimerSet ( sock_i, NET_TIMER_RECONNECT, (int) delay );
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+// -> CORE CODE <-
+//----------------------------------------------------------------------------------------------------------------------
+
+
+void NetworkSystem::netClientCompleteConnection(int sock_i)
+{
+	// We do not mark the client connection fully complete until client has 
+	// received 'sOkT' event. See netProcessEvents.
+	//
+	m_socks[ sock_i ].state = STATE_HANDSHAKE;
+}
+
+void NetworkSystem::netProcessEvents ( Event& e )
+{
+	TRACE_ENTER ( (__func__) );
+	switch ( e.getName ( ) ) {
+		case 'sOkT': {
+			// Server sent OK for this client. Connection complete.			
+			netIP cli_ip = e.getInt64 ( );		// Client IP completed
+			netPort cli_port = e.getInt64 ( );  // Client port
+			netIP srv_ip = e.getInt64 ( );		// Server IP
+			int srv_port = e.getInt64 ( );		// Server port
+			int srv_sock = e.getInt ( );		// Server sock which maintains this client
 
 			int cli_sock = e.getSrcSock();		// Client sock which received accept (srcsock, not in payload)
 	
@@ -1596,6 +2440,7 @@ void NetworkSystem::netProcessEvents ( Event& e )
 			tcpSock.lastStateChange.SetTimeNSec();
 			tcpSock.dest.sock = srv_sock;			// assign server socket
 			tcpSock.src.port = cli_port;			// assign client port from server			
+			netTimerConnected ( cli_sock );
 
 			// Connection complete
 			bool ssl = tcpSock.security & NET_SECURITY_OPENSSL;
@@ -1603,7 +2448,7 @@ void NetworkSystem::netProcessEvents ( Event& e )
 
 			// Add optional UDP sockets
 			if (tcpSock.num_udp > 0) {
-				netClientStartUDP ();
+				netClientStartUDP ( cli_sock );
 			} else {
 				// List new network config
 				netList();
@@ -1614,7 +2459,7 @@ void NetworkSystem::netProcessEvents ( Event& e )
 			ce.attachInt ( cli_sock );		
 			ce.startRead ( );
 
-			(*m_userEventCallback) ( ce, this ); // Send to application
+			netUserCallback ( ce ); // Send to application
 
 			} break;		 
 
@@ -1626,18 +2471,21 @@ void NetworkSystem::netProcessEvents ( Event& e )
 			} break;
 
 		case 'cONU': {
-			int cli_sock = e.getInt ( );			// Client socket			
+			int srv_sock = e.getInt ( );			// Server socket (session)
 			int val = e.getInt();
-			NPRINTF ( VERBOSE, "START UDP: cONU, %d, val %d", cli_sock, val );			
+			int cli_sock = e.getInt ( );			// Client socket, session for replies
+			NPRINTF ( VERBOSE, "START UDP: cONU, %d, val %d, client sock %d", srv_sock, val, cli_sock );
+			if ( !valid_socket_index ( srv_sock ) ) break;
+			m_socks[ srv_sock ].udp_dest.sock = cli_sock;
 
 			netList();
 
 			// send packet back
 			Event e;
 			netMakeEvent ( e, 'sONU' );
-			e.attachInt ( 1 );
+			e.attachInt ( cli_sock );
 			e.attachInt ( 34016 );
-			netSendUDP ( e, cli_sock );
+			netSendUDP ( e, srv_sock );
 			} break;
 
 		case 'sONU': {
@@ -1648,6 +2496,10 @@ void NetworkSystem::netProcessEvents ( Event& e )
 
 			} break;
 
+		case 'nHbt':
+			// Heartbeat. Receipt already counts as activity (see netStatRecv).
+			break;
+
 		case 'cEXT': {
 			// Client has exited from this server.
 			int local_sock_i = e.getUInt ( ); // Socket to close
@@ -1669,9 +2521,14 @@ void NetworkSystem::netInitialize ( )
 	TRACE_ENTER ( (__func__) );
 	m_check = 0;
 	NPRINTF ( VERBOSE, "Network Initialize" );
-	m_eventPool = 0x0; // No event pooling
+	#if defined(BUILD_EVENT_POOLING) && defined(USE_EVENT_POOLING)
+		if ( m_eventPool == 0x0 ) m_eventPool = new EventPool;		// thread-safe, shared with workers' threads
+	#else
+		m_eventPool = 0x0; // No event pooling
+	#endif
 	netStartSocketAPI ( ); 
 	netSetHostname ( ); 
+	netSetPollMode ( m_pollMode );		// create readiness backend
 	TRACE_EXIT ( (__func__) );
 }
 
@@ -1719,6 +2576,9 @@ NetSock NetworkSystem::netCreateSocket ( int side, int mode, int state, bool blo
 		s.pktLen = 0;
 		s.pktCounter = 0;		
 
+		// receive ring
+		if ( m_recvRingSize > 0 ) netRingCreate ( s, m_recvRingSize );
+
 		// initial tx buf
 		s.txMax = 8192;			// expandable
 		s.txBuf = (char*) malloc(s.txMax);
@@ -1746,16 +2606,96 @@ int NetworkSystem::netAddSocket ( int side, int mode, int state, bool block, Net
 	NetSock s = netCreateSocket ( side, mode, state, block, src, dest );
 	if (s.socket==0) return NET_ERR;
 
-	// valid socket, add to list
-	int sock_i = m_socks.size ( );
-	m_socks.push_back ( s );	
+	// valid socket, reuse a terminated slot or add to list
+	int sock_i = netSockSlot ( );
+	if ( sock_i >= 0 ) {
+		netFreeSocketBufs ( m_socks[ sock_i ] );
+		m_socks[ sock_i ] = s;
+	} else {
+		sock_i = m_socks.size ( );
+		m_socks.push_back ( s );	
+	}
+	// next generation of this slot, so stale handles to an old socket no longer match.
+	// taken from m_sockGen, not the slot, as slots at the end of the list are erased.
+	if ( sock_i >= (int) m_sockGen.size() ) m_sockGen.resize ( sock_i + 1, 0 );
+	if ( ++m_sockGen[ sock_i ] == 0 ) m_sockGen[ sock_i ] = 1;		// 0 is never a valid handle
+	m_socks[ sock_i ].gen = m_sockGen[ sock_i ];
+	netSockIndexAdd ( sock_i );
 	CXSocketUpdateMode ( sock_i, 's' );
 	CXSocketUpdateMode ( sock_i, 'd' );	
+	netSocketPollAdd ( sock_i );
 	
 	TRACE_EXIT ( (__func__) );
 	return sock_i;
 }
 
+// Take a terminated slot from the free list
+// Entries are checked here rather than removed when a slot changes, so an entry may be
+// past the end of the list (erased) or already in use again.
+int NetworkSystem::netSockSlot ( )
+{
+	while ( m_sockFree.size() > 0 ) {
+		int sock_i = m_sockFree.back ( );
+		m_sockFree.pop_back ( );
+		if ( valid_socket_index ( sock_i ) && m_socks[ sock_i ].state == STATE_TERMINATED ) return sock_i;
+	}
+	return -1;
+}
+
+// Buffers of a terminated socket, released when its slot is reused
+void NetworkSystem::netFreeSocketBufs ( NetSock& s )
+{
+	if ( s.rxBuf != 0x0 ) free ( s.rxBuf );
+	if ( s.txBuf != 0x0 ) free ( s.txBuf );
+	if ( s.pktBuf != 0x0 ) free ( s.pktBuf );
+	delete s.event;
+	s.rxBuf = s.rxPtr = 0x0;
+	s.txBuf = s.txPtr = 0x0;
+	s.pktBuf = s.pktPtr = 0x0;
+	s.event = 0x0;
+}
+
+// Destination index
+// Sockets by dest ip:port. Must be updated wherever dest changes.
+void NetworkSystem::netSockIndexAdd ( int sock_i )
+{
+	NetSock& s = m_socks[ sock_i ];
+	m_sockDest[ net_dest_key ( s.dest.ip, s.dest.port ) ].push_back ( sock_i );
+}
+
+void NetworkSystem::netSockIndexRemove ( int sock_i )
+{
+	NetSock& s = m_socks[ sock_i ];
+	auto it = m_sockDest.find ( net_dest_key ( s.dest.ip, s.dest.port ) );
+	if ( it == m_sockDest.end() ) return;
+	std::vector<int>& list = it->second;
+	for ( int n = 0; n < (int) list.size(); n++ ) {
+		if ( list[ n ] == sock_i ) {
+			list[ n ] = list.back ( );
+			list.pop_back ( );
+			break;
+		}
+	}
+	if ( list.empty() ) m_sockDest.erase ( it );
+}
+
+// Socket handles
+// Slot index in the low 32 bits, slot generation in the high 32 bits. A handle held across
+// ticks (or threads) resolves to -1 once its socket is closed, even if the slot was reused.
+xlong NetworkSystem::netSockHandle ( int sock_i )
+{
+	if ( !valid_socket_index ( sock_i ) || m_socks[ sock_i ].state == STATE_TERMINATED ) return 0;
+	return ( (xlong) m_socks[ sock_i ].gen << 32 ) | (uint32_t) sock_i;
+}
+
+int NetworkSystem::netSockFromHandle ( xlong h )
+{
+	int sock_i = (int) ( h & 0xFFFFFFFF );
+	uint32_t gen = (uint32_t) ( h >> 32 );
+	if ( !valid_socket_index ( sock_i ) || m_socks[ sock_i ].gen != gen || m_socks[ sock_i ].state == STATE_TERMINATED ) return -1;
+	return sock_i;
+}
+
 void NetworkSystem::netSocketReuse ( int sock_i )
 {
 	// Several steps must occur to allow socket reuse.
@@ -1778,6 +2718,7 @@ void NetworkSystem::netSocketReuse ( int sock_i )
 	#endif	
 
 	// close the socket
+	netSocketPollRemove ( sock_i );
 	CXSocketClose( s.socket );
 	s.socket = 0;
 	
@@ -1789,12 +2730,16 @@ void NetworkSystem::netSocketReuse ( int sock_i )
 	s.socket = cxsock;
 	CXSocketUpdateMode ( sock_i, 's' );
 	CXSocketUpdateMode ( sock_i, 'd' );		
+	netSocketPollAdd ( sock_i );
 
 	// reset socket buffers
 	netResetBuf ( s.rxBuf, s.rxPtr, s.rxLen );
 	netResetBuf ( s.txBuf, s.txPtr, s.txLen );
+	netSendQueueClear ( sock_i );
+	s.rxHead = s.rxTail = 0;
 
-	// note: don't try and reconnect here. let the reconnect counter do it.
+	// note: don't try and reconnect here. let the reconnect timer do it.
+	netTimerReconnect ( sock_i );
 }
 
 void NetworkSystem::netResetBufs()
@@ -1805,6 +2750,8 @@ void NetworkSystem::netResetBufs()
 			NetSock& s = m_socks[i];
 			netResetBuf(s.rxBuf, s.rxPtr, s.rxLen);
 			netResetBuf(s.txBuf, s.txPtr, s.txLen);
+			netSendQueueClear ( i );
+			s.rxHead = s.rxTail = 0;
 		}
 	}
 }
@@ -1825,7 +2772,9 @@ int NetworkSystem::netManageHandshakeError ( int sock_i, std::string reason )
 		// Client try fallback to plain TCP
 		s.security = NET_SECURITY_PLAIN_TCP;
 		s.srvPort -= 1;									// TCP ports
+		netSockIndexRemove ( sock_i );
 		s.dest.port -= 1;
+		netSockIndexAdd ( sock_i );
 		s.state = STATE_NONE;						// indicate ready to restart
 		s.reconnectCount = s.reconnectMaxCount;		// reset the reconnect budget for TCP
 
@@ -1879,8 +2828,9 @@ int NetworkSystem::netManageTransmitError ( int sock_i, std::string reason, int
 
 // Terminate Socket
 // Note: This does not erase the socket from std::vector because we don't want to
-// shift around the other socket IDs. Instead it disables the socket ID, making it available
-// to another client later. Only the very last socket could be actually removed from list.
+// shift around the other socket IDs. Instead it disables the socket ID and places the slot
+// on the free list, so the next netAddSocket reuses it. Only the very last socket could be 
+// actually removed from list.
 
 
 int NetworkSystem::netDeleteSocket ( int sock_i, int force )
@@ -1901,20 +2851,30 @@ int NetworkSystem::netDeleteSocket ( int sock_i, int force )
 		// retain socket (client only)
 		NPRINTF(VERBOSE_HS, "Retained socket: %d", sock_i);
 		s.state = STATE_NONE;					// ready to start again (but do not start here)
+		netTimerReconnect ( sock_i );
 
 } else { 
 
 		// terminate socket
 		NPRINTF(VERBOSE_HS, "Terminating socket: %d", sock_i);
+		NET_TRACE ( NT_CLOSE, sock_i, 0 );
+		netSendQueueClear ( sock_i );
+		netRingFree ( s );
+		delete s.rel;
+		s.rel = 0x0;
+		delete s.emu;
+		s.emu = 0x0;
+		netSocketPollRemove ( sock_i );
 		CXSocketClose ( s.socket );
+		netTimerClear ( sock_i );
 		s.state = STATE_TERMINATED;
+		netSockIndexRemove ( sock_i );
+		m_sockFree.push_back ( sock_i );
 		// remove sockets at end of list
 		// --- FOR NOW, THIS IS NECESSARY ON CLIENT (which may have only 1 socket),
 		// BUT IN FUTURE CLIENTS SHOULD BE ABLE TO HAVE ANY NUMBER OF PREVIOUSLY TERMINATED SOCKETS
-		if ( m_socks.size ( ) > 0 ) {
-			while ( m_socks[ m_socks.size() -1 ].state == STATE_TERMINATED ) {
-				m_socks.erase ( m_socks.end ( ) -1 );
-			}
+		while ( m_socks.size ( ) > 0 && m_socks[ m_socks.size() -1 ].state == STATE_TERMINATED ) {
+			m_socks.erase ( m_socks.end ( ) -1 );
 		}
 	}
 	
@@ -1922,14 +2882,15 @@ int NetworkSystem::netDeleteSocket ( int sock_i, int force )
 	if ( wasConnected ) {
 		if ( m_hostType == 's' ) {
 			Event se (120, 'app ', 'cFIN', 0, m_eventPool );
-			se.attachInt ( sock_i );
+			se.attachInt ( netSockId ( sock_i ) );
+			se.setSrcSock ( netSockId ( sock_i ) );
 			se.startRead ( );
-			(*m_userEventCallback) (se, this); // Send to application
+			netUserCallback ( se ); // Send to application
 		} else {
 			Event ce (120, 'app ', 'sFIN', 0, m_eventPool );
 			ce.attachInt ( sock_i );
 			ce.startRead ( );
-			(*m_userEventCallback) (ce, this); // Send to application
+			netUserCallback ( ce ); // Send to application
 		}
 	}
 
@@ -1947,9 +2908,10 @@ int NetworkSystem::netEventCallback ( Event& e )
 
 	// Application should handle event
 	if ( sys != 'net ' ) {								// not intended for network system
-		if ( m_userEventCallback != 0x0 ) {				// pass user events to application
+		if ( m_userEventCallback != 0x0 || !m_owner->m_handlers.empty() ) {		// pass user events to application
 			TRACE_EXIT ( (__func__) );
-			return (*m_userEventCallback) ( e, this );
+			if ( m_sockBase > 0 ) e.setSrcSock ( netSockId ( e.getSrcSock() ) );		// global id on workers
+			return netUserCallback ( e, m_dispatchTime );
 		}
 	}
 	// Network system should handle event
@@ -1966,7 +2928,7 @@ void NetworkSystem::netReportError ( int result )
 	netMakeEvent ( e, 'nerr' );
 	e.attachInt ( result );
 	e.startRead();
-	(*m_userEventCallback) ( e, this );
+	netUserCallback ( e );
 	TRACE_EXIT ( (__func__) );
 }
 
@@ -1977,6 +2939,16 @@ void NetworkSystem::netReportError ( int result )
 int NetworkSystem::netProcessQueue ( void )
 {
 	// TRACE_ENTER ( (__func__) );	
+	// This thread consumes both queues, set before receive pushes to the event queue
+	m_postQueue.setConsumer ();
+	m_eventQueue.setConsumer ();
+
+	// Send events posted from other threads
+	Event pe;
+	while ( m_postQueue.PopFront ( pe ) ) {
+		netSendAcquire ( pe, pe.getSrcSock() );
+	}
+
 	if ( m_socks.size ( ) > 0 ) {
 		if ( m_hostType == 'c' ) {			
 			netClientProcessIO ( );
@@ -1984,17 +2956,19 @@ int NetworkSystem::netProcessQueue ( void )
 			netServerProcessIO ( );
 		}
 	}
+	netEmuRelease ( );					// emulated link, deliver held data that is due
+	netStatSample ( );					// periodic RTT
+
 	int iOk = 0; // Handle incoming events on queue
-	Event* e;
+	Event e;
 	
-	while ( m_eventQueue.getSize ( ) > 0 ) {
-
-		m_eventQueue.PopFront ( e );
-		iOk += netEventCallback ( *e );		// count each user event handled ok				
-		
-		e->consume ();
-		delete e;
+	while ( m_eventQueue.PopFront ( e, &m_dispatchTime ) ) {		// event moves out of queue slot
+		iOk += netEventCallback ( e );		// count each user event handled ok				
+		e.consume ();
 	}
+	m_dispatchTime = 0;
+	iOk += m_recvHandled;				// events handled as views during receive
+	m_recvHandled = 0;
 	// TRACE_EXIT ( (__func__) );
 	return iOk;
 }
@@ -2021,6 +2995,109 @@ void NetworkSystem::netResetBuf ( char*& buf, char*& ptr, int& len )
 	ptr = buf;
 }
 
+// Receive ring
+// Received bytes [rxHead, rxTail) are waiting to be parsed into events.
+// With NET_RING_MIRROR the ring is mapped twice back-to-back, so any span up to
+// rxRingMax is contiguous across the wrap. Otherwise the ring is a linear buffer, and
+// only a trailing partial event is moved to the front when the end is reached.
+//
+bool NetworkSystem::netRingCreate ( NetSock& s, int size )
+{
+	int sz = 4096;
+	while ( sz < size ) sz <<= 1;			// power of 2, page multiple
+	s.rxRing = 0x0;
+	s.rxRingMax = 0;
+	s.rxRingMirror = false;
+	s.rxHead = s.rxTail = 0;
+
+	#ifdef NET_RING_MIRROR
+		int fd = memfd_create ( "netring", 0 );
+		if ( fd >= 0 ) {
+			char* base = (char*) mmap ( NULL, 2*sz, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0 );
+			if ( ftruncate ( fd, sz ) == 0 && base != MAP_FAILED ) {
+				char* a = (char*) mmap ( base, sz, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_FIXED, fd, 0 );
+				char* b = (char*) mmap ( base + sz, sz, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_FIXED, fd, 0 );
+				if ( a == base && b == base + sz ) {
+					s.rxRing = base;
+					s.rxRingMirror = true;
+				} else {
+					munmap ( base, 2*sz );
+				}
+			} else if ( base != MAP_FAILED ) {
+				munmap ( base, 2*sz );
+			}
+			close ( fd );
+		}
+	#endif
+	if ( s.rxRing == 0x0 ) {
+		s.rxRing = (char*) malloc ( sz );		// linear fallback
+		if ( s.rxRing == 0x0 ) return false;
+	}
+	s.rxRingMax = sz;
+	return true;
+}
+
+void NetworkSystem::netRingFree ( NetSock& s )
+{
+	if ( s.rxRing == 0x0 ) return;
+	#ifdef NET_RING_MIRROR
+		if ( s.rxRingMirror ) munmap ( s.rxRing, 2*s.rxRingMax );
+		else free ( s.rxRing );
+	#else
+		free ( s.rxRing );
+	#endif
+	s.rxRing = 0x0;
+	s.rxRingMax = 0;
+	s.rxHead = s.rxTail = 0;
+}
+
+// Make at least 'need' contiguous bytes writable at the ring tail
+bool NetworkSystem::netRingReserve ( NetSock& s, int need )
+{
+	int used = (int) (s.rxTail - s.rxHead);
+
+	if ( s.rxRingMirror ) {
+		if ( s.rxRingMax - used >= need ) return true;
+	} else {
+		if ( used == 0 ) s.rxHead = s.rxTail = 0;
+		if ( s.rxRingMax - (int) s.rxTail >= need ) return true;
+		if ( s.rxRingMax - used >= need ) {
+			memmove ( s.rxRing, s.rxRing + s.rxHead, used );		// move partial event to front
+			s.rxHead = 0;
+			s.rxTail = used;
+			return true;
+		}
+	}
+	// grow ring, retaining unparsed bytes
+	int64_t sz = ( (int64_t) used + need ) * EXPAND_FACTOR;
+	if ( sz > INT_MAX / 2 ) sz = (int64_t) used + need;					// no headroom near the int limit
+	if ( sz > INT_MAX / 2 ) return false;
+	NetSock ns;
+	if ( !netRingCreate ( ns, (int) sz ) ) return false;
+	memcpy ( ns.rxRing, netRingRead ( s ), used );
+	netRingFree ( s );
+	s.rxRing = ns.rxRing;
+	s.rxRingMax = ns.rxRingMax;
+	s.rxRingMirror = ns.rxRingMirror;
+	s.rxHead = 0;
+	s.rxTail = used;
+	return true;
+}
+
+char* NetworkSystem::netRingRead ( NetSock& s )
+{
+	return s.rxRing + ( s.rxRingMirror ? ( s.rxHead & (s.rxRingMax-1) ) : s.rxHead );
+}
+char* NetworkSystem::netRingWrite ( NetSock& s, int& avail )
+{
+	if ( s.rxRingMirror ) {
+		avail = s.rxRingMax - (int) (s.rxTail - s.rxHead);
+		return s.rxRing + ( s.rxTail & (s.rxRingMax-1) );
+	}
+	avail = s.rxRingMax - (int) s.rxTail;
+	return s.rxRing + s.rxTail;
+}
+
 xlong NetworkSystem::ComputeChecksum ( char* buf, int len )
 {
 	xlong sum = 0;
@@ -2031,18 +3108,28 @@ xlong NetworkSystem::ComputeChecksum ( char* buf, int len )
 	return sum;	
 }
 
-void NetworkSystem::netDeserializeUDP ( NetSock& s, int sock_i )
+void NetworkSystem::netDeserializeUDP ( NetSock& s, int sock_i, char* buf, int len )
 {
 	int header_sz = Event::staticSerializedHeaderSize();
 
 	// UDP always contains complete event.
-	// rxBuf is already populated upon entry
-	s.pktLen = s.rxLen;
-	s.pktPtr = s.rxBuf;
+	// buf holds one datagram (rx buffer or batch slot)
+	s.pktLen = len;
+	s.pktPtr = buf;
 	
 	// Start of new event, retrieve total event length from encoded header
 	s.eventLen = *((int*) (s.pktPtr + Event::staticOffsetLenInfo())) + Event::staticSerializedHeaderSize ( );
 
+	// Reliable channel trailer follows the event
+	if ( s.pktLen == s.eventLen + (int) sizeof(NetRelHdr) ) {
+		NetRelHdr h;
+		memcpy ( &h, buf + s.eventLen, sizeof(NetRelHdr) );
+		if ( h.magic == NET_REL_MAGIC ) {
+			netRelReceive ( sock_i, buf, s.eventLen, h );
+			return;
+		}
+	}
+
 	if ( s.pktLen <= s.eventLen ) {
 		// Create event; no name/target. will be set during deserialize		
 		eventStr_t name = *(eventStr_t*) (s.pktPtr + Event::staticOffsetLenInfo() + 4);
@@ -2052,13 +3139,35 @@ void NetworkSystem::netDeserializeUDP ( NetSock& s, int sock_i )
 		s.event->setSrcIP( m_socks[ sock_i ].src.ip );		// recover sender address from socket
 				
 		// Deserialize directly from input buffer (for performance)				
-		s.event->deserialize ( s.pktPtr, s.eventLen );		// deserialize					
-		netQueueEvent ( *s.event );								// queue event (consumed later)				
+		if ( netDeserializeEvent ( *s.event, s.pktPtr, s.eventLen ) )
+			netQueueEvent ( *s.event );								// queue event (consumed later)				
 	}
 }
 
 
-void NetworkSystem::netDeserializeEvents(int sock_i)
+// Length of a received event (header included) from its header, or -1 when the length
+// is negative or over m_maxEventSize.
+int NetworkSystem::netRecvEventLen ( char* hdr )
+{
+	int header_sz = Event::staticSerializedHeaderSize();
+	int data_len = *((int*) (hdr + Event::staticOffsetLenInfo()));
+	if ( data_len < 0 || data_len > m_maxEventSize - header_sz ) return -1;
+	return data_len + header_sz;
+}
+
+// Bad event length. The stream can't be resynced, so the connection is dropped.
+// Returns false, for the caller to return.
+bool NetworkSystem::netRecvBadLength ( int sock_i, char* hdr )
+{
+	NetSock& s = m_socks[ sock_i ];
+	NPRINTF ( DERROR, "RX bad event length %d (max %d), sock %d. Dropping connection.", *((int*) (hdr + Event::staticOffsetLenInfo())), m_maxEventSize, sock_i );
+	s.rxLen = s.pktLen = s.eventLen = 0;
+	s.rxPtr = s.rxBuf;
+	netManageTransmitError ( sock_i, "bad event length" );
+	return false;
+}
+
+bool NetworkSystem::netDeserializeEvents(int sock_i)
 {
 	TRACE_ENTER ( (__func__) );
 
@@ -2086,7 +3195,8 @@ void NetworkSystem::netDeserializeEvents(int sock_i)
 		if ( s.rxLen == 0 && s.pktLen >= header_sz ) { // Check for new or partial event
 			
 			// Start of new event, retrieve total event length from encoded header
-			s.eventLen = *((int*)(s.pktPtr + Event::staticOffsetLenInfo())) + Event::staticSerializedHeaderSize ( );
+			s.eventLen = netRecvEventLen ( s.pktPtr );
+			if ( s.eventLen < 0 ) { TRACE_EXIT ( (__func__) ); return netRecvBadLength ( sock_i, s.pktPtr ); }
 
 			if ( s.pktLen >= s.eventLen ) {
 				// Create event; no name/target. will be set during deserialize		
@@ -2097,8 +3207,8 @@ void NetworkSystem::netDeserializeEvents(int sock_i)
 				s.event->setSrcIP( m_socks[ sock_i ].src.ip );				// recover sender address from socket
 				
 				// Deserialize directly from input buffer (for performance)				
-				s.event->deserialize ( s.pktPtr, s.eventLen );		// deserialize					
-				netQueueEvent ( *s.event );								// queue event (consumed later)				
+				if ( netDeserializeEvent ( *s.event, s.pktPtr, s.eventLen ) )
+					netQueueEvent ( *s.event );								// queue event (consumed later)				
 
 				// Checksum [debugging] - determine if send/recv buffers (events) match byte-for-byte
 				if (m_printFlow) {
@@ -2132,7 +3242,8 @@ void NetworkSystem::netDeserializeEvents(int sock_i)
 			s.pktLen = 0;
 
 			if (s.rxLen >= header_sz && s.eventLen == 0 )  {
-				s.eventLen = *((int*)(s.rxBuf + Event::staticOffsetLenInfo())) + Event::staticSerializedHeaderSize();				
+				s.eventLen = netRecvEventLen ( s.rxBuf );
+				if ( s.eventLen < 0 ) { TRACE_EXIT ( (__func__) ); return netRecvBadLength ( sock_i, s.rxBuf ); }
 			}
 		}
 
@@ -2140,15 +3251,15 @@ void NetworkSystem::netDeserializeEvents(int sock_i)
 		while ( s.rxLen >= s.eventLen && s.eventLen > 0 ) {
 
 			// Create event; no name/target. will be set during deserialize	
-			eventStr_t name = *(eventStr_t*) (s.pktPtr + Event::staticOffsetLenInfo() + 4);
+			eventStr_t name = *(eventStr_t*) (s.rxBuf + Event::staticOffsetLenInfo() + 4);
 			new_event ( *s.event, s.eventLen - Event::staticSerializedHeaderSize ( ), 'net ', name, 0, m_eventPool, "netRecv" );
 			s.event->rescope ( "nets" );						// belongs to network now
 			s.event->setSrcSock ( sock_i );					// tag event /w socket
 			s.event->setSrcIP ( m_socks[ sock_i ].src.ip );		// recover sender address from socket
 				
 			// Deserialize event from recv buf			
-			s.event->deserialize ( s.rxBuf, s.eventLen );	// deserialize			
-			netQueueEvent ( *s.event );							// queue event (consumed later)			
+			if ( netDeserializeEvent ( *s.event, s.rxBuf, s.eventLen ) )
+				netQueueEvent ( *s.event );							// queue event (consumed later)			
 			
 			// Checksum [debugging] - determine if send/recv buffers (events) match byte-for-byte
 			if ( m_printFlow ) {
@@ -2163,14 +3274,152 @@ void NetworkSystem::netDeserializeEvents(int sock_i)
 			s.eventLen = 0;													// reset event len
 
 			// Check for additional event(s)
-			if (s.rxLen > header_sz) {
-				s.eventLen = *((int*)(s.rxBuf + Event::staticOffsetLenInfo())) + Event::staticSerializedHeaderSize();	
+			if (s.rxLen >= header_sz) {
+				s.eventLen = netRecvEventLen ( s.rxBuf );
+				if ( s.eventLen < 0 ) { TRACE_EXIT ( (__func__) ); return netRecvBadLength ( sock_i, s.rxBuf ); }
 			}
 		}
 	}
 	TRACE_EXIT ( (__func__) );
+	return true;
 } 
 
+// Deserialize events from receive ring
+// Complete events are parsed in place. With netSetRecvViews, events are handed to the 
+// callback immediately as borrowed views of ring memory (no pooled copy). An app that 
+// retains the event (acquire or copy) gets a deep copy. Views are only used when the 
+// event queue is empty, to keep delivery in order.
+//
+bool NetworkSystem::netDeserializeRing ( int sock_i )
+{
+	TRACE_ENTER ( (__func__) );
+	int header_sz = Event::staticSerializedHeaderSize();
+	xlong chksum = 0;
+
+	while ( valid_socket_index ( sock_i ) ) {
+		NetSock& s = m_socks[ sock_i ];
+		if ( s.state == STATE_TERMINATED || s.rxRing == 0x0 ) break;
+
+		int used = (int) (s.rxTail - s.rxHead);
+		if ( used < header_sz ) break;
+
+		char* ptr = netRingRead ( s );
+		int event_len = netRecvEventLen ( ptr );
+		if ( event_len < 0 ) {
+			// corrupt or hostile length
+			s.rxHead = s.rxTail = 0;
+			TRACE_EXIT ( (__func__) );
+			return netRecvBadLength ( sock_i, ptr );
+		}
+		if ( used < event_len ) {
+			// partial event, make room for the rest
+			if ( !netRingReserve ( s, event_len - used ) ) {
+				NPRINTF ( DERROR, "RX unable to hold event of %d bytes, sock %d. Dropping connection.", event_len, sock_i );
+				s.rxHead = s.rxTail = 0;
+				netManageTransmitError ( sock_i, "rx ring" );
+				TRACE_EXIT ( (__func__) );
+				return false;
+			}
+			break;
+		}
+		if ( m_printFlow ) {
+			chksum = ComputeChecksum ( ptr, event_len );
+		}
+		NPRINTF ( DFLOW, "RX %d bytes (ring=%d) --> RECV  chksum=%lld", event_len, used, chksum );
+
+		bool packed = *(eventStr_t*) ( ptr + Event::staticOffsetTarget() ) == (eventStr_t) NET_EVENT_LZ4;
+		if ( m_recvViews && m_eventQueue.getSize() == 0 && !packed ) {
+			// Borrowed view, dispatched now. Ring bytes are consumed after the callback.
+			Event view;
+			view.borrow ( ptr, event_len, m_eventPool );
+			view.rescope ( "nets" );
+			view.setSrcSock ( sock_i );
+			view.setSrcIP ( s.src.ip );
+			NET_TRACE ( NT_RECV_EVENT, sock_i, view.getName() );
+			xlong head = s.rxHead;
+			char* ring = s.rxRing;
+			netStatRecv ( s, event_len );
+			m_recvHandled += netEventCallback ( view );			
+
+			// callback may close or reset the socket
+			if ( !valid_socket_index ( sock_i ) ) break;
+			NetSock& sc = m_socks[ sock_i ];
+			if ( sc.rxRing != ring || sc.rxTail < head + event_len ) break;
+			sc.rxHead = head + event_len;
+		} else {
+			// Pooled copy, queued
+			eventStr_t name = *(eventStr_t*) (ptr + Event::staticOffsetLenInfo() + 4);
+			new_event ( *s.event, event_len - header_sz, 'app ', name, 0, m_eventPool, "netRecv" );
+			s.event->rescope ( "nets" );
+			s.event->setSrcSock ( sock_i );
+			s.event->setSrcIP ( s.src.ip );
+			if ( netDeserializeEvent ( *s.event, ptr, event_len ) )
+				netQueueEvent ( *s.event );
+			s.rxHead += event_len;
+		}
+	}
+	TRACE_EXIT ( (__func__) );
+	return true;
+}
+
+// Deserialize one complete event from buf
+// Compressed events (target NET_EVENT_LZ4) are expanded to their original target and
+// payload. Returns false if a compressed payload is corrupt.
+bool NetworkSystem::netDeserializeEvent ( Event& e, char* buf, int len )
+{
+	int header_sz = Event::staticSerializedHeaderSize();
+	int pre_sz = sizeof(int) + sizeof(eventStr_t);				// original length and target
+	NET_TRACE ( NT_RECV_EVENT, e.getSrcSock(), *(eventStr_t*) ( buf + Event::staticOffsetLenInfo() + 4 ) );
+
+	if ( *(eventStr_t*) ( buf + Event::staticOffsetTarget() ) != (eventStr_t) NET_EVENT_LZ4 ) {
+		e.deserialize ( buf, len );
+		return true;
+	}
+	int orig_len = ( len >= header_sz + pre_sz ) ? *(int*) ( buf + header_sz ) : -1;
+	if ( orig_len < 0 || orig_len > NET_COMPRESS_MAX ) {
+		NPRINTF ( DERROR, "RX compressed event has bad length %d, sock %d", orig_len, e.getSrcSock() );
+		return false;
+	}
+	eventStr_t name = *(eventStr_t*) ( buf + Event::staticOffsetLenInfo() + 4 );
+	new_event ( e, orig_len, 'app ', name, 0, m_eventPool, "netUnzip" );
+
+	// header, then payload
+	int cid = e.mCID;
+	memcpy ( (char*) &e + Event::staticOffsetLenInfo(), buf, header_sz );
+	e.mCID = cid;
+	e.mTarget = *(eventStr_t*) ( buf + header_sz + sizeof(int) );
+	int result = netDecompress ( buf + header_sz + pre_sz, len - header_sz - pre_sz, e.mData, orig_len );
+	if ( result != orig_len ) {
+		NPRINTF ( DERROR, "RX compressed event is corrupt, sock %d", e.getSrcSock() );
+		e.mDataLen = 0;
+		return false;
+	}
+	e.mDataLen = orig_len;
+	e.mPos = e.mData + orig_len;
+	return true;
+}
+
+// Compress the payload of e into ce
+// Returns false if the payload does not shrink by at least 1/8, so it is sent as is.
+bool NetworkSystem::netCompressEvent ( Event& e, Event& ce )
+{
+	int len = e.getDataLength ();
+	int max = len - len / 8;
+	int pre_sz = sizeof(int) + sizeof(eventStr_t);
+
+	new_event ( ce, pre_sz + max, NET_EVENT_LZ4, e.getName(), 0, m_eventPool, "netZip" );
+	ce.setTimeStamp ( e.getTimeStamp() );
+	*(int*) ce.mData = len;
+	*(eventStr_t*) ( ce.mData + sizeof(int) ) = e.getTarget();
+	int clen = netCompress ( e.getData(), len, ce.mData + pre_sz, max );
+	if ( clen <= 0 ) return false;
+
+	ce.mDataLen = pre_sz + clen;
+	ce.mPos = ce.mData + ce.mDataLen;
+	NPRINTF ( DFLOW, "TX compressed %s, %d -> %d bytes", e.NameToStr().c_str(), len, clen );
+	return true;
+}
+
 // -- Original deserialize func (NOT CORRECT)
 //
 /* void NetworkSystem::netDeserializeEvents(int sock_i)
@@ -2269,6 +3518,19 @@ void NetworkSystem::netReceiveByInjectedBuf(int sock_i, char* buf, int buflen )
 	
 	// inject buffer
 	NetSock& s = m_socks[sock_i];
+	if ( s.rxRing != 0x0 ) {
+		int avail;
+		if ( !netRingReserve ( s, buflen ) ) {
+			NPRINTF ( DERROR, "Injected packet too large for ring. %d bytes", buflen );
+			TRACE_EXIT((__func__));
+			return;
+		}
+		memcpy ( netRingWrite ( s, avail ), buf, buflen );
+		s.rxTail += buflen;
+		netDeserializeRing ( sock_i );
+		TRACE_EXIT((__func__));	
+		return;
+	}
 	if ( buflen > s.pktMax ) {
 		NPRINTF ( DERROR, "Injected packet too large. %d > %d max", buflen, s.pktMax );
 		exit(-77);
@@ -2292,9 +3554,50 @@ void NetworkSystem::netReceiveData ( int sock_i )
 	NetSock& s = m_socks[ sock_i ];	
 	int result = 1;
 
+	NetEmu* emu = netEmuFor ( s );
+	if ( emu != 0x0 ) {
+		// Emulated link. Hold received bytes, delivered later by netEmuRelease
+		int max = (s.rxRing != 0x0) ? 65536 : s.pktMax;
+		if ( (int) m_emuBuf.size() < max ) m_emuBuf.resize ( max );
+		while ( result > 0 ) {
+			if ( emu->queued >= emu->cfg.queue_bytes ) { emu->throttled = true; break; }
+			result = CXSocketRecv ( sock_i, m_emuBuf.data(), max );
+			if ( result < 0 ) {
+				netManageTransmitError ( sock_i, "recv error" );			
+				break;
+			} else if ( result > 0 ) {
+				netEmuHold ( emu, m_emuBuf.data(), result, 0x0 );
+			}
+		}
+		TRACE_EXIT ( (__func__) );	
+		return;
+	}
+
+	if ( s.rxRing != 0x0 ) {
+		// Receive directly into ring
+		while ( result > 0 && valid_socket_index ( sock_i ) ) {
+			NetSock& s = m_socks[ sock_i ];
+			int avail;
+			netRingReserve ( s, 4096 );
+			char* dst = netRingWrite ( s, avail );
+			result = CXSocketRecv ( sock_i, dst, avail );
+			if ( result < 0 ) {
+				netManageTransmitError ( sock_i, "recv error" );			
+				break;
+			} else if ( result > 0 ) {
+				NET_TRACE ( NT_RECV, sock_i, result );
+				s.rxTail += result;
+				s.pktCounter++;
+				if ( !netDeserializeRing ( sock_i ) ) break;		// connection dropped
+			}
+		}
+		TRACE_EXIT ( (__func__) );	
+		return;
+	}
+
 	while ( result > 0 ) {
 
-		result = CXSocketRecv ( s.socket, s.security, s.state, s.pktBuf, s.pktMax );
+		result = CXSocketRecv ( sock_i, s.pktBuf, s.pktMax );
 		
 		if ( result < 0 ) {
 			// recv error
@@ -2304,9 +3607,10 @@ void NetworkSystem::netReceiveData ( int sock_i )
 
 		} else if ( result > 0 ) {
 			// received bytes. deserialize.
+			NET_TRACE ( NT_RECV, sock_i, result );
 			s.pktLen = result; 
 			assert ( result <= s.pktMax );
-			netDeserializeEvents(sock_i);
+			if ( !netDeserializeEvents ( sock_i ) ) break;		// connection dropped
 		}
 
 		#ifdef DEBUG_STREAM
@@ -2325,11 +3629,72 @@ void NetworkSystem::netReceiveData ( int sock_i )
 	TRACE_EXIT ( (__func__) );	
 }
 
+// Receive UDP
+// Batched: drains up to m_udpBatch datagrams per recvmmsg, repeated while the batch fills.
+// With GRO, one slot may hold several equal-size datagrams, split by the segment size.
 void NetworkSystem::netReceiveUDP ()
 {
+	TRACE_ENTER ( (__func__) );
 	std::string msg;
 	NetAddr recv_src;
-	
+
+	#ifdef NET_UDP_MMSG
+	if ( m_udpBatch > 1 ) {
+		int slot = m_udpOffload ? NET_UDP_GRO_SIZE : m_udp_sock.rxMax;
+		if ( (int) m_udpRxBuf.size() != slot * m_udpBatch ) m_udpRxBuf.resize ( slot * m_udpBatch );
+
+		mmsghdr msgs[ NET_UDP_BATCH_MAX ];
+		iovec iov[ NET_UDP_BATCH_MAX ];
+		sockaddr_in src[ NET_UDP_BATCH_MAX ];
+		char ctl[ NET_UDP_BATCH_MAX ][ CMSG_SPACE(sizeof(int)) ];
+
+		for ( int round = 0; round < 8; round++ ) {			// bounded per tick
+			for ( int i = 0; i < m_udpBatch; i++ ) {
+				iov[i].iov_base = &m_udpRxBuf[ i * slot ];
+				iov[i].iov_len = slot;
+				memset ( &msgs[i], 0, sizeof(mmsghdr) );
+				msgs[i].msg_hdr.msg_name = &src[i];
+				msgs[i].msg_hdr.msg_namelen = sizeof(sockaddr_in);
+				msgs[i].msg_hdr.msg_iov = &iov[i];
+				msgs[i].msg_hdr.msg_iovlen = 1;
+				if ( m_udpOffload ) {
+					msgs[i].msg_hdr.msg_control = ctl[i];
+					msgs[i].msg_hdr.msg_controllen = sizeof(ctl[i]);
+				}
+			}
+			int cnt = recvmmsg ( m_udp_sock.socket, msgs, m_udpBatch, MSG_DONTWAIT, NULL );
+			if ( cnt < 0 ) {
+				if (!CXSocketWouldBlock ( msg )) {
+					NPRINTF( DERROR_HS, "Recvmmsg UDP error.");
+				}
+				break;
+			}
+			NET_TRACE ( NT_UDP_RECV, -1, cnt );
+			for ( int i = 0; i < cnt; i++ ) {
+				char* buf = (char*) iov[i].iov_base;
+				int len = msgs[i].msg_len;
+				if ( msgs[i].msg_hdr.msg_flags & MSG_TRUNC ) {
+					NPRINTF ( DERROR, "UDP datagram truncated, larger than %d bytes.", slot );
+					continue;
+				}
+				// GRO segment size
+				int seg = len;
+				for ( cmsghdr* cm = CMSG_FIRSTHDR(&msgs[i].msg_hdr); cm != 0x0; cm = CMSG_NXTHDR(&msgs[i].msg_hdr, cm) ) {
+					if ( cm->cmsg_level == SOL_UDP && cm->cmsg_type == UDP_GRO ) memcpy ( &seg, CMSG_DATA(cm), sizeof(int) );
+				}
+				if ( seg <= 0 ) seg = len;
+				recv_src.addr = src[i];
+				for ( int off = 0; off < len; off += seg ) {
+					netReceiveUDPPacket ( buf + off, imin ( seg, len - off ), recv_src );
+				}
+			}
+			if ( cnt < m_udpBatch ) break;			// socket drained
+		}
+		TRACE_EXIT ( (__func__) );
+		return;
+	}
+	#endif
+
 	int result = CXSocketRecvFrom ( m_udp_sock.socket, m_udp_sock.rxBuf, m_udp_sock.rxMax, recv_src );
 	
 	if ( netFuncError(result)  ) {
@@ -2338,32 +3703,52 @@ void NetworkSystem::netReceiveUDP ()
 		}
 
 	} else if ( result > 0 ) {
+		NET_TRACE ( NT_UDP_RECV, -1, 1 );
+		netReceiveUDPPacket ( m_udp_sock.rxBuf, result, recv_src );
+	}
 
-		// Received bytes
-		m_udp_sock.rxLen = result; 
-		
-		// Update the client UDP port (dynamic)		
-		int sock_i = * (int*) (m_udp_sock.rxBuf + Event::staticSerializedHeaderSize() );
-		if (sock_i < 0 || sock_i >= m_socks.size() ) {
-			NPRINTF ( DERROR, "Client not found UDP: %d\n", sock_i );
-			return;
-		}
-		NetSock& s = m_socks[ sock_i];
-		CXSocketUnpackAddr ( recv_src );		
-		s.udp_dest.type = NTYPE_CONNECT;
-		s.udp_dest.port = recv_src.port;
-		s.udp_dest.ip = recv_src.ip;
-		CXSocketUpdateAddr ( s.udp_dest );
-
-		// Deserialize
-		netDeserializeUDP ( m_udp_sock, sock_i );		
+	TRACE_EXIT ( (__func__) );	
+}
 
-		if (m_printFlow) {
-			dbgprintf ( "recvfrom: %s, %d bytes, sock %d, %s\n", netPrintAddr(s.udp_dest).c_str(), result, sock_i, m_udp_sock.event->NameToStr().c_str() );
-		}
+// Handle one received datagram
+void NetworkSystem::netReceiveUDPPacket ( char* buf, int len, NetAddr& recv_src, bool emulate )
+{
+	NetEmu* emu = emulate ? netEmuFor ( m_udp_sock ) : 0x0;
+	if ( emu != 0x0 ) {
+		netEmuHold ( emu, buf, len, &recv_src );		// emulated link, delivered later
+		return;
+	}
+	if ( len < Event::staticSerializedHeaderSize() + (int) sizeof(int) ) {
+		NPRINTF ( DERROR, "UDP datagram too short: %d bytes\n", len );
+		return;
+	}
+	// Loss model (testing)
+	if ( m_udpLoss > 0 ) {
+		m_udpLossSeed ^= m_udpLossSeed << 13;  m_udpLossSeed ^= m_udpLossSeed >> 17;  m_udpLossSeed ^= m_udpLossSeed << 5;		// xorshift
+		if ( (m_udpLossSeed & 0xFFFFFF) < (uint32_t) (m_udpLoss * 0xFFFFFF) ) { m_udpLost++; return; }
 	}
+	// Received bytes
+	m_udp_sock.rxLen = len; 
+	
+	// Update the client UDP port (dynamic)		
+	int sock_i = * (int*) (buf + Event::staticSerializedHeaderSize() );
+	if (sock_i < 0 || sock_i >= m_socks.size() ) {
+		NPRINTF ( DERROR, "Client not found UDP: %d\n", sock_i );
+		return;
+	}
+	NetSock& s = m_socks[ sock_i];
+	CXSocketUnpackAddr ( recv_src );		
+	s.udp_dest.type = NTYPE_CONNECT;
+	s.udp_dest.port = recv_src.port;
+	s.udp_dest.ip = recv_src.ip;
+	CXSocketUpdateAddr ( s.udp_dest );
 
-	TRACE_EXIT ( (__func__) );	
+	// Deserialize
+	netDeserializeUDP ( m_udp_sock, sock_i, buf, len );		
+
+	if (m_printFlow) {
+		dbgprintf ( "recvfrom: %s, %d bytes, sock %d, %s\n", netPrintAddr(s.udp_dest).c_str(), len, sock_i, m_udp_sock.event->NameToStr().c_str() );
+	}
 }
 
 //----------------------------------------------------------------------------------------------------------------------
@@ -2374,13 +3759,14 @@ void NetworkSystem::netQueueEvent ( Event& e )
 {
 	TRACE_ENTER ( (__func__) );
 
-	// persistent event
-	Event* eq = new Event;
-	eq->acquire ( e );				// eq now owns the data
-	eq->persist ();					// persist beyond scope of this func
-	eq->rescope ( "nets" );
+	int sock_i = e.getSrcSock ();
+	if ( valid_socket_index ( sock_i ) ) netStatRecv ( m_socks[ sock_i ], e.getSerializedLength() );
+	NET_TRACE ( NT_QUEUE, sock_i, e.getName() );
 
-	m_eventQueue.Push ( eq );	// data payload is owned by queued event
+	// queue slot acquires the event (no copy, no allocation)
+	e.rescope ( "nets" );
+	e.consume ();
+	m_eventQueue.Push ( e, TimeX::GetSystemNSec() );	// data payload is owned by queued event
 
 	TRACE_EXIT ( (__func__) );
 }
@@ -2412,38 +3798,46 @@ int NetworkSystem::netFindSocket ( int side, int mode, int type )
 
 int NetworkSystem::netFindSocket ( int state, NetAddr& dest )
 {
-	for ( int n = 0; n < m_socks.size ( ); n++ ) { 
-		if (m_socks[ n].state == state && m_socks[ n ].dest.ip == dest.ip && m_socks[ n ].dest.port == dest.port ) {
-			return n;		
-		}
+	auto it = m_sockDest.find ( net_dest_key ( dest.ip, dest.port ) );		// sockets with this dest only
+	if ( it == m_sockDest.end() ) return -1;
+	int found = -1;
+	for ( int n : it->second ) {
+		if ( m_socks[ n ].state == state && ( found == -1 || n < found ) ) found = n;		// lowest index, as a full scan
 	}
-	return -1;
+	return found;
 }
 
 int NetworkSystem::netFindSocket ( int side, int mode, int state, NetAddr& dest )
 {
 	TRACE_ENTER ( (__func__) );
-	for ( int n = 0; n < m_socks.size ( ); n++ ) { // Find socket with specific destination
-		if ( m_socks[ n ].mode == mode && m_socks[ n ].side == side && m_socks[ n].state == state ) {
-			if ( m_socks[ n ].dest.type == dest.type &&  m_socks[ n ].dest.ip == dest.ip && m_socks[ n ].dest.port == dest.port ) {
-				TRACE_EXIT ( (__func__) );
-				return n;
-			}
+	int found = -1;
+	auto it = m_sockDest.find ( net_dest_key ( dest.ip, dest.port ) );		// Find socket with specific destination
+	if ( it != m_sockDest.end() ) {
+		for ( int n : it->second ) {
+			NetSock& s = m_socks[ n ];
+			if ( s.mode == mode && s.side == side && s.state == state && s.dest.type == dest.type && ( found == -1 || n < found ) ) found = n;
 		}
 	}
 	TRACE_EXIT ( (__func__) );
-	return -1;
+	return found;
 }
 
 int NetworkSystem::netFindOutgoingSocket ( bool bTcp )
 {
 	TRACE_ENTER ( (__func__) );
-	for ( int n=0; n < m_socks.size ( ); n++ ) { // Find first fully-connected outgoing socket
+	int n = m_sockOut;						// last found, if still connected
+	if ( valid_socket_index ( n ) && m_socks[ n ].mode==NET_TCP && m_socks[ n ].state == STATE_CONNECTED ) {
+		TRACE_EXIT ( (__func__) );
+		return n;
+	}
+	for ( n=0; n < m_socks.size ( ); n++ ) { // Find first fully-connected outgoing socket
 		if ( m_socks[ n ].mode==NET_TCP && m_socks[ n ].state == STATE_CONNECTED ) {
+			m_sockOut = n;
 			TRACE_EXIT ( (__func__) );
 			return n;
 		}
 	}
+	m_sockOut = -1;
 	TRACE_EXIT ( (__func__) );
 	return -1;
 }
@@ -2488,7 +3882,7 @@ void NetworkSystem::netList ( bool verbose )
 			};
 			src = netPrintAddr ( s.src );
 			dst = netPrintAddr ( s.dest );			
-			udp = (s.udp_dest.sock==0) ? "" : "udp:" + std::to_string ( s.udp_dest.port );
+			udp = (s.udp_dest.sock < 0) ? "" : "udp:" + std::to_string ( s.udp_dest.port );
 			msg = "";
 			if ( s.side==NET_CLI && s.state == STATE_CONNECTED ) msg = "--> to Server";
 			if ( s.side==NET_SRV && s.state == STATE_CONNECTED ) msg = "--> to Client";
@@ -2501,7 +3895,417 @@ void NetworkSystem::netList ( bool verbose )
 }
 
 //----------------------------------------------------------------------------------------------------------------------
-// -> LOW-LEVEL WRAPPER <-
+// -> RELIABLE UDP CHANNELS <-
+//----------------------------------------------------------------------------------------------------------------------
+//
+// Optional reliability over UDP. Channel types:
+//   NET_CHAN_UNRELIABLE           - plain datagram (netSendUDP), no trailer
+//   NET_CHAN_RELIABLE_ORDERED     - resent until acked, delivered in order (later messages held)
+//   NET_CHAN_RELIABLE_UNORDERED   - resent until acked, delivered on arrival, duplicates dropped
+//   NET_CHAN_UNRELIABLE_SEQUENCED - not resent, stale messages dropped
+// Every channel datagram acks the peer's last 33 packets. A socket which received but had
+// nothing to send replies with an ack-only datagram on the next tick. Resends wait the 
+// larger of the retransmit time and twice the smoothed round trip.
+// As with netSendUDP, the event payload must begin with the peer's socket (session) id.
+//
+
+static inline bool seq_newer ( uint16_t a, uint16_t b )		{ return (int16_t) (a - b) > 0; }
+
+NetRel::NetRel ()
+{
+	localSeq = 0; remoteSeq = 0; remoteBits = 0;
+	remoteValid = false; ackPending = false;
+	for (int c=0; c < NET_REL_CHANNELS; c++) { sendSeq[c] = 0; recvSeq[c] = 0; recvValid[c] = false; }
+	recvMark.assign ( NET_REL_CHANNELS * NET_REL_WINDOW, 0 );
+	for (int n=0; n < NET_REL_SENT; n++) { sentSeq[n] = 0; sentKey[n] = 0xFFFFFFFF; sentTime[n] = 0; }
+	srtt = 0;
+	numSent = numResent = numAcked = numDelivered = 0;
+}
+
+void NetworkSystem::netSetChannel ( int channel, int type )
+{
+	if ( channel < 0 || channel >= NET_REL_CHANNELS || type < NET_CHAN_UNRELIABLE || type > NET_CHAN_UNRELIABLE_SEQUENCED ) {
+		NPRINTF ( DERROR, "Invalid UDP channel %d or type %d.", channel, type );
+		return;
+	}
+	m_relChannel[ channel ] = type;
+}
+
+void NetworkSystem::netSetLossModel ( float loss, uint32_t seed )
+{
+	m_udpLoss = loss;
+	m_udpLossSeed = (seed == 0) ? 1 : seed;
+}
+
+NetRel* NetworkSystem::netRelState ( int sock_i )
+{
+	NetSock& s = m_socks[ sock_i ];
+	if ( s.rel == 0x0 ) {
+		s.rel = new NetRel;
+		if ( std::find ( m_relSocks.begin(), m_relSocks.end(), sock_i ) == m_relSocks.end() ) m_relSocks.push_back ( sock_i );
+	}
+	return s.rel;
+}
+
+// Session id of the peer, first int of a datagram
+// The peer's socket, learned when UDP starts (see netClientStartUDP and 'cONU').
+int NetworkSystem::netRelPeerSock ( int sock_i )
+{
+	return valid_socket_index ( sock_i ) ? m_socks[ sock_i ].udp_dest.sock : -1;
+}
+
+// Send on UDP channel
+bool NetworkSystem::netSend ( Event& e, int sock_i, int channel )
+{
+	TRACE_ENTER ( (__func__) );
+	if ( channel < 0 || channel >= NET_REL_CHANNELS || m_udp_sock.state != STATE_CONNECTED || !valid_socket_index(sock_i) ) {
+		TRACE_EXIT ( (__func__) );
+		return false;
+	}
+	int type = m_relChannel[ channel ];
+	if ( type == NET_CHAN_UNRELIABLE ) {
+		bool ok = netSendUDP ( e, sock_i );
+		TRACE_EXIT ( (__func__) );
+		return ok;
+	}
+	NetRel* r = netRelState ( sock_i );
+	e.rescope ( "nets" );
+	if ( e.mData == 0x0 ) 												{ TRACE_EXIT ( (__func__) ); return false; }
+	e.serialize ();
+	char* buf = e.getSerializedData ( );
+	int len = e.getSerializedLength ( );
+	uint16_t msg_seq = r->sendSeq[ channel ];
+
+	if ( type != NET_CHAN_UNRELIABLE_SEQUENCED ) {
+		// hold until acked
+		if ( r->pending.size() >= NET_REL_WINDOW ) {
+			NPRINTF ( DFLOW, "Reliable UDP window full, sock %d.", sock_i );
+			TRACE_EXIT ( (__func__) );
+			return false;
+		}
+		NetRelMsg& m = r->pending[ (channel << 16) | msg_seq ];
+		m.data.assign ( buf, buf + len );
+		m.sends = 0;
+		buf = m.data.data();
+	}
+	r->sendSeq[ channel ]++;
+	netRelSendPacket ( sock_i, buf, len, channel, msg_seq, 0 );
+
+	TRACE_EXIT ( (__func__) );
+	return true;
+}
+
+// Send datagram with channel trailer
+void NetworkSystem::netRelSendPacket ( int sock_i, char* buf, int len, int channel, uint16_t msg_seq, int flags )
+{
+	NetRel* r = m_socks[ sock_i ].rel;
+	uint64_t now = TimeX::GetSystemNSec ();
+
+	NetRelHdr h;
+	h.seq = r->localSeq++;
+	h.ack = r->remoteSeq;
+	h.ack_bits = r->remoteBits;
+	h.msg_seq = msg_seq;
+	h.channel = channel;
+	h.flags = flags | (r->remoteValid ? NET_REL_HASACK : 0);
+	h.magic = NET_REL_MAGIC;
+	r->ackPending = false;					// acks ride on every datagram
+
+	// track packet for acks and round trip
+	int slot = h.seq % NET_REL_SENT;
+	r->sentSeq[ slot ] = h.seq;
+	r->sentTime[ slot ] = now;
+	r->sentKey[ slot ] = 0xFFFFFFFF;
+	if ( !(flags & NET_REL_ACKONLY) ) {
+		auto it = r->pending.find ( (channel << 16) | msg_seq );
+		if ( it != r->pending.end() ) {
+			r->sentKey[ slot ] = it->first;
+			it->second.sent = now;
+			if ( it->second.sends++ > 0 ) r->numResent++;
+		}
+	}
+	r->numSent++;
+
+	m_relPkt.resize ( len + sizeof(NetRelHdr) );
+	memcpy ( &m_relPkt[0], buf, len );
+	memcpy ( &m_relPkt[len], &h, sizeof(NetRelHdr) );
+	netSendUDPBuf ( &m_relPkt[0], (int) m_relPkt.size(), sock_i );
+}
+
+// Peer received packet seq
+void NetworkSystem::netRelAck ( NetRel* r, uint16_t seq )
+{
+	int slot = seq % NET_REL_SENT;
+	if ( r->sentSeq[ slot ] != seq || r->sentTime[ slot ] == 0 ) return;		// unknown or already acked
+
+	uint64_t rtt_ns = TimeX::GetSystemNSec() - r->sentTime[ slot ];
+	float rtt = float( rtt_ns ) / MSEC_SCALAR;
+	m_stat.rtt.record ( rtt_ns );
+	r->srtt = (r->srtt == 0) ? rtt : r->srtt * 0.875f + rtt * 0.125f;
+	r->sentTime[ slot ] = 0;
+	if ( r->sentKey[ slot ] != 0xFFFFFFFF && r->pending.erase ( r->sentKey[ slot ] ) > 0 ) r->numAcked++;
+}
+
+// Receive datagram with channel trailer
+// buf/len is the event, without trailer
+void NetworkSystem::netRelReceive ( int sock_i, char* buf, int len, NetRelHdr& h )
+{
+	NetRel* r = netRelState ( sock_i );
+
+	// record packet, to ack
+	if ( !r->remoteValid ) {
+		r->remoteValid = true;
+		r->remoteSeq = h.seq;
+		r->remoteBits = 0;
+	} else if ( seq_newer ( h.seq, r->remoteSeq ) ) {
+		int shift = (uint16_t) (h.seq - r->remoteSeq);
+		r->remoteBits = ( shift < 32 ? r->remoteBits << shift : 0 ) | ( shift <= 32 ? 1u << (shift-1) : 0 );
+		r->remoteSeq = h.seq;
+	} else {
+		int d = (uint16_t) (r->remoteSeq - h.seq);
+		if ( d >= 1 && d <= 32 ) r->remoteBits |= 1u << (d-1);
+	}
+
+	// acks from peer
+	if ( h.flags & NET_REL_HASACK ) {
+		netRelAck ( r, h.ack );
+		for ( int n = 0; n < 32; n++ ) {
+			if ( h.ack_bits & (1u << n) ) netRelAck ( r, h.ack - 1 - n );
+		}
+	}
+	if ( h.flags & NET_REL_ACKONLY ) return;
+	r->ackPending = true;
+
+	int ch = h.channel;
+	if ( ch >= NET_REL_CHANNELS ) return;
+	uint16_t seq = h.msg_seq;
+
+	switch ( m_relChannel[ ch ] ) {
+	case NET_CHAN_RELIABLE_UNORDERED: {
+		uint32_t& mark = r->recvMark[ ch * NET_REL_WINDOW + seq % NET_REL_WINDOW ];
+		if ( mark == (seq | 0x10000u) ) return;				// duplicate
+		mark = seq | 0x10000u;
+		} break;
+	case NET_CHAN_RELIABLE_ORDERED: {
+		uint16_t dist = seq - r->recvSeq[ ch ];
+		if ( dist >= NET_REL_WINDOW ) return;					// duplicate
+		if ( dist > 0 ) {
+			if ( r->hold[ ch ].find ( seq ) == r->hold[ ch ].end() ) 
+				r->hold[ ch ][ seq ].assign ( buf, buf + len );		// early, hold until gap is filled
+			return;
+		}
+		r->recvSeq[ ch ]++;
+		r->numDelivered++;
+		netDeserializeUDP ( m_udp_sock, sock_i, buf, len );
+
+		// release held messages now in order
+		auto it = r->hold[ ch ].find ( r->recvSeq[ ch ] );
+		while ( it != r->hold[ ch ].end() ) {
+			netDeserializeUDP ( m_udp_sock, sock_i, it->second.data(), (int) it->second.size() );
+			r->hold[ ch ].erase ( it );
+			r->recvSeq[ ch ]++;
+			r->numDelivered++;
+			it = r->hold[ ch ].find ( r->recvSeq[ ch ] );
+		}
+		} return;
+	case NET_CHAN_UNRELIABLE_SEQUENCED:
+		if ( r->recvValid[ ch ] && !seq_newer ( seq, r->recvSeq[ ch ] ) ) return;		// stale
+		r->recvValid[ ch ] = true;
+		r->recvSeq[ ch ] = seq;
+		break;
+	};
+	r->numDelivered++;
+	netDeserializeUDP ( m_udp_sock, sock_i, buf, len );
+}
+
+// Resends and acks, once per tick
+void NetworkSystem::netRelUpdate ( )
+{
+	if ( m_relSocks.empty() ) return;
+	uint64_t now = TimeX::GetSystemNSec ();
+	int j = 0;
+
+	for ( int n = 0; n < (int) m_relSocks.size(); n++ ) {
+		int sock_i = m_relSocks[ n ];
+		if ( !valid_socket_index ( sock_i ) || m_socks[ sock_i ].rel == 0x0 ) continue;		// socket closed
+		m_relSocks[ j++ ] = sock_i;
+		NetRel* r = m_socks[ sock_i ].rel;
+
+		// resend unacked messages
+		uint64_t rto = (uint64_t) imax ( m_relRetransmit, (int) (2 * r->srtt) ) * MSEC_SCALAR;
+		for ( auto it = r->pending.begin(); it != r->pending.end(); ) {
+			NetRelMsg& m = it->second;
+			if ( now - m.sent < rto ) { ++it; continue; }
+			if ( m.sends >= NET_REL_MAX_SENDS ) {
+				NPRINTF ( DERROR, "Reliable UDP message dropped after %d sends. sock %d, channel %d", m.sends, sock_i, it->first >> 16 );
+				it = r->pending.erase ( it );
+				continue;
+			}
+			netRelSendPacket ( sock_i, m.data.data(), (int) m.data.size(), it->first >> 16, it->first & 0xFFFF, 0 );
+			++it;
+		}
+		// ack-only, when nothing was sent since receiving
+		if ( r->ackPending && netRelPeerSock ( sock_i ) >= 0 ) {
+			Event e;
+			netMakeEvent ( e, 'rACK' );
+			e.attachInt ( netRelPeerSock ( sock_i ) );
+			e.serialize ();
+			netRelSendPacket ( sock_i, e.getSerializedData(), e.getSerializedLength(), 0, 0, NET_REL_ACKONLY );
+		}
+	}
+	m_relSocks.resize ( j );
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+// -> NETWORK EMULATION <-
+//----------------------------------------------------------------------------------------------------------------------
+//
+// In-process link emulation, for reproducible tests on one machine (no namespaces or root).
+// Received data is taken from the socket as usual, held, and released on a later tick through 
+// netReceiveByInjectedBuf (TCP) or the datagram path (UDP). Release time is
+//   link free + len / recv_bps + latency +/- jitter
+// TCP stays in order. UDP datagrams may be dropped, or skip the delay (reorder).
+// Held TCP bytes above queue_bytes stop reads, so the sender sees real flow control.
+// Emulate both directions by setting emulation on both systems.
+//
+
+static inline float emu_rand ( uint32_t& s )
+{
+	s ^= s << 13;  s ^= s >> 17;  s ^= s << 5;			// xorshift
+	return (s & 0xFFFFFF) / float(0x1000000);
+}
+
+void NetworkSystem::netSetCompression ( int min_bytes, int sock_i )
+{
+	// set before netServerStartWorkers for all sockets. workers inherit it.
+	if ( sock_i >= 0 ) {
+		if ( valid_socket_index ( sock_i ) ) m_socks[ sock_i ].compressMin = min_bytes;
+		return;
+	}
+	m_compressMin = min_bytes;
+	for ( int n = 0; n < (int) m_socks.size(); n++ )
+		m_socks[ n ].compressMin = -1;
+}
+
+void NetworkSystem::netSetEmulation ( NetEmuConfig cfg, int sock_i )
+{
+	// set before netServerStartWorkers for all sockets. workers inherit it.
+	if ( sock_i >= 0 ) {
+		if ( !valid_socket_index ( sock_i ) ) return;
+		NetSock& s = m_socks[ sock_i ];
+		if ( s.emu == 0x0 ) s.emu = new NetEmu ( cfg );
+		else s.emu->cfg = cfg;
+		return;
+	}
+	m_emuOn = true;
+	m_emuConfig = cfg;
+	for ( int n = 0; n < (int) m_socks.size(); n++ ) {
+		if ( m_socks[ n ].emu != 0x0 ) m_socks[ n ].emu->cfg = cfg;
+	}
+	if ( m_udp_sock.emu != 0x0 ) m_udp_sock.emu->cfg = cfg;
+}
+
+void NetworkSystem::netClearEmulation ( )
+{
+	netEmuRelease ( true );
+	m_emuOn = false;
+	for ( int n = 0; n < (int) m_socks.size(); n++ ) {
+		delete m_socks[ n ].emu;
+		m_socks[ n ].emu = 0x0;
+	}
+	delete m_udp_sock.emu;
+	m_udp_sock.emu = 0x0;
+}
+
+NetEmu* NetworkSystem::netEmuFor ( NetSock& s )
+{
+	if ( s.emu == 0x0 && m_emuOn ) s.emu = new NetEmu ( m_emuConfig );
+	return s.emu;
+}
+
+// Hold received bytes (src = 0) or a datagram
+void NetworkSystem::netEmuHold ( NetEmu* emu, char* buf, int len, NetAddr* src )
+{
+	NetEmuConfig& c = emu->cfg;
+	uint64_t now = TimeX::GetSystemNSec ();
+
+	if ( src != 0x0 ) {
+		if ( ( c.loss > 0 && emu_rand ( emu->rng ) < c.loss ) || emu->queued + len > c.queue_bytes ) {
+			emu->numDropped++;				// lost, or link queue full
+			return;
+		}
+	}
+	// serialization at link rate, then propagation
+	uint64_t release = now;
+	if ( c.recv_bps > 0 ) {
+		release = imax ( now, emu->linkFree ) + (uint64_t) ( len / c.recv_bps * SEC_SCALAR );
+		emu->linkFree = release;
+	}
+	float delay = c.latency_ms;
+	if ( c.jitter_ms > 0 ) delay += ( emu_rand ( emu->rng ) * 2 - 1 ) * c.jitter_ms;
+	if ( delay > 0 ) release += (uint64_t) ( delay * MSEC_SCALAR );
+
+	if ( src != 0x0 && c.reorder > 0 && emu_rand ( emu->rng ) < c.reorder ) {
+		release = now;								// arrives ahead of earlier datagrams
+		emu->numReordered++;
+	} else {
+		release = imax ( release, emu->lastRelease );		// in order
+		emu->lastRelease = release;
+	}
+	NetEmuChunk& chunk = emu->queue.insert ( std::make_pair ( release, NetEmuChunk() ) )->second;
+	chunk.data.assign ( buf, buf + len );
+	if ( src != 0x0 ) chunk.src = *src;
+	emu->queued += len;
+	emu->numHeld++;
+	emu->bytesHeld += len;
+}
+
+// Deliver held data that is due (or all)
+void NetworkSystem::netEmuRelease ( bool all )
+{
+	uint64_t now = TimeX::GetSystemNSec ();
+
+	for ( int n = 0; n < (int) m_socks.size(); n++ ) {
+		NetEmu* emu = m_socks[ n ].emu;
+		if ( emu == 0x0 ) continue;
+		while ( !emu->queue.empty() && ( all || emu->queue.begin()->first <= now ) ) {
+			NetEmuChunk chunk;
+			chunk.data.swap ( emu->queue.begin()->second.data );
+			emu->queue.erase ( emu->queue.begin() );
+			emu->queued -= (int) chunk.data.size();
+			netReceiveByInjectedBuf ( n, chunk.data.data(), (int) chunk.data.size() );
+			if ( !valid_socket_index ( n ) || m_socks[ n ].emu != emu ) break;		// socket closed
+		}
+		if ( valid_socket_index ( n ) && m_socks[ n ].emu == emu && emu->throttled && emu->queued < emu->cfg.queue_bytes ) {
+			emu->throttled = false;
+			netReceiveData ( n );					// resume reads
+		}
+	}
+	NetEmu* emu = m_udp_sock.emu;
+	while ( emu != 0x0 && !emu->queue.empty() && ( all || emu->queue.begin()->first <= now ) ) {
+		NetEmuChunk chunk;
+		chunk.data.swap ( emu->queue.begin()->second.data );
+		chunk.src = emu->queue.begin()->second.src;
+		emu->queue.erase ( emu->queue.begin() );
+		emu->queued -= (int) chunk.data.size();
+		netReceiveUDPPacket ( chunk.data.data(), (int) chunk.data.size(), chunk.src, false );
+	}
+}
+
+// Outbound bytes allowed now (token bucket, 10 msec burst)
+int NetworkSystem::netEmuSendAllow ( NetEmu* emu )
+{
+	if ( emu == 0x0 || emu->cfg.send_bps <= 0 ) return 0x7FFFFFFF;
+	uint64_t now = TimeX::GetSystemNSec ();
+	double burst = imax ( emu->cfg.send_bps * 0.01, 16384.0 );
+	if ( emu->sendTime == 0 ) emu->sendTokens = burst;
+	else emu->sendTokens = imin ( burst, emu->sendTokens + double(now - emu->sendTime) / SEC_SCALAR * emu->cfg.send_bps );
+	emu->sendTime = now;
+	return (int) emu->sendTokens;
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+// -> LOW-LEVEL WRAPPER <-
 //----------------------------------------------------------------------------------------------------------------------
 
 void NetworkSystem::netStartSocketAPI ( )
@@ -2570,97 +4374,737 @@ void NetworkSystem::netMeasureSocketStats ( bool start, int sock_i )
 	}
 }
 
-float NetworkSystem::getSockRTT ( int sock_i )
+float NetworkSystem::getSockRTT ( int sock_i )
+{
+	NetSock& sock = m_socks[sock_i];
+
+	#ifndef _WIN32	
+	
+		tcp_info info{};
+		socklen_t len = sizeof(info);
+		getsockopt ( sock.socket, IPPROTO_TCP, TCP_INFO, &info, &len);
+		return info.tcpi_rtt / 1000.0;
+
+	#else
+		return 0;
+	#endif
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+// -> STATISTICS <-
+//----------------------------------------------------------------------------------------------------------------------
+//
+// Counters are kept per socket and as totals per system, always on. Each is written by the
+// thread owning the socket and may be read from any thread. Latency histograms record
+// dispatch time (netQueueEvent to user callback) and round trips, sampled from TCP_INFO 
+// each netSetStatInterval and from reliable UDP acks.
+//
+
+void NetHist::reset ()
+{
+	for ( int b = 0; b < NET_HIST_BUCKETS; b++ ) counts[ b ].store ( 0, std::memory_order_relaxed );
+	count.store ( 0, std::memory_order_relaxed );
+	sum.store ( 0, std::memory_order_relaxed );
+	vmax.store ( 0, std::memory_order_relaxed );
+}
+
+int NetHist::bucket ( uint64_t v )
+{
+	if ( v < 2*NET_HIST_SUB ) return (int) v;								// exact
+	if ( v >> NET_HIST_BITS ) return NET_HIST_BUCKETS - 1;
+	int msb = 63;
+	#ifdef _WIN32
+		unsigned long i;
+		_BitScanReverse64 ( &i, v );
+		msb = (int) i;
+	#else
+		msb = 63 - __builtin_clzll ( v );
+	#endif
+	int shift = msb - 5;																		// top 6 bits kept, v >> shift in [32,63]
+	return NET_HIST_SUB * shift + (int) ( v >> shift );
+}
+
+uint64_t NetHist::bucketValue ( int b )
+{
+	if ( b < 2*NET_HIST_SUB ) return b;
+	int shift = b / NET_HIST_SUB - 1;
+	uint64_t sub = b - NET_HIST_SUB * shift;
+	return ( ( sub + 1 ) << shift ) - 1;
+}
+
+void NetHist::record ( uint64_t v )
+{
+	counts[ bucket ( v ) ].fetch_add ( 1, std::memory_order_relaxed );
+	count.fetch_add ( 1, std::memory_order_relaxed );
+	sum.fetch_add ( v, std::memory_order_relaxed );
+	uint64_t m = vmax.load ( std::memory_order_relaxed );
+	while ( v > m && !vmax.compare_exchange_weak ( m, v, std::memory_order_relaxed ) );
+}
+
+void NetHist::merge ( const NetHist& h )
+{
+	for ( int b = 0; b < NET_HIST_BUCKETS; b++ ) {
+		uint64_t c = h.counts[ b ].load ( std::memory_order_relaxed );
+		if ( c > 0 ) counts[ b ].fetch_add ( c, std::memory_order_relaxed );
+	}
+	count.fetch_add ( h.getCount(), std::memory_order_relaxed );
+	sum.fetch_add ( h.sum.load ( std::memory_order_relaxed ), std::memory_order_relaxed );
+	if ( h.getMax() > getMax() ) vmax.store ( h.getMax(), std::memory_order_relaxed );
+}
+
+double NetHist::getMean () const
+{
+	uint64_t n = getCount ();
+	return ( n == 0 ) ? 0 : double( sum.load ( std::memory_order_relaxed ) ) / n;
+}
+
+uint64_t NetHist::getPercentile ( double q ) const
+{
+	uint64_t n = getCount ();
+	if ( n == 0 ) return 0;
+	uint64_t rank = (uint64_t) ( q * n );
+	if ( rank >= n ) rank = n - 1;
+	uint64_t seen = 0;
+	for ( int b = 0; b < NET_HIST_BUCKETS; b++ ) {
+		seen += counts[ b ].load ( std::memory_order_relaxed );
+		if ( seen > rank ) return imin ( bucketValue ( b ), getMax() );
+	}
+	return getMax ();
+}
+
+str NetHist::getJSON () const
+{
+	char buf[ 256 ];
+	snprintf ( buf, 256, "{\"count\": %llu, \"mean\": %.0f, \"max\": %llu, \"p50\": %llu, \"p90\": %llu, \"p99\": %llu, \"p999\": %llu}",
+		(unsigned long long) getCount(), getMean(), (unsigned long long) getMax(), (unsigned long long) getPercentile(0.5), 
+		(unsigned long long) getPercentile(0.9), (unsigned long long) getPercentile(0.99), (unsigned long long) getPercentile(0.999) );
+	return buf;
+}
+
+static str stat_counters_json ( const NetSockStat& c )
+{
+	char buf[ 512 ];
+	snprintf ( buf, 512, "\"events_in\": %llu, \"events_out\": %llu, \"bytes_in\": %llu, \"bytes_out\": %llu, \"partial_sends\": %llu, \"send_fail\": %llu, \"reconnects\": %llu, \"tls_full\": %llu, \"tls_resumed\": %llu",
+		(unsigned long long) c.events_in.get(), (unsigned long long) c.events_out.get(), (unsigned long long) c.bytes_in.get(), (unsigned long long) c.bytes_out.get(),
+		(unsigned long long) c.partial_sends.get(), (unsigned long long) c.send_fail.get(), (unsigned long long) c.reconnects.get(),
+		(unsigned long long) c.tls_full.get(), (unsigned long long) c.tls_resumed.get() );
+	return buf;
+}
+
+// Sample TCP round trip of connected sockets
+void NetworkSystem::netStatSample ( )
+{
+	if ( m_statInterval <= 0 ) return;
+	TimeX current_time;
+	current_time.SetTimeNSec ();
+	if ( current_time.GetElapsedMSec ( m_statLast ) < m_statInterval ) return;
+	m_statLast = current_time;
+
+	for ( int n = 0; n < (int) m_socks.size(); n++ ) {
+		NetSock& s = m_socks[ n ];
+		if ( s.mode != NET_TCP || s.state != STATE_CONNECTED || s.src.type == NTYPE_ANY ) continue;
+		float rtt = getSockRTT ( n );			// msec
+		if ( rtt <= 0 ) continue;
+		s.stats.rtt_us.set ( (uint64_t) ( rtt * 1000 ) );
+		m_stat.rtt.record ( (uint64_t) ( rtt * MSEC_SCALAR ) );
+	}
+}
+
+void NetworkSystem::netResetStats ( )
+{
+	m_stat.total.reset ();
+	m_stat.dispatch.reset ();
+	m_stat.rtt.reset ();
+	for ( int n = 0; n < (int) m_socks.size(); n++ ) m_socks[ n ].stats.reset ();
+	for ( NetworkSystem* ws : m_workers ) {
+		ws->m_stat.total.reset ();				// worker sockets are reset by the worker
+		ws->m_stat.dispatch.reset ();
+		ws->m_stat.rtt.reset ();
+	}
+}
+
+// Statistics as JSON
+// Totals and histograms include workers. Sockets are those of this system, 
+// worker sockets are listed only when called on the worker thread.
+str NetworkSystem::netGetStatsJSON ( bool sockets )
+{
+	NetSockStat total = m_stat.total;
+	NetHist* dispatch = new NetHist;
+	NetHist* rtt = new NetHist;
+	dispatch->merge ( m_stat.dispatch );
+	rtt->merge ( m_stat.rtt );
+	int queued = m_eventQueue.getSize ();
+	for ( NetworkSystem* ws : m_workers ) {
+		const NetSockStat& w = ws->m_stat.total;
+		total.events_in.add ( w.events_in.get() );			total.events_out.add ( w.events_out.get() );
+		total.bytes_in.add ( w.bytes_in.get() );				total.bytes_out.add ( w.bytes_out.get() );
+		total.partial_sends.add ( w.partial_sends.get() );	total.send_fail.add ( w.send_fail.get() );
+		total.reconnects.add ( w.reconnects.get() );
+		total.tls_full.add ( w.tls_full.get() );				total.tls_resumed.add ( w.tls_resumed.get() );
+		dispatch->merge ( ws->m_stat.dispatch );
+		rtt->merge ( ws->m_stat.rtt );
+		queued += ws->m_eventQueue.getSize ();
+	}
+	char buf[ 512 ];
+	str json = "{" + stat_counters_json ( total );
+	snprintf ( buf, 512, ", \"event_queue\": %d, \"workers\": %d", queued, (int) m_workers.size() );
+	json += buf;
+	json += ", \"dispatch_ns\": " + dispatch->getJSON ();
+	json += ", \"rtt_ns\": " + rtt->getJSON ();
+	delete dispatch;
+	delete rtt;
+
+	if ( sockets ) {
+		json += ", \"sockets\": [";
+		bool first = true;
+		for ( int n = 0; n < (int) m_socks.size(); n++ ) {
+			NetSock& s = m_socks[ n ];
+			if ( s.state == STATE_TERMINATED || s.src.type == NTYPE_ANY ) continue;		// closed, or listening
+			snprintf ( buf, 512, "%s{\"id\": %d, \"mode\": \"%s\", \"state\": %d, \"dest\": \"%s:%d\", \"tx_queued\": %llu, \"rtt_us\": %llu, ", 
+				first ? "" : ", ", netSockId ( n ), (s.mode == NET_TCP) ? "tcp" : "udp", (int) s.state, getIPStr ( s.dest.ip ).c_str(), (int) s.dest.port,
+				(unsigned long long) s.stats.tx_queued.get(), (unsigned long long) s.stats.rtt_us.get() );
+			json += buf + stat_counters_json ( s.stats ) + "}";
+			first = false;
+		}
+		json += "]";
+	}
+	json += "}";
+	return json;
+}
+
+
+
+bool NetworkSystem::netSendLiteral ( str str_lit, int sock_i )
+{
+	TRACE_ENTER ( (__func__) );
+	int len = str_lit.length ( ), result;
+	char* buf = (char*) malloc ( str_lit.length ( ) + 1 );
+	strcpy ( buf, str_lit.c_str ( ) );	
+	
+	NetSock& s = m_socks[ sock_i ]; // Send over socket
+	if ( s.mode == NET_TCP ) {
+		if ( s.security == NET_SECURITY_PLAIN_TCP || s.state < STATE_HANDSHAKE ) {
+			result = send ( s.socket, buf, len, NET_SEND_FLAGS ); // TCP/IP
+		} else {
+			#ifdef BUILD_OPENSSL
+				if ( ( result = SSL_write ( s.ssl, buf, len ) ) <= 0 ) {	
+					if ( netNonFatalErrorSSL ( sock_i, result ) == 2 ) { 
+						TRACE_EXIT ( (__func__) );
+						return SSL_ERROR_WANT_WRITE;
+					} else {
+						str msg = netGetErrorStringSSL ( result, s.ssl );
+						NPRINTF ( DERROR, "Failed at ssl write (1): Returned: %d: %s", result, msg.c_str ( ) );
+					}
+				}
+			#endif
+		} 
+	}
+
+	
+	free( buf );
+	TRACE_EXIT ( (__func__) );
+	return CXSocketBlockError ( ) || netCheckError ( result, sock_i );		
+}
+
+bool NetworkSystem::netCheckError ( int result, int sock_i )
+{
+	TRACE_ENTER ( (__func__) );
+	if ( !CXSocketIsValid ( m_socks[ sock_i ].socket ) ) {
+		netManageTransmitError ( sock_i, "unexpected error" );		// Peer has shutdown (unexpected shutdown)
+		NPRINTF ( DERROR, "Unexpected shutdown" );
+		TRACE_EXIT ( (__func__) );
+		return false;
+	}
+	TRACE_EXIT ( (__func__) );
+	return true; // TODO: Check this; treat as benign error if there is a tail to send
+}
+
+// Send queued bytes
+// Drains the outbound queue of a socket. Copied bytes in txBuf and held events are 
+// gathered into one vectored send, repeated until the queue is empty or the socket would block.
+//
+void NetworkSystem::netSendResidualEvent ( int sock_i )
+{
+	TRACE_ENTER ( (__func__) );
+	NetSock& s = m_socks[ sock_i ];	
+	int result = 0;
+
+	if ( s.security != NET_SECURITY_PLAIN_TCP && s.state >= STATE_HANDSHAKE ) {
+		#ifdef BUILD_OPENSSL
+			netSendResidualSSL ( sock_i );
+		#endif
+		TRACE_EXIT ( (__func__) );
+		return;
+	}
+	s.txBlocked = false;
+
+	while ( s.txQueued > 0 ) {
+
+		// gather segments (in queue order)
+		#ifdef _WIN32
+			WSABUF iov[ NET_TX_IOV ];
+		#else
+			struct iovec iov[ NET_TX_IOV ];
+		#endif
+		int cnt = 0, remain = 0;
+		char* cursor = s.txBuf + s.txHead;
+		for ( int n = 0; n < (int) s.txSegs.size() && cnt < NET_TX_IOV; n++ ) {
+			NetTxSeg& seg = s.txSegs[ n ];
+			char* base;
+			if ( seg.event == 0x0 ) {
+				base = cursor;
+				cursor += seg.len - seg.sent;
+			} else {
+				base = seg.event->getSerializedData() + seg.sent;		// pooled event memory
+			}
+			#ifdef _WIN32
+				iov[ cnt ].buf = base;
+				iov[ cnt ].len = seg.len - seg.sent;
+			#else
+				iov[ cnt ].iov_base = base;
+				iov[ cnt ].iov_len = seg.len - seg.sent;
+			#endif
+			remain += seg.len - seg.sent;
+			cnt++;
+		}
+		// emulated link rate
+		int allow = netEmuSendAllow ( netEmuFor ( s ) );
+		if ( allow <= 0 ) break;				// retried on next flush
+		if ( remain > allow ) {
+			int keep = 0, n = 0;
+			for ( ; n < cnt && keep < allow; n++ ) {
+				#ifdef _WIN32
+					if ( keep + (int) iov[ n ].len > allow ) iov[ n ].len = allow - keep;
+					keep += iov[ n ].len;
+				#else
+					if ( keep + (int) iov[ n ].iov_len > allow ) iov[ n ].iov_len = allow - keep;
+					keep += iov[ n ].iov_len;
+				#endif
+			}
+			cnt = n;
+			remain = keep;
+		}
+		#ifdef _WIN32
+			DWORD sent = 0;
+			result = ( WSASend ( s.socket, iov, cnt, &sent, 0, NULL, NULL ) == 0 ) ? (int) sent : -1;
+		#else
+			struct msghdr msg;
+			memset ( &msg, 0, sizeof(msg) );
+			msg.msg_iov = iov;
+			msg.msg_iovlen = cnt;
+			result = sendmsg ( s.socket, &msg, NET_SEND_FLAGS );	// TCP/IP
+		#endif
+
+		if ( result <= 0 ) {
+			std::string msg;
+			if ( result < 0 && !CXSocketWouldBlock ( msg ) ) {
+				m_stat.failed_per_tick++;
+				s.stats.send_fail.add ( 1 );
+				m_stat.total.send_fail.add ( 1 );
+				NPRINTF ( DERROR, "TX queue send failed, sock %d: %s", sock_i, msg.c_str() );
+			}
+			s.txBlocked = true;				// wait for writable
+			break;
+		}
+		NET_TRACE ( NT_SEND_FLUSH, sock_i, result );
+		netSendQueueConsume ( sock_i, result );
+		m_stat.bytes_sent_per_tick += result;
+		netStatSent ( s, result );
+		if ( s.emu != 0x0 ) s.emu->sendTokens -= result;
+
+		if ( result < remain ) {
+			s.stats.partial_sends.add ( 1 );
+			m_stat.total.partial_sends.add ( 1 );
+			NPRINTF ( DFLOW, "TX %d/%d (queued=%d, %d events)", result, remain, s.txQueued, s.txCount );
+			s.txBlocked = true;				// kernel buffer full
+			break;
+		}
+		NPRINTF ( DFLOW, "TX %d/%d (%d events)%s", result, remain, s.txCount, (s.txQueued==0) ? " - DONE" : "" );
+	}
+
+	if ( s.txQueued == 0 ) {
+		// queue empty
+		s.txHead = s.txLen = s.txPktSize = s.txCount = 0;
+		s.txPtr = s.txBuf;
+	}
+	TRACE_EXIT ( (__func__) );
+}
+
+#ifdef BUILD_OPENSSL
+
+// TLS write
+// Returns bytes written, 0 if the write must be retried (with the same leading bytes), or -1 on error.
+int NetworkSystem::netWriteSSL ( int sock_i, char* buf, int len )
+{
+	NetSock& s = m_socks[ sock_i ];
+	ERR_clear_error ( );
+	int result = SSL_write ( s.ssl, buf, len );
+	if ( result > 0 ) return result;
+
+	int err = SSL_get_error ( s.ssl, result );
+	if ( err == SSL_ERROR_WANT_WRITE ) {
+		s.txBlocked = true;					// wait for writable
+		return 0;
+	}
+	if ( err == SSL_ERROR_WANT_READ ) return 0;		// retried on next flush
+	
+	str msg = netGetErrorStringSSL ( result, s.ssl );
+	NPRINTF ( DERROR, "Failed ssl write, sock %d: Return: %d: %s", sock_i, result, msg.c_str ( ) );
+	return -1;
+}
+
+// Send queued bytes over TLS
+// Each SSL_write makes one record per 16k, so writes are batched up to m_tlsWrite bytes: 
+// a held event or a run of copied bytes is written in place, smaller mixed segments are 
+// gathered into m_tlsBuf. Writes are all or nothing (no partial write mode). A write that 
+// would block keeps its progress inside OpenSSL and is retried on the same queue, which only 
+// grows at the back, so the retry passes the same leading bytes and at least as many.
+//
+void NetworkSystem::netSendResidualSSL ( int sock_i )
+{
+	NetSock& s = m_socks[ sock_i ];
+	if ( s.ssl == 0x0 || !SSL_is_init_finished ( s.ssl ) ) return;
+	s.txBlocked = false;
+
+	while ( s.txQueued > 0 ) {
+		char* base = 0x0;
+		int len = 0;
+		NetTxSeg& front = s.txSegs.front ();
+
+		if ( front.event != 0x0 ) {
+			// held event
+			int rest = front.len - front.sent;
+			if ( rest >= m_tlsWrite || s.txSegs.size() == 1 ) {
+				base = front.event->getSerializedData() + front.sent;
+				len = rest;
+			}
+		} else {
+			// run of copied bytes
+			int run = 0, n = 0;
+			for ( ; n < (int) s.txSegs.size() && s.txSegs[ n ].event == 0x0; n++ ) run += s.txSegs[ n ].len - s.txSegs[ n ].sent;
+			if ( n == (int) s.txSegs.size() || run >= m_tlsWrite ) {
+				base = s.txBuf + s.txHead;
+				len = run;
+			}
+		}
+		if ( base == 0x0 ) {
+			// gather mixed segments
+			len = imin ( s.txQueued, m_tlsWrite );
+			if ( (int) m_tlsBuf.size() < len ) m_tlsBuf.resize ( len );
+			char* dst = m_tlsBuf.data ();
+			char* cursor = s.txBuf + s.txHead;
+			int got = 0;
+			for ( int n = 0; n < (int) s.txSegs.size() && got < len; n++ ) {
+				NetTxSeg& seg = s.txSegs[ n ];
+				int take = imin ( seg.len - seg.sent, len - got );
+				if ( seg.event == 0x0 ) {
+					memcpy ( dst + got, cursor, take );
+					cursor += seg.len - seg.sent;
+				} else {
+					memcpy ( dst + got, seg.event->getSerializedData() + seg.sent, take );
+				}
+				got += take;
+			}
+			base = dst;
+		}
+
+		int result = netWriteSSL ( sock_i, base, len );
+		if ( result < 0 ) {
+			m_stat.failed_per_tick++;
+			s.stats.send_fail.add ( 1 );
+			m_stat.total.send_fail.add ( 1 );
+			s.txBlocked = true;
+			break;
+		}
+		if ( result == 0 ) break;						// would block
+
+		NET_TRACE ( NT_SEND_FLUSH, sock_i, result );
+		netSendQueueConsume ( sock_i, result );
+		m_stat.bytes_sent_per_tick += result;
+		netStatSent ( s, result );
+
+		if ( result < len ) {
+			s.stats.partial_sends.add ( 1 );
+			m_stat.total.partial_sends.add ( 1 );
+			NPRINTF ( DFLOW, "TLS TX %d/%d (queued=%d, %d events)", result, len, s.txQueued, s.txCount );
+		}
+	}
+
+	if ( s.txQueued == 0 ) {
+		// queue empty
+		s.txHead = s.txLen = s.txPktSize = s.txCount = 0;
+		s.txPtr = s.txBuf;
+	}
+}
+
+#endif
+
+// Consume bytes accepted by the kernel
+// Held events are released once every byte has been sent.
+//
+void NetworkSystem::netSendQueueConsume ( int sock_i, int bytes )
+{
+	NetSock& s = m_socks[ sock_i ];
+	s.txQueued -= bytes;
+	s.stats.tx_queued.set ( s.txQueued );
+
+	while ( bytes > 0 && !s.txSegs.empty() ) {
+		NetTxSeg& seg = s.txSegs.front();
+		int take = imin ( bytes, seg.len - seg.sent );
+		seg.sent += take;
+		bytes -= take;
+		if ( seg.event == 0x0 ) s.txHead += take;		
+		if ( seg.sent < seg.len ) break;
+
+		if ( seg.event != 0x0 && seg.event->decRefs() <= 0 ) {
+			delete seg.event;			// returns data to pool
+		}
+		s.txSegs.pop_front ();
+	}
+}
+
+// Append serialized bytes to the outbound queue
+// Bounded by m_sendQueueMax, except when forced to hold the remainder of a partial send.
+//
+bool NetworkSystem::netSendQueueAppend ( int sock_i, char* buf, int len, bool force )
+{
+	NetSock& s = m_socks[ sock_i ];
+	int pending = s.txLen - s.txHead;
+
+	if ( !force && s.txQueued > 0 && s.txQueued + len > m_sendQueueMax ) {
+		return false;		// queue full, caller should retry later
+	}
+	// compact sent bytes before growing the buffer
+	if ( s.txHead > 0 && s.txLen + len >= s.txMax ) {
+		memmove ( s.txBuf, s.txBuf + s.txHead, pending );		// overlapping move
+		s.txLen = pending;
+		s.txHead = 0;
+		s.txPtr = s.txBuf + s.txLen;
+	}
+	netExpandBuf ( s.txBuf, s.txPtr, s.txMax, s.txLen, len );
+	memcpy ( s.txPtr, buf, len );
+	s.txLen += len;
+	s.txPtr += len;
+	s.txCount++;
+	s.txQueued += len;
+	s.stats.tx_queued.set ( s.txQueued );
+
+	// extend last copied segment, or start a new one
+	if ( !s.txSegs.empty() && s.txSegs.back().event == 0x0 ) {
+		s.txSegs.back().len += len;
+	} else {
+		s.txSegs.push_back ( NetTxSeg { 0x0, len, 0 } );
+	}
+	netSendQueuePending ( sock_i );
+	return true;
+}
+
+// Queue an event for sending
+// With acquire, large events are held by reference and sent from pooled event memory
+// (zero copy), and the caller's event is detached. Otherwise the bytes are copied.
+//
+bool NetworkSystem::netSendQueueEvent ( int sock_i, Event& e, int sent, bool force, bool acquire )
 {
-	NetSock& sock = m_socks[sock_i];
-
-	#ifndef _WIN32	
-	
-		tcp_info info{};
-		socklen_t len = sizeof(info);
-		getsockopt ( sock.socket, IPPROTO_TCP, TCP_INFO, &info, &len);
-		return info.tcpi_rtt / 1000.0;
+	NetSock& s = m_socks[ sock_i ];
+	int len = e.getSerializedLength ();
 
-	#else
-		return 0;
-	#endif
+	if ( !acquire || m_sendZeroCopyMin <= 0 || len < m_sendZeroCopyMin ) {
+		return netSendQueueAppend ( sock_i, e.getSerializedData() + sent, len - sent, force );
+	}
+	if ( !force && s.txQueued > 0 && s.txQueued + len - sent > m_sendQueueMax ) {
+		return false;
+	}
+	Event* held = new Event;
+	held->acquire ( e );			// transfer ownership, no copy
+	held->incRefs ();
+	s.txSegs.push_back ( NetTxSeg { held, len, sent } );
+	s.txQueued += len - sent;
+	s.stats.tx_queued.set ( s.txQueued );
+	s.txCount++;
+	netSendQueuePending ( sock_i );
+	return true;
 }
 
+void NetworkSystem::netSendQueuePending ( int sock_i )
+{
+	NetSock& s = m_socks[ sock_i ];
+	if ( !s.txPending ) {
+		s.txPending = true;
+		m_sendPending.push_back ( sock_i );
+	}
+}
 
+// Discard the outbound queue
+// Releases held events. Used when a socket is reset or closed.
+//
+void NetworkSystem::netSendQueueClear ( int sock_i )
+{
+	NetSock& s = m_socks[ sock_i ];
+	for ( NetTxSeg& seg : s.txSegs ) {
+		if ( seg.event != 0x0 && seg.event->decRefs() <= 0 ) {
+			delete seg.event;
+		}
+	}
+	s.txSegs.clear ();
+	s.txHead = s.txCount = s.txQueued = 0;
+	s.stats.tx_queued.set ( 0 );
+	s.txBlocked = false;
+}
 
-bool NetworkSystem::netSendLiteral ( str str_lit, int sock_i )
+// Flush outbound queues
+// Called once per tick. Sockets waiting for writable are skipped, 
+// these are drained by the readiness loop instead.
+//
+void NetworkSystem::netSendFlush ( )
 {
-	TRACE_ENTER ( (__func__) );
-	int len = str_lit.length ( ), result;
-	char* buf = (char*) malloc ( str_lit.length ( ) + 1 );
-	strcpy ( buf, str_lit.c_str ( ) );	
-	
-	NetSock& s = m_socks[ sock_i ]; // Send over socket
-	if ( s.mode == NET_TCP ) {
-		if ( s.security == NET_SECURITY_PLAIN_TCP || s.state < STATE_HANDSHAKE ) {
-			result = send ( s.socket, buf, len, 0 ); // TCP/IP
+	int j = 0;
+	for ( int n = 0; n < (int) m_sendPending.size(); n++ ) {
+		int sock_i = m_sendPending[ n ];
+		if ( !valid_socket_index ( sock_i ) ) continue;
+		NetSock& s = m_socks[ sock_i ];
+
+		if ( s.txQueued > 0 && !s.txBlocked && s.state != STATE_TERMINATED ) {
+			netSendResidualEvent ( sock_i );
+		}
+		if ( s.txQueued > 0 ) {
+			m_sendPending[ j++ ] = sock_i;		// still pending
 		} else {
-			#ifdef BUILD_OPENSSL
-				if ( ( result = SSL_write ( s.ssl, buf, len ) ) <= 0 ) {	
-					if ( netNonFatalErrorSSL ( sock_i, result ) ) { 
-						TRACE_EXIT ( (__func__) );
-						return SSL_ERROR_WANT_WRITE;
-					} else {
-						str msg = netGetErrorStringSSL ( result, s.ssl );
-						NPRINTF ( DERROR, "Failed at ssl write (1): Returned: %d: %s", result, msg.c_str ( ) );
-					}
-				}
-			#endif
-		} 
+			s.txPending = false;
+		}
 	}
+	m_sendPending.resize ( j );
 
-	
-	free( buf );
-	TRACE_EXIT ( (__func__) );
-	return CXSocketBlockError ( ) || netCheckError ( result, sock_i );		
+	netRelUpdate ();					// resends and acks
+	netSendFlushUDP ();
 }
 
-bool NetworkSystem::netCheckError ( int result, int sock_i )
+// Send queued datagrams
+// One sendmmsg per batch of datagrams. With GSO, a run of equal-size datagrams to the same 
+// peer goes as one message, split by the kernel (UDP_SEGMENT). Datagrams that would block 
+// stay queued for the next tick.
+int NetworkSystem::netSendFlushUDP ( )
 {
-	TRACE_ENTER ( (__func__) );
-	if ( !CXSocketIsValid ( m_socks[ sock_i ].socket ) ) {
-		netManageTransmitError ( sock_i, "unexpected error" );		// Peer has shutdown (unexpected shutdown)
-		NPRINTF ( DERROR, "Unexpected shutdown" );
-		TRACE_EXIT ( (__func__) );
-		return false;
+	int done = 0;
+	#ifdef NET_UDP_MMSG
+	if ( m_udpTx.empty() ) return 0;
+
+	mmsghdr msgs[ NET_UDP_BATCH_MAX ];
+	iovec iov[ NET_UDP_BATCH_MAX ];
+	char ctl[ NET_UDP_BATCH_MAX ][ CMSG_SPACE(sizeof(uint16_t)) ];
+	size_t first[ NET_UDP_BATCH_MAX + 1 ];				// queue index of each message
+	size_t q = 0;
+	std::string msg;
+
+	while ( q < m_udpTx.size() ) {
+		while ( q < m_udpTx.size() && !valid_socket_index ( m_udpTx[q].sock_i ) ) q++;		// socket gone
+
+		// build messages. queued datagrams are contiguous in m_udpTxBuf
+		int n = 0;
+		size_t k = q;
+		while ( n < m_udpBatch && k < m_udpTx.size() && valid_socket_index ( m_udpTx[k].sock_i ) ) {
+			NetUdpMsg& m = m_udpTx[ k ];
+			int segs = 1;
+			int total = m.len;
+			if ( m_udpOffload ) {
+				while ( k + segs < m_udpTx.size() && segs < 64 ) {
+					NetUdpMsg& next = m_udpTx[ k + segs ];
+					if ( next.sock_i != m.sock_i || next.len > m.len || total + next.len > 65000 ) break;
+					total += next.len;
+					segs++;
+					if ( next.len < m.len ) break;			// shorter datagram ends the run
+				}
+			}
+			iov[n].iov_base = &m_udpTxBuf[ m.off ];
+			iov[n].iov_len = total;
+			memset ( &msgs[n], 0, sizeof(mmsghdr) );
+			msgs[n].msg_hdr.msg_name = &m_socks[ m.sock_i ].udp_dest.addr;
+			msgs[n].msg_hdr.msg_namelen = sizeof(sockaddr_in);
+			msgs[n].msg_hdr.msg_iov = &iov[n];
+			msgs[n].msg_hdr.msg_iovlen = 1;
+			if ( segs > 1 ) {
+				msgs[n].msg_hdr.msg_control = ctl[n];
+				msgs[n].msg_hdr.msg_controllen = sizeof(ctl[n]);
+				cmsghdr* cm = CMSG_FIRSTHDR ( &msgs[n].msg_hdr );
+				cm->cmsg_level = SOL_UDP;
+				cm->cmsg_type = UDP_SEGMENT;
+				cm->cmsg_len = CMSG_LEN ( sizeof(uint16_t) );
+				uint16_t seg = m.len;
+				memcpy ( CMSG_DATA(cm), &seg, sizeof(uint16_t) );
+			}
+			first[ n++ ] = k;
+			k += segs;
+		}
+		first[ n ] = k;
+		if ( n == 0 ) continue;
+
+		int sent = sendmmsg ( m_udp_sock.socket, msgs, n, MSG_DONTWAIT );
+		if ( sent < 0 ) {
+			if ( CXSocketWouldBlock ( msg ) ) break;			// keep for next tick
+			if ( m_udpOffload && ( errno == EIO || errno == EINVAL || errno == ENOPROTOOPT ) ) {
+				NPRINTF ( VERBOSE, "UDP GSO not supported, offload disabled." );
+				m_udpOffload = false;
+				continue;
+			}
+			NPRINTF ( DERROR, "Failed sendmmsg by UDP. %s\n", netPrintAddr( m_socks[ m_udpTx[q].sock_i ].udp_dest ).c_str() );
+			sent = 1;			// drop first message
+		}
+		if (m_printFlow) {
+			dbgprintf ( "sendmmsg: %d msgs, %d datagrams\n", sent, (int) (first[sent] - q) );
+		}
+		NET_TRACE ( NT_UDP_SEND, -1, first[ sent ] - q );
+		done += (int) (first[ sent ] - q);
+		q = first[ sent ];
 	}
-	TRACE_EXIT ( (__func__) );
-	return true; // TODO: Check this; treat as benign error if there is a tail to send
+
+	// remove sent datagrams
+	if ( q >= m_udpTx.size() ) {
+		m_udpTx.clear ();
+		m_udpTxBuf.clear ();
+	} else if ( q > 0 ) {
+		// keep unsent datagrams, compacted to the front of the buffer
+		int base = m_udpTx[ q ].off;
+		m_udpTx.erase ( m_udpTx.begin(), m_udpTx.begin() + q );
+		m_udpTxBuf.erase ( m_udpTxBuf.begin(), m_udpTxBuf.begin() + base );
+		for ( NetUdpMsg& m : m_udpTx ) m.off -= base;
+	}
+	#endif
+	return done;
 }
 
-void NetworkSystem::netSendResidualEvent ( int sock_i )
+// Set batching and offload of UDP
+// Batching needs recvmmsg/sendmmsg (linux). Offload is best effort, GRO is
+// enabled on the socket, GSO is disabled on the first send the kernel rejects.
+void NetworkSystem::netSetUDPBatch ( int batch, bool offload )
 {
-	TRACE_ENTER ( (__func__) );
-	NetSock& s = m_socks[ sock_i ];	
-	int result = 0;
+	netSendFlushUDP ();
+	#ifdef NET_UDP_MMSG
+		m_udpBatch = imax ( 1, imin ( batch, NET_UDP_BATCH_MAX ) );
+		m_udpOffload = offload && m_udpBatch > 1;
+	#else
+		m_udpBatch = 1;
+		m_udpOffload = false;
+	#endif
+	m_udpRxBuf.clear ();					// slots resized on next receive
+	if ( m_udp_sock.state != STATE_NONE ) netSocketUDPOffload ();
+}
 
-	if ( s.security == NET_SECURITY_PLAIN_TCP || s.state < STATE_HANDSHAKE ) {
-		result = send ( s.socket, s.txBuf, s.txLen, 0 ); // TCP/IP
-	} else {
-		s.txLen = 0;
-		TRACE_EXIT ( (__func__) );
-		return;
-		//result = SSL_write ( s.ssl, s.txBuf + s.txSoFar, remaining );
+void NetworkSystem::netSocketUDPOffload ( )
+{
+	#ifdef NET_UDP_MMSG
+		int on = m_udpOffload ? 1 : 0;
+		if ( setsockopt ( m_udp_sock.socket, SOL_UDP, UDP_GRO, &on, sizeof(on) ) < 0 && on ) {
+			NPRINTF ( VERBOSE, "UDP GRO not supported." );
+		}
+	#endif
+}
+
+int NetworkSystem::netGetSendQueued ( int sock_i )
+{
+	if ( !m_workers.empty() && sock_i >= NET_SHARD_SOCKS ) {
+		int queued = netWorkerSockState ( sock_i );		// socket owned by a worker
+		return ( queued > 0 ) ? queued : 0;
 	}
-	
-	if ( result > 0 ) {
-		s.txLen -= result;
-		int remain = s.txLen;
-		memmove ( s.txBuf, s.txBuf + result, remain );		// overlapping move
-		s.txPtr = s.txBuf + remain;
-		if ( result != s.txLen ) {
-			NPRINTF ( DFLOW, "TX %d/%d (txLen=%d)", result, remain, s.txLen );
-		} else {
-			NPRINTF ( DFLOW, "TX %d/%d (txLen=%d) - DONE", result, remain, s.txLen );			
-			s.txLen = s.txPktSize = 0;
-		} 
-	} 
-	TRACE_EXIT ( (__func__) );
+	return valid_socket_index ( sock_i ) ? m_socks[ sock_i ].txQueued : 0;
 }
 
 bool NetworkSystem::netSendUDP ( Event& e, int sock_i )
@@ -2669,39 +5113,76 @@ bool NetworkSystem::netSendUDP ( Event& e, int sock_i )
 
 	// get tcp socket (for dest address)
 	if (!valid_socket_index(sock_i)) 							{ TRACE_EXIT ( (__func__) ); return false; }
-	NetSock& s = m_socks[ sock_i ];	
 
 	// event retains its persist/consume status
 	//  (will pass thru send back to caller)
 	e.rescope ( "nets" );
 	if ( e.mData == 0x0 ) 												{ TRACE_EXIT ( (__func__) ); return false; }
 	e.serialize ();		// Prepare serialized buffer	
-	char* buf = e.getSerializedData ( );
-	int event_len = e.getSerializedLength ( );
-
-	// send udp	
-	int dest_i = * (int*) (buf + Event::staticSerializedHeaderSize() );	
-	int	result = sendto ( m_udp_sock.socket, buf, event_len, 0, (sockaddr*) &s.udp_dest.addr, sizeof(sockaddr_in) );	// UDP
-	if ( netFuncError(result) ) {
-		NPRINTF( DERROR, "Failed sendto by UDP. %s\n", netPrintAddr(s.udp_dest).c_str() );
-		// send error
 
-	} else if (result < event_len) {
-		// partial event sent
+	if (m_printFlow) {
+		dbgprintf ( "sendto  : %s, %d bytes, sock %d, %s\n", netPrintAddr(m_socks[sock_i].udp_dest).c_str(), e.getSerializedLength(), sock_i, e.NameToStr().c_str() );
 	}
+	bool ok = netSendUDPBuf ( e.getSerializedData(), e.getSerializedLength(), sock_i );
+	netStatEvent ( m_socks[ sock_i ], ok );
+	if ( ok ) netStatSent ( m_socks[ sock_i ], e.getSerializedLength() );
+	return ok;
+}
 
-	if (m_printFlow) {
-		dbgprintf ( "sendto  : %s, %d bytes, sock %d, %s\n", netPrintAddr(s.udp_dest).c_str(), result, sock_i, e.NameToStr().c_str() );
+// Send one datagram to the UDP peer of a socket
+// Queued for sendmmsg when batched, otherwise sent now.
+bool NetworkSystem::netSendUDPBuf ( char* buf, int len, int sock_i )
+{
+	NetSock& s = m_socks[ sock_i ];	
+
+	#ifdef NET_UDP_MMSG
+	if ( m_udpBatch > 1 ) {
+		// queue datagram, sent by sendmmsg on flush (once per tick)
+		int off = (int) m_udpTxBuf.size();
+		m_udpTxBuf.insert ( m_udpTxBuf.end(), buf, buf + len );
+		m_udpTx.push_back ( NetUdpMsg { sock_i, off, len } );
+		if ( (int) m_udpTx.size() >= NET_UDP_QUEUE_MAX ) netSendFlushUDP ();
+		return true;
 	}
+	#endif
 
+	// send udp	
+	int	result = sendto ( m_udp_sock.socket, buf, len, 0, (sockaddr*) &s.udp_dest.addr, sizeof(sockaddr_in) );	// UDP
+	if ( netFuncError(result) ) {
+		NPRINTF( DERROR, "Failed sendto by UDP. %s\n", netPrintAddr(s.udp_dest).c_str() );
+		return false;
+	}
 	return true;
 }
 
 
 // low-level send function
+// The caller's event is left as is, and queued events are copied.
 bool NetworkSystem::netSend ( Event& e, int sock_i )
+{
+	if ( e.getTarget() == (eventStr_t) NET_EVENT_LZ4 ) return false;		// reserved, receiver would expand it
+	return netSendEvent ( e, sock_i, false );
+}
+
+// Send without copying large events into the queue
+// Events of netSetSendZeroCopy bytes or more that are queued (or partly sent) are acquired,
+// leaving the caller's event detached. Use for events that are not reused after sending.
+bool NetworkSystem::netSendAcquire ( Event& e, int sock_i )
+{
+	if ( e.getTarget() == (eventStr_t) NET_EVENT_LZ4 ) return false;		// reserved
+	return netSendEvent ( e, sock_i, true );
+}
+
+bool NetworkSystem::netSendEvent ( Event& e, int sock_i, bool acquire )
 {
 	TRACE_ENTER ( (__func__) );
+
+	// socket owned by a worker
+	if ( !m_workers.empty() && sock_i >= NET_SHARD_SOCKS ) {
+		bool ok = netWorkerSend ( e, sock_i, acquire );
+		TRACE_EXIT ( (__func__) );
+		return ok;
+	}
 	
 	// caller may wish to send on any outgoing socket
 	if ( sock_i == -1 ) { 
@@ -2717,8 +5198,22 @@ bool NetworkSystem::netSend ( Event& e, int sock_i )
 	// cannot send on a listening socket
 	if ( m_socks[ sock_i ].src.type == NTYPE_ANY) 	{ TRACE_EXIT ( (__func__) ); return false; }
 
-	// make sure we have a transmission buffer
-	if ( m_socks[ sock_i ].txLen > 0 ) 		{ TRACE_EXIT ( (__func__) ); return false; }	
+	// compress large payloads, sent in place of the event
+	int compress = ( s.compressMin >= 0 ) ? s.compressMin : m_compressMin;
+	if ( compress > 0 && e.getDataLength() >= compress && e.getTarget() != (eventStr_t) NET_EVENT_LZ4 && e.mData != 0x0 ) {
+		Event ce;
+		if ( netCompressEvent ( e, ce ) ) {
+			bool ok = netSendEvent ( ce, sock_i, true );		// local, always acquired
+			TRACE_EXIT ( (__func__) );
+			return ok;
+		}
+	}
+
+	// TLS sockets need a session
+	bool plain = ( s.security == NET_SECURITY_PLAIN_TCP || s.state < STATE_HANDSHAKE );
+	#ifdef BUILD_OPENSSL
+		if ( !plain && s.ssl == 0x0 ) 		{ TRACE_EXIT ( (__func__) ); return false; }
+	#endif
 
 	// make sure we have an event data buffer
 	int result;
@@ -2738,15 +5233,31 @@ bool NetworkSystem::netSend ( Event& e, int sock_i )
 	}
 
 	NPRINTF ( DFLOW, "TX %d bytes, %s --> SENDING  chksum=%lld", e.getSerializedLength (), e.NameToStr().c_str(), chksum );
-
+	NET_TRACE ( NT_SEND, sock_i, e.getName() );
 	
-	if ( s.security == NET_SECURITY_PLAIN_TCP || s.state < STATE_HANDSHAKE ) {
+	if ( plain ) {
+
+		// Queue behind pending events (or coalesce until flush, or emulated link rate)
+		NetEmu* emu = netEmuFor ( s );
+		if ( s.txQueued > 0 || m_sendCoalesce || ( emu != 0x0 && emu->cfg.send_bps > 0 ) ) {
+			bool ok = netSendQueueEvent ( sock_i, e, 0, false, acquire );
+			netStatEvent ( s, ok );
+			NET_TRACE ( NT_SEND_QUEUE, sock_i, s.txQueued );
+			if ( ok ) {
+				m_stat.num_sent_per_tick++;
+			} else {
+				m_stat.failed_per_tick++;
+				NPRINTF ( DFLOW, "TX queue full, sock %d (%d bytes)", sock_i, s.txQueued );
+			}
+			TRACE_EXIT ( (__func__) );
+			return ok;
+		}
 
 		if (m_printStats) {
 			netMeasureSocketStats( true, sock_i );
 		}
 					
-		result = send ( s.socket, buf, event_len, 0 ); // TCP/IP
+		result = send ( s.socket, buf, event_len, NET_SEND_FLAGS ); // TCP/IP
 
 		if (m_printStats) {
 			netMeasureSocketStats( false, sock_i );
@@ -2755,77 +5266,89 @@ bool NetworkSystem::netSend ( Event& e, int sock_i )
 		if ( result > 0 ) {			
 			m_stat.num_sent_per_tick++;
 			m_stat.bytes_sent_per_tick += result;
+			netStatEvent ( s, true );
+			netStatSent ( s, result );
 				
 			// bytes sent
 			if ( result == event_len ) {
 				// full event sent					
 			} else {
-				// partial event sent, transmit more later
+				// partial event sent, queue remainder to transmit later
 				int remain = event_len - result;
 				m_stat.bytes_remain_per_tick += remain;
-				netExpandBuf (s.txBuf, s.txPtr, s.txMax, s.txLen, remain );
-				memcpy ( s.txPtr, buf + result, remain);
-				s.txLen += remain;					
-				s.txBuf[ event_len ] = '\0';
-				NPRINTF ( DFLOW, "TX %d/%d, %d remain (txLen=%d)", result, event_len, remain, s.txLen );
+				s.stats.partial_sends.add ( 1 );
+				m_stat.total.partial_sends.add ( 1 );
+				netSendQueueEvent ( sock_i, e, result, true, acquire );
+				s.txBlocked = true;
+				NET_TRACE ( NT_SEND_PARTIAL, sock_i, result );
+				NPRINTF ( DFLOW, "TX %d/%d, %d remain (queued=%d)", result, event_len, remain, s.txQueued );
 			}
 				
 			// done
 			TRACE_EXIT ( (__func__) );
 			return true;
 		} else {
+			std::string msg;
+			if ( result < 0 && CXSocketWouldBlock ( msg ) ) {
+				// kernel buffer full, queue whole event
+				s.txBlocked = true;
+				bool ok = netSendQueueEvent ( sock_i, e, 0, true, acquire );
+				netStatEvent ( s, ok );
+				NET_TRACE ( NT_SEND_QUEUE, sock_i, s.txQueued );
+				TRACE_EXIT ( (__func__) );
+				return ok;
+			}
 			m_stat.failed_per_tick++;
+			netStatEvent ( s, false );
 		}
 			
 	} else {
 		#ifdef BUILD_OPENSSL
-				
-			fd_set sockSet;
-			struct timeval tv = { 0, 0 };
-			int fd = SSL_get_fd ( s.ssl );
-			FD_ZERO ( &sockSet );
-			FD_SET ( fd, &sockSet );	
-			if ( select ( fd + 1, NULL, &sockSet, NULL, &tv ) < 0 ) {
+
+			// Queue behind pending bytes, or small events so they go out in full TLS records
+			if ( s.txQueued > 0 || m_sendCoalesce || ( m_tlsCoalesce && event_len < m_tlsWrite ) ) {
+				bool ok = netSendQueueEvent ( sock_i, e, 0, false, acquire );
+				netStatEvent ( s, ok );
+				NET_TRACE ( NT_SEND_QUEUE, sock_i, s.txQueued );
+				if ( ok ) {
+					m_stat.num_sent_per_tick++;
+				} else {
+					m_stat.failed_per_tick++;
+					NPRINTF ( DFLOW, "TX queue full, sock %d (%d bytes)", sock_i, s.txQueued );
+				}
 				TRACE_EXIT ( (__func__) );
-				return false;
+				return ok;
 			}
-				
-			result = SSL_write ( s.ssl, buf, event_len );
+
+			result = netWriteSSL ( sock_i, buf, event_len );
 
 			if ( result > 0 ) {
-				// bytes sent
-				if ( result == event_len ) {
-					// full event sent
-				} else if ( result < event_len ) {	
-					// partial event sent, transmit more later
-					netExpandBuf (s.txBuf, s.txPtr, s.txMax, s.txLen, event_len + 1);
-					s.txLen = result;
-					s.txPktSize = result;
-					memcpy ( s.txBuf, buf, result );
-					// s.txBuf[ event_len ] = '\0';					
-					NPRINTF ( VERBOSE, "1 Partial TX: %d < %d", result, event_len);					
-					std::cin.get();						
-				}	else {
-					NPRINTF(DERROR, "Unexpected TX: %d > %d", result, event_len );
-					exit(-77);
+				m_stat.num_sent_per_tick++;
+				m_stat.bytes_sent_per_tick += result;
+				netStatEvent ( s, true );
+				netStatSent ( s, result );
+				if ( result < event_len ) {
+					// partial event sent, queue remainder to transmit later
+					m_stat.bytes_remain_per_tick += event_len - result;
+					s.stats.partial_sends.add ( 1 );
+					m_stat.total.partial_sends.add ( 1 );
+					netSendQueueEvent ( sock_i, e, result, true, acquire );
+					NET_TRACE ( NT_SEND_PARTIAL, sock_i, result );
+					NPRINTF ( DFLOW, "TLS TX %d/%d (queued=%d)", result, event_len, s.txQueued );
 				}
-					
 				TRACE_EXIT ( (__func__) );
 				return true;
 
-			} else {
-				// no bytes sent. check why.
-				if ( netNonFatalErrorSSL ( sock_i, result ) ) { 
-					str msg = netGetErrorStringSSL ( result, s.ssl );
-					s.txLen = 0;
-					NPRINTF ( DERROR, "Non fatal SSL error: Return: %d: %s", result, msg.c_str ( ) );
-					TRACE_EXIT ( (__func__) );
-					return false;						
-				} else {
-					str msg = netGetErrorStringSSL ( result, s.ssl );
-					NPRINTF ( DERROR, "1 Failed ssl write (2): Return: %d: %s", result, msg.c_str ( ) );
-				}
-			} 
+			} else if ( result == 0 ) {
+				// would block, queue whole event. retried with the same leading bytes.
+				bool ok = netSendQueueEvent ( sock_i, e, 0, true, acquire );
+				netStatEvent ( s, ok );
+				NET_TRACE ( NT_SEND_QUEUE, sock_i, s.txQueued );
+				TRACE_EXIT ( (__func__) );
+				return ok;
+			}
+			m_stat.failed_per_tick++;
+			netStatEvent ( s, false );
 		#endif
 	}  	
 	
@@ -2842,6 +5365,10 @@ CX_SOCKET NetworkSystem::CXSocketCreate ( int mode )
 	CX_SOCKET cxsock;
 	if ( mode == NET_TCP ) {
 		cxsock = socket ( AF_INET, SOCK_STREAM, IPPROTO_TCP ); 
+		#if !defined(MSG_NOSIGNAL) && defined(SO_NOSIGPIPE)
+			int on = 1;
+			setsockopt ( cxsock, SOL_SOCKET, SO_NOSIGPIPE, &on, sizeof(on) );		// see NET_SEND_FLAGS
+		#endif
 	} else {
 		cxsock = socket ( AF_INET, SOCK_DGRAM, IPPROTO_UDP ); 
 	}
@@ -2966,18 +5493,18 @@ int NetworkSystem::netSocketAccept ( int sock_i, CX_SOCKET& tcp_sock, netIP& cli
 	return 1;
 }
 
-int NetworkSystem::CXSocketRecv ( CX_SOCKET sock, int secur, int state, char* buf, int bufmax )
+int NetworkSystem::CXSocketRecv ( int sock_i, char* buf, int bufmax )
 {
-	TRACE_ENTER ( (__func__) ); // Return value: success = 0, or an error number; on success recvlen = bytes recieved
-	CX_SOCKLEN addr_size;
+	TRACE_ENTER ( (__func__) ); // Return value: bytes received, 0 if none pending, or -1 on error
+	NetSock& s = m_socks[ sock_i ];
 	int result;
 	std::string msg;
 
 	// Handle TCP/IP recv for both plain TCP and OpenSSL
 	// Assumes: mode = NET_TCP, type = NTYPE_CONNECT
 
-	if ( secur == NET_SECURITY_PLAIN_TCP || state < STATE_HANDSHAKE ) { 
-		result = recv ( sock, buf, bufmax, 0 );	// TCP/IP
+	if ( s.security == NET_SECURITY_PLAIN_TCP || s.state < STATE_HANDSHAKE ) { 
+		result = recv ( s.socket, buf, bufmax, 0 );	// TCP/IP
 		if ( netFuncError(result) ) {
 			TRACE_EXIT((__func__));
 			if ( CXSocketWouldBlock(msg) ) {					
@@ -2988,14 +5515,17 @@ int NetworkSystem::CXSocketRecv ( CX_SOCKET sock, int secur, int state, char* bu
 		}
 	} else {
 		#ifdef BUILD_OPENSSL
+			if ( s.ssl == 0x0 ) { TRACE_EXIT ( (__func__) ); return 0; }
 			result = SSL_read(s.ssl, buf, bufmax);
 			if ( result <= 0 ) {
-				if ( netNonFatalErrorSSL ( sock_i, result ) ) { 
+				if ( netNonFatalErrorSSL ( sock_i, result ) == 2 ) { 
 					TRACE_EXIT ( (__func__) );
-					return SSL_ERROR_WANT_READ;
+					return 0;			// want read/write, no application data yet
 				} else {
 					str msg = netGetErrorStringSSL ( result, s.ssl );
 					NPRINTF ( DERROR, "Failed at ssl read: Returned: %d: %s", result, msg.c_str ( ) );
+					TRACE_EXIT ( (__func__) );
+					return -1;		// closed or failed, not retried
 				}
 			}
 		#endif
@@ -3062,7 +5592,7 @@ bool NetworkSystem::netSocketIsSelected ( fd_set* sockSet, int sock_i )
 int NetworkSystem::netSocketSelect ( fd_set* sockReadSet, fd_set* sockWriteSet ) 
 {
 	TRACE_ENTER ( (__func__) );
-	if ( m_socks.size ( ) == 0 ) {
+	if ( m_socks.size ( ) == 0 && m_wakeFd < 0 ) {
 		TRACE_EXIT ( (__func__) );
 		return 0;
 	}
@@ -3077,7 +5607,7 @@ int NetworkSystem::netSocketSelect ( fd_set* sockReadSet, fd_set* sockWriteSet )
 		
 			if ( s.security == NET_SECURITY_PLAIN_TCP || s.state < STATE_HANDSHAKE ) { 
 				FD_SET ( s.socket, sockReadSet );
-				if ( s.txLen > 0 ) {
+				if ( s.txQueued > 0 ) {
 					FD_SET ( s.socket, sockWriteSet );
 				}
 				if ( (int) s.socket > maxfd ) maxfd = s.socket;			
@@ -3093,6 +5623,10 @@ int NetworkSystem::netSocketSelect ( fd_set* sockReadSet, fd_set* sockWriteSet )
 			}
 		}
 	}
+	if ( m_wakeFd >= 0 ) {
+		FD_SET ( m_wakeFd, sockReadSet );
+		if ( m_wakeFd > maxfd ) maxfd = m_wakeFd;
+	}
 	NET_PERF_POP ( );
 	
 	if ( ++maxfd == 0 ) {
@@ -3111,6 +5645,152 @@ int NetworkSystem::netSocketSelect ( fd_set* sockReadSet, fd_set* sockWriteSet )
 	return result;
 }
 
+// Poll sockets for readiness
+// Fills m_sockReady with only those sockets which can be read or written.
+// - select: fd_sets are rebuilt from all sockets on each call, O(N) per tick
+// - epoll:  sockets stay registered (edge-triggered), only the ready set is returned
+//
+int NetworkSystem::netSocketPoll ( )
+{
+	TRACE_ENTER ( (__func__) );
+	m_sockReady.clear ( );
+
+	#ifdef __linux__
+	if ( m_pollMode == NET_POLL_EPOLL && m_pollFd >= 0 ) {
+
+		epoll_event evs[ 1024 ];
+		int timeout_ms = m_rcvSelectTimout.tv_sec * 1000 + m_rcvSelectTimout.tv_usec / 1000;
+		NET_PERF_PUSH ( "epoll" );
+		int result = epoll_wait ( m_pollFd, evs, 1024, timeout_ms );
+		NET_PERF_POP ( );
+		if ( result < 0 ) {
+			if ( errno != EINTR ) NPRINTF ( DERROR, "epoll_wait failed: Return: %d", result );
+			TRACE_EXIT ( (__func__) );
+			return 0;
+		}
+		NetReady r;
+		for ( int n = 0; n < result; n++ ) {
+			if ( evs[ n ].data.u32 == NET_WAKE_ID ) { netWakeClear (); continue; }
+			r.sock_i = evs[ n ].data.u32;
+			if ( !valid_socket_index ( r.sock_i ) ) continue;
+			NetSock& s = m_socks[ r.sock_i ];
+			if ( s.state == STATE_NONE || s.state == STATE_TERMINATED || s.state == STATE_FAILED ) continue;
+
+			// hangup and error are reported as readable, so recv can detect them
+			r.read = ( evs[ n ].events & ( EPOLLIN | EPOLLHUP | EPOLLERR ) ) != 0;
+			r.write = ( evs[ n ].events & EPOLLOUT ) && s.txQueued > 0;
+			if ( r.read || r.write ) m_sockReady.push_back ( r );
+		}
+		NET_TRACE ( NT_POLL, -1, m_sockReady.size() );
+		TRACE_EXIT ( (__func__) );
+		return (int) m_sockReady.size ( );
+	}
+	#endif
+
+	// select fallback
+	fd_set sockReadSet;
+	fd_set sockWriteSet;
+	int result = netSocketSelect ( &sockReadSet, &sockWriteSet );
+	if ( result > 0 ) {
+		if ( m_wakeFd >= 0 && FD_ISSET ( m_wakeFd, &sockReadSet ) ) netWakeClear ();
+		NetReady r;
+		for ( int sock_i = 0; sock_i < (int) m_socks.size ( ); sock_i++ ) {
+			r.sock_i = sock_i;
+			r.read = netSocketIsSelected ( &sockReadSet, sock_i );
+			r.write = netSocketIsSelected ( &sockWriteSet, sock_i );
+			if ( r.read || r.write ) m_sockReady.push_back ( r );
+		}
+	}
+	NET_TRACE ( NT_POLL, -1, m_sockReady.size() );
+	TRACE_EXIT ( (__func__) );
+	return (int) m_sockReady.size ( );
+}
+
+// Register socket with epoll
+// Sockets remain registered across ticks. Edge-triggered, so the receive and
+// send paths must consume until the socket would block (see netReceiveData).
+//
+void NetworkSystem::netSocketPollAdd ( int sock_i )
+{
+	#ifdef __linux__
+		if ( m_pollMode != NET_POLL_EPOLL || m_pollFd < 0 ) return;
+		NetSock& s = m_socks[ sock_i ];
+		if ( !CXSocketIsValid ( s.socket ) || s.socket == 0 ) return;
+
+		epoll_event ev;
+		ev.events = EPOLLIN | EPOLLOUT | EPOLLET;
+		ev.data.u64 = 0;
+		ev.data.u32 = sock_i;
+		if ( epoll_ctl ( m_pollFd, EPOLL_CTL_ADD, s.socket, &ev ) < 0 ) {
+			if ( errno == EEXIST ) {
+				epoll_ctl ( m_pollFd, EPOLL_CTL_MOD, s.socket, &ev );		// socket index changed
+			} else {
+				NPRINTF ( DERROR, "epoll_ctl add failed on sock %d", sock_i );
+			}
+		}
+	#endif
+}
+
+void NetworkSystem::netSocketPollRemove ( int sock_i )
+{
+	#ifdef __linux__
+		if ( m_pollMode != NET_POLL_EPOLL || m_pollFd < 0 ) return;
+		NetSock& s = m_socks[ sock_i ];
+		if ( !CXSocketIsValid ( s.socket ) || s.socket == 0 ) return;
+
+		epoll_event ev;		// non-null for kernels before 2.6.9
+		epoll_ctl ( m_pollFd, EPOLL_CTL_DEL, s.socket, &ev );
+	#endif
+}
+
+// Wake fd
+// Posts from other threads (netPost, netSendAsync) would otherwise wait for the poll
+// timeout. An eventfd in the read set ends the wait. Linux only, elsewhere posts are
+// drained on the next timeout.
+//
+void NetworkSystem::netWakeCreate ( )
+{
+	#ifdef __linux__
+		if ( m_wakeFd < 0 ) m_wakeFd = eventfd ( 0, EFD_NONBLOCK | EFD_CLOEXEC );
+		if ( m_wakeFd < 0 || m_pollMode != NET_POLL_EPOLL || m_pollFd < 0 ) return;
+		epoll_event ev;
+		ev.events = EPOLLIN;					// level-triggered, cleared by netWakeClear
+		ev.data.u64 = 0;
+		ev.data.u32 = NET_WAKE_ID;
+		if ( epoll_ctl ( m_pollFd, EPOLL_CTL_ADD, m_wakeFd, &ev ) < 0 && errno != EEXIST ) {
+			NPRINTF ( DERROR, "epoll_ctl add failed on wake fd" );
+		}
+	#endif
+}
+
+void NetworkSystem::netWakeFree ( )
+{
+	#ifdef __linux__
+		if ( m_wakeFd < 0 ) return;
+		close ( m_wakeFd );					// also leaves the epoll set
+		m_wakeFd = -1;
+	#endif
+}
+
+void NetworkSystem::netWake ( )
+{
+	#ifdef __linux__
+		if ( m_wakeFd < 0 ) return;
+		uint64_t one = 1;
+		ssize_t r = write ( m_wakeFd, &one, sizeof(one) );
+		(void) r;								// only fails when the counter is full, already awake
+	#endif
+}
+
+void NetworkSystem::netWakeClear ( )
+{
+	#ifdef __linux__
+		uint64_t cnt;
+		ssize_t r = read ( m_wakeFd, &cnt, sizeof(cnt) );
+		(void) r;
+	#endif
+}
+
 str NetworkSystem::netPrintf ( int flag, const char* fmt_raw, ... )
 {
 	if (flag == DFLOW && !m_printFlow) {
@@ -3202,6 +5882,36 @@ void NetworkSystem::netSetSelectInterval ( int time_ms )
 	m_rcvSelectTimout.tv_usec = ( time_ms % 1000 ) * 1000; 
 }
 
+// Set readiness backend
+// - NET_POLL_EPOLL is available on linux only, select is the fallback on all platforms.
+// - May be called at any time. Existing sockets are moved to the new backend.
+bool NetworkSystem::netSetPollMode ( int mode )
+{
+	#ifdef __linux__
+		if ( m_pollFd >= 0 ) {
+			close ( m_pollFd );				// closing epoll also releases all registrations
+			m_pollFd = -1;
+		}
+		m_pollMode = mode;
+		if ( mode == NET_POLL_EPOLL ) {
+			m_pollFd = epoll_create1 ( 0 );
+			if ( m_pollFd < 0 ) {
+				NPRINTF ( DERROR, "Unable to create epoll. Using select." );
+				m_pollMode = NET_POLL_SELECT;
+				return false;
+			}
+			for ( int n = 0; n < (int) m_socks.size ( ); n++ ) {
+				if ( m_socks[ n ].state != STATE_TERMINATED ) netSocketPollAdd ( n );
+			}
+			if ( m_wakeFd >= 0 ) netWakeCreate ();		// register wake fd
+		}
+		return true;
+	#else
+		m_pollMode = NET_POLL_SELECT;
+		return ( mode == NET_POLL_SELECT );
+	#endif
+}
+
 //----------------------------------------------------------------------------------------------------------------------
 // -> SECURITY CONFIG API <-
 //----------------------------------------------------------------------------------------------------------------------
@@ -3222,6 +5932,12 @@ bool NetworkSystem::netSetReconnectInterval ( int time_ms )
 	return true;
 }
 
+void NetworkSystem::netSetReconnectBackoff ( int max_ms, float jitter )
+{
+	m_reconnectMax = max_ms;
+	m_reconnectJitter = fmin ( fmax ( jitter, 0.0f ), 1.0f );
+}
+
 bool NetworkSystem::netSetReconnectLimit ( int max_count )
 {
 	m_reconnectMaxCount = max_count;
@@ -3314,6 +6030,21 @@ bool NetworkSystem::netSetPathToCertFile ( str path )
 	return true;
 }
 
+void NetworkSystem::netSetTLSWrite ( int bytes )
+{
+	m_tlsWrite = imax ( bytes, 16384 );			// at least one full record
+}
+
+bool NetworkSystem::netSetTLSTicketKeys ( str path )
+{
+	m_pathTicketKeys = path;
+	#ifdef BUILD_OPENSSL
+		std::lock_guard<std::mutex> lock ( m_tlsMtx );
+		if ( m_tlsCtxSrv != 0x0 ) return tls_ticket_keys ( m_tlsCtxSrv, path );		// server already started
+	#endif
+	return true;
+}
+
 //----------------------------------------------------------------------------------------------------------------------
 // -> END <-
 //----------------------------------------------------------------------------------------------------------------------
@@ -0,0 +1,142 @@
+//--------------------------------------------------------------------------------
+// Copyright 2007-2022 (c) Quanta Sciences, Rama Hoetzlein, ramakarl.com
+//
+// * Derivative works may append the above copyright notice but should not remove or modify earlier notices.
+//
+// MIT License:
+// Permission is hereby granted, free of charge, to any person obtaining a copy of this software and
+// associated documentation files (the "Software"), to deal in the Software without restriction, including without
+// limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software,
+// and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+// The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+// OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+// BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF
+// OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+//
+
+
+#include "network_timer.h"
+
+NetTimerWheel::NetTimerWheel ()
+{
+	init ( 0 );
+}
+
+void NetTimerWheel::init ( uint64_t now_ms, int tick_ms )
+{
+	m_timers.clear ();
+	m_free.clear ();
+	for ( int l = 0; l < NET_TIMER_LEVELS; l++ )
+		for ( int n = 0; n < NET_TIMER_SLOTS; n++ ) m_head[ l ][ n ] = -1;
+	m_tickMs = ( tick_ms > 0 ) ? tick_ms : 1;
+	m_tick = now_ms / m_tickMs;
+	m_count = 0;
+}
+
+// Put timer in the slot for its deadline, relative to base (the first tick not yet processed)
+void NetTimerWheel::place ( int id, uint64_t base )
+{
+	Timer& t = m_timers[ id ];
+	uint64_t delta = t.due - base;
+	uint64_t due = t.due;
+	int level = 0;
+	while ( level < NET_TIMER_LEVELS - 1 && delta >= ( (uint64_t) 1 << ( NET_TIMER_BITS * ( level + 1 ) ) ) ) level++;
+	if ( level == NET_TIMER_LEVELS - 1 ) {
+		uint64_t span = (uint64_t) 1 << ( NET_TIMER_BITS * NET_TIMER_LEVELS );
+		if ( delta >= span ) due = base + span - 1;					// beyond last wheel, placed again on cascade
+	}
+	t.level = level;
+	t.slot = (int) ( due >> ( NET_TIMER_BITS * level ) ) & ( NET_TIMER_SLOTS - 1 );
+	t.prev = -1;
+	t.next = m_head[ level ][ t.slot ];
+	if ( t.next >= 0 ) m_timers[ t.next ].prev = id;
+	m_head[ level ][ t.slot ] = id;
+}
+
+void NetTimerWheel::unlink ( int id )
+{
+	Timer& t = m_timers[ id ];
+	if ( t.prev >= 0 )	m_timers[ t.prev ].next = t.next;
+	else								m_head[ t.level ][ t.slot ] = t.next;
+	if ( t.next >= 0 ) m_timers[ t.next ].prev = t.prev;
+	t.level = -1;
+}
+
+int NetTimerWheel::add ( uint64_t due_ms, int sock, uint32_t gen, int kind )
+{
+	int id;
+	if ( !m_free.empty () ) {
+		id = m_free.back ();
+		m_free.pop_back ();
+	} else {
+		id = (int) m_timers.size ();
+		m_timers.push_back ( Timer () );
+	}
+	Timer& t = m_timers[ id ];
+	t.due = ( due_ms + m_tickMs - 1 ) / m_tickMs;			// round up, never early
+	if ( t.due <= m_tick ) t.due = m_tick + 1;
+	t.sock = sock;
+	t.gen = gen;
+	t.kind = kind;
+	place ( id, m_tick + 1 );
+	m_count++;
+	return id;
+}
+
+void NetTimerWheel::cancel ( int id )
+{
+	if ( id < 0 || id >= (int) m_timers.size () || m_timers[ id ].level < 0 ) return;
+	unlink ( id );
+	m_free.push_back ( id );
+	m_count--;
+}
+
+// Move a slot of a higher wheel down. The list is detached first, as timers due a full 
+// revolution later go back into the same slot.
+void NetTimerWheel::cascade ( int level, uint64_t base )
+{
+	int slot = (int) ( base >> ( NET_TIMER_BITS * level ) ) & ( NET_TIMER_SLOTS - 1 );
+	int id = m_head[ level ][ slot ];
+	m_head[ level ][ slot ] = -1;
+	while ( id >= 0 ) {
+		int next = m_timers[ id ].next;
+		place ( id, base );
+		id = next;
+	}
+}
+
+int NetTimerWheel::advance ( uint64_t now_ms, std::vector<NetTimerFire>& fired )
+{
+	uint64_t now = now_ms / m_tickMs;
+	int cnt = 0;
+	if ( m_count == 0 && now > m_tick ) m_tick = now;			// nothing to expire
+
+	while ( m_tick < now ) {
+		uint64_t tick = m_tick + 1;
+
+		// cascade wheels which wrap at this tick, highest first
+		int wrap = 0;
+		while ( wrap < NET_TIMER_LEVELS - 1 && ( tick & ( ( (uint64_t) 1 << ( NET_TIMER_BITS * ( wrap + 1 ) ) ) - 1 ) ) == 0 ) wrap++;
+		for ( int l = wrap; l > 0; l-- ) cascade ( l, tick );
+
+		// expire slot
+		int slot = (int) tick & ( NET_TIMER_SLOTS - 1 );
+		int id = m_head[ 0 ][ slot ];
+		m_head[ 0 ][ slot ] = -1;
+		while ( id >= 0 ) {
+			Timer& t = m_timers[ id ];
+			int next = t.next;
+			t.level = -1;
+			fired.push_back ( NetTimerFire { id, t.sock, t.gen, t.kind } );
+			m_free.push_back ( id );
+			m_count--;
+			cnt++;
+			id = next;
+		}
+		m_tick = tick;
+		if ( m_count == 0 ) m_tick = now;
+	}
+	return cnt;
+}
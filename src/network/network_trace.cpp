@@ -0,0 +1,173 @@
+//--------------------------------------------------------------------------------
+// Copyright 2007-2022 (c) Quanta Sciences, Rama Hoetzlein, ramakarl.com
+//
+// * Derivative works may append the above copyright notice but should not remove or modify earlier notices.
+//
+// MIT License:
+// Permission is hereby granted, free of charge, to any person obtaining a copy of this software and
+// associated documentation files (the "Software"), to deal in the Software without restriction, including without
+// limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software,
+// and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+// The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+// OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+// BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF
+// OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+//
+
+#include "network_trace.h"
+#include "string_helper.h"
+#include "timex.h"
+
+#include <stdio.h>
+#include <mutex>
+#include <vector>
+#include <algorithm>
+
+// File layout: header, then per thread: NetTraceFileRing and its records, oldest first.
+#define NET_TRACE_MAGIC		0x4352544E		// 'NTRC'
+#define NET_TRACE_VERSION	1
+
+struct NetTraceFileHdr {
+	uint32_t	magic;
+	uint32_t	version;
+	uint32_t	num_rings;
+	uint32_t	pad;
+};
+struct NetTraceFileRing {
+	uint32_t	thread;
+	uint32_t	pad;
+	uint64_t	count;
+};
+
+// Ring owned by one thread. Only the owner writes records and pos.
+// Rings are kept until exit, so a dump includes threads which have finished.
+struct NetTraceRing {
+	uint32_t		thread;
+	uint32_t		gen;				// trace session, rings are cleared on a new session
+	std::atomic<uint64_t>	pos;
+	std::vector<NetTraceRec> recs;
+};
+
+HELPAPI std::atomic<bool>	g_netTraceOn ( false );
+static std::atomic<uint32_t>	g_traceGen ( 0 );
+static int								g_traceSize = NET_TRACE_RECORDS;
+static std::mutex					g_traceMtx;
+static std::vector<NetTraceRing*>	g_traceRings;
+static thread_local NetTraceRing*	t_traceRing = 0x0;
+
+static const char* g_traceNames[ NT_MAX ] = {
+	"none", "poll", "recv", "recv_event", "queue", "dispatch", "send", "send_queue",
+	"send_partial", "send_flush", "udp_recv", "udp_send", "accept", "close"
+};
+
+const char* netTraceName ( int id )
+{
+	return ( id >= 0 && id < NT_MAX ) ? g_traceNames[ id ] : "?";
+}
+
+void netTraceStart ( int records )
+{
+	std::lock_guard<std::mutex> lock ( g_traceMtx );
+	int sz = 1024;
+	while ( sz < records ) sz <<= 1;			// power of 2
+	g_traceSize = sz;
+	g_traceGen.fetch_add ( 1 );							// rings reset on next write
+	g_netTraceOn.store ( true );
+}
+
+void netTraceStop ()
+{
+	g_netTraceOn.store ( false );
+}
+
+void netTraceWrite ( uint32_t id, int sock, int64_t arg )
+{
+	NetTraceRing* r = t_traceRing;
+	uint32_t gen = g_traceGen.load ( std::memory_order_relaxed );
+	if ( r == 0x0 || r->gen != gen ) {
+		std::lock_guard<std::mutex> lock ( g_traceMtx );
+		if ( r == 0x0 ) {
+			r = new NetTraceRing;
+			r->thread = (uint32_t) g_traceRings.size();
+			g_traceRings.push_back ( r );
+			t_traceRing = r;
+		}
+		r->recs.resize ( g_traceSize );
+		r->pos.store ( 0, std::memory_order_relaxed );
+		r->gen = g_traceGen.load ( std::memory_order_relaxed );
+	}
+	uint64_t pos = r->pos.load ( std::memory_order_relaxed );
+	NetTraceRec& rec = r->recs[ pos & ( r->recs.size() - 1 ) ];
+	rec.time = TimeX::GetSystemNSec ();
+	rec.id = id;
+	rec.sock = sock;
+	rec.arg = arg;
+	r->pos.store ( pos + 1, std::memory_order_release );
+}
+
+// Write rings of the current session. Call after netTraceStop for a consistent file;
+// while tracing, the newest records of a ring may be partly written.
+bool netTraceDump ( const char* fn )
+{
+	FILE* fp = fopen ( fn, "wb" );
+	if ( fp == 0x0 ) return false;
+
+	std::lock_guard<std::mutex> lock ( g_traceMtx );
+	uint32_t gen = g_traceGen.load ();
+	std::vector<NetTraceRing*> rings;
+	for ( NetTraceRing* r : g_traceRings )
+		if ( r->gen == gen ) rings.push_back ( r );
+
+	NetTraceFileHdr hdr = { NET_TRACE_MAGIC, NET_TRACE_VERSION, (uint32_t) rings.size(), 0 };
+	fwrite ( &hdr, sizeof(hdr), 1, fp );
+	for ( NetTraceRing* r : rings ) {
+		uint64_t pos = r->pos.load ( std::memory_order_acquire );
+		uint64_t sz = r->recs.size();
+		uint64_t cnt = std::min ( pos, sz );
+		NetTraceFileRing fr = { r->thread, 0, cnt };
+		fwrite ( &fr, sizeof(fr), 1, fp );
+		for ( uint64_t i = pos - cnt; i < pos; i++ )
+			fwrite ( &r->recs[ i & (sz-1) ], sizeof(NetTraceRec), 1, fp );
+	}
+	fclose ( fp );
+	return true;
+}
+
+// Decode a dump to text, one record per line, all threads merged in time order:
+//   usec  thread  name  sock  arg
+bool netTraceDecode ( const char* bin_fn, const char* txt_fn )
+{
+	FILE* fp = fopen ( bin_fn, "rb" );
+	if ( fp == 0x0 ) return false;
+	NetTraceFileHdr hdr;
+	if ( fread ( &hdr, sizeof(hdr), 1, fp ) != 1 || hdr.magic != NET_TRACE_MAGIC || hdr.version != NET_TRACE_VERSION ) {
+		fclose ( fp );
+		return false;
+	}
+	std::vector< std::pair<NetTraceRec, uint32_t> > all;			// record, thread
+	for ( uint32_t n = 0; n < hdr.num_rings; n++ ) {
+		NetTraceFileRing fr;
+		if ( fread ( &fr, sizeof(fr), 1, fp ) != 1 ) break;
+		NetTraceRec rec;
+		for ( uint64_t i = 0; i < fr.count && fread ( &rec, sizeof(rec), 1, fp ) == 1; i++ )
+			all.push_back ( std::make_pair ( rec, fr.thread ) );
+	}
+	fclose ( fp );
+
+	std::stable_sort ( all.begin(), all.end(), [] ( const std::pair<NetTraceRec, uint32_t>& a, const std::pair<NetTraceRec, uint32_t>& b ) { return a.first.time < b.first.time; } );
+
+	FILE* out = fopen ( txt_fn, "wt" );
+	if ( out == 0x0 ) return false;
+	uint64_t t0 = all.empty() ? 0 : all[0].first.time;
+	for ( auto& a : all ) {
+		NetTraceRec& r = a.first;
+		bool is_name = ( r.id == NT_RECV_EVENT || r.id == NT_QUEUE || r.id == NT_DISPATCH || r.id == NT_SEND );
+		fprintf ( out, "%14.3f  T%-3u %-13s sock %-5d ", (r.time - t0) / 1000.0, a.second, netTraceName ( r.id ), r.sock );
+		if ( is_name )	fprintf ( out, "%s\n", nameToStr ( (nameStr_t) r.arg ).c_str() );
+		else						fprintf ( out, "%lld\n", (long long) r.arg );
+	}
+	fclose ( out );
+	return true;
+}